@@ -0,0 +1,562 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SGFX_NS_INTERNAL sgfx_ns_bench_internal
+#define SGFX_INTERNAL_IMPLEMENTATION 1
+
+#ifdef _MSC_VER
+#   define SGFX_FORCE_INLINE __forceinline
+#else
+#   define SGFX_FORCE_INLINE __attribute__((always_inline)) inline
+#endif
+
+#include "sigrlinn.hh"
+
+// DrawQueue recording microbenchmark, does not need a GPU
+//
+// Records the same frame into a single queue over and over, reports recorded draw calls per
+// second and the amount of command data produced per draw call. The same frames are recorded into
+// a copy of the draw queue as it was before the command stream (a full DrawCall per draw), so the
+// before and after columns come from the same run.
+//
+// The threaded part splits a fixed amount of draw calls between child queues recorded from
+// separate threads, then walks the merged streams the same way a backend does on submit.
+//
+// The sorting part records keyed draw calls into many queues and measures the merge and the radix
+// sort done by the multi-queue submit. Runs of draw calls share a key that starts with their
+// material, the bind calls a backend would make for the sorted ranges are counted as well.
+//
+// The merging part walks streams of consecutive index ranges with and without the draw merging
+// pass and reports how many draw calls were folded.
+
+namespace sgfx
+{
+void* allocate(size_t size) { return malloc(size); }
+void  deallocate(void* ptr) { free(ptr); }
+}
+
+using namespace sgfx;
+using namespace sgfx::SGFX_NS_INTERNAL;
+
+// transient queue storage, reset after every frame
+static FrameArena g_frameArena;
+
+enum
+{
+    kNumDrawCalls = 50000,
+    kNumFrames    = 20,
+    kNumTextures  = 4,
+    kNumObjects   = 64,
+
+    kNumThreadedDrawCalls = 800000,
+    kNumThreadedFrames    = 5,
+    kMaxThreads           = 16,
+
+    kNumSortedQueues      = 64,
+    kNumSortedDrawCalls   = 2000, // per queue
+    kNumSortedMaterials   = 16,
+    kSortedRunLength      = 16    // draw calls of one object, they share the key
+};
+
+// fake handles, the queue never dereferences them
+template <typename T>
+static T fakeHandle(size_t idx) { return T(reinterpret_cast<void*>((idx + 1) * 64)); }
+
+// a copy of the former DrawQueue recording: every draw call copies the whole DrawCall with all
+// of its slots into an array and clears it again
+struct FatDrawCall final
+{
+    enum
+    {
+        kMaxConstantBuffers = 8,
+        kMaxShaderResources = 128,
+        kMaxVertexBuffers   = 16
+    };
+
+    ConstantBufferHandle constantBuffers[kMaxConstantBuffers];
+    ShaderResource       shaderResources[kMaxShaderResources];
+
+    BufferHandle      vertexBuffers[kMaxVertexBuffers];
+    BufferHandle      indexBuffer;
+    BufferHandle      indirectArgsBuffer;
+    size_t            indirectArgsOffset;
+    PrimitiveTopology primitiveTopology;
+
+    uint32_t       instanceCount;
+    uint32_t       count;
+    uint32_t       startVertex;
+    uint32_t       startIndex;
+    uint32_t       startInstance;
+    DrawCall::Type type;
+};
+
+class FatDrawQueue final
+{
+    FatDrawCall                           currentDrawCall;
+    DynamicArray<FatDrawCall, 4096, 4096> drawCalls;
+
+public:
+
+    FatDrawQueue() { std::memset(static_cast<void*>(&currentDrawCall), 0, sizeof(currentDrawCall)); }
+
+    SGFX_FORCE_INLINE size_t getSize() const { return drawCalls.GetSize() * sizeof(FatDrawCall); }
+    SGFX_FORCE_INLINE void   clear()         { drawCalls.Clear(); }
+
+    SGFX_FORCE_INLINE void setPrimitiveTopology(PrimitiveTopology topology)   { currentDrawCall.primitiveTopology = topology; }
+    SGFX_FORCE_INLINE void setVertexBuffer(uint32_t idx, BufferHandle handle) { currentDrawCall.vertexBuffers[idx] = handle; }
+    SGFX_FORCE_INLINE void setIndexBuffer(BufferHandle handle)                { currentDrawCall.indexBuffer = handle; }
+
+    SGFX_FORCE_INLINE void setConstantBuffer(uint32_t idx, ConstantBufferHandle resource)
+    {
+        currentDrawCall.constantBuffers[idx] = resource;
+    }
+
+    SGFX_FORCE_INLINE void setResource(uint32_t idx, TextureHandle resource)
+    {
+        currentDrawCall.shaderResources[idx] = ShaderResource(true, resource.value);
+    }
+
+    SGFX_FORCE_INLINE void drawIndexed(uint32_t count, uint32_t startIndex, uint32_t startVertex)
+    {
+        currentDrawCall.count       = count;
+        currentDrawCall.startVertex = startVertex;
+        currentDrawCall.startIndex  = startIndex;
+        currentDrawCall.type        = DrawCall::DrawIndexed;
+        drawCalls.Add(currentDrawCall);
+        std::memset(static_cast<void*>(&currentDrawCall), 0, sizeof(currentDrawCall));
+    }
+};
+
+struct Scenario
+{
+    const char* name;
+    uint32_t    changeMask; // what changes from one draw call to the next
+};
+
+enum : uint32_t
+{
+    ChangeNone           = 0,
+    ChangeConstantBuffer = (1U << 0),
+    ChangeTextures       = (1U << 1),
+    ChangeGeometry       = (1U << 2),
+    ChangeAll            = ChangeConstantBuffer | ChangeTextures | ChangeGeometry
+};
+
+template <typename Queue>
+static void recordFrame(Queue& queue, uint32_t changeMask, uint32_t numDrawCalls = kNumDrawCalls)
+{
+    for (uint32_t i = 0; i < numDrawCalls; ++i) {
+        size_t cb   = (changeMask & ChangeConstantBuffer) ? (i % kNumObjects) : 0;
+        size_t tex  = (changeMask & ChangeTextures)       ? (i % kNumObjects) * kNumTextures : 0;
+        size_t geom = (changeMask & ChangeGeometry)       ? (i % kNumObjects) : 0;
+
+        queue.setPrimitiveTopology(PrimitiveTopology::TriangleList);
+        queue.setVertexBuffer(0, fakeHandle<BufferHandle>(geom));
+        queue.setIndexBuffer(fakeHandle<BufferHandle>(kNumObjects + geom));
+        queue.setConstantBuffer(0, fakeHandle<ConstantBufferHandle>(cb));
+        for (uint32_t t = 0; t < kNumTextures; ++t)
+            queue.setResource(t, fakeHandle<TextureHandle>(tex + t));
+        queue.drawIndexed(36, 0, 0);
+    }
+}
+
+// decodes a command stream the way backends do, returns the number of draw calls
+static uint32_t walkCommands(const ArenaCommandBuffer& commands)
+{
+    CommandReader reader(commands);
+    DrawCall      call;
+    uint32_t      numDraws = 0;
+
+    uint8_t opcode = 0;
+    while (reader.ReadOpcode(opcode)) {
+        switch (opcode) {
+        case DrawCommand::SetPrimitiveTopology: { reader.Read<uint8_t>(); } break;
+        case DrawCommand::SetVertexBuffer:      { reader.Read<uint8_t>(); reader.Read<void*>(); } break;
+        case DrawCommand::SetIndexBuffer:       { reader.Read<void*>(); } break;
+        case DrawCommand::SetConstantBuffer:    { reader.Read<uint8_t>(); reader.Read<void*>(); } break;
+        case DrawCommand::SetResource:          { reader.Read<uint8_t>(); reader.Read<uint8_t>(); reader.Read<void*>(); } break;
+        case DrawCommand::SetBindGroup:         { reader.Read<uint8_t>(); reader.Read<void*>(); } break;
+        case DrawCommand::SetConstants:         { reader.Read<uint8_t>(); reader.ReadBytes(reader.Read<uint32_t>()); } break;
+        default: {
+            DrawQueue::readDrawCall(reader, opcode, call);
+            numDraws++;
+        } break;
+        }
+    }
+
+    return numDraws;
+}
+
+// same as walkCommands, but issues draw calls through the merging pass
+static uint32_t walkMergedCommands(const ArenaCommandBuffer& commands, bool merge, uint32_t& numMerged)
+{
+    CommandReader  reader(commands);
+    DrawCall       call;
+    DrawCallMerger merger(merge);
+    uint32_t       numIssued = 0;
+
+    auto issue = [&numIssued](const DrawCall&) { numIssued++; };
+
+    uint8_t opcode = 0;
+    while (reader.ReadOpcode(opcode)) {
+        if (opcode > DrawCommand::LastDraw)
+            merger.Flush(issue);
+
+        switch (opcode) {
+        case DrawCommand::SetPrimitiveTopology: { merger.SetTopology(static_cast<PrimitiveTopology>(reader.Read<uint8_t>())); } break;
+        case DrawCommand::SetVertexBuffer:      { reader.Read<uint8_t>(); reader.Read<void*>(); } break;
+        case DrawCommand::SetIndexBuffer:       { reader.Read<void*>(); } break;
+        case DrawCommand::SetConstantBuffer:    { reader.Read<uint8_t>(); reader.Read<void*>(); } break;
+        case DrawCommand::SetResource:          { reader.Read<uint8_t>(); reader.Read<uint8_t>(); reader.Read<void*>(); } break;
+        case DrawCommand::SetBindGroup:         { reader.Read<uint8_t>(); reader.Read<void*>(); } break;
+        case DrawCommand::SetConstants:         { reader.Read<uint8_t>(); reader.ReadBytes(reader.Read<uint32_t>()); } break;
+        default: {
+            DrawQueue::readDrawCall(reader, opcode, call);
+            merger.Add(call, issue);
+        } break;
+        }
+    }
+
+    merger.Flush(issue);
+    numMerged = merger.GetNumMerged();
+    return numIssued;
+}
+
+static void runThreaded()
+{
+    const uint32_t threadCounts[] = { 1, 2, 4, 8, 16 };
+
+    printf("\n%-16s %16s %12s %16s %12s\n", "threads", "draws/sec", "speedup", "submit ns/draw", "hw threads");
+
+    double baseline = 0.0;
+    for (uint32_t numThreads : threadCounts) {
+        DrawQueue* parent = new DrawQueue(&g_frameArena, PipelineStateHandle::invalidHandle());
+
+        DrawQueue* children[kMaxThreads];
+        for (uint32_t i = 0; i < numThreads; ++i)
+            children[i] = new DrawQueue(parent);
+
+        uint32_t drawsPerThread = kNumThreadedDrawCalls / numThreads;
+
+        double recordSeconds = 0.0;
+        double submitSeconds = 0.0;
+
+        for (uint32_t frame = 0; frame <= kNumThreadedFrames; ++frame) {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            std::vector<std::thread> threads;
+            for (uint32_t i = 0; i < numThreads; ++i) {
+                DrawQueue* child = children[i];
+                threads.emplace_back([child, drawsPerThread]() { recordFrame(*child, ChangeAll, drawsPerThread); });
+            }
+            for (std::thread& thread : threads)
+                thread.join();
+
+            auto recorded = std::chrono::high_resolution_clock::now();
+
+            // submit walks the parent and then every child in place, nothing is copied
+            uint32_t numDraws = walkCommands(parent->getCommands());
+            for (const DrawQueue* child : parent->getChildren())
+                numDraws += walkCommands(child->getCommands());
+
+            auto end = std::chrono::high_resolution_clock::now();
+
+            if (numDraws != drawsPerThread * numThreads)
+                printf("draw count mismatch: %u\n", numDraws);
+
+            if (frame != 0) { // first frame is a warm up
+                recordSeconds += std::chrono::duration<double>(recorded - start).count();
+                submitSeconds += std::chrono::duration<double>(end - recorded).count();
+            }
+            parent->clear();
+            g_frameArena.Reset();
+        }
+
+        double numDraws    = static_cast<double>(drawsPerThread) * numThreads * kNumThreadedFrames;
+        double drawsPerSec = numDraws / recordSeconds;
+        if (baseline == 0.0)
+            baseline = drawsPerSec;
+
+        printf(
+            "%-16u %16.0f %12.2f %16.2f %12u\n",
+            numThreads,
+            drawsPerSec,
+            drawsPerSec / baseline,
+            submitSeconds * 1e9 / numDraws,
+            std::thread::hardware_concurrency()
+        );
+
+        for (uint32_t i = 0; i < numThreads; ++i)
+            delete children[i];
+        delete parent;
+    }
+}
+
+// bind calls for the ranges of a sorted submit, bindings are reset between ranges and only the
+// slots that differ from the previous range are bound (see BindingSlots)
+static size_t countSortedBinds(const DrawQueueSorter& sorter)
+{
+    BindingSlots<void*, DrawCall::kMaxConstantBuffers> constantBuffers;
+    BindingSlots<void*, DrawCall::kMaxShaderResources> resources;
+
+    size_t numBinds = 0;
+    auto   count    = [&numBinds](uint32_t, uint32_t, void* const*) { numBinds++; };
+
+    for (size_t i = 0; i < sorter.GetSize(); ++i) {
+        constantBuffers.Reset();
+        resources.Reset();
+
+        CommandReader reader(sorter[i].begin, sorter[i].end);
+        DrawCall      call;
+
+        uint8_t opcode = 0;
+        while (reader.ReadOpcode(opcode)) {
+            switch (opcode) {
+            case DrawCommand::SetPrimitiveTopology: { reader.Read<uint8_t>(); } break;
+            case DrawCommand::SetVertexBuffer:      { reader.Read<uint8_t>(); reader.Read<void*>(); } break;
+            case DrawCommand::SetIndexBuffer:       { reader.Read<void*>(); } break;
+            case DrawCommand::SetBindGroup:         { reader.Read<uint8_t>(); reader.Read<void*>(); } break;
+            case DrawCommand::SetConstants:         { reader.Read<uint8_t>(); reader.ReadBytes(reader.Read<uint32_t>()); } break;
+            case DrawCommand::SetConstantBuffer: {
+                uint8_t slot = reader.Read<uint8_t>();
+                constantBuffers.Set(slot, reader.Read<void*>());
+            } break;
+            case DrawCommand::SetResource: {
+                uint8_t slot = reader.Read<uint8_t>();
+                reader.Read<uint8_t>();
+                resources.Set(slot, reader.Read<void*>());
+            } break;
+            default: {
+                DrawQueue::readDrawCall(reader, opcode, call);
+                constantBuffers.Flush(count);
+                resources.Flush(count);
+            } break;
+            }
+        }
+    }
+
+    return numBinds;
+}
+
+static void runSorted()
+{
+    DrawQueue* queues[kNumSortedQueues];
+    for (uint32_t i = 0; i < kNumSortedQueues; ++i)
+        queues[i] = new DrawQueue(&g_frameArena, fakeHandle<PipelineStateHandle>(i % 8));
+
+    DrawQueueSorter sorter;
+
+    printf("\n%-16s %16s %12s %16s %12s %12s\n", "sorting", "draws/sec", "ns/draw", "bytes/draw", "ranges", "binds/draw");
+
+    const char* names[] = { "unsorted", "sorted" };
+    for (uint32_t sorted = 0; sorted < 2; ++sorted) {
+        double recordSeconds = 0.0;
+        double sortSeconds   = 0.0;
+        size_t totalBytes    = 0;
+        size_t totalRanges   = 0;
+        size_t totalBinds    = 0;
+
+        for (uint32_t frame = 0; frame <= kNumFrames; ++frame) {
+            uint32_t random   = 12345;
+            uint32_t material = 0;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (DrawQueue* queue : queues) {
+                for (uint32_t i = 0; i < kNumSortedDrawCalls; ++i) {
+                    if (i % kSortedRunLength == 0) {
+                        random   = random * 1664525 + 1013904223;
+                        material = (random >> 16) % kNumSortedMaterials;
+                        if (sorted)
+                            queue->setSortKey((static_cast<uint64_t>(material) << 32) | (random & 0xFFFF));
+                    }
+                    queue->setConstantBuffer(0, fakeHandle<ConstantBufferHandle>(i % kNumObjects));
+                    queue->setResource(0, fakeHandle<TextureHandle>(material));
+                    queue->drawIndexed(36, 0, 0);
+                }
+            }
+            auto recorded = std::chrono::high_resolution_clock::now();
+
+            sorter.Clear();
+            for (DrawQueue* queue : queues)
+                sorter.Add(queue);
+            sorter.Sort();
+
+            auto end = std::chrono::high_resolution_clock::now();
+
+            if (frame != 0) { // first frame is a warm up
+                recordSeconds += std::chrono::duration<double>(recorded - start).count();
+                sortSeconds   += std::chrono::duration<double>(end - recorded).count();
+                totalRanges   += sorter.GetSize();
+                totalBinds    += countSortedBinds(sorter);
+                for (DrawQueue* queue : queues)
+                    totalBytes += queue->getCommands().GetSize();
+            }
+
+            for (DrawQueue* queue : queues)
+                queue->clear();
+            g_frameArena.Reset();
+        }
+
+        double numDraws = static_cast<double>(kNumSortedDrawCalls) * kNumSortedQueues * kNumFrames;
+        printf(
+            "%-16s %16.0f %12.2f %16.2f %12zu %12.2f\n",
+            names[sorted],
+            numDraws / (recordSeconds + sortSeconds),
+            (recordSeconds + sortSeconds) * 1e9 / numDraws,
+            static_cast<double>(totalBytes) / numDraws,
+            totalRanges / kNumFrames,
+            static_cast<double>(totalBinds) / numDraws
+        );
+    }
+
+    for (DrawQueue* queue : queues)
+        delete queue;
+}
+
+static void runMerged()
+{
+    DrawQueue* queue = new DrawQueue(&g_frameArena, PipelineStateHandle::invalidHandle());
+
+    printf("\n%-16s %16s %12s %12s %12s\n", "merging", "draws/sec", "ns/draw", "issued", "merged");
+
+    // runLength sub-meshes of one mesh share a constant buffer, the next mesh switches it
+    const uint32_t runLengths[] = { 1, 4, 16 };
+    for (uint32_t runLength : runLengths) {
+        for (uint32_t merge = 0; merge < 2; ++merge) {
+            double   totalSeconds = 0.0;
+            uint32_t numIssued    = 0;
+            uint32_t numMerged    = 0;
+
+            for (uint32_t frame = 0; frame <= kNumFrames; ++frame) {
+                for (uint32_t i = 0; i < kNumDrawCalls; ++i) {
+                    queue->setPrimitiveTopology(PrimitiveTopology::TriangleList);
+                    queue->setVertexBuffer(0, fakeHandle<BufferHandle>(0));
+                    queue->setIndexBuffer(fakeHandle<BufferHandle>(1));
+                    queue->setConstantBuffer(0, fakeHandle<ConstantBufferHandle>(i / runLength));
+                    queue->drawIndexed(36, (i % runLength) * 36, 0);
+                }
+
+                auto start = std::chrono::high_resolution_clock::now();
+                numIssued = walkMergedCommands(queue->getCommands(), merge != 0, numMerged);
+                auto end   = std::chrono::high_resolution_clock::now();
+
+                if (frame != 0) // first frame is a warm up
+                    totalSeconds += std::chrono::duration<double>(end - start).count();
+
+                queue->clear();
+                g_frameArena.Reset();
+            }
+
+            char name[32];
+            snprintf(name, sizeof(name), "%s_run%u", merge ? "merged" : "plain", runLength);
+
+            double numDraws = static_cast<double>(kNumDrawCalls) * kNumFrames;
+            printf(
+                "%-16s %16.0f %12.2f %12u %12u\n",
+                name,
+                numDraws / totalSeconds,
+                totalSeconds * 1e9 / numDraws,
+                numIssued,
+                numMerged
+            );
+        }
+    }
+
+    delete queue;
+}
+
+int main()
+{
+    const Scenario scenarios[] = {
+        { "static",          ChangeNone           },
+        { "constant_buffer", ChangeConstantBuffer },
+        { "textures",        ChangeTextures       },
+        { "everything",      ChangeAll            }
+    };
+
+    DrawQueue*    queue    = new DrawQueue(&g_frameArena, PipelineStateHandle::invalidHandle());
+    FatDrawQueue* fatQueue = new FatDrawQueue();
+
+    printf("sizeof(DrawQueue) = %zu, sizeof(ComputeQueue) = %zu\n\n", sizeof(DrawQueue), sizeof(ComputeQueue));
+    printf(
+        "%-16s %16s %12s %16s %16s %16s\n",
+        "scenario", "draws/sec", "ns/draw", "bytes/draw", "before ns/draw", "before bytes/draw"
+    );
+    for (const Scenario& scenario : scenarios) {
+        recordFrame(*queue, scenario.changeMask); // warm up
+        queue->clear();
+        recordFrame(*fatQueue, scenario.changeMask);
+        fatQueue->clear();
+
+        double totalSeconds    = 0.0;
+        size_t totalBytes      = 0;
+        double totalFatSeconds = 0.0;
+        size_t totalFatBytes   = 0;
+
+        for (uint32_t frame = 0; frame < kNumFrames; ++frame) {
+            auto start = std::chrono::high_resolution_clock::now();
+            recordFrame(*queue, scenario.changeMask);
+            auto end   = std::chrono::high_resolution_clock::now();
+
+            totalSeconds += std::chrono::duration<double>(end - start).count();
+            totalBytes   += queue->getCommands().GetSize();
+            queue->clear();
+            g_frameArena.Reset();
+
+            start = std::chrono::high_resolution_clock::now();
+            recordFrame(*fatQueue, scenario.changeMask);
+            end   = std::chrono::high_resolution_clock::now();
+
+            totalFatSeconds += std::chrono::duration<double>(end - start).count();
+            totalFatBytes   += fatQueue->getSize();
+            fatQueue->clear();
+        }
+
+        double numDraws = static_cast<double>(kNumDrawCalls) * kNumFrames;
+        printf(
+            "%-16s %16.0f %12.2f %16.2f %16.2f %16.2f\n",
+            scenario.name,
+            numDraws / totalSeconds,
+            totalSeconds * 1e9 / numDraws,
+            static_cast<double>(totalBytes) / numDraws,
+            totalFatSeconds * 1e9 / numDraws,
+            static_cast<double>(totalFatBytes) / numDraws
+        );
+    }
+
+    delete fatQueue;
+    delete queue;
+
+    runThreaded();
+    runSorted();
+    runMerged();
+
+    printf("\nframe arena capacity: %zu bytes\n", g_frameArena.GetCapacity());
+    return 0;
+}
@@ -0,0 +1,326 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+
+#include "sigrlinn.hh"
+
+// sgfx_bench: CPU overhead of the public API, runs headless against the null backend
+//
+// Every scenario goes through sgfx:: calls only, so the numbers are comparable between backends
+// that can be initialized without a window. Results are printed as JSON, one record per
+// scenario with the operations per second, nanoseconds per operation and, for draw calls, the
+// amount of command data recorded per draw.
+//
+// Scenarios:
+// - record_*: recording draw calls into a draw queue with varying amounts of state change
+// - submit_*: translating the recorded queue on submit
+// - compute_submit: binding resources to a compute queue and dispatching it
+// - map_unmap: writing a dynamic buffer through mapBuffer/unmapBuffer
+// - handle_lookup: resolving buffer handles
+
+using namespace sgfx;
+
+enum
+{
+    kNumDrawCalls     = 50000,
+    kNumFrames        = 20,
+    kNumWarmupFrames  = 2,
+    kNumObjects       = 64,
+    kNumTextures      = 4,
+
+    kNumDispatches    = 20000,
+    kNumMaps          = 100000,
+    kMapSize          = 256,
+    kNumLookups       = 1000000
+};
+
+enum : uint32_t
+{
+    ChangeNone           = 0,
+    ChangeConstantBuffer = (1U << 0),
+    ChangeTextures       = (1U << 1),
+    ChangeGeometry       = (1U << 2),
+    ChangeAll            = ChangeConstantBuffer | ChangeTextures | ChangeGeometry
+};
+
+struct Scenario
+{
+    const char* name;
+    uint32_t    changeMask; // what changes from one draw call to the next
+};
+
+struct Objects
+{
+    VertexShaderHandle   vertexShader;
+    PixelShaderHandle    pixelShader;
+    ComputeShaderHandle  computeShader;
+    SurfaceShaderHandle  surfaceShader;
+    PipelineStateHandle  pipelineState;
+
+    BufferHandle         vertexBuffers[kNumObjects];
+    BufferHandle         indexBuffers[kNumObjects];
+    ConstantBufferHandle constantBuffers[kNumObjects];
+    TextureHandle        textures[kNumObjects * kNumTextures];
+    BufferHandle         dynamicBuffer;
+};
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double seconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static bool g_firstResult = true;
+
+static void printResult(const char* name, const char* op, uint64_t count, double totalSeconds, double bytesPerOp)
+{
+    printf(
+        "%s\n    { \"name\": \"%s\", \"op\": \"%s\", \"count\": %llu, \"ops_per_sec\": %.0f, \"ns_per_op\": %.2f, \"bytes_per_op\": %.2f }",
+        g_firstResult ? "" : ",",
+        name, op,
+        static_cast<unsigned long long>(count),
+        count / totalSeconds,
+        totalSeconds * 1e9 / count,
+        bytesPerOp
+    );
+    g_firstResult = false;
+}
+
+static bool createObjects(Objects& objects)
+{
+    const char bytecode[] = "sgfx_bench";
+
+    objects.vertexShader  = createVertexShader(bytecode, sizeof(bytecode));
+    objects.pixelShader   = createPixelShader(bytecode, sizeof(bytecode));
+    objects.computeShader = createComputeShader(bytecode, sizeof(bytecode));
+    objects.surfaceShader = linkSurfaceShader(
+        objects.vertexShader,
+        HullShaderHandle::invalidHandle(),
+        DomainShaderHandle::invalidHandle(),
+        GeometryShaderHandle::invalidHandle(),
+        objects.pixelShader
+    );
+
+    PipelineStateDescriptor desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.shader = objects.surfaceShader;
+    objects.pipelineState = createPipelineState(desc);
+
+    float    vertices[36 * 3] = {};
+    uint16_t indices[36]      = {};
+    float    constants[16]    = {};
+
+    for (size_t i = 0; i < kNumObjects; ++i) {
+        objects.vertexBuffers[i]   = createBuffer(BufferFlags::VertexBuffer, vertices, sizeof(vertices), sizeof(float) * 3);
+        objects.indexBuffers[i]    = createBuffer(BufferFlags::IndexBuffer, indices, sizeof(indices), sizeof(uint16_t));
+        objects.constantBuffers[i] = createConstantBuffer(constants, sizeof(constants));
+    }
+    for (TextureHandle& texture : objects.textures)
+        texture = createTexture2D(4, 4, DataFormat::RGBA8, 1, 0);
+
+    objects.dynamicBuffer = createBuffer(BufferFlags::CPUWrite | BufferFlags::StructuredBuffer, nullptr, kMapSize, kMapSize);
+
+    return objects.pipelineState != PipelineStateHandle::invalidHandle() && isValid(objects.dynamicBuffer);
+}
+
+static void releaseObjects(Objects& objects)
+{
+    releaseBuffer(objects.dynamicBuffer);
+    for (TextureHandle texture : objects.textures)
+        releaseTexture(texture);
+    for (size_t i = 0; i < kNumObjects; ++i) {
+        releaseConstantBuffer(objects.constantBuffers[i]);
+        releaseBuffer(objects.indexBuffers[i]);
+        releaseBuffer(objects.vertexBuffers[i]);
+    }
+
+    releasePipelineState(objects.pipelineState);
+    releaseSurfaceShader(objects.surfaceShader);
+    releaseComputeShader(objects.computeShader);
+    releasePixelShader(objects.pixelShader);
+    releaseVertexShader(objects.vertexShader);
+}
+
+static void recordFrame(const Objects& objects, DrawQueueHandle queue, uint32_t changeMask)
+{
+    for (uint32_t i = 0; i < kNumDrawCalls; ++i) {
+        size_t cb   = (changeMask & ChangeConstantBuffer) ? (i % kNumObjects) : 0;
+        size_t tex  = (changeMask & ChangeTextures)       ? (i % kNumObjects) * kNumTextures : 0;
+        size_t geom = (changeMask & ChangeGeometry)       ? (i % kNumObjects) : 0;
+
+        setPrimitiveTopology(queue, PrimitiveTopology::TriangleList);
+        setVertexBuffer(queue, objects.vertexBuffers[geom]);
+        setIndexBuffer(queue, objects.indexBuffers[geom]);
+        setConstantBuffer(queue, 0, objects.constantBuffers[cb]);
+        for (uint32_t t = 0; t < kNumTextures; ++t)
+            setResource(queue, t, objects.textures[tex + t]);
+        drawIndexed(queue, 36, 0, 0);
+    }
+}
+
+static void runDrawScenarios(const Objects& objects)
+{
+    const Scenario scenarios[] = {
+        { "no_changes",       ChangeNone           },
+        { "constant_buffers", ChangeConstantBuffer },
+        { "textures",         ChangeTextures       },
+        { "geometry",         ChangeGeometry       },
+        { "all_changes",      ChangeAll            }
+    };
+
+    for (const Scenario& scenario : scenarios) {
+        DrawQueueHandle queue = createDrawQueue(objects.pipelineState);
+
+        double recordSeconds = 0.0;
+        double submitSeconds = 0.0;
+
+        for (uint32_t frame = 0; frame < kNumWarmupFrames + kNumFrames; ++frame) {
+            if (frame == kNumWarmupFrames)
+                null::resetStats();
+
+            auto start = Clock::now();
+            recordFrame(objects, queue, scenario.changeMask);
+            auto recorded = Clock::now();
+            submit(queue);
+            auto end = Clock::now();
+
+            endFrame();
+
+            if (frame >= kNumWarmupFrames) {
+                recordSeconds += seconds(start, recorded);
+                submitSeconds += seconds(recorded, end);
+            }
+        }
+
+        const null::Stats& stats = null::getStats();
+
+        uint64_t numDraws     = static_cast<uint64_t>(kNumDrawCalls) * kNumFrames;
+        double   bytesPerDraw = static_cast<double>(stats.numBytesRecorded) / numDraws;
+
+        char name[64];
+        snprintf(name, sizeof(name), "record_%s", scenario.name);
+        printResult(name, "draw", numDraws, recordSeconds, bytesPerDraw);
+        snprintf(name, sizeof(name), "submit_%s", scenario.name);
+        printResult(name, "draw", numDraws, submitSeconds, bytesPerDraw);
+
+        releaseDrawQueue(queue);
+    }
+}
+
+static void runComputeScenario(const Objects& objects)
+{
+    ComputeQueueHandle queue = createComputeQueue(objects.computeShader);
+
+    double totalSeconds = 0.0;
+    for (uint32_t frame = 0; frame < kNumWarmupFrames + kNumFrames; ++frame) {
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < kNumDispatches; ++i) {
+            setConstantBuffer(queue, 0, objects.constantBuffers[i % kNumObjects]);
+            setResource(queue, 0, objects.textures[i % kNumObjects]);
+            setResourceRW(queue, 0, objects.dynamicBuffer);
+            submit(queue, 64, 1, 1);
+        }
+        auto end = Clock::now();
+
+        if (frame >= kNumWarmupFrames)
+            totalSeconds += seconds(start, end);
+    }
+
+    printResult("compute_submit", "dispatch", static_cast<uint64_t>(kNumDispatches) * kNumFrames, totalSeconds, 0.0);
+
+    releaseComputeQueue(queue);
+}
+
+static void runMapScenario(const Objects& objects)
+{
+    uint8_t data[kMapSize];
+    memset(data, 0xAB, sizeof(data));
+
+    double totalSeconds = 0.0;
+    for (uint32_t frame = 0; frame < kNumWarmupFrames + kNumFrames; ++frame) {
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < kNumMaps; ++i) {
+            void* mapped = mapBuffer(objects.dynamicBuffer, MapType::Write);
+            if (mapped != nullptr)
+                memcpy(mapped, data, sizeof(data));
+            unmapBuffer(objects.dynamicBuffer);
+        }
+        auto end = Clock::now();
+
+        if (frame >= kNumWarmupFrames)
+            totalSeconds += seconds(start, end);
+    }
+
+    printResult("map_unmap", "map", static_cast<uint64_t>(kNumMaps) * kNumFrames, totalSeconds, kMapSize);
+}
+
+static void runLookupScenario(const Objects& objects)
+{
+    uint32_t numValid     = 0;
+    double   totalSeconds = 0.0;
+
+    for (uint32_t frame = 0; frame < kNumWarmupFrames + kNumFrames; ++frame) {
+        auto start = Clock::now();
+        for (uint32_t i = 0; i < kNumLookups; ++i)
+            numValid += isValid(objects.vertexBuffers[(i * 7) % kNumObjects]) ? 1 : 0;
+        auto end = Clock::now();
+
+        if (frame >= kNumWarmupFrames)
+            totalSeconds += seconds(start, end);
+    }
+
+    if (numValid != static_cast<uint32_t>(kNumLookups) * (kNumWarmupFrames + kNumFrames))
+        fprintf(stderr, "handle lookup mismatch: %u\n", numValid);
+
+    printResult("handle_lookup", "lookup", static_cast<uint64_t>(kNumLookups) * kNumFrames, totalSeconds, 0.0);
+}
+
+int main()
+{
+    if (!initNull(1280, 720)) {
+        fprintf(stderr, "failed to initialize the null backend\n");
+        return 1;
+    }
+
+    Objects objects;
+    if (!createObjects(objects)) {
+        fprintf(stderr, "failed to create benchmark objects\n");
+        return 1;
+    }
+
+    printf("{\n  \"backend\": \"null\",\n  \"draw_calls_per_frame\": %u,\n  \"results\": [", kNumDrawCalls);
+
+    runDrawScenarios(objects);
+    runComputeScenario(objects);
+    runMapScenario(objects);
+    runLookupScenario(objects);
+
+    printf("\n  ]\n}\n");
+
+    releaseObjects(objects);
+    shutdown();
+    return 0;
+}
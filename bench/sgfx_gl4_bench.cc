@@ -0,0 +1,215 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+#include <chrono>
+#include <stdio.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "sigrlinn.hh"
+
+// sgfx_gl4_bench: redundant state filtering of the GL4 backend, runs headless
+//
+// The context is a pbuffer created through EGL. On Mesa the surfaceless platform is used, so the
+// benchmark runs on llvmpipe without a display. Every frame submits kNumQueues draw queues, one
+// submit per queue, and the results list the GL state calls that reached the driver and the calls
+// the state shadow skipped, per submit. Their sum is what the backend issued without the shadow.
+//
+// Scenarios:
+// - same_pipeline: every queue uses the same pipeline state
+// - one_substate: neighbouring pipelines differ in the blend state only
+// - all_substates: neighbouring pipelines differ in every sub-state
+// - reset_every_frame: one_substate with gl4::resetStateCache at the start of each frame
+
+using namespace sgfx;
+
+enum
+{
+    kNumQueues        = 256,
+    kNumDrawsPerQueue = 4,
+    kNumFrames        = 50,
+    kNumWarmupFrames  = 2,
+    kNumPipelines     = 4
+};
+
+enum : uint32_t
+{
+    ChangeBlend        = (1U << 0),
+    ChangeRasterizer   = (1U << 1),
+    ChangeDepthStencil = (1U << 2),
+    ChangeAll          = ChangeBlend | ChangeRasterizer | ChangeDepthStencil
+};
+
+struct Scenario
+{
+    const char* name;
+    uint32_t    changeMask;      // sub-states that differ between neighbouring pipelines
+    bool        resetEveryFrame;
+};
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double seconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static bool createContext()
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay != nullptr)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+        return false;
+    if (!eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    const EGLint surfaceAttribs[] = {
+        EGL_WIDTH,  64,
+        EGL_HEIGHT, 64,
+        EGL_NONE
+    };
+
+    EGLConfig config     = nullptr;
+    EGLint    numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+        return false;
+
+    // compatibility profile, GLEW looks the extensions up with glGetString
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT)
+        return false;
+
+    return eglMakeCurrent(display, surface, surface, context) == EGL_TRUE;
+}
+
+static PipelineStateHandle createPipeline(uint32_t changeMask, uint32_t idx)
+{
+    PipelineStateDescriptor desc;
+    desc.blendState.blendDesc.blendEnabled = true;
+
+    if (changeMask & ChangeBlend)
+        desc.blendState.blendDesc.dstBlend = (idx & 1) ? BlendFactor::OneMinusSrcAlpha : BlendFactor::Zero;
+    if (changeMask & ChangeRasterizer)
+        desc.rasterizerState.cullMode = (idx & 1) ? CullMode::Front : CullMode::Back;
+    if (changeMask & ChangeDepthStencil)
+        desc.depthStencilState.depthFunc = (idx & 1) ? DepthFunc::LessEqual : DepthFunc::Less;
+
+    return createPipelineState(desc);
+}
+
+static void runScenario(const Scenario& scenario, bool firstResult)
+{
+    PipelineStateHandle pipelines[kNumPipelines];
+    for (uint32_t i = 0; i < kNumPipelines; ++i)
+        pipelines[i] = createPipeline(scenario.changeMask, i);
+
+    DrawQueueHandle queues[kNumQueues];
+    for (uint32_t i = 0; i < kNumQueues; ++i)
+        queues[i] = createDrawQueue(pipelines[i % kNumPipelines]);
+
+    double totalSeconds = 0.0;
+    for (uint32_t frame = 0; frame < kNumWarmupFrames + kNumFrames; ++frame) {
+        if (frame == kNumWarmupFrames)
+            gl4::resetStats();
+
+        auto start = Clock::now();
+        if (scenario.resetEveryFrame)
+            gl4::resetStateCache();
+
+        for (DrawQueueHandle queue : queues) {
+            setPrimitiveTopology(queue, PrimitiveTopology::TriangleList);
+            for (uint32_t i = 0; i < kNumDrawsPerQueue; ++i)
+                draw(queue, 3, 0);
+            submit(queue);
+        }
+        auto end = Clock::now();
+
+        endFrame();
+
+        if (frame >= kNumWarmupFrames)
+            totalSeconds += seconds(start, end);
+    }
+
+    const gl4::Stats& stats      = gl4::getStats();
+    uint64_t          numSubmits = static_cast<uint64_t>(kNumQueues) * kNumFrames;
+
+    printf(
+        "%s\n    { \"name\": \"%s\", \"submits\": %llu, \"state_calls_per_submit\": %.2f, \"skipped_calls_per_submit\": %.2f, \"ns_per_submit\": %.2f }",
+        firstResult ? "" : ",",
+        scenario.name,
+        static_cast<unsigned long long>(numSubmits),
+        static_cast<double>(stats.numStateCalls) / numSubmits,
+        static_cast<double>(stats.numSkippedStateCalls) / numSubmits,
+        totalSeconds * 1e9 / numSubmits
+    );
+
+    for (DrawQueueHandle queue : queues)
+        releaseDrawQueue(queue);
+    for (PipelineStateHandle pipeline : pipelines)
+        releasePipelineState(pipeline);
+}
+
+int main()
+{
+    if (!createContext()) {
+        fprintf(stderr, "failed to create an EGL context\n");
+        return 1;
+    }
+    if (!initOpenGL()) {
+        fprintf(stderr, "failed to initialize the GL4 backend\n");
+        return 1;
+    }
+
+    const Scenario scenarios[] = {
+        { "same_pipeline",     0,           false },
+        { "one_substate",      ChangeBlend, false },
+        { "all_substates",     ChangeAll,   false },
+        { "reset_every_frame", ChangeBlend, true  }
+    };
+
+    printf("{\n  \"backend\": \"gl4\",\n  \"queues_per_frame\": %u,\n  \"results\": [", kNumQueues);
+
+    bool firstResult = true;
+    for (const Scenario& scenario : scenarios) {
+        runScenario(scenario, firstResult);
+        firstResult = false;
+    }
+
+    printf("\n  ]\n}\n");
+
+    shutdown();
+    return 0;
+}
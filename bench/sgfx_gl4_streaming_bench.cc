@@ -0,0 +1,207 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "sigrlinn.hh"
+
+// sgfx_gl4_streaming_bench: per frame buffer updates of the GL4 backend, runs headless
+//
+// The context is created the same way as in sgfx_gl4_bench. Every frame rewrites a buffer
+// kNumUpdatesPerFrame times, each update is followed by a draw queue that reads it. The results
+// list the CPU cost of an update, the write maps served by the streaming copies and the waits for
+// the GPU to release a copy.
+//
+// Scenarios:
+// - copy_buffer_data: copyBufferData into a buffer the CPU does not map
+// - map_driver: mapBuffer on a buffer that can also be read back, so it is not streamed
+// - map_streaming: mapBuffer on a CPUWrite buffer, streamed through the persistently mapped copies
+// - map_streaming_overrun: map_streaming with more updates per frame than there are copies
+
+using namespace sgfx;
+
+enum
+{
+    kBufferSize      = 64 * 1024,
+    kNumFrames       = 200,
+    kNumWarmupFrames = 4
+};
+
+enum class UpdateMethod : uint32_t
+{
+    Copy,
+    Map
+};
+
+struct Scenario
+{
+    const char*  name;
+    UpdateMethod method;
+    uint32_t     flags;
+    uint32_t     numUpdatesPerFrame;
+};
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double seconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static bool createContext()
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay != nullptr)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+        return false;
+    if (!eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    const EGLint surfaceAttribs[] = {
+        EGL_WIDTH,  64,
+        EGL_HEIGHT, 64,
+        EGL_NONE
+    };
+
+    EGLConfig config     = nullptr;
+    EGLint    numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+        return false;
+
+    // compatibility profile, GLEW looks the extensions up with glGetString
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, nullptr);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT)
+        return false;
+
+    return eglMakeCurrent(display, surface, surface, context) == EGL_TRUE;
+}
+
+static void runScenario(const Scenario& scenario, PipelineStateHandle pipeline, bool firstResult)
+{
+    static uint8_t source[kBufferSize];
+
+    BufferHandle buffer = createBuffer(scenario.flags, nullptr, kBufferSize, 16);
+
+    double totalSeconds = 0.0;
+    for (uint32_t frame = 0; frame < kNumWarmupFrames + kNumFrames; ++frame) {
+        if (frame == kNumWarmupFrames)
+            gl4::resetStats();
+
+        for (uint32_t i = 0; i < scenario.numUpdatesPerFrame; ++i) {
+            memset(source, static_cast<int>(frame + i), sizeof(source));
+
+            auto start = Clock::now();
+            if (scenario.method == UpdateMethod::Copy) {
+                copyBufferData(buffer, 0, kBufferSize, source);
+            } else {
+                void* data = mapBuffer(buffer, MapType::Write);
+                if (data != nullptr)
+                    memcpy(data, source, kBufferSize);
+                unmapBuffer(buffer);
+            }
+            auto end = Clock::now();
+
+            DrawQueueHandle queue = createDrawQueue(pipeline);
+            setResource(queue, 0, buffer);
+            draw(queue, 3, 0);
+            submit(queue);
+            releaseDrawQueue(queue);
+
+            if (frame >= kNumWarmupFrames)
+                totalSeconds += seconds(start, end);
+        }
+
+        endFrame();
+    }
+
+    const gl4::Stats& stats      = gl4::getStats();
+    uint64_t          numUpdates = static_cast<uint64_t>(scenario.numUpdatesPerFrame) * kNumFrames;
+
+    printf(
+        "%s\n    { \"name\": \"%s\", \"updates\": %llu, \"streaming_maps\": %llu, \"streaming_orphans\": %llu, \"frame_stalls\": %llu, \"ns_per_update\": %.2f }",
+        firstResult ? "" : ",",
+        scenario.name,
+        static_cast<unsigned long long>(numUpdates),
+        static_cast<unsigned long long>(stats.numStreamingMaps),
+        static_cast<unsigned long long>(stats.numStreamingOrphans),
+        static_cast<unsigned long long>(stats.numFrameStalls),
+        totalSeconds * 1e9 / numUpdates
+    );
+
+    releaseBuffer(buffer);
+}
+
+int main()
+{
+    if (!createContext()) {
+        fprintf(stderr, "failed to create an EGL context\n");
+        return 1;
+    }
+    if (!initOpenGL()) {
+        fprintf(stderr, "failed to initialize the GL4 backend\n");
+        return 1;
+    }
+
+    const uint32_t kStreamed = BufferFlags::StructuredBuffer | BufferFlags::CPUWrite;
+
+    const Scenario scenarios[] = {
+        { "copy_buffer_data",      UpdateMethod::Copy, BufferFlags::StructuredBuffer,       1 },
+        { "map_driver",            UpdateMethod::Map,  kStreamed | BufferFlags::CPURead,    1 },
+        { "map_streaming",         UpdateMethod::Map,  kStreamed,                           1 },
+        { "map_streaming_overrun", UpdateMethod::Map,  kStreamed,                           4 }
+    };
+
+    PipelineStateDescriptor desc;
+    PipelineStateHandle     pipeline = createPipelineState(desc);
+
+    printf("{\n  \"backend\": \"gl4\",\n  \"buffer_size\": %u,\n  \"results\": [", kBufferSize);
+
+    bool firstResult = true;
+    for (const Scenario& scenario : scenarios) {
+        runScenario(scenario, pipeline, firstResult);
+        firstResult = false;
+    }
+
+    printf("\n  ]\n}\n");
+
+    releasePipelineState(pipeline);
+    shutdown();
+    return 0;
+}
@@ -0,0 +1,290 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+
+#include "sigrlinn.hh"
+
+#ifdef _WIN32
+#include <direct.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// sgfx_shadercache_bench: application startup with and without the shader cache, runs headless
+// against the null backend
+//
+// A startup loads the shader variants the demos load (every VS, PS, CS and VF permutation) the way
+// Application::loadShader does: read the file, compile, hand the bytecode back. Modes:
+// - nocache: sgfx::compileShader for every variant
+// - cold:    shadercache::compileShader with an empty cache directory, compiles and stores everything
+// - warm:    shadercache::compileShader with the entries of the previous startup, nothing is compiled
+//
+// The null backend compiles by copying the source, so nocache is the cost of the read alone and
+// warm - nocache is the overhead of the cache lookup. On D3D11 cold and nocache add the D3DCompile
+// time of every variant and warm does not. Results are printed as JSON in the sgfx_bench format,
+// ops are startups.
+
+using namespace sgfx;
+
+#ifndef SGFX_SHADER_DIR
+#define SGFX_SHADER_DIR "shaders"
+#endif
+
+enum
+{
+    kNumStartups = 50,
+    kMaxPath     = 1024
+};
+
+enum class Mode
+{
+    NoCache,
+    Cold,
+    Warm
+};
+
+struct Variant
+{
+    const char*         file;
+    ShaderCompileTarget target;
+    const char*         macro; // defined to 1, nullptr for none
+};
+
+static const Variant kVariants[] = {
+    { "sample0.hlsl",       ShaderCompileTarget::VS, nullptr            },
+    { "sample0.hlsl",       ShaderCompileTarget::PS, nullptr            },
+    { "sample0.hlsl",       ShaderCompileTarget::VS, "VF"               },
+    { "cmrs.hlsl",          ShaderCompileTarget::VS, nullptr            },
+    { "cmrs.hlsl",          ShaderCompileTarget::PS, nullptr            },
+    { "cmrs.hlsl",          ShaderCompileTarget::VS, "VF"               },
+    { "oit_cube.hlsl",      ShaderCompileTarget::VS, nullptr            },
+    { "oit_cube.hlsl",      ShaderCompileTarget::PS, nullptr            },
+    { "oit_cube.hlsl",      ShaderCompileTarget::VS, "VF"               },
+    { "oit_simple.hlsl",    ShaderCompileTarget::VS, nullptr            },
+    { "oit_simple.hlsl",    ShaderCompileTarget::PS, nullptr            },
+    { "oit_resolve.hlsl",   ShaderCompileTarget::VS, nullptr            },
+    { "oit_resolve.hlsl",   ShaderCompileTarget::PS, nullptr            },
+    { "dvp.hlsl",           ShaderCompileTarget::VS, nullptr            },
+    { "dvp.hlsl",           ShaderCompileTarget::PS, nullptr            },
+    { "dvp.hlsl",           ShaderCompileTarget::VS, "OCCLUSION_RENDER" },
+    { "dvp.hlsl",           ShaderCompileTarget::PS, "OCCLUSION_RENDER" },
+    { "dvp_cull.hlsl",      ShaderCompileTarget::CS, nullptr            },
+    { "dvp_downscale.hlsl", ShaderCompileTarget::CS, nullptr            },
+    { "particles.hlsl",     ShaderCompileTarget::VS, nullptr            },
+    { "particles.hlsl",     ShaderCompileTarget::PS, nullptr            },
+    { "particles_cs.hlsl",  ShaderCompileTarget::CS, nullptr            },
+    { "pbr_gbuffer.hlsl",   ShaderCompileTarget::VS, nullptr            },
+    { "pbr_gbuffer.hlsl",   ShaderCompileTarget::PS, nullptr            },
+    { "pbr_gbuffer.hlsl",   ShaderCompileTarget::VS, "VF"               },
+    { "pbr_resolve.hlsl",   ShaderCompileTarget::VS, nullptr            },
+    { "pbr_resolve.hlsl",   ShaderCompileTarget::PS, nullptr            }
+};
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double seconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static bool g_firstResult = true;
+
+static void printResult(const char* name, const char* op, uint64_t count, double totalSeconds, double bytesPerOp)
+{
+    printf(
+        "%s\n    { \"name\": \"%s\", \"op\": \"%s\", \"count\": %llu, \"ops_per_sec\": %.2f, \"ns_per_op\": %.2f, \"bytes_per_op\": %.2f }",
+        g_firstResult ? "" : ",",
+        name, op,
+        static_cast<unsigned long long>(count),
+        count / totalSeconds,
+        totalSeconds * 1e9 / count,
+        bytesPerOp
+    );
+    g_firstResult = false;
+}
+
+static void makeDirectory(const char* path)
+{
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+}
+
+// removes the cache entries, the directory itself stays
+static void clearDirectory(const char* path)
+{
+    char entryPath[kMaxPath];
+
+#ifdef _WIN32
+    char pattern[kMaxPath];
+    snprintf(pattern, sizeof(pattern), "%s/*.bin", path);
+
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    if (find == INVALID_HANDLE_VALUE)
+        return;
+    do {
+        snprintf(entryPath, sizeof(entryPath), "%s/%s", path, data.cFileName);
+        remove(entryPath);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+#else
+    DIR* dir = opendir(path);
+    if (dir == nullptr)
+        return;
+    while (dirent* entry = readdir(dir)) {
+        size_t length = strlen(entry->d_name);
+        if (length > 4 && strcmp(entry->d_name + length - 4, ".bin") == 0) {
+            snprintf(entryPath, sizeof(entryPath), "%s/%s", path, entry->d_name);
+            remove(entryPath);
+        }
+    }
+    closedir(dir);
+#endif
+}
+
+static char* readFile(const char* path, size_t& size)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr)
+        return nullptr;
+
+    fseek(file, 0, SEEK_END);
+    size = static_cast<size_t>(ftell(file));
+    fseek(file, 0, SEEK_SET);
+
+    char* data = new char[size + 1];
+    size = fread(data, 1, size, file);
+    data[size] = '\0';
+    fclose(file);
+
+    return data;
+}
+
+// one startup, returns the bytecode size of all variants or 0 on failure
+static size_t loadShaders(Mode mode, const char* cacheDirectory)
+{
+    size_t totalSize = 0;
+
+    for (const Variant& variant : kVariants) {
+        char path[kMaxPath];
+        snprintf(path, sizeof(path), "%s/%s", SGFX_SHADER_DIR, variant.file);
+
+        size_t sourceSize = 0;
+        char*  source     = readFile(path, sourceSize);
+        if (source == nullptr) {
+            fprintf(stderr, "failed to read %s\n", path);
+            return 0;
+        }
+
+        ShaderCompileMacro macro = { variant.macro, "1" };
+        size_t             numMacros = (variant.macro != nullptr) ? 1 : 0;
+
+        void*  bytecode     = nullptr;
+        size_t bytecodeSize = 0;
+        bool   compiled     = (mode == Mode::NoCache)
+            ? sgfx::compileShader(source, sourceSize, ShaderCompileVersion::v5_0, variant.target, &macro, numMacros, 0, nullptr, bytecode, bytecodeSize)
+            : shadercache::compileShader(cacheDirectory, source, sourceSize, ShaderCompileVersion::v5_0, variant.target, &macro, numMacros, 0, nullptr, bytecode, bytecodeSize);
+
+        delete [] source;
+        if (!compiled)
+            return 0;
+
+        totalSize += bytecodeSize;
+        deallocate(bytecode);
+    }
+
+    return totalSize;
+}
+
+static bool runMode(const char* name, Mode mode, const char* cacheDirectory)
+{
+    double totalSeconds = 0.0;
+    size_t totalSize    = 0;
+
+    shadercache::resetStats();
+
+    for (uint32_t i = 0; i < kNumStartups; ++i) {
+        if (mode == Mode::Cold)
+            clearDirectory(cacheDirectory);
+
+        auto start = Clock::now();
+        totalSize = loadShaders(mode, cacheDirectory);
+        totalSeconds += seconds(start, Clock::now());
+
+        if (totalSize == 0)
+            return false;
+    }
+
+    // every cold startup misses and every warm one hits
+    shadercache::Stats stats = shadercache::getStats();
+    uint64_t expected = static_cast<uint64_t>(kNumStartups) * (sizeof(kVariants) / sizeof(kVariants[0]));
+    if ((mode == Mode::Cold && (stats.numMisses != expected || stats.numFailedWrites != 0)) ||
+        (mode == Mode::Warm && stats.numHits != expected)) {
+        fprintf(stderr, "%s: unexpected cache stats, hits %llu misses %llu failed writes %llu\n", name,
+            static_cast<unsigned long long>(stats.numHits),
+            static_cast<unsigned long long>(stats.numMisses),
+            static_cast<unsigned long long>(stats.numFailedWrites));
+        return false;
+    }
+
+    printResult(name, "startup", kNumStartups, totalSeconds, static_cast<double>(totalSize));
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const char* cacheDirectory = (argc > 1) ? argv[1] : "sgfx_shadercache_bench.cache";
+
+    makeDirectory(cacheDirectory);
+    clearDirectory(cacheDirectory);
+
+    if (!initNull(1280, 720)) {
+        fprintf(stderr, "failed to initialize the null backend\n");
+        return 1;
+    }
+
+    printf(
+        "{\n  \"backend\": \"null\",\n  \"shaders_per_startup\": %u,\n  \"results\": [",
+        static_cast<uint32_t>(sizeof(kVariants) / sizeof(kVariants[0]))
+    );
+
+    // cold leaves the entries of its last startup for warm
+    bool succeeded =
+        runMode("nocache", Mode::NoCache, cacheDirectory) &&
+        runMode("cold",    Mode::Cold,    cacheDirectory) &&
+        runMode("warm",    Mode::Warm,    cacheDirectory);
+
+    printf("\n  ]\n}\n");
+
+    clearDirectory(cacheDirectory);
+    shutdown();
+
+    return succeeded ? 0 : 1;
+}
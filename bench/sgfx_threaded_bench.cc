@@ -0,0 +1,236 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+#include <chrono>
+#include <string.h>
+#include <stdio.h>
+
+#include "sigrlinn.hh"
+
+// sgfx_threaded_bench: frame time with and without threaded mode, runs headless against the null
+// backend built with the threaded layer
+//
+// Every frame spends a fixed amount of time on simulated game work, then records, submits and ends
+// the frame. Without threaded mode the frame time is the sum of both, with it the render thread
+// translates frame N while the main thread works on frame N + 1. Results are printed as JSON in
+// the sgfx_bench format, one record per mode, ops are frames.
+
+using namespace sgfx;
+
+enum
+{
+    kNumDrawCalls    = 20000,
+    kNumFrames       = 50,
+    kNumWarmupFrames = 5,
+    kNumObjects      = 64,
+    kGameWorkMicros  = 4000
+};
+
+struct Mode
+{
+    const char* name;
+    bool        threaded;
+    uint32_t    maxFramesInFlight;
+};
+
+struct Objects
+{
+    VertexShaderHandle   vertexShader;
+    PixelShaderHandle    pixelShader;
+    SurfaceShaderHandle  surfaceShader;
+    PipelineStateHandle  pipelineState;
+
+    BufferHandle         vertexBuffers[kNumObjects];
+    ConstantBufferHandle constantBuffers[kNumObjects];
+    TextureHandle        textures[kNumObjects];
+};
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double seconds(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static bool g_firstResult = true;
+
+static void printResult(const char* name, const char* op, uint64_t count, double totalSeconds, double bytesPerOp)
+{
+    printf(
+        "%s\n    { \"name\": \"%s\", \"op\": \"%s\", \"count\": %llu, \"ops_per_sec\": %.2f, \"ns_per_op\": %.2f, \"bytes_per_op\": %.2f }",
+        g_firstResult ? "" : ",",
+        name, op,
+        static_cast<unsigned long long>(count),
+        count / totalSeconds,
+        totalSeconds * 1e9 / count,
+        bytesPerOp
+    );
+    g_firstResult = false;
+}
+
+static void createObjects(Objects& objects)
+{
+    const char bytecode[] = "sgfx_threaded_bench";
+
+    objects.vertexShader  = createVertexShader(bytecode, sizeof(bytecode));
+    objects.pixelShader   = createPixelShader(bytecode, sizeof(bytecode));
+    objects.surfaceShader = linkSurfaceShader(
+        objects.vertexShader,
+        HullShaderHandle::invalidHandle(),
+        DomainShaderHandle::invalidHandle(),
+        GeometryShaderHandle::invalidHandle(),
+        objects.pixelShader
+    );
+
+    PipelineStateDescriptor desc;
+    memset(&desc, 0, sizeof(desc));
+    desc.shader = objects.surfaceShader;
+    objects.pipelineState = createPipelineState(desc);
+
+    float vertices[36 * 3] = {};
+    float constants[16]    = {};
+
+    for (size_t i = 0; i < kNumObjects; ++i) {
+        objects.vertexBuffers[i]   = createBuffer(BufferFlags::VertexBuffer, vertices, sizeof(vertices), sizeof(float) * 3);
+        objects.constantBuffers[i] = createConstantBuffer(constants, sizeof(constants));
+        objects.textures[i]        = createTexture2D(4, 4, DataFormat::RGBA8, 1, 0);
+    }
+}
+
+static void releaseObjects(Objects& objects)
+{
+    for (size_t i = 0; i < kNumObjects; ++i) {
+        releaseTexture(objects.textures[i]);
+        releaseConstantBuffer(objects.constantBuffers[i]);
+        releaseBuffer(objects.vertexBuffers[i]);
+    }
+
+    releasePipelineState(objects.pipelineState);
+    releaseSurfaceShader(objects.surfaceShader);
+    releasePixelShader(objects.pixelShader);
+    releaseVertexShader(objects.vertexShader);
+}
+
+// busy wait, sleeping would hide how much of the frame the calling thread spends in sgfx
+static void simulateGameWork()
+{
+    auto start = Clock::now();
+    while (seconds(start, Clock::now()) * 1e6 < kGameWorkMicros) {}
+}
+
+static void recordFrame(const Objects& objects, DrawQueueHandle queue)
+{
+    float constants[16] = {};
+    for (size_t i = 0; i < kNumObjects; ++i)
+        updateConstantBuffer(objects.constantBuffers[i], constants);
+
+    for (uint32_t i = 0; i < kNumDrawCalls; ++i) {
+        size_t object = i % kNumObjects;
+
+        setPrimitiveTopology(queue, PrimitiveTopology::TriangleList);
+        setVertexBuffer(queue, objects.vertexBuffers[object]);
+        setConstantBuffer(queue, 0, objects.constantBuffers[object]);
+        setResource(queue, 0, objects.textures[object]);
+        draw(queue, 36, 0);
+    }
+    submit(queue);
+}
+
+static bool runMode(const Mode& mode)
+{
+    if (mode.threaded) {
+        threaded::Descriptor desc;
+        desc.maxFramesInFlight = mode.maxFramesInFlight;
+        if (!threaded::start(desc))
+            return false;
+    }
+
+    // initialized after start so the backend lives on the render thread
+    if (!initNull(1280, 720))
+        return false;
+
+    Objects objects;
+    createObjects(objects);
+    DrawQueueHandle queue = createDrawQueue(objects.pipelineState);
+
+    double gameSeconds  = 0.0;
+    double totalSeconds = 0.0;
+
+    for (uint32_t frame = 0; frame < kNumWarmupFrames + kNumFrames; ++frame) {
+        auto start = Clock::now();
+        simulateGameWork();
+        auto worked = Clock::now();
+        recordFrame(objects, queue);
+        endFrame();
+        auto end = Clock::now();
+
+        if (frame >= kNumWarmupFrames) {
+            gameSeconds  += seconds(start, worked);
+            totalSeconds += seconds(start, end);
+        }
+    }
+
+    // the render thread may still be on the last frames
+    auto drainStart = Clock::now();
+    threaded::finish();
+    totalSeconds += seconds(drainStart, Clock::now());
+
+    char name[64];
+    snprintf(name, sizeof(name), "frame_%s", mode.name);
+    printResult(name, "frame", kNumFrames, totalSeconds, 0.0);
+    snprintf(name, sizeof(name), "api_%s", mode.name);
+    printResult(name, "frame", kNumFrames, totalSeconds - gameSeconds, 0.0); // time the main thread was not doing game work
+
+    releaseDrawQueue(queue);
+    releaseObjects(objects);
+    shutdown();
+
+    if (mode.threaded)
+        threaded::stop();
+
+    return true;
+}
+
+int main()
+{
+    const Mode modes[] = {
+        { "serial",     false, 0 },
+        { "threaded_0", true,  0 },
+        { "threaded_1", true,  1 },
+        { "threaded_2", true,  2 }
+    };
+
+    printf(
+        "{\n  \"backend\": \"null\",\n  \"draw_calls_per_frame\": %u,\n  \"game_work_us\": %u,\n  \"results\": [",
+        kNumDrawCalls, kGameWorkMicros
+    );
+
+    for (const Mode& mode : modes) {
+        if (!runMode(mode)) {
+            fprintf(stderr, "failed to run %s\n", mode.name);
+            return 1;
+        }
+    }
+
+    printf("\n  ]\n}\n");
+    return 0;
+}
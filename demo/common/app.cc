@@ -27,6 +27,9 @@
 
 Application* ApplicationInstance = nullptr;
 
+// compiled shaders are kept here between runs, see sgfx::shadercache
+static const char* kShaderCacheDirectory = "shadercache";
+
 void Application::genericErrorReporter(const char* msg)
 {
     OutputDebugString(msg);
@@ -44,7 +47,10 @@ bool Application::loadShader(const char* path, const Application::ShaderMacroVec
         std::memset(sourceCode, 0, size + 1);
         ifs.read(sourceCode, size);
 
-        auto ret = sgfx::compileShader(
+        CreateDirectoryA(kShaderCacheDirectory, NULL); // fails harmlessly when it exists
+
+        auto ret = sgfx::shadercache::compileShader(
+            kShaderCacheDirectory,
             sourceCode,
             size,
             sgfx::ShaderCompileVersion::v5_0,
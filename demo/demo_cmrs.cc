@@ -247,6 +247,7 @@ public:
     {
         // setup Sigrlinn
         sgfx::initD3D11(g_pd3dDevice, g_pImmediateContext, g_pSwapChain);
+        sgfx::setDeferredRelease(true); // the index buffer is recreated when the tessellation outgrows it
 
         // create render target
         colorBuffer        = sgfx::getBackBuffer();
@@ -134,6 +134,7 @@ public:
 
         // setup Sigrlinn
         sgfx::initD3D11(g_pd3dDevice, g_pImmediateContext, g_pSwapChain);
+        sgfx::setDeferredRelease(true); // the model buffers are recreated whenever the mesh is deformed
 
         // create render target
         colorBuffer        = sgfx::getBackBuffer();
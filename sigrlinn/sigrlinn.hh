@@ -24,6 +24,19 @@
 
 #include <stdint.h>
 #include <wchar.h>
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef SGFX_INTERNAL_IMPLEMENTATION
+#include <new>
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#endif
 
 namespace sgfx
 {
@@ -77,6 +90,15 @@ typedef Handle<void*, 15> DrawQueueHandle;
 // compute queue
 typedef Handle<void*, 16> ComputeQueueHandle;
 
+// draw bundle
+typedef Handle<void*, 17> DrawBundleHandle;
+
+// bind group
+typedef Handle<void*, 18> BindGroupHandle;
+
+// fence, a value on the GPU timeline (see insertFence)
+typedef Handle<void*, 19> FenceHandle;
+
 // buffers
 namespace BufferFlags {
 enum : uint32_t {
@@ -95,8 +117,9 @@ enum : uint32_t {
 
 enum class MapType : size_t
 {
-    Read  = 0,
-    Write = 1,
+    Read             = 0,
+    Write            = 1, // the previous contents of the whole resource are discarded
+    WriteNoOverwrite = 2, // buffers only, the application does not touch ranges the GPU may still read
 
     Count
 };
@@ -205,6 +228,60 @@ enum class DataFormat : size_t
 inline bool isCompressedFormat(DataFormat format) { return format < DataFormat::UnknownCompressed; }
 inline bool isDepthFormat(DataFormat format)      { return format > DataFormat::UnknownDepth;      }
 
+// bytes per texel, or per 4x4 block for compressed formats, 0 for unsupported formats
+inline size_t getFormatSize(DataFormat format)
+{
+    switch (format) {
+    case DataFormat::BC1:        { return 8;  } break;
+    case DataFormat::BC2:        { return 16; } break;
+    case DataFormat::BC3:        { return 16; } break;
+    case DataFormat::BC4:        { return 8;  } break;
+    case DataFormat::BC5:        { return 16; } break;
+    case DataFormat::BC6H:       { return 16; } break;
+    case DataFormat::BC7:        { return 16; } break;
+    case DataFormat::ETC1:       { return 8;  } break;
+    case DataFormat::ETC2:       { return 8;  } break;
+    case DataFormat::ETC2A:      { return 16; } break;
+    case DataFormat::ETC2A1:     { return 8;  } break;
+    case DataFormat::PTC12:      { return 4;  } break;
+    case DataFormat::PTC14:      { return 8;  } break;
+    case DataFormat::PTC12A:     { return 4;  } break;
+    case DataFormat::PTC14A:     { return 8;  } break;
+    case DataFormat::PTC22:      { return 4;  } break;
+    case DataFormat::PTC24:      { return 8;  } break;
+
+    case DataFormat::R1:         { return 1;  } break; // rounded up to a byte
+    case DataFormat::R8:         { return 1;  } break;
+    case DataFormat::R16:        { return 2;  } break;
+    case DataFormat::R16F:       { return 2;  } break;
+    case DataFormat::R32I:       { return 4;  } break;
+    case DataFormat::R32U:       { return 4;  } break;
+    case DataFormat::R32F:       { return 4;  } break;
+    case DataFormat::RG8:        { return 2;  } break;
+    case DataFormat::RG16:       { return 4;  } break;
+    case DataFormat::RG16F:      { return 4;  } break;
+    case DataFormat::RG32I:      { return 8;  } break;
+    case DataFormat::RG32U:      { return 8;  } break;
+    case DataFormat::RG32F:      { return 8;  } break;
+    case DataFormat::RGB32I:     { return 12; } break;
+    case DataFormat::RGB32U:     { return 12; } break;
+    case DataFormat::RGB32F:     { return 12; } break;
+    case DataFormat::RGBA8:      { return 4;  } break;
+    case DataFormat::RGBA16:     { return 8;  } break;
+    case DataFormat::RGBA16F:    { return 8;  } break;
+    case DataFormat::RGBA32I:    { return 16; } break;
+    case DataFormat::RGBA32U:    { return 16; } break;
+    case DataFormat::RGBA32F:    { return 16; } break;
+    case DataFormat::R11G11B10F: { return 4;  } break;
+
+    case DataFormat::D16:        { return 2;  } break;
+    case DataFormat::D24S8:      { return 4;  } break;
+    case DataFormat::D32F:       { return 4;  } break;
+
+    default: { return 0; } break; // unsupported
+    }
+}
+
 // render state
 enum class FillMode : size_t
 {
@@ -404,6 +481,31 @@ struct RenderTargetDescriptor
     sgfx::TextureHandle depthStencilTexture;
 };
 
+struct BindGroupDescriptor
+{
+    enum
+    {
+        kMaxConstantBuffers = 8,
+        kMaxShaderResources = 32,
+        kMaxSamplerStates   = 8
+    };
+
+    // every kind is bound to consecutive slots starting from its first slot
+    uint32_t                   firstConstantBuffer = 0;
+    uint32_t                   numConstantBuffers  = 0;
+    sgfx::ConstantBufferHandle constantBuffers[kMaxConstantBuffers];
+
+    // one resource per slot, the buffer is used if both are set
+    uint32_t                   firstShaderResource = 0;
+    uint32_t                   numShaderResources  = 0;
+    sgfx::BufferHandle         buffers[kMaxShaderResources];
+    sgfx::TextureHandle        textures[kMaxShaderResources];
+
+    uint32_t                   firstSamplerState = 0;
+    uint32_t                   numSamplerStates  = 0;
+    sgfx::SamplerStateHandle   samplerStates[kMaxSamplerStates];
+};
+
 // caps
 namespace GPUCaps {
 enum : uint64_t {
@@ -438,6 +540,7 @@ typedef void(*ErrorReportFunc)(const char*);
 bool initD3D11(void* d3dDevice, void* d3dContext, void* d3dSwapChain);
 bool initD3D12(void* d3dDevice);
 bool initOpenGL();
+bool initNull(uint32_t backBufferWidth, uint32_t backBufferHeight); // no GPU, see sgfx::null
 #ifdef NDA_CODE_AMD_MANTLE
 // NDACodeStripper v0.17: 1 line removed
 #endif
@@ -448,6 +551,7 @@ typedef void* (*AllocFunc)(size_t size);
 typedef void  (*FreeFunc)(void* ptr);
 
 // memory
+// create* and release* functions may be called from any thread, nalloc and nfree must be thread-safe too
 void  setAllocator(AllocFunc nalloc, FreeFunc nfree);
 void* allocate(size_t size);
 void  deallocate(void* ptr);
@@ -535,11 +639,15 @@ void                    releaseComputeQueue(ComputeQueueHandle handle);
 void                    setConstantBuffer(ComputeQueueHandle handle, uint32_t idx, ConstantBufferHandle buffer);
 void                    setResource(ComputeQueueHandle handle, uint32_t idx, BufferHandle resource);
 void                    setResource(ComputeQueueHandle handle, uint32_t idx, TextureHandle resource);
+// GL4 binds read-only buffers to shader storage bindings 0-7 and read-write buffers to 8-15, read-write
+// textures to image units and the counters of GPUCounter and GPUAppend buffers to atomic counter
+// bindings, both with the slot number
 void                    setResourceRW(ComputeQueueHandle handle, uint32_t idx, BufferHandle resource);
 void                    setResourceRW(ComputeQueueHandle handle, uint32_t idx, TextureHandle resource);
 
 void                    submit(ComputeQueueHandle handle, uint32_t x, uint32_t y, uint32_t z);
 
+// data is bytecode on D3D11 and GLSL source on GL4
 ComputeShaderHandle     createComputeShader(const void* data, size_t dataSize);
 void                    releaseComputeShader(ComputeShaderHandle handle);
 
@@ -558,7 +666,16 @@ void                    releasePipelineState(PipelineStateHandle handle);
 // buffers
 BufferHandle            createBuffer(uint32_t flags, const void* mem, size_t size, size_t stride);
 void                    releaseBuffer(BufferHandle handle);
+bool                    isValid(BufferHandle handle); // false for released handles
+// on GL4 buffers created with CPUWrite and none of the read, GPU write, counter or stream output
+// flags keep a persistently mapped copy per frame in flight, a write map hands out the next copy
+// and only waits when an earlier frame still uses it. A copy the frame being recorded still uses
+// (more write maps per frame than copies, or no endFrame() calls) gets new storage instead, the
+// way a discarding map orphans the buffer
 void*                   mapBuffer(BufferHandle handle, MapType type);
+// maps [offset, offset + size) and returns a pointer to offset. Ring buffers map with Write when
+// they wrap and with WriteNoOverwrite for the ranges appended after that
+void*                   mapBuffer(BufferHandle handle, MapType type, size_t offset, size_t size);
 void                    unmapBuffer(BufferHandle handle);
 void                    copyBufferData(BufferHandle handle, size_t offset, size_t size, const void* mem);
 
@@ -592,6 +709,7 @@ void                    updateTexture(
     size_t rowPitch, size_t depthPitch
 );
 void                    releaseTexture(TextureHandle handle);
+bool                    isValid(TextureHandle handle);
 
 // async buffer copying
 void                    copyResource(TextureHandle        src, TextureHandle        dst);
@@ -615,10 +733,52 @@ void                    clearRenderTarget(RenderTargetHandle handle, uint32_t sl
 void                    clearDepthStencil(RenderTargetHandle handle, float depth, uint8_t stencil);
 void                    present(uint32_t swapInterval);
 
+// frame boundary
+// transient draw queue storage is recycled at the end of every frame, so commands recorded into a
+// queue have to be submitted within the same frame, leftovers are dropped. present() ends the
+// frame implicitly, backends without present() (OpenGL) need endFrame() once per frame.
+// endFrame() is mandatory there: without it the recorded commands are never recycled and the
+// storage grows with every draw queue, debug builds assert once a frame passes 256MB.
+void                    endFrame();
+
+// deferred release
+// when enabled, released buffers, constant buffers and textures stay alive until the GPU has
+// finished the frame that released them and are destroyed by a later endFrame() or present(), so
+// a resource can be released and recreated while draw calls that use it are in flight. isValid()
+// stays true until then. Off by default, turning it off doesn't destroy the pending releases early.
+struct DeferredReleaseStats
+{
+    uint64_t numPendingReleases = 0; // released handles that wait for their frame
+    uint64_t numBytesHeld       = 0; // memory they keep alive, estimated for textures
+};
+
+void                    setDeferredRelease(bool enabled);
+DeferredReleaseStats    getDeferredReleaseStats();
+
+// GPU synchronization
+// a fence is signaled once the GPU has finished every command issued before it, fences are
+// signaled in the order they were inserted. They are values rather than objects and need no
+// release. The invalid handle counts as signaled, a timeout of UINT64_MAX waits forever.
+FenceHandle             insertFence();
+bool                    isFenceSignaled(FenceHandle fence);
+bool                    waitFence(FenceHandle fence, uint64_t timeout); // nanoseconds, false if the fence is still pending
+
+// frames are numbered from 1 and end with endFrame() or present(), memory the GPU read in frame N
+// can be reused once getCompletedFrameIndex() >= N
+uint64_t                getFrameIndex();          // the frame being recorded
+uint64_t                getCompletedFrameIndex(); // the last frame the GPU has finished, 0 before the first one
+
 // drawing
 DrawQueueHandle         createDrawQueue(PipelineStateHandle state);
 void                    releaseDrawQueue(DrawQueueHandle handle);
 
+// parallel recording
+// a child queue shares the pipeline state of its parent and is submitted together with it: the
+// parent commands go first, then every child in creation order. Each child has its own storage,
+// so different children can be recorded from different threads at the same time.
+// Children must not be recorded while the parent is being submitted.
+DrawQueueHandle         createChildDrawQueue(DrawQueueHandle parent);
+
 // per queue
 void                    setSamplerState(DrawQueueHandle handle, uint32_t idx, SamplerStateHandle sampler);
 
@@ -631,6 +791,23 @@ void                    setConstantBuffer(DrawQueueHandle handle, uint32_t idx,
 void                    setResource(DrawQueueHandle handle, uint32_t idx, BufferHandle resource);
 void                    setResource(DrawQueueHandle handle, uint32_t idx, TextureHandle resource);
 
+// per draw call constants
+// copies 1 to 4096 bytes (DrawQueue::kMaxConstantDataSize) into the queue, they are bound to
+// constant buffer slot idx for the next draw call instead of a constant buffer. Submit packs the
+// constants of all draw calls into one ring buffer and binds ranges of it, so unique constants per
+// object cost no constant buffer and no update each. The shader must not read past size.
+// Sizes out of range assert, release builds ignore the call and the slot keeps its binding.
+void                    setConstants(DrawQueueHandle dq, uint32_t idx, const void* data, size_t size);
+
+// bind groups
+// an immutable set of constant buffers, shader resources and sampler states that is resolved once
+// and bound with a single command, up to 4 groups per draw call. Groups bound together must not
+// share slots. Slots covered by a bound group ignore the per slot setters, sampler slots fall back
+// to the queue sampler states when the group is unbound. The resources must outlive the group.
+BindGroupHandle         createBindGroup(const BindGroupDescriptor& desc);
+void                    releaseBindGroup(BindGroupHandle handle);
+void                    setBindGroup(DrawQueueHandle dq, uint32_t idx, BindGroupHandle group);
+
 void                    draw(DrawQueueHandle dq, uint32_t count, uint32_t startVertex);
 void                    drawIndexed(DrawQueueHandle dq, uint32_t count, uint32_t startIndex, uint32_t startVertex);
 
@@ -640,9 +817,54 @@ void                    drawIndexedInstanced(DrawQueueHandle dq, uint32_t instan
 void                    drawInstancedIndirect(DrawQueueHandle dq, BufferHandle indirectArgs, size_t argsOffset);
 void                    drawIndexedInstancedIndirect(DrawQueueHandle dq, BufferHandle indirectArgs, size_t argsOffset);
 
+// up to maxDraws indexed instanced draw calls from consecutive args records, stride 0 means tightly packed
+// the draw count is read from countBuffer at countOffset (clamped to maxDraws) unless it is an invalid handle.
+// Backends that can't read the count on the GPU issue all maxDraws records, so the unused records must
+// have zero instance count.
+// Nothing is drawn if the last record does not fit in indirectArgs.
+void                    multiDrawIndexedIndirect(
+    DrawQueueHandle dq,
+    BufferHandle indirectArgs, size_t argsOffset, uint32_t maxDraws,
+    BufferHandle countBuffer,  size_t countOffset,
+    uint32_t stride
+);
+
 void                    submit(DrawQueueHandle handle);
 void                    flush();
 
+// optional draw call sorting
+// draw calls recorded after setSortKey carry the key until it is changed or the queue is
+// submitted. Submitting several queues at once merges them (children included) and orders all
+// draw calls by key, draw calls with equal keys keep the submission order.
+// submit(DrawQueueHandle) ignores the keys and always uses the recording order.
+void                    setSortKey(DrawQueueHandle dq, uint64_t key);
+void                    submit(const DrawQueueHandle* queues, size_t count);
+
+// optional draw call merging
+// when enabled, submit joins consecutive draw calls of the same type that were recorded with the
+// same state and continue each other's vertex or index range (list topologies only, indirect
+// draw calls are never merged, nor triangle lists that don't end on a whole triangle). The
+// setting is kept between submits and applies to the children. A merged draw call numbers its
+// primitives as one, so SV_PrimitiveID / gl_PrimitiveID of the later draw calls no longer
+// start at zero.
+void                    setDrawMerging(DrawQueueHandle dq, bool enabled);
+uint32_t                getNumMergedDrawCalls(DrawQueueHandle dq); // draw calls saved by the last submit
+
+// retained draw bundles
+// a bundle captures everything recorded into the queue and its children so far, the queue is
+// cleared afterwards. Bundles are immutable and can be submitted any number of times.
+// Constant buffers and resources can be overridden per slot before a replay, an override applies
+// to all draw calls of the bundle and stays until it is changed. Setting an invalid handle removes
+// the override.
+DrawBundleHandle        createDrawBundle(DrawQueueHandle dq);
+void                    releaseDrawBundle(DrawBundleHandle handle);
+
+void                    setConstantBuffer(DrawBundleHandle handle, uint32_t idx, ConstantBufferHandle buffer);
+void                    setResource(DrawBundleHandle handle, uint32_t idx, BufferHandle resource);
+void                    setResource(DrawBundleHandle handle, uint32_t idx, TextureHandle resource);
+
+void                    submitBundle(DrawBundleHandle handle);
+
 // performance markers
 void                    beginPerfEvent(const wchar_t* name);
 void                    endPerfEvent();
@@ -670,6 +892,147 @@ ID3D11DepthStencilView*     getNativeDSV(RenderTargetHandle handle);
 }
 #endif
 
+// inline constant uploads of the D3D11 backend, accumulated until reset
+// setConstants data goes into a ring buffer bound with D3D11.1 constant buffer offsets when the
+// device supports them (see SGFX_USE_D3D11_1), otherwise into a buffer per slot
+namespace d3d11
+{
+
+struct Stats
+{
+    uint64_t numConstantDataBytes      = 0; // setConstants data copied into constant buffers
+    uint64_t numConstantRingDiscards   = 0; // wraps of the constant ring, each discards it
+    uint64_t numConstantUploadFailures = 0; // setConstants calls whose slot was left unbound
+};
+
+const Stats& getStats();
+void         resetStats();
+
+}
+
+// statistics of the null backend, accumulated until reset
+namespace null
+{
+
+struct Stats
+{
+    uint64_t numSubmits                = 0; // draw queues and bundles
+    uint64_t numCommands               = 0; // recorded commands walked by submits
+    uint64_t numBytesRecorded          = 0; // command data of submitted draw queues and their children
+    uint64_t numPipelineStates         = 0;
+    uint64_t numDrawCalls              = 0; // after merging, indirect draws count every executed record
+    uint64_t numMergedDrawCalls        = 0;
+    uint64_t numIndirectDrawCalls      = 0;
+    uint64_t numVertices               = 0; // vertices or indices, times instances
+    uint64_t numInstances              = 0;
+    uint64_t numBufferBindings         = 0; // vertex and index buffers
+    uint64_t numConstantBufferBindings = 0;
+    uint64_t numResourceBindings       = 0;
+    uint64_t numBindGroupBindings      = 0;
+    uint64_t numBindCalls              = 0; // slot ranges that changed, a GPU backend makes one call per range
+    uint64_t numDispatches             = 0;
+    uint64_t numThreadGroups           = 0;
+    uint64_t numBytesUploaded          = 0; // copied from CPU memory into resources
+};
+
+const Stats& getStats();
+void         resetStats();
+
+}
+
+// redundant state filtering of the GL4 backend, accumulated until reset
+// the backend keeps a shadow copy of the context state it set and skips calls that would not change
+// it. Call resetStateCache after changing GL state outside of sgfx, in threaded mode after finish
+namespace gl4
+{
+
+struct Stats
+{
+    uint64_t numStateCalls         = 0; // state calls that reached the driver
+    uint64_t numSkippedStateCalls  = 0; // state calls dropped because the context already had the values
+    uint64_t numMemoryBarriers     = 0; // glMemoryBarrier calls, issued before reads of compute results
+    uint64_t numConstantDataBytes  = 0; // setConstants data copied into the constant ring
+    uint64_t numStreamingMaps      = 0; // write maps of streaming buffers, served without a driver call
+    uint64_t numStreamingOrphans   = 0; // write maps that replaced a copy the current frame still uses
+    uint64_t numFrameStalls        = 0; // waits for the GPU to finish a frame before reusing its memory
+};
+
+const Stats& getStats();
+void         resetStats();
+void         resetStateCache();
+
+}
+
+// on-disk cache for compileShader (see sigrlinn_shadercache.cc)
+// the bytecode is stored in a directory under a hash of the source, macros, target, version and flags,
+// a warm start loads it and skips the compiler. Bytecode differs between backends, so every backend
+// needs its own directory
+namespace shadercache
+{
+
+struct Stats
+{
+    uint64_t numHits          = 0; // loaded from the cache
+    uint64_t numMisses        = 0; // compiled, stored if the write succeeded
+    uint64_t numFailedWrites  = 0; // compiled but not stored, the next start compiles again
+};
+
+// same as sgfx::compileShader, directory must exist, nullptr compiles without the cache
+bool compileShader(
+    const char*                 directory,
+    const char*                 sourceCode,
+    size_t                      sourceCodeSize,
+    ShaderCompileVersion        version,
+    ShaderCompileTarget         target,
+    const ShaderCompileMacro*   macros,
+    size_t                      macrosSize,
+    uint64_t                    flags,
+    ErrorReportFunc             errorFunc,
+
+    void*&  outData, // use deallocate() to dispose this
+    size_t& outDataSize
+);
+
+Stats getStats();
+void  resetStats();
+
+}
+
+// frame capture, only available when linked with a capture build (see sigrlinn_capture.cc)
+// every call between begin and end is written to the file for sgfx-replay, frames end with present or endFrame
+namespace capture
+{
+
+bool begin(const char* path);
+void end();
+
+}
+
+// threaded mode, only available when linked with a threaded build (see sigrlinn_threaded.cc)
+// after start, calls made on the thread that called start are queued and run on a render thread,
+// calls that return a value wait for the render thread to catch up. Buffers and textures may still
+// be created and released from any thread, everything else stays on the recording thread
+namespace threaded
+{
+
+typedef void (*ThreadFunc)(void* userData);
+
+struct Descriptor final
+{
+    uint32_t   maxFramesInFlight = 1;               // frames the recording thread may be ahead, counted by present and endFrame
+    size_t     ringSize          = 4 * 1024 * 1024; // bytes of queued calls
+    ThreadFunc threadStart       = nullptr;         // runs first on the render thread, make the GL context current here
+    ThreadFunc threadExit        = nullptr;
+    void*      userData          = nullptr;
+};
+
+// call init* after start so the backend is initialized on the render thread
+bool start(const Descriptor& desc);
+void stop();   // runs the queued calls and joins the render thread
+void finish(); // waits until the queued calls ran, null::getStats is safe to read after this
+
+}
+
 // internal classes and data
 #ifdef SGFX_INTERNAL_IMPLEMENTATION
 
@@ -890,7 +1253,7 @@ public:
     SGFX_FORCE_INLINE void Merge(const DynamicArray& other)
     {
         if (!other.IsEmpty()) {
-            Reserve(GetSize() + other.GetSize());
+            Reserve(size + other.GetSize());
             for (const T& element : other)
                 Add(element);
         }
@@ -941,189 +1304,2238 @@ public:
     }
 };
 
-// emulated draw queues for pre-DX12 APIs (DX11 and GL4)
-struct ShaderResource final
+///
+/// AtomicFreeList is a lock-free stack of indices, the links are stored by the caller.
+///
+/// The head packs a tag with the index of the first free element, every successful exchange bumps
+/// the tag so an element popped and pushed back by another thread does not corrupt the list (ABA).
+/// Links may be read after another thread took the element, the exchange fails in that case.
+///
+class AtomicFreeList final
 {
-    bool  isTexture = false;
-    void* value     = nullptr;
+    std::atomic<uint64_t> head;
 
-    inline ShaderResource() {}
-    inline ShaderResource(bool texture, void* newHandle)
-        : isTexture(texture), value(newHandle)
-    {}
+public:
+
+    enum : uint32_t
+    {
+        kEndOfList = 0xFFFFFFFE
+    };
+
+    SGFX_FORCE_INLINE AtomicFreeList() : head(kEndOfList) {}
+    AtomicFreeList(const AtomicFreeList&) = delete;
+    AtomicFreeList& operator=(const AtomicFreeList&) = delete;
+
+    // links(index) returns the std::atomic<uint32_t> that holds the next free index
+    template <typename Links>
+    SGFX_FORCE_INLINE bool Pop(uint32_t& index, const Links& links)
+    {
+        uint64_t current = head.load(std::memory_order_acquire);
+        for (;;) {
+            uint32_t first = static_cast<uint32_t>(current);
+            if (first == kEndOfList)
+                return false;
+
+            uint32_t next = links(first).load(std::memory_order_relaxed);
+            uint64_t tag  = (current >> 32) + 1;
+            if (head.compare_exchange_weak(current, (tag << 32) | next, std::memory_order_acquire, std::memory_order_acquire)) {
+                index = first;
+                return true;
+            }
+        }
+    }
+
+    template <typename Links>
+    SGFX_FORCE_INLINE void Push(uint32_t index, const Links& links)
+    {
+        uint64_t current = head.load(std::memory_order_relaxed);
+        for (;;) {
+            links(index).store(static_cast<uint32_t>(current), std::memory_order_relaxed);
+
+            uint64_t tag = (current >> 32) + 1;
+            if (head.compare_exchange_weak(current, (tag << 32) | index, std::memory_order_release, std::memory_order_relaxed))
+                return;
+        }
+    }
 };
 
-struct DrawCall final
+///
+/// HandlePool stores objects of a single type in pages of contiguous slots and identifies them
+/// with 32 bit handles: the low kIndexBits are the slot index + 1 (zero is the invalid handle),
+/// the high bits are the slot generation.
+///
+/// Releasing an object bumps the generation of its slot, so a stale handle is detected in O(1)
+/// and resolves to null. Pages are never moved, object addresses stay valid until release.
+///
+/// Create, Release and Get may be called concurrently from any thread: free slots are kept in an
+/// AtomicFreeList and the page table has a fixed size, pages are published with a compare and
+/// exchange. Using an object while another thread releases it is still an error.
+///
+template <typename T, size_t P = 256, typename A = DefaultAllocator>
+class HandlePool final
 {
-    enum Type : uint32_t
+    enum : uint32_t
     {
-        Draw                            = 0,
-        DrawIndexed                     = 1,
-        DrawInstanced                   = 2,
-        DrawIndexedInstanced            = 3,
-
-        DrawInstancedIndirect           = 4,
-        DrawIndexedInstancedIndirect    = 5
+        kIndexBits       = 20,
+        kIndexMask       = (1U << kIndexBits) - 1,
+        kGenerationMask  = (1U << (32 - kIndexBits)) - 1,
+        kPageSize        = P,
+        kMaxPages        = (kIndexMask + P - 1) / P,
+        kAlive           = 0xFFFFFFFF,
+        kEndOfList       = AtomicFreeList::kEndOfList
     };
 
-    enum
+    struct Slot final
     {
-        kMaxConstantBuffers     = 8,
-        kMaxShaderResources     = 128,
-        kMaxVertexBuffers       = 16
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+        std::atomic<uint32_t> generation;
+        std::atomic<uint32_t> nextFree;   // kAlive if the slot holds an object, kEndOfList for the last free slot
+
+        SGFX_FORCE_INLINE Slot() : generation(0), nextFree(kEndOfList) {}
+
+        SGFX_FORCE_INLINE T* GetObject() { return reinterpret_cast<T*>(&storage); }
     };
 
-    ConstantBufferHandle    constantBuffers[kMaxConstantBuffers];
-    ShaderResource          shaderResources[kMaxShaderResources];
+    std::atomic<Slot*>    pages[kMaxPages];
+    std::atomic<uint32_t> numSlots;
+    std::atomic<uint32_t> numObjects;
+    AtomicFreeList        freeSlots;
 
-    BufferHandle      vertexBuffers[kMaxVertexBuffers];
-    BufferHandle      indexBuffer;
-    BufferHandle      indirectArgsBuffer;
-    size_t            indirectArgsOffset;
-    PrimitiveTopology primitiveTopology;
+    SGFX_FORCE_INLINE Slot* GetSlot(uint32_t index) const { return pages[index / kPageSize].load(std::memory_order_acquire) + (index % kPageSize); }
 
-    uint32_t instanceCount;
-    uint32_t count;
-    uint32_t startVertex;
-    uint32_t startIndex;
-    uint32_t startInstance;
-    Type     type;
-};
+    // the page of a new slot may still be missing if another thread took the previous slots
+    SGFX_FORCE_INLINE Slot* GetOrCreatePage(uint32_t pageIndex)
+    {
+        Slot* page = pages[pageIndex].load(std::memory_order_acquire);
+        if (page == nullptr) {
+            Slot* newPage = reinterpret_cast<Slot*>(A::Allocate(kPageSize * sizeof(Slot)));
+            for (uint32_t i = 0; i < kPageSize; ++i)
+                ::new (newPage + i) Slot();
+
+            if (pages[pageIndex].compare_exchange_strong(page, newPage, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                page = newPage;
+            } else {
+                A::Free(reinterpret_cast<uint8_t*>(newPage)); // another thread was faster
+            }
+        }
+        return page;
+    }
+
+    static SGFX_FORCE_INLINE uint32_t ToHandle(void* value) { return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(value)); }
+    static SGFX_FORCE_INLINE void*    ToValue(uint32_t handle) { return reinterpret_cast<void*>(static_cast<uintptr_t>(handle)); }
 
-class DrawQueue final
-{
 public:
 
-    typedef DynamicArray<DrawCall, 4096, 4096> DrawCallArray;
+    HandlePool() : numSlots(0), numObjects(0)
+    {
+        for (std::atomic<Slot*>& page : pages)
+            page.store(nullptr, std::memory_order_relaxed);
+    }
+    HandlePool(const HandlePool&) = delete;
+    HandlePool& operator=(const HandlePool&) = delete;
 
-private:
-    PipelineStateHandle state;
-    DrawCall            currentDrawCall;
-    DrawCallArray       drawCalls;
+    ~HandlePool()
+    {
+        for (std::atomic<Slot*>& pageRef : pages) {
+            Slot* page = pageRef.load(std::memory_order_relaxed);
+            if (page == nullptr)
+                continue;
+
+            for (uint32_t i = 0; i < kPageSize; ++i) {
+                if (page[i].nextFree.load(std::memory_order_relaxed) == kAlive)
+                    page[i].GetObject()->~T();
+            }
+            A::Free(reinterpret_cast<uint8_t*>(page));
+        }
+    }
 
-public:
+    SGFX_FORCE_INLINE uint32_t GetSize() const { return numObjects.load(std::memory_order_relaxed); }
 
-    enum
+    // constructs a new object, returns its handle value and address or null once all kIndexMask
+    // slots are taken; the caller checks the handle and returns an invalid one
+    template <typename ...Args>
+    SGFX_FORCE_INLINE void* Create(T*& object, Args&&... args)
     {
-        kMaxSamplerStates = 8
-    };
-    SamplerStateHandle samplerStates[kMaxSamplerStates];
+        uint32_t index = kEndOfList;
+        Slot*    slot  = nullptr;
+
+        if (freeSlots.Pop(index, [this](uint32_t i) -> std::atomic<uint32_t>& { return GetSlot(i)->nextFree; })) {
+            slot = GetSlot(index);
+        } else {
+            index = numSlots.fetch_add(1, std::memory_order_relaxed);
+            if (index >= kIndexMask) {
+                numSlots.store(kIndexMask, std::memory_order_relaxed);
+                object = nullptr;
+                return nullptr; // out of handles
+            }
+            slot = GetOrCreatePage(index / kPageSize) + (index % kPageSize);
+        }
 
-    DrawQueue(PipelineStateHandle _state) : state(_state) {}
+        object = ::new (slot->GetObject()) T(static_cast<Args&&>(args)...);
+        slot->nextFree.store(kAlive, std::memory_order_release);
 
-    SGFX_FORCE_INLINE PipelineStateHandle  getState() const     { return state; }
-    SGFX_FORCE_INLINE const DrawCallArray& getDrawCalls() const { return drawCalls; }
+        numObjects.fetch_add(1, std::memory_order_relaxed);
+        return ToValue(((slot->generation.load(std::memory_order_relaxed) & kGenerationMask) << kIndexBits) | (index + 1));
+    }
 
-    SGFX_FORCE_INLINE void clear()
+    // null for invalid and stale handles
+    SGFX_FORCE_INLINE T* Get(void* value) const
     {
-        drawCalls.Clear();
+        uint32_t handle = ToHandle(value);
+        uint32_t index  = (handle & kIndexMask) - 1;
+
+        if (index >= kIndexMask) // the invalid handle
+            return nullptr;
+
+        Slot* page = pages[index / kPageSize].load(std::memory_order_acquire);
+        if (page == nullptr)
+            return nullptr;
+
+        Slot* slot = page + (index % kPageSize);
+        if (slot->nextFree.load(std::memory_order_acquire) != kAlive || (slot->generation.load(std::memory_order_relaxed) & kGenerationMask) != (handle >> kIndexBits))
+            return nullptr;
+
+        return slot->GetObject();
     }
 
-    SGFX_FORCE_INLINE void setPrimitiveTopology(PrimitiveTopology topology)     { currentDrawCall.primitiveTopology = topology; }
-    SGFX_FORCE_INLINE void setVertexBuffer(uint32_t idx, BufferHandle handle)   { currentDrawCall.vertexBuffers[idx] = handle; }
-    SGFX_FORCE_INLINE void setIndexBuffer(BufferHandle handle)                  { currentDrawCall.indexBuffer  = handle; }
+    SGFX_FORCE_INLINE bool IsValid(void* value) const { return Get(value) != nullptr; }
 
-    SGFX_FORCE_INLINE void setSamplerState(uint32_t idx, SamplerStateHandle handle)
+    SGFX_FORCE_INLINE void Release(void* value)
     {
-        samplerStates[idx] = handle;
+        T* object = Get(value);
+        if (object != nullptr) {
+            uint32_t handle = ToHandle(value);
+            uint32_t index  = (handle & kIndexMask) - 1;
+            Slot*    slot   = GetSlot(index);
+
+            // claim the slot by bumping the generation the handle was created with: only one of the
+            // threads releasing the same handle gets past this, a stale handle of a reused slot never does
+            uint32_t generation = slot->generation.load(std::memory_order_acquire);
+            do {
+                if ((generation & kGenerationMask) != (handle >> kIndexBits))
+                    return;
+            } while (!slot->generation.compare_exchange_weak(generation, generation + 1, std::memory_order_acq_rel, std::memory_order_acquire));
+
+            slot->nextFree.store(kEndOfList, std::memory_order_release);
+            object->~T();
+            freeSlots.Push(index, [this](uint32_t i) -> std::atomic<uint32_t>& { return GetSlot(i)->nextFree; });
+
+            numObjects.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+};
+
+// bytes of a texture and its mip chain, 0 for unsupported formats
+inline size_t getTextureDataSize(DataFormat format, uint32_t width, uint32_t height, uint32_t depth, uint32_t numMipmaps)
+{
+    size_t block = isCompressedFormat(format) ? 4 : 1;
+    size_t size  = 0;
+    for (uint32_t i = 0; i < ((numMipmaps != 0) ? numMipmaps : 1); ++i) {
+        size_t mipWidth  = (width  >> i) != 0 ? (width  >> i) : 1;
+        size_t mipHeight = (height >> i) != 0 ? (height >> i) : 1;
+        size_t mipDepth  = (depth  >> i) != 0 ? (depth  >> i) : 1;
+
+        size += ((mipWidth + block - 1) / block) * ((mipHeight + block - 1) / block) * mipDepth * getFormatSize(format);
     }
+    return size;
+}
 
-    SGFX_FORCE_INLINE void setConstantBuffer(uint32_t idx, ConstantBufferHandle resource)
+///
+/// DeferredReleaseQueue keeps released resources alive until the GPU is done with them (see
+/// setDeferredRelease). Push may be called from any thread, the backend calls Retire from endFrame
+/// on its own thread: entries pushed since the last call are stamped with the frame being ended,
+/// entries whose frame has completed are handed to the release function and removed.
+///
+class DeferredReleaseQueue final
+{
+public:
+
+    enum class Type : uint32_t
+    {
+        Buffer,
+        ConstantBuffer,
+        Texture
+    };
+
+    struct Entry final
+    {
+        void*    handle = nullptr;
+        Type     type   = Type::Buffer;
+        uint64_t frame  = 0; // 0 until the frame that released it ends
+        size_t   size   = 0;
+    };
+
+private:
+
+    std::mutex          mutex;
+    DynamicArray<Entry> entries;
+    std::atomic<bool>   enabled;
+    uint64_t            numBytes = 0;
+
+public:
+
+    SGFX_FORCE_INLINE DeferredReleaseQueue() : enabled(false) {}
+
+    SGFX_FORCE_INLINE void SetEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+
+    // false if deferred release is off, the caller releases the handle right away
+    SGFX_FORCE_INLINE bool Push(void* handle, Type type, size_t size)
     {
-        currentDrawCall.constantBuffers[idx] = resource;
+        if (!enabled.load(std::memory_order_relaxed) || handle == nullptr)
+            return false;
+
+        Entry entry;
+        entry.handle = handle;
+        entry.type   = type;
+        entry.size   = size;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.Add(entry);
+        numBytes += size;
+        return true;
     }
 
-    SGFX_FORCE_INLINE void setResource(uint32_t idx, BufferHandle resource)
+    template <typename F>
+    SGFX_FORCE_INLINE void Retire(uint64_t endedFrame, uint64_t completedFrame, const F& release)
     {
-        currentDrawCall.shaderResources[idx] = ShaderResource(false, resource.value);
+        std::lock_guard<std::mutex> lock(mutex);
+
+        size_t numKept = 0;
+        for (size_t i = 0; i < entries.GetSize(); ++i) {
+            Entry entry = entries[i];
+            if (entry.frame == 0)
+                entry.frame = endedFrame;
+
+            if (entry.frame <= completedFrame) {
+                release(entry);
+                numBytes -= entry.size;
+            } else {
+                entries[numKept++] = entry;
+            }
+        }
+        entries.Resize(numKept);
     }
 
-    SGFX_FORCE_INLINE void setResource(uint32_t idx, TextureHandle resource)
+    // shutdown, the GPU is idle
+    template <typename F>
+    SGFX_FORCE_INLINE void RetireAll(const F& release)
     {
-        currentDrawCall.shaderResources[idx] = ShaderResource(true, resource.value);
+        Retire(0, UINT64_MAX, release);
     }
 
-    SGFX_FORCE_INLINE void draw(uint32_t count, uint32_t startVertex)
+    SGFX_FORCE_INLINE DeferredReleaseStats GetStats()
     {
-        currentDrawCall.count       = count;
-        currentDrawCall.startVertex = startVertex;
-        currentDrawCall.startIndex  = 0;
-        currentDrawCall.type        = DrawCall::Draw;
-        drawCalls.Add(currentDrawCall);
-        std::memset(&currentDrawCall, 0, sizeof(currentDrawCall));
+        std::lock_guard<std::mutex> lock(mutex);
+
+        DeferredReleaseStats stats;
+        stats.numPendingReleases = entries.GetSize();
+        stats.numBytesHeld       = numBytes;
+        return stats;
     }
+};
 
-    SGFX_FORCE_INLINE void drawIndexed(uint32_t count, uint32_t startIndex, uint32_t startVertex)
+///
+/// StateKey is the canonical form of a state descriptor: a list of 32 bit words built field by
+/// field. Descriptors have padding and members that only matter for some flags (the stencil
+/// values when stencil is disabled), so they can't be hashed or compared as raw memory.
+///
+class StateKey final
+{
+    DynamicArray<uint32_t, 32, 32> words;
+
+    static SGFX_FORCE_INLINE uint64_t HashBytes(const void* data, size_t size)
     {
-        currentDrawCall.count       = count;
-        currentDrawCall.startVertex = startVertex;
-        currentDrawCall.startIndex  = startIndex;
-        currentDrawCall.type        = DrawCall::DrawIndexed;
-        drawCalls.Add(currentDrawCall);
-        std::memset(&currentDrawCall, 0, sizeof(currentDrawCall));
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+        uint64_t hash = 14695981039346656037ULL; // FNV-1a
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
     }
 
-    SGFX_FORCE_INLINE void drawInstanced(uint32_t instanceCount, uint32_t count, uint32_t startVertex, uint32_t startInstance)
+public:
+
+    SGFX_FORCE_INLINE void Add(uint32_t value) { words.Add(value); }
+
+    SGFX_FORCE_INLINE void AddFloat(float value)
     {
-        currentDrawCall.instanceCount = instanceCount;
-        currentDrawCall.count         = count;
-        currentDrawCall.startVertex   = startVertex;
-        currentDrawCall.startIndex    = 0;
-        currentDrawCall.startInstance = startInstance;
-        currentDrawCall.type          = DrawCall::DrawInstanced;
-        drawCalls.Add(currentDrawCall);
-        std::memset(&currentDrawCall, 0, sizeof(currentDrawCall));
+        uint32_t bits = 0;
+        std::memcpy(&bits, &value, sizeof(bits));
+        Add(bits);
     }
 
-    SGFX_FORCE_INLINE void drawIndexedInstanced(uint32_t instanceCount, uint32_t count, uint32_t startIndex, uint32_t startVertex, uint32_t startInstance)
+    SGFX_FORCE_INLINE void AddPointer(const void* pointer)
     {
-        currentDrawCall.instanceCount = instanceCount;
-        currentDrawCall.count         = count;
-        currentDrawCall.startVertex   = startVertex;
-        currentDrawCall.startIndex    = startIndex;
-        currentDrawCall.startInstance = startInstance;
-        currentDrawCall.type          = DrawCall::DrawIndexedInstanced;
-        drawCalls.Add(currentDrawCall);
-        std::memset(&currentDrawCall, 0, sizeof(currentDrawCall));
+        uint64_t value = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer));
+        Add(static_cast<uint32_t>(value));
+        Add(static_cast<uint32_t>(value >> 32));
     }
 
-    SGFX_FORCE_INLINE void drawInstancedIndirect(BufferHandle indirectArgs, size_t argsOffset)
+    // the string is copied, null and empty strings are the same key
+    SGFX_FORCE_INLINE void AddString(const char* str)
     {
-        currentDrawCall.type                = DrawCall::DrawInstancedIndirect;
-        currentDrawCall.indirectArgsBuffer  = indirectArgs;
-        currentDrawCall.indirectArgsOffset  = argsOffset;
-        drawCalls.Add(currentDrawCall);
-        std::memset(&currentDrawCall, 0, sizeof(currentDrawCall));
+        size_t length = (str != nullptr) ? std::strlen(str) : 0;
+        Add(static_cast<uint32_t>(length));
+
+        for (size_t i = 0; i < length; i += sizeof(uint32_t)) {
+            uint32_t word = 0;
+            std::memcpy(&word, str + i, (length - i < sizeof(uint32_t)) ? length - i : sizeof(uint32_t));
+            Add(word);
+        }
     }
 
-    SGFX_FORCE_INLINE void drawIndexedInstancedIndirect(BufferHandle indirectArgs, size_t argsOffset)
+    // large blobs (shader bytecode) are keyed by their size and hash
+    SGFX_FORCE_INLINE void AddBlob(const void* data, size_t size)
+    {
+        uint64_t hash = HashBytes(data, size);
+        Add(static_cast<uint32_t>(size));
+        Add(static_cast<uint32_t>(hash));
+        Add(static_cast<uint32_t>(hash >> 32));
+    }
+
+    SGFX_FORCE_INLINE uint64_t GetHash() const { return HashBytes(words.GetData(), words.GetSize() * sizeof(uint32_t)); }
+
+    SGFX_FORCE_INLINE bool operator==(const StateKey& other) const
     {
-        currentDrawCall.type                = DrawCall::DrawIndexedInstancedIndirect;
-        currentDrawCall.indirectArgsBuffer  = indirectArgs;
-        currentDrawCall.indirectArgsOffset  = argsOffset;
-        drawCalls.Add(currentDrawCall);
-        std::memset(&currentDrawCall, 0, sizeof(currentDrawCall));
+        return
+            words.GetSize() == other.words.GetSize() &&
+            std::memcmp(words.GetData(), other.words.GetData(), words.GetSize() * sizeof(uint32_t)) == 0;
     }
 };
 
-struct ComputeQueue final
+static SGFX_FORCE_INLINE void addStateKey(StateKey& key, const RasterizerState& state)
 {
-    enum
-    {
-        kMaxSamplerStates = 8
-    };
+    key.Add(static_cast<uint32_t>(state.fillMode));
+    key.Add(static_cast<uint32_t>(state.cullMode));
+    key.Add(static_cast<uint32_t>(state.counterDirection));
+}
 
-    enum
-    {
-        kMaxConstantBuffers = 8,
-        kMaxShaderResources = 128,
-        kMaxShaderResourcesRW = 8
-    };
+static SGFX_FORCE_INLINE void addStateKey(StateKey& key, const BlendDesc& desc)
+{
+    key.Add(desc.blendEnabled ? 1 : 0);
+    key.Add(static_cast<uint32_t>(desc.writeMask));
+    key.Add(static_cast<uint32_t>(desc.srcBlend));
+    key.Add(static_cast<uint32_t>(desc.dstBlend));
+    key.Add(static_cast<uint32_t>(desc.blendOp));
+    key.Add(static_cast<uint32_t>(desc.srcBlendAlpha));
+    key.Add(static_cast<uint32_t>(desc.dstBlendAlpha));
+    key.Add(static_cast<uint32_t>(desc.blendOpAlpha));
+}
 
-    SamplerStateHandle      samplerStates[kMaxSamplerStates];
-    ConstantBufferHandle    constantBuffers[kMaxConstantBuffers];
-    ShaderResource          shaderResources[kMaxShaderResources];
-    ShaderResource          shaderResourcesRW[kMaxShaderResourcesRW];
+static SGFX_FORCE_INLINE void addStateKey(StateKey& key, const BlendState& state)
+{
+    addStateKey(key, state.blendDesc);
+
+    key.Add(state.separateBlendEnabled ? 1 : 0);
+    for (const BlendDesc& desc : state.renderTargetBlendDesc)
+        addStateKey(key, desc);
+
+    key.Add(state.alphaToCoverageEnabled ? 1 : 0);
+}
+
+static SGFX_FORCE_INLINE void addStateKey(StateKey& key, const StencilDesc& desc)
+{
+    key.Add(static_cast<uint32_t>(desc.stencilFunc));
+    key.Add(static_cast<uint32_t>(desc.failOp));
+    key.Add(static_cast<uint32_t>(desc.depthFailOp));
+    key.Add(static_cast<uint32_t>(desc.passOp));
+}
+
+// the stencil values have no defaults and are only keyed when stencil is enabled
+static SGFX_FORCE_INLINE void addStateKey(StateKey& key, const DepthStencilState& state)
+{
+    key.Add(state.depthEnabled ? 1 : 0);
+    key.Add(static_cast<uint32_t>(state.writeMask));
+    key.Add(static_cast<uint32_t>(state.depthFunc));
+
+    key.Add(state.stencilEnabled ? 1 : 0);
+    if (state.stencilEnabled) {
+        key.Add(state.stencilRef);
+        key.Add(state.stencilReadMask);
+        key.Add(state.stencilWriteMask);
+        addStateKey(key, state.frontFaceStencilDesc);
+        addStateKey(key, state.backFaceStencilDesc);
+    }
+}
+
+static SGFX_FORCE_INLINE void addStateKey(StateKey& key, const VertexElementDescriptor& desc)
+{
+    key.AddString(desc.semanticName);
+    key.Add(desc.semanticIndex);
+    key.Add(static_cast<uint32_t>(desc.format));
+    key.Add(desc.slot);
+    key.Add(static_cast<uint32_t>(desc.offset));
+    key.Add(desc.perInstanceData ? 1 : 0);
+}
+
+static SGFX_FORCE_INLINE void addStateKey(StateKey& key, const SamplerStateDescriptor& desc)
+{
+    key.Add(static_cast<uint32_t>(desc.filter));
+    key.Add(static_cast<uint32_t>(desc.addressU));
+    key.Add(static_cast<uint32_t>(desc.addressV));
+    key.Add(static_cast<uint32_t>(desc.addressW));
+    key.AddFloat(desc.lodBias);
+    key.Add(desc.maxAnisotropy);
+    key.Add(static_cast<uint32_t>(desc.comparisonFunc));
+    key.Add(desc.borderColor);
+    key.AddFloat(desc.minLod);
+    key.AddFloat(desc.maxLod);
+}
+
+// base of the backend state objects kept in a StateCache
+struct StateObject
+{
+    StateObject* nextInBucket = nullptr;
+    uint64_t     hash         = 0;
+    uint32_t     refCount     = 0;
+    StateKey     key;
+};
+
+///
+/// StateCache interns immutable state objects. Objects created from equal StateKeys are shared and
+/// reference counted: Acquire returns the existing object with one more reference, Release drops a
+/// reference and tells the caller to destroy the object when it was the last one.
+///
+/// Sharing makes pointer comparison meaningful, a backend can skip a state when the incoming object
+/// is the one that is already bound. Objects live in a chained hash table that doubles when it has
+/// more objects than buckets. State objects are created rarely and from any thread, so Acquire and
+/// Release lock a mutex and the create functor runs under it.
+///
+template <typename T>
+class StateCache final
+{
+    enum
+    {
+        kInitialBuckets = 64
+    };
+
+    DynamicArray<StateObject*, kInitialBuckets, kInitialBuckets> buckets; // the size is a power of two
+    size_t                                                         numObjects = 0;
+    std::mutex                                                     mutex;
+
+    SGFX_FORCE_INLINE StateObject*& GetBucket(uint64_t hash) { return buckets[static_cast<size_t>(hash) & (buckets.GetSize() - 1)]; }
+
+    void Grow()
+    {
+        DynamicArray<StateObject*, kInitialBuckets, kInitialBuckets> objects;
+        for (StateObject* bucket : buckets) {
+            for (StateObject* object = bucket; object != nullptr; object = object->nextInBucket)
+                objects.Add(object);
+        }
+
+        buckets.Resize(buckets.GetSize() * 2);
+        for (StateObject*& bucket : buckets)
+            bucket = nullptr;
+
+        for (StateObject* object : objects) {
+            StateObject*& bucket = GetBucket(object->hash);
+            object->nextInBucket = bucket;
+            bucket = object;
+        }
+    }
+
+public:
+
+    StateCache()
+    {
+        buckets.Resize(kInitialBuckets);
+        for (StateObject*& bucket : buckets)
+            bucket = nullptr;
+    }
+    StateCache(const StateCache&) = delete;
+    StateCache& operator=(const StateCache&) = delete;
+
+    SGFX_FORCE_INLINE size_t GetSize() const { return numObjects; }
+
+    // create() returns a new object or null on failure, it is only called when there is no object for the key
+    template <typename Create>
+    T* Acquire(const StateKey& key, const Create& create)
+    {
+        uint64_t hash = key.GetHash();
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for (StateObject* object = GetBucket(hash); object != nullptr; object = object->nextInBucket) {
+            if (object->hash == hash && object->key == key) {
+                object->refCount += 1;
+                return static_cast<T*>(object);
+            }
+        }
+
+        T* object = create();
+        if (object == nullptr)
+            return nullptr;
+
+        object->hash     = hash;
+        object->refCount = 1;
+        object->key      = key;
+
+        StateObject*& bucket = GetBucket(hash);
+        object->nextInBucket = bucket;
+        bucket = object;
+
+        numObjects += 1;
+        if (numObjects > buckets.GetSize())
+            Grow();
+
+        return object;
+    }
+
+    // true if that was the last reference, the object is no longer in the cache and the caller destroys it
+    bool Release(T* object)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        object->refCount -= 1;
+        if (object->refCount != 0)
+            return false;
+
+        for (StateObject** link = &GetBucket(object->hash); *link != nullptr; link = &(*link)->nextInBucket) {
+            if (*link == object) {
+                *link = object->nextInBucket;
+                break;
+            }
+        }
+
+        numObjects -= 1;
+        return true;
+    }
+};
+
+// returns the index of the lowest set bit, value must be non-zero
+static SGFX_FORCE_INLINE uint32_t findFirstSetBit(uint64_t value)
+{
+#if defined(_MSC_VER) && defined(_WIN64)
+    unsigned long index = 0;
+    _BitScanForward64(&index, value);
+    return static_cast<uint32_t>(index);
+#elif defined(_MSC_VER)
+    unsigned long index = 0;
+    if (_BitScanForward(&index, static_cast<unsigned long>(value)))
+        return static_cast<uint32_t>(index);
+    _BitScanForward(&index, static_cast<unsigned long>(value >> 32));
+    return static_cast<uint32_t>(index + 32);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(value));
+#endif
+}
+
+///
+/// SlotMask is a fixed size bit set that tracks which binding slots are in use.
+///
+/// ForEach visits set bits only, so sparse masks are iterated in O(number of set bits) instead of
+/// O(N).
+///
+template <size_t N>
+class SlotMask final
+{
+    enum
+    {
+        kNumWords = (N + 63) / 64
+    };
+
+    uint64_t words[kNumWords];
+
+public:
+
+    SGFX_FORCE_INLINE SlotMask() { Clear(); }
+
+    SGFX_FORCE_INLINE void Clear()                   { std::memset(words, 0, sizeof(words)); }
+    SGFX_FORCE_INLINE void Set(uint32_t idx)         { words[idx >> 6] |= (1ULL << (idx & 63)); }
+    SGFX_FORCE_INLINE void Reset(uint32_t idx)       { words[idx >> 6] &= ~(1ULL << (idx & 63)); }
+    SGFX_FORCE_INLINE bool Test(uint32_t idx) const  { return (words[idx >> 6] & (1ULL << (idx & 63))) != 0; }
+
+    SGFX_FORCE_INLINE bool IsEmpty() const
+    {
+        uint64_t result = 0;
+        for (size_t i = 0; i < kNumWords; ++i)
+            result |= words[i];
+        return result == 0;
+    }
+
+    SGFX_FORCE_INLINE SlotMask operator|(const SlotMask& other) const
+    {
+        SlotMask result;
+        for (size_t i = 0; i < kNumWords; ++i)
+            result.words[i] = words[i] | other.words[i];
+        return result;
+    }
+
+    // slots that are set in this mask but not in the other one
+    SGFX_FORCE_INLINE SlotMask Exclude(const SlotMask& other) const
+    {
+        SlotMask result;
+        for (size_t i = 0; i < kNumWords; ++i)
+            result.words[i] = words[i] & ~other.words[i];
+        return result;
+    }
+
+    template <typename Func>
+    SGFX_FORCE_INLINE void ForEach(const Func& func) const
+    {
+        for (size_t i = 0; i < kNumWords; ++i) {
+            uint64_t word = words[i];
+            while (word != 0) {
+                func(static_cast<uint32_t>(i * 64) + findFirstSetBit(word));
+                word &= word - 1;
+            }
+        }
+    }
+
+    // func(first, count) for every run of contiguous set bits, runs may cross words
+    template <typename Func>
+    SGFX_FORCE_INLINE void ForEachRange(const Func& func) const
+    {
+        uint32_t first = 0;
+        uint32_t count = 0;
+
+        for (size_t i = 0; i < kNumWords; ++i) {
+            uint64_t word = words[i];
+            while (word != 0) {
+                uint32_t start    = findFirstSetBit(word);
+                uint64_t inverted = ~(word >> start);
+                uint32_t length   = (inverted != 0) ? findFirstSetBit(inverted) : 64;
+                uint32_t slot     = static_cast<uint32_t>(i * 64) + start;
+
+                if (count != 0 && first + count == slot) {
+                    count += length;
+                } else {
+                    if (count != 0)
+                        func(first, count);
+                    first = slot;
+                    count = length;
+                }
+
+                word = (start + length < 64) ? word & ~(((1ULL << length) - 1) << start) : 0;
+            }
+        }
+
+        if (count != 0)
+            func(first, count);
+    }
+};
+
+///
+/// BindingSlots keeps the values bound to N slots of one kind and the slots that changed since
+/// the last Flush, backends keep one per slot kind for draw and compute translation.
+///
+/// Set only marks a slot when the value differs from the one the last Flush bound, Flush walks the
+/// dirty bits and hands every run of contiguous dirty slots to the backend in one call, so
+/// unchanged slots cost nothing and a change of slots 0-3 is a single bind. Reset puts the slots
+/// that hold a value back to T(), the next Flush unbinds them unless they are set again first, so
+/// a reset followed by the same bindings (sorted submit ranges, child queues) binds nothing.
+/// Values are compared with ==, T() is the unbound value.
+///
+template <typename T, size_t N>
+class BindingSlots final
+{
+    T           values[N];
+    T           bound[N];  // values as of the last Flush
+    SlotMask<N> dirty;     // slots where values and bound differ
+    SlotMask<N> used;      // slots that hold something other than T()
+
+public:
+
+    SGFX_FORCE_INLINE BindingSlots()
+    {
+        for (size_t i = 0; i < N; ++i) {
+            values[i] = T();
+            bound[i]  = T();
+        }
+    }
+
+    SGFX_FORCE_INLINE const T& Get(uint32_t idx) const { return values[idx]; }
+    SGFX_FORCE_INLINE bool     IsDirty() const         { return !dirty.IsEmpty(); }
+
+    SGFX_FORCE_INLINE void Set(uint32_t idx, const T& value)
+    {
+        if (!(values[idx] == value)) {
+            values[idx] = value;
+
+            if (value == bound[idx])
+                dirty.Reset(idx);
+            else
+                dirty.Set(idx);
+
+            if (value == T())
+                used.Reset(idx);
+            else
+                used.Set(idx);
+        }
+    }
+
+    SGFX_FORCE_INLINE void Set(uint32_t first, uint32_t count, const T* newValues)
+    {
+        for (uint32_t i = 0; i < count; ++i)
+            Set(first + i, newValues[i]);
+    }
+
+    // slots below first keep their values
+    SGFX_FORCE_INLINE void Reset(uint32_t first = 0)
+    {
+        used.ForEach([this, first](uint32_t idx) {
+            if (idx >= first)
+                Set(idx, T());
+        });
+    }
+
+    // slots holding value go back to T() without being marked dirty, for bindings the API dropped itself
+    SGFX_FORCE_INLINE void Forget(const T& value)
+    {
+        ForgetIf([&value](const T& other) { return other == value; });
+    }
+
+    // same as Forget for every slot whose value matches pred(value), bound or pending
+    template <typename Pred>
+    SGFX_FORCE_INLINE void ForgetIf(const Pred& pred)
+    {
+        // a slot bound to something else than T() is either in use or dirty
+        (used | dirty).ForEach([this, &pred](uint32_t idx) {
+            if (pred(bound[idx]))
+                bound[idx] = T();
+
+            if (pred(values[idx])) {
+                values[idx] = T();
+                used.Reset(idx);
+            }
+
+            if (values[idx] == bound[idx])
+                dirty.Reset(idx);
+            else
+                dirty.Set(idx);
+        });
+    }
+
+    // bind(first, count, values) for every run of dirty slots
+    template <typename Func>
+    SGFX_FORCE_INLINE void Flush(const Func& bind)
+    {
+        if (dirty.IsEmpty())
+            return;
+
+        dirty.ForEachRange([this, &bind](uint32_t first, uint32_t count) {
+            for (uint32_t i = first; i < first + count; ++i)
+                bound[i] = values[i];
+            bind(first, count, values + first);
+        });
+        dirty.Clear();
+    }
+};
+
+///
+/// CommandBuffer is a growable byte stream used to record queue commands.
+///
+/// Commands are written and read with memcpy, so payloads do not need to be aligned. Capacity
+/// grows geometrically, which keeps appending amortized O(1).
+///
+class CommandBuffer final
+{
+    enum
+    {
+        kInitialCapacity = 4096
+    };
+
+    uint8_t* pointer  = nullptr;
+    size_t   size     = 0;
+    size_t   capacity = 0;
+
+    SGFX_FORCE_INLINE void Grow(size_t minCapacity)
+    {
+        size_t newCapacity = (capacity == 0) ? kInitialCapacity : capacity * 2;
+        while (newCapacity < minCapacity)
+            newCapacity *= 2;
+
+        uint8_t* ptr = DefaultAllocator::Allocate(newCapacity);
+        if (pointer != nullptr) {
+            std::memcpy(ptr, pointer, size);
+            DefaultAllocator::Free(pointer);
+        }
+
+        pointer  = ptr;
+        capacity = newCapacity;
+    }
+
+public:
+
+    SGFX_FORCE_INLINE CommandBuffer() {}
+    CommandBuffer(const CommandBuffer& other) = delete;
+    CommandBuffer& operator=(const CommandBuffer& other) = delete;
+
+    SGFX_FORCE_INLINE ~CommandBuffer()
+    {
+        if (pointer != nullptr)
+            DefaultAllocator::Free(pointer);
+    }
+
+    SGFX_FORCE_INLINE const uint8_t* GetData() const     { return pointer; }
+    SGFX_FORCE_INLINE size_t         GetSize() const     { return size; }
+    SGFX_FORCE_INLINE size_t         GetCapacity() const { return capacity; }
+    SGFX_FORCE_INLINE bool           IsEmpty() const     { return size == 0; }
+
+    SGFX_FORCE_INLINE void Clear() { size = 0; }
+
+    SGFX_FORCE_INLINE uint8_t* Allocate(size_t numBytes)
+    {
+        if (size + numBytes > capacity)
+            Grow(size + numBytes);
+
+        uint8_t* ptr = pointer + size;
+        size += numBytes;
+        return ptr;
+    }
+
+    template <typename T>
+    SGFX_FORCE_INLINE void Write(const T& value)
+    {
+        std::memcpy(Allocate(sizeof(T)), &value, sizeof(T));
+    }
+
+    SGFX_FORCE_INLINE void Append(const uint8_t* data, size_t numBytes)
+    {
+        if (numBytes != 0)
+            std::memcpy(Allocate(numBytes), data, numBytes);
+    }
+};
+
+///
+/// FrameArena is a linear allocator for transient data that lives until the end of the frame.
+///
+/// Memory is carved out of large pages with an atomic bump pointer, so several threads can
+/// allocate at the same time and only switching to the next page takes a lock. Reset() makes all
+/// the memory available again and advances the frame index, pages are kept for the next frames.
+/// The pages only grow when a frame needs more than the frames before it, past kHighWaterMark
+/// that most likely means the frame never ends (no endFrame or present) and debug builds assert.
+///
+class FrameArena final
+{
+    enum
+    {
+        kPageSize      = 1024 * 1024,
+        kAlignment     = 16,
+        kHighWaterMark = 256 * 1024 * 1024
+    };
+
+    struct Page final
+    {
+        Page*               next;
+        size_t              capacity;
+        std::atomic<size_t> used;
+    };
+
+    enum
+    {
+        kPageHeaderSize = (sizeof(Page) + kAlignment - 1) & ~(kAlignment - 1)
+    };
+
+    std::atomic<Page*> current;
+    Page*              first      = nullptr;
+    size_t             capacity   = 0;
+    uint64_t           frameIndex = 0;
+    std::mutex         mutex;
+
+    SGFX_FORCE_INLINE Page* NewPage(size_t pageCapacity)
+    {
+        Page* page = ::new (DefaultAllocator::Allocate(kPageHeaderSize + pageCapacity)) Page;
+        page->next     = nullptr;
+        page->capacity = pageCapacity;
+        page->used.store(0, std::memory_order_relaxed);
+
+        capacity += pageCapacity;
+        assert(capacity <= kHighWaterMark && "FrameArena: frame too large, is endFrame() called?");
+        return page;
+    }
+
+    // moves to the next page that fits, must be called with the mutex locked
+    SGFX_FORCE_INLINE void Advance(Page* page, size_t numBytes)
+    {
+        if (current.load(std::memory_order_relaxed) != page)
+            return; // another thread has already done it
+
+        size_t pageCapacity = (numBytes > kPageSize) ? numBytes : kPageSize;
+
+        if (page == nullptr) {
+            first = NewPage(pageCapacity);
+            current.store(first, std::memory_order_release);
+            return;
+        }
+
+        Page* next = page->next;
+        if (next == nullptr || next->capacity < numBytes) {
+            Page* newPage = NewPage(pageCapacity);
+            newPage->next = next;
+            page->next    = newPage;
+            next          = newPage;
+        }
+
+        current.store(next, std::memory_order_release);
+    }
+
+public:
+
+    FrameArena() : current(nullptr) {}
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    ~FrameArena()
+    {
+        Page* page = first;
+        while (page != nullptr) {
+            Page* next = page->next;
+            page->~Page();
+            DefaultAllocator::Free(reinterpret_cast<uint8_t*>(page));
+            page = next;
+        }
+    }
+
+    SGFX_FORCE_INLINE uint64_t GetFrameIndex() const { return frameIndex; }
+    SGFX_FORCE_INLINE size_t   GetCapacity() const   { return capacity; }
+
+    // thread safe
+    SGFX_FORCE_INLINE uint8_t* Allocate(size_t numBytes)
+    {
+        numBytes = (numBytes + kAlignment - 1) & ~static_cast<size_t>(kAlignment - 1);
+
+        for (;;) {
+            Page* page = current.load(std::memory_order_acquire);
+            if (page != nullptr) {
+                size_t offset = page->used.fetch_add(numBytes, std::memory_order_relaxed);
+                if (offset + numBytes <= page->capacity)
+                    return reinterpret_cast<uint8_t*>(page) + kPageHeaderSize + offset;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            Advance(page, numBytes);
+        }
+    }
+
+    // not thread safe, all the memory returned by Allocate becomes invalid
+    SGFX_FORCE_INLINE void Reset()
+    {
+        for (Page* page = first; page != nullptr; page = page->next)
+            page->used.store(0, std::memory_order_relaxed);
+
+        current.store(first, std::memory_order_release);
+        frameIndex++;
+    }
+};
+
+// commands that are handled by the stream itself
+namespace StreamCommand {
+enum : uint8_t {
+    Segment = 0xFE, // uint64_t key, next segment - skipped by readers, see DrawQueue::setSortKey
+    Jump    = 0xFF  // pointer to the next block
+};
+
+enum
+{
+    kSegmentSize = 1 + sizeof(uint64_t) + sizeof(void*),
+    kJumpSize    = 1 + sizeof(void*)
+};
+}
+
+///
+/// ArenaCommandBuffer records commands into blocks allocated from a FrameArena.
+///
+/// Blocks are linked with jump commands, so growing never copies anything. Block size doubles
+/// up to kMaxBlockSize, blocks are reused after Clear() and dropped after Reset(). Every command
+/// has to end up in a single block: writers reserve the maximum size of what they are going to
+/// write first. The recorded data is valid until the arena is reset.
+///
+class ArenaCommandBuffer final
+{
+    enum
+    {
+        kMinBlockSize = 4096,
+        kMaxBlockSize = 64 * 1024
+    };
+
+    struct Block final
+    {
+        Block*   next;
+        size_t   capacity;
+        size_t   size;     // bytes used, the jump to the next block is not included
+
+        SGFX_FORCE_INLINE uint8_t* GetData() { return reinterpret_cast<uint8_t*>(this + 1); }
+    };
+
+    FrameArena* arena;
+    Block*      first     = nullptr;
+    Block*      last      = nullptr;
+    uint8_t*    cursor    = nullptr;
+    uint8_t*    limit     = nullptr; // the space for a jump is reserved after the limit
+    size_t      size      = 0;
+    size_t      blockSize = kMinBlockSize;
+
+    SGFX_FORCE_INLINE void NewBlock(size_t numBytes)
+    {
+        Block* block = (last != nullptr) ? last->next : first;
+
+        if (block == nullptr || block->capacity < numBytes) {
+            size_t capacity = blockSize;
+            while (capacity < numBytes)
+                capacity *= 2;
+
+            if (blockSize < kMaxBlockSize)
+                blockSize *= 2;
+
+            Block* next = block;
+            block = reinterpret_cast<Block*>(arena->Allocate(sizeof(Block) + capacity + StreamCommand::kJumpSize));
+            block->next     = next;
+            block->capacity = capacity;
+        }
+
+        if (last != nullptr) {
+            uint8_t* data = block->GetData();
+
+            last->size = static_cast<size_t>(cursor - last->GetData());
+            last->next = block;
+
+            cursor[0] = StreamCommand::Jump;
+            std::memcpy(cursor + 1, &data, sizeof(data));
+        } else {
+            first = block;
+        }
+
+        last   = block;
+        cursor = block->GetData();
+        limit  = cursor + block->capacity;
+    }
+
+public:
+
+    SGFX_FORCE_INLINE explicit ArenaCommandBuffer(FrameArena* frameArena) : arena(frameArena) {}
+    ArenaCommandBuffer(const ArenaCommandBuffer& other) = delete;
+    ArenaCommandBuffer& operator=(const ArenaCommandBuffer& other) = delete;
+
+    SGFX_FORCE_INLINE FrameArena*    GetArena() const { return arena; }
+    SGFX_FORCE_INLINE const uint8_t* GetBegin() const { return (first != nullptr) ? first->GetData() : nullptr; }
+    SGFX_FORCE_INLINE const uint8_t* GetEnd() const   { return cursor; }
+    SGFX_FORCE_INLINE size_t         GetSize() const  { return size; }
+    SGFX_FORCE_INLINE bool           IsEmpty() const  { return size == 0; }
+
+    // rewinds to the first block, blocks are kept
+    SGFX_FORCE_INLINE void Clear()
+    {
+        if (first != nullptr) {
+            cursor = first->GetData();
+            limit  = cursor + first->capacity;
+        }
+
+        last = first;
+        size = 0;
+    }
+
+    // forgets all the blocks, they belong to an arena that was reset
+    SGFX_FORCE_INLINE void Reset()
+    {
+        first  = nullptr;
+        last   = nullptr;
+        cursor = nullptr;
+        limit  = nullptr;
+        size   = 0;
+    }
+
+    SGFX_FORCE_INLINE void Reserve(size_t numBytes)
+    {
+        if (static_cast<size_t>(limit - cursor) < numBytes)
+            NewBlock(numBytes);
+    }
+
+    SGFX_FORCE_INLINE uint8_t* Allocate(size_t numBytes)
+    {
+        Reserve(numBytes);
+
+        uint8_t* ptr = cursor;
+        cursor += numBytes;
+        size   += numBytes;
+        return ptr;
+    }
+
+    template <typename T>
+    SGFX_FORCE_INLINE void Write(const T& value)
+    {
+        std::memcpy(Allocate(sizeof(T)), &value, sizeof(T));
+    }
+
+    // calls func(data, size) for every block, jumps are not included
+    template <typename Func>
+    SGFX_FORCE_INLINE void ForEachBlock(const Func& func) const
+    {
+        for (Block* block = first; block != nullptr; block = block->next) {
+            if (block == last) {
+                func(block->GetData(), static_cast<size_t>(cursor - block->GetData()));
+                break;
+            }
+            func(block->GetData(), block->size);
+        }
+    }
+};
+
+class CommandReader final
+{
+    const uint8_t* pointer;
+    const uint8_t* end;
+
+public:
+
+    SGFX_FORCE_INLINE CommandReader(const uint8_t* begin, const uint8_t* streamEnd)
+        : pointer(begin), end(streamEnd)
+    {}
+
+    SGFX_FORCE_INLINE explicit CommandReader(const CommandBuffer& buffer)
+        : pointer(buffer.GetData()), end(buffer.GetData() + buffer.GetSize())
+    {}
+
+    SGFX_FORCE_INLINE explicit CommandReader(const ArenaCommandBuffer& buffer)
+        : pointer(buffer.GetBegin()), end(buffer.GetEnd())
+    {}
+
+    // reads the next opcode, follows jumps and skips segments, returns false at the end
+    SGFX_FORCE_INLINE bool ReadOpcode(uint8_t& opcode)
+    {
+        while (pointer != end) {
+            opcode = Read<uint8_t>();
+
+            if (opcode == StreamCommand::Jump)
+                pointer = Read<const uint8_t*>();
+            else if (opcode == StreamCommand::Segment)
+                pointer += StreamCommand::kSegmentSize - 1;
+            else
+                return true;
+        }
+        return false;
+    }
+
+    template <typename T>
+    SGFX_FORCE_INLINE T Read()
+    {
+        T value;
+        std::memcpy(&value, pointer, sizeof(T));
+        pointer += sizeof(T);
+        return value;
+    }
+
+    // skips size bytes of inline data and returns them, the data is not aligned
+    SGFX_FORCE_INLINE const uint8_t* ReadBytes(size_t size)
+    {
+        const uint8_t* data = pointer;
+        pointer += size;
+        return data;
+    }
+};
+
+// emulated draw queues for pre-DX12 APIs (DX11 and GL4)
+struct ShaderResource final
+{
+    bool  isTexture = false;
+    void* value     = nullptr;
+
+    inline ShaderResource() {}
+    inline ShaderResource(bool texture, void* newHandle)
+        : isTexture(texture), value(newHandle)
+    {}
+};
+
+// draw call arguments, decoded from the command stream
+struct DrawCall final
+{
+    enum Type : uint32_t
+    {
+        Draw                            = 0,
+        DrawIndexed                     = 1,
+        DrawInstanced                   = 2,
+        DrawIndexedInstanced            = 3,
+
+        DrawInstancedIndirect           = 4,
+        DrawIndexedInstancedIndirect    = 5,
+        MultiDrawIndexedIndirect        = 6
+    };
+
+    enum
+    {
+        kMaxConstantBuffers     = 8,
+        kMaxShaderResources     = 128,
+        kMaxVertexBuffers       = 16,
+        kMaxSamplerStates       = 8,
+        kMaxBindGroups          = 4
+    };
+
+    BufferHandle      indirectArgsBuffer;
+    size_t            indirectArgsOffset = 0;
+
+    // multi draw indirect
+    BufferHandle      indirectCountBuffer;
+    size_t            indirectCountOffset = 0;
+    uint32_t          indirectStride      = 0;
+    uint32_t          maxDrawCount        = 0;
+
+    uint32_t instanceCount  = 0;
+    uint32_t count          = 0;
+    uint32_t startVertex    = 0;
+    uint32_t startIndex     = 0;
+    uint32_t startInstance  = 0;
+    Type     type           = Draw;
+};
+
+///
+/// BindGroup holds the slots covered by a bind group, backends derive their bind group
+/// implementation from it. Draw queues use the masks to keep the per slot state in sync.
+///
+struct BindGroup
+{
+    typedef SlotMask<DrawCall::kMaxConstantBuffers> ConstantBufferMask;
+    typedef SlotMask<DrawCall::kMaxShaderResources> ShaderResourceMask;
+    typedef SlotMask<DrawCall::kMaxSamplerStates>   SamplerStateMask;
+
+    uint32_t firstConstantBuffer = 0;
+    uint32_t numConstantBuffers  = 0;
+    uint32_t firstShaderResource = 0;
+    uint32_t numShaderResources  = 0;
+    uint32_t firstSamplerState   = 0;
+    uint32_t numSamplerStates    = 0;
+
+    ConstantBufferMask constantBufferMask;
+    ShaderResourceMask shaderResourceMask;
+    SamplerStateMask   samplerStateMask;
+
+    explicit BindGroup(const BindGroupDescriptor& desc)
+        : firstConstantBuffer(desc.firstConstantBuffer), numConstantBuffers(desc.numConstantBuffers)
+        , firstShaderResource(desc.firstShaderResource), numShaderResources(desc.numShaderResources)
+        , firstSamplerState(desc.firstSamplerState),     numSamplerStates(desc.numSamplerStates)
+    {
+        for (uint32_t i = 0; i < numConstantBuffers; ++i)
+            constantBufferMask.Set(firstConstantBuffer + i);
+        for (uint32_t i = 0; i < numShaderResources; ++i)
+            shaderResourceMask.Set(firstShaderResource + i);
+        for (uint32_t i = 0; i < numSamplerStates; ++i)
+            samplerStateMask.Set(firstSamplerState + i);
+    }
+
+    // the ranges must fit both the descriptor arrays and the draw call slots
+    static SGFX_FORCE_INLINE bool IsValid(const BindGroupDescriptor& desc)
+    {
+        return
+            desc.numConstantBuffers <= BindGroupDescriptor::kMaxConstantBuffers &&
+            desc.numShaderResources <= BindGroupDescriptor::kMaxShaderResources &&
+            desc.numSamplerStates   <= BindGroupDescriptor::kMaxSamplerStates   &&
+            desc.firstConstantBuffer + desc.numConstantBuffers <= DrawCall::kMaxConstantBuffers &&
+            desc.firstShaderResource + desc.numShaderResources <= DrawCall::kMaxShaderResources &&
+            desc.firstSamplerState   + desc.numSamplerStates   <= DrawCall::kMaxSamplerStates;
+    }
+};
+
+///
+/// Draw queue command stream opcodes.
+///
+/// Every command is a single opcode byte followed by its payload. Draw opcodes match
+/// DrawCall::Type, state opcodes follow them. DrawQueue only records state that differs from the
+/// state of the previous draw call, so a run of draw calls that share buffers and resources costs
+/// just the draw opcode and its arguments.
+///
+namespace DrawCommand {
+enum : uint8_t {
+    Draw                         = DrawCall::Draw,                         // count, startVertex
+    DrawIndexed                  = DrawCall::DrawIndexed,                  // count, startIndex, startVertex
+    DrawInstanced                = DrawCall::DrawInstanced,                // instanceCount, count, startVertex, startInstance
+    DrawIndexedInstanced         = DrawCall::DrawIndexedInstanced,         // instanceCount, count, startIndex, startVertex, startInstance
+    DrawInstancedIndirect        = DrawCall::DrawInstancedIndirect,        // buffer, offset
+    DrawIndexedInstancedIndirect = DrawCall::DrawIndexedInstancedIndirect, // buffer, offset
+    MultiDrawIndexedIndirect     = DrawCall::MultiDrawIndexedIndirect,     // buffer, offset, uint32_t maxDraws, count buffer, count offset, uint32_t stride
+
+    SetPrimitiveTopology,        // uint8_t topology
+    SetVertexBuffer,             // uint8_t slot, buffer
+    SetIndexBuffer,              // buffer
+    SetConstantBuffer,           // uint8_t slot, buffer
+    SetResource,                 // uint8_t slot, uint8_t isTexture, resource (null resource unbinds the slot)
+    SetBindGroup,                // uint8_t slot, bind group (null group unbinds the slots of the previous one)
+    SetConstants,                // uint8_t slot, uint32_t size, size bytes of constant data
+
+    LastDraw = MultiDrawIndexedIndirect
+};
+}
+
+// folds consecutive draw calls with contiguous ranges into one, used by the backends on submit
+// the stream only records state changes, so consecutive draw calls always share the same state
+class DrawCallMerger final
+{
+    DrawCall pending;
+    bool     hasPending = false;
+    bool     enabled    = false;
+    bool     canAppend  = true;  // strips can not be concatenated
+    bool     triangles  = true;  // a triangle list only continues after a whole triangle
+    uint32_t numMerged  = 0;
+
+    static SGFX_FORCE_INLINE bool TryMerge(DrawCall& dst, const DrawCall& src)
+    {
+        if (dst.type != src.type)
+            return false;
+
+        switch (dst.type) {
+        case DrawCall::Draw: {
+            if (dst.startVertex + dst.count != src.startVertex)
+                return false;
+        } break;
+
+        case DrawCall::DrawIndexed: {
+            if (dst.startVertex != src.startVertex || dst.startIndex + dst.count != src.startIndex)
+                return false;
+        } break;
+
+        case DrawCall::DrawInstanced: {
+            if (dst.instanceCount != src.instanceCount || dst.startInstance != src.startInstance ||
+                dst.startVertex + dst.count != src.startVertex)
+                return false;
+        } break;
+
+        case DrawCall::DrawIndexedInstanced: {
+            if (dst.instanceCount != src.instanceCount || dst.startInstance != src.startInstance ||
+                dst.startVertex != src.startVertex || dst.startIndex + dst.count != src.startIndex)
+                return false;
+        } break;
+
+        default: return false; // indirect arguments are not known on the CPU
+        }
+
+        dst.count += src.count;
+        return true;
+    }
+
+public:
+
+    explicit DrawCallMerger(bool enable) : enabled(enable) {}
+
+    SGFX_FORCE_INLINE uint32_t GetNumMerged() const { return numMerged; }
+
+    SGFX_FORCE_INLINE void SetTopology(PrimitiveTopology topology)
+    {
+        canAppend = topology != PrimitiveTopology::TriangleStrip;
+        triangles = topology == PrimitiveTopology::TriangleList;
+    }
+
+    // issues the previous draw call unless the new one extends it
+    template <typename F>
+    SGFX_FORCE_INLINE void Add(const DrawCall& call, F issue)
+    {
+        if (!enabled) {
+            issue(call);
+            return;
+        }
+
+        if (hasPending) {
+            // a partial triangle at the end would take vertices of the next draw call
+            bool wholePrimitives = !triangles || (pending.count % 3) == 0;
+            if (canAppend && wholePrimitives && TryMerge(pending, call)) {
+                numMerged++;
+                return;
+            }
+            issue(pending);
+        }
+
+        pending    = call;
+        hasPending = true;
+    }
+
+    // must be called before any state change and at the end of a stream
+    template <typename F>
+    SGFX_FORCE_INLINE void Flush(F issue)
+    {
+        if (hasPending) {
+            issue(pending);
+            hasPending = false;
+        }
+    }
+};
+
+class DrawQueue final
+{
+public:
+
+    typedef SlotMask<DrawCall::kMaxVertexBuffers>   VertexBufferMask;
+    typedef SlotMask<DrawCall::kMaxConstantBuffers> ConstantBufferMask;
+    typedef SlotMask<DrawCall::kMaxShaderResources> ShaderResourceMask;
+    typedef SlotMask<DrawCall::kMaxBindGroups>      BindGroupMask;
+
+private:
+
+    enum
+    {
+        // the most recordState() and a draw call can write
+        kMaxRecordSize =
+            StreamCommand::kSegmentSize +
+            2 + (1 + sizeof(void*)) +                                   // topology, index buffer
+            DrawCall::kMaxVertexBuffers   * (2 + sizeof(void*)) +
+            DrawCall::kMaxBindGroups      * (2 + sizeof(void*)) +
+            DrawCall::kMaxConstantBuffers * (2 + sizeof(void*)) +
+            DrawCall::kMaxShaderResources * (3 + sizeof(void*)) +
+            1 + 2 * (sizeof(void*) + sizeof(uint64_t) + sizeof(uint32_t)) // largest draw call
+    };
+
+    struct DrawState final
+    {
+        PrimitiveTopology    primitiveTopology = PrimitiveTopology::TriangleList;
+        BufferHandle         indexBuffer;
+        BufferHandle         vertexBuffers[DrawCall::kMaxVertexBuffers];
+        ConstantBufferHandle constantBuffers[DrawCall::kMaxConstantBuffers];
+        ShaderResource       shaderResources[DrawCall::kMaxShaderResources];
+        BindGroupHandle      bindGroups[DrawCall::kMaxBindGroups];
+
+        // inline constants, copied to the frame arena until the draw call writes them into the stream
+        const uint8_t*       constantData[DrawCall::kMaxConstantBuffers];
+        uint32_t             constantDataSizes[DrawCall::kMaxConstantBuffers];
+
+        // pending state: slots that were set since the last draw call
+        // recorded state: slots that are not null
+        VertexBufferMask     vertexBufferMask;
+        ConstantBufferMask   constantBufferMask;
+        ConstantBufferMask   constantDataMask;   // slots bound to inline constants instead of a buffer
+        ShaderResourceMask   shaderResourceMask;
+        BindGroupMask        bindGroupMask;
+    };
+
+    // recording state, lives in the frame arena together with the commands
+    struct TransientState final
+    {
+        DrawState pending;  // state for the next draw call
+        DrawState recorded; // state already written to the command stream
+    };
+
+    PipelineStateHandle state;
+    ArenaCommandBuffer  commands;
+    uint32_t            numDrawCalls = 0;
+
+    TransientState*     transient  = nullptr;
+    uint64_t            frameIndex = 0;       // frame of the transient data
+
+    // child queues are recorded independently and submitted after the parent, in creation order
+    DrawQueue*                     parent = nullptr;
+    DynamicArray<DrawQueue*, 1, 8> children;
+
+    // sort keys, only used when setSortKey was called since the last submit
+    // key runs are marked with segment commands linked into a list inside the stream
+    uint64_t            sortKey        = 0;
+    bool                sortingEnabled = false;
+    uint8_t*            firstSegment   = nullptr;
+    uint8_t*            lastSegment    = nullptr;
+
+    // draw merging, kept between submits, the children follow the root queue
+    bool                mergingEnabled     = false;
+    mutable uint32_t    numMergedDrawCalls = 0;       // by the last submit
+
+    SGFX_FORCE_INLINE bool isCurrent() const
+    {
+        return transient != nullptr && frameIndex == commands.GetArena()->GetFrameIndex();
+    }
+
+    // the arena was reset since the last recording, start over
+    SGFX_FORCE_INLINE void beginRecording()
+    {
+        if (!isCurrent()) {
+            FrameArena* arena = commands.GetArena();
+
+            transient  = ::new (arena->Allocate(sizeof(TransientState))) TransientState;
+            frameIndex = arena->GetFrameIndex();
+
+            commands.Reset();
+            resetTransientData();
+        }
+    }
+
+    SGFX_FORCE_INLINE void resetRecordedState()
+    {
+        DrawState& recorded = transient->recorded;
+
+        recorded.vertexBufferMask.ForEach([&recorded](uint32_t i)   { recorded.vertexBuffers[i] = BufferHandle::invalidHandle(); });
+        recorded.constantBufferMask.ForEach([&recorded](uint32_t i) { recorded.constantBuffers[i] = ConstantBufferHandle::invalidHandle(); });
+        recorded.shaderResourceMask.ForEach([&recorded](uint32_t i) { recorded.shaderResources[i] = ShaderResource(); });
+        recorded.bindGroupMask.ForEach([&recorded](uint32_t i)      { recorded.bindGroups[i] = BindGroupHandle::invalidHandle(); });
+
+        recorded.vertexBufferMask.Clear();
+        recorded.constantBufferMask.Clear();
+        recorded.constantDataMask.Clear();
+        recorded.shaderResourceMask.Clear();
+        recorded.bindGroupMask.Clear();
+
+        recorded.primitiveTopology = PrimitiveTopology::Count; // force the first draw call to set it
+        recorded.indexBuffer       = BufferHandle::invalidHandle();
+    }
+
+    SGFX_FORCE_INLINE void resetTransientData()
+    {
+        numDrawCalls = 0;
+        resetRecordedState();
+
+        sortKey        = 0;
+        sortingEnabled = false;
+        firstSegment   = nullptr;
+        lastSegment    = nullptr;
+    }
+
+    SGFX_FORCE_INLINE void clearCommands()
+    {
+        if (isCurrent()) {
+            commands.Clear();
+            resetTransientData();
+        }
+    }
+
+    SGFX_FORCE_INLINE DrawState& getPendingState()
+    {
+        beginRecording();
+        return transient->pending;
+    }
+
+    SGFX_FORCE_INLINE void beginSegment()
+    {
+        uint8_t* segment = commands.Allocate(StreamCommand::kSegmentSize);
+        uint8_t* next    = nullptr;
+
+        segment[0] = StreamCommand::Segment;
+        std::memcpy(segment + 1, &sortKey, sizeof(sortKey));
+        std::memcpy(segment + 1 + sizeof(sortKey), &next, sizeof(next));
+
+        if (lastSegment != nullptr)
+            std::memcpy(lastSegment + 1 + sizeof(sortKey), &segment, sizeof(segment));
+        else
+            firstSegment = segment;
+
+        lastSegment = segment;
+    }
+
+    // writes the difference between the pending and the recorded state, then resets the pending
+    // state - every draw call starts with a clean state, just like a freshly created queue
+    SGFX_FORCE_INLINE void recordState()
+    {
+        beginRecording();
+
+        size_t recordSize = kMaxRecordSize;
+        transient->pending.constantDataMask.ForEach([this, &recordSize](uint32_t i) {
+            recordSize += 2 + sizeof(uint32_t) + transient->pending.constantDataSizes[i];
+        });
+        commands.Reserve(recordSize);
+
+        // start a new run when the key changes, runs are moved around independently when sorting
+        if (sortingEnabled && (lastSegment == nullptr || getSegmentKey(lastSegment) != sortKey)) {
+            resetRecordedState();
+            beginSegment();
+        }
+
+        DrawState& pending  = transient->pending;
+        DrawState& recorded = transient->recorded;
+        if (pending.primitiveTopology != recorded.primitiveTopology) {
+            commands.Write<uint8_t>(DrawCommand::SetPrimitiveTopology);
+            commands.Write<uint8_t>(static_cast<uint8_t>(pending.primitiveTopology));
+            recorded.primitiveTopology = pending.primitiveTopology;
+        }
+
+        if (pending.indexBuffer.value != recorded.indexBuffer.value) {
+            commands.Write<uint8_t>(DrawCommand::SetIndexBuffer);
+            commands.Write<void*>(pending.indexBuffer.value);
+            recorded.indexBuffer = pending.indexBuffer;
+        }
+
+        (pending.vertexBufferMask | recorded.vertexBufferMask).ForEach([this, &pending, &recorded](uint32_t i) {
+            void* value = pending.vertexBufferMask.Test(i) ? pending.vertexBuffers[i].value : nullptr;
+            if (value != recorded.vertexBuffers[i].value) {
+                commands.Write<uint8_t>(DrawCommand::SetVertexBuffer);
+                commands.Write<uint8_t>(static_cast<uint8_t>(i));
+                commands.Write<void*>(value);
+
+                recorded.vertexBuffers[i] = value;
+                if (value != nullptr) recorded.vertexBufferMask.Set(i);
+                else                  recorded.vertexBufferMask.Reset(i);
+            }
+        });
+
+        // bind groups go before the per slot state: the slots of a bound group are owned by it, the
+        // per slot state is only recorded for the remaining ones
+        ConstantBufferMask groupConstantBuffers;
+        ShaderResourceMask groupShaderResources;
+
+        (pending.bindGroupMask | recorded.bindGroupMask).ForEach([this, &pending, &recorded, &groupConstantBuffers, &groupShaderResources](uint32_t i) {
+            void*            value = pending.bindGroupMask.Test(i) ? pending.bindGroups[i].value : nullptr;
+            const BindGroup* group = static_cast<const BindGroup*>(value);
+
+            if (value != recorded.bindGroups[i].value) {
+                commands.Write<uint8_t>(DrawCommand::SetBindGroup);
+                commands.Write<uint8_t>(static_cast<uint8_t>(i));
+                commands.Write<void*>(value);
+
+                recorded.bindGroups[i] = value;
+                if (value != nullptr) recorded.bindGroupMask.Set(i);
+                else                  recorded.bindGroupMask.Reset(i);
+
+                // the group replaced whatever was bound to its slots
+                if (group != nullptr) {
+                    group->constantBufferMask.ForEach([&recorded](uint32_t slot) { recorded.constantBuffers[slot] = ConstantBufferHandle::invalidHandle(); });
+                    group->shaderResourceMask.ForEach([&recorded](uint32_t slot) { recorded.shaderResources[slot] = ShaderResource(); });
+
+                    recorded.constantBufferMask = recorded.constantBufferMask.Exclude(group->constantBufferMask);
+                    recorded.constantDataMask   = recorded.constantDataMask.Exclude(group->constantBufferMask);
+                    recorded.shaderResourceMask = recorded.shaderResourceMask.Exclude(group->shaderResourceMask);
+                }
+            }
+
+            if (group != nullptr) {
+                groupConstantBuffers = groupConstantBuffers | group->constantBufferMask;
+                groupShaderResources = groupShaderResources | group->shaderResourceMask;
+            }
+        });
+
+        // inline constants are written for every draw call that sets them, the next draw call
+        // without them unbinds the slot like a null buffer
+        ConstantBufferMask constantSlots = pending.constantBufferMask | pending.constantDataMask | recorded.constantBufferMask | recorded.constantDataMask;
+        constantSlots.Exclude(groupConstantBuffers).ForEach([this, &pending, &recorded](uint32_t i) {
+            if (pending.constantDataMask.Test(i)) {
+                uint32_t size = pending.constantDataSizes[i];
+
+                commands.Write<uint8_t>(DrawCommand::SetConstants);
+                commands.Write<uint8_t>(static_cast<uint8_t>(i));
+                commands.Write<uint32_t>(size);
+                std::memcpy(commands.Allocate(size), pending.constantData[i], size);
+
+                recorded.constantBuffers[i] = ConstantBufferHandle::invalidHandle();
+                recorded.constantBufferMask.Reset(i);
+                recorded.constantDataMask.Set(i);
+                return;
+            }
+
+            void* value = pending.constantBufferMask.Test(i) ? pending.constantBuffers[i].value : nullptr;
+            if (value != recorded.constantBuffers[i].value || recorded.constantDataMask.Test(i)) {
+                commands.Write<uint8_t>(DrawCommand::SetConstantBuffer);
+                commands.Write<uint8_t>(static_cast<uint8_t>(i));
+                commands.Write<void*>(value);
+
+                recorded.constantBuffers[i] = value;
+                recorded.constantDataMask.Reset(i);
+                if (value != nullptr) recorded.constantBufferMask.Set(i);
+                else                  recorded.constantBufferMask.Reset(i);
+            }
+        });
+
+        (pending.shaderResourceMask | recorded.shaderResourceMask).Exclude(groupShaderResources).ForEach([this, &pending, &recorded](uint32_t i) {
+            ShaderResource resource;
+            if (pending.shaderResourceMask.Test(i))
+                resource = pending.shaderResources[i];
+
+            const ShaderResource& prev = recorded.shaderResources[i];
+            if (resource.value != prev.value || (resource.value != nullptr && resource.isTexture != prev.isTexture)) {
+                // null resources keep the type of the previous one, so the backend knows what to unbind
+                bool isTexture = (resource.value != nullptr) ? resource.isTexture : prev.isTexture;
+
+                commands.Write<uint8_t>(DrawCommand::SetResource);
+                commands.Write<uint8_t>(static_cast<uint8_t>(i));
+                commands.Write<uint8_t>(isTexture ? 1 : 0);
+                commands.Write<void*>(resource.value);
+
+                recorded.shaderResources[i] = resource;
+                if (resource.value != nullptr) recorded.shaderResourceMask.Set(i);
+                else                           recorded.shaderResourceMask.Reset(i);
+            }
+        });
+
+        pending.primitiveTopology = PrimitiveTopology::TriangleList;
+        pending.indexBuffer       = BufferHandle::invalidHandle();
+        pending.vertexBufferMask.Clear();
+        pending.constantBufferMask.Clear();
+        pending.constantDataMask.Clear();
+        pending.shaderResourceMask.Clear();
+        pending.bindGroupMask.Clear();
+
+        numDrawCalls++;
+    }
+
+public:
+
+    enum
+    {
+        kMaxSamplerStates    = 8,
+        kMaxConstantDataSize = 4096 // per slot and draw call, see setConstants
+    };
+    SamplerStateHandle samplerStates[kMaxSamplerStates];
+
+    DrawQueue(FrameArena* arena, PipelineStateHandle _state) : state(_state), commands(arena) {}
+
+    // children of a child queue are attached to the root queue, so there is only one level
+    DrawQueue(DrawQueue* _parent)
+        : state(_parent->state)
+        , commands(_parent->commands.GetArena())
+        , parent((_parent->parent != nullptr) ? _parent->parent : _parent)
+    {
+        parent->children.Add(this);
+    }
+
+    ~DrawQueue()
+    {
+        if (parent != nullptr)
+            parent->children.Remove(this);
+        for (DrawQueue* child : children)
+            child->parent = nullptr;
+    }
+
+    SGFX_FORCE_INLINE PipelineStateHandle       getState() const        { return state; }
+    SGFX_FORCE_INLINE const ArenaCommandBuffer& getCommands() const     { return commands; }
+    SGFX_FORCE_INLINE uint32_t                  getNumDrawCalls() const { return isCurrent() ? numDrawCalls : 0; }
+
+    SGFX_FORCE_INLINE const ImmutableArray<DrawQueue*>& getChildren() const { return children; }
+
+    // segments of the sort key runs, null if sorting was not used
+    SGFX_FORCE_INLINE const uint8_t* getFirstSegment() const { return isCurrent() ? firstSegment : nullptr; }
+
+    static SGFX_FORCE_INLINE uint64_t getSegmentKey(const uint8_t* segment)
+    {
+        uint64_t key;
+        std::memcpy(&key, segment + 1, sizeof(key));
+        return key;
+    }
+
+    static SGFX_FORCE_INLINE const uint8_t* getNextSegment(const uint8_t* segment)
+    {
+        const uint8_t* next;
+        std::memcpy(&next, segment + 1 + sizeof(uint64_t), sizeof(next));
+        return next;
+    }
+
+    // true if neither this queue nor any of its children has recorded draw calls
+    SGFX_FORCE_INLINE bool isEmpty() const
+    {
+        uint32_t result = getNumDrawCalls();
+        for (const DrawQueue* child : children)
+            result |= child->getNumDrawCalls();
+        return result == 0;
+    }
+
+    SGFX_FORCE_INLINE void clear()
+    {
+        clearCommands();
+
+        for (DrawQueue* child : children)
+            child->clearCommands();
+    }
+
+    SGFX_FORCE_INLINE bool     isMergingEnabled() const                    { return mergingEnabled; }
+    SGFX_FORCE_INLINE void     setMergingEnabled(bool value)               { mergingEnabled = value; }
+    SGFX_FORCE_INLINE uint32_t getNumMergedDrawCalls() const               { return numMergedDrawCalls; }
+    SGFX_FORCE_INLINE void     setNumMergedDrawCalls(uint32_t value) const { numMergedDrawCalls = value; }
+
+    SGFX_FORCE_INLINE void setSortKey(uint64_t key)
+    {
+        beginRecording();
+
+        sortKey        = key;
+        sortingEnabled = true;
+    }
+
+    SGFX_FORCE_INLINE void setPrimitiveTopology(PrimitiveTopology topology)     { getPendingState().primitiveTopology = topology; }
+    SGFX_FORCE_INLINE void setIndexBuffer(BufferHandle handle)                  { getPendingState().indexBuffer = handle; }
+
+    SGFX_FORCE_INLINE void setVertexBuffer(uint32_t idx, BufferHandle handle)
+    {
+        DrawState& pending = getPendingState();
+        pending.vertexBuffers[idx] = handle;
+        pending.vertexBufferMask.Set(idx);
+    }
+
+    SGFX_FORCE_INLINE void setSamplerState(uint32_t idx, SamplerStateHandle handle)
+    {
+        samplerStates[idx] = handle;
+    }
+
+    SGFX_FORCE_INLINE void setConstantBuffer(uint32_t idx, ConstantBufferHandle resource)
+    {
+        DrawState& pending = getPendingState();
+        pending.constantBuffers[idx] = resource;
+        pending.constantBufferMask.Set(idx);
+        pending.constantDataMask.Reset(idx);
+    }
+
+    // the data is copied now, the stream gets it with the next draw call
+    SGFX_FORCE_INLINE void setConstants(uint32_t idx, const void* data, size_t size)
+    {
+        assert(size != 0 && size <= kMaxConstantDataSize && "setConstants: size out of range");
+        if (size == 0 || size > kMaxConstantDataSize)
+            return;
+
+        DrawState& pending = getPendingState();
+        uint8_t*   copy    = commands.GetArena()->Allocate(size);
+        std::memcpy(copy, data, size);
+
+        pending.constantData[idx]      = copy;
+        pending.constantDataSizes[idx] = static_cast<uint32_t>(size);
+        pending.constantDataMask.Set(idx);
+        pending.constantBufferMask.Reset(idx);
+    }
+
+    SGFX_FORCE_INLINE void setResource(uint32_t idx, BufferHandle resource)
+    {
+        DrawState& pending = getPendingState();
+        pending.shaderResources[idx] = ShaderResource(false, resource.value);
+        pending.shaderResourceMask.Set(idx);
+    }
+
+    SGFX_FORCE_INLINE void setResource(uint32_t idx, TextureHandle resource)
+    {
+        DrawState& pending = getPendingState();
+        pending.shaderResources[idx] = ShaderResource(true, resource.value);
+        pending.shaderResourceMask.Set(idx);
+    }
+
+    SGFX_FORCE_INLINE void setBindGroup(uint32_t idx, BindGroupHandle group)
+    {
+        DrawState& pending = getPendingState();
+        pending.bindGroups[idx] = group;
+        pending.bindGroupMask.Set(idx);
+    }
+
+    SGFX_FORCE_INLINE void draw(uint32_t count, uint32_t startVertex)
+    {
+        recordState();
+        commands.Write<uint8_t>(DrawCommand::Draw);
+        commands.Write<uint32_t>(count);
+        commands.Write<uint32_t>(startVertex);
+    }
+
+    SGFX_FORCE_INLINE void drawIndexed(uint32_t count, uint32_t startIndex, uint32_t startVertex)
+    {
+        recordState();
+        commands.Write<uint8_t>(DrawCommand::DrawIndexed);
+        commands.Write<uint32_t>(count);
+        commands.Write<uint32_t>(startIndex);
+        commands.Write<uint32_t>(startVertex);
+    }
+
+    SGFX_FORCE_INLINE void drawInstanced(uint32_t instanceCount, uint32_t count, uint32_t startVertex, uint32_t startInstance)
+    {
+        recordState();
+        commands.Write<uint8_t>(DrawCommand::DrawInstanced);
+        commands.Write<uint32_t>(instanceCount);
+        commands.Write<uint32_t>(count);
+        commands.Write<uint32_t>(startVertex);
+        commands.Write<uint32_t>(startInstance);
+    }
+
+    SGFX_FORCE_INLINE void drawIndexedInstanced(uint32_t instanceCount, uint32_t count, uint32_t startIndex, uint32_t startVertex, uint32_t startInstance)
+    {
+        recordState();
+        commands.Write<uint8_t>(DrawCommand::DrawIndexedInstanced);
+        commands.Write<uint32_t>(instanceCount);
+        commands.Write<uint32_t>(count);
+        commands.Write<uint32_t>(startIndex);
+        commands.Write<uint32_t>(startVertex);
+        commands.Write<uint32_t>(startInstance);
+    }
+
+    SGFX_FORCE_INLINE void drawInstancedIndirect(BufferHandle indirectArgs, size_t argsOffset)
+    {
+        recordState();
+        commands.Write<uint8_t>(DrawCommand::DrawInstancedIndirect);
+        commands.Write<void*>(indirectArgs.value);
+        commands.Write<uint64_t>(argsOffset);
+    }
+
+    SGFX_FORCE_INLINE void drawIndexedInstancedIndirect(BufferHandle indirectArgs, size_t argsOffset)
+    {
+        recordState();
+        commands.Write<uint8_t>(DrawCommand::DrawIndexedInstancedIndirect);
+        commands.Write<void*>(indirectArgs.value);
+        commands.Write<uint64_t>(argsOffset);
+    }
+
+    SGFX_FORCE_INLINE void multiDrawIndexedIndirect(
+        BufferHandle indirectArgs, size_t argsOffset, uint32_t maxDraws,
+        BufferHandle countBuffer,  size_t countOffset,
+        uint32_t stride
+    )
+    {
+        recordState();
+        commands.Write<uint8_t>(DrawCommand::MultiDrawIndexedIndirect);
+        commands.Write<void*>(indirectArgs.value);
+        commands.Write<uint64_t>(argsOffset);
+        commands.Write<uint32_t>(maxDraws);
+        commands.Write<void*>(countBuffer.value);
+        commands.Write<uint64_t>(countOffset);
+        commands.Write<uint32_t>(stride);
+    }
+
+    // decodes draw call arguments that follow a draw opcode
+    static SGFX_FORCE_INLINE void readDrawCall(CommandReader& reader, uint8_t opcode, DrawCall& call)
+    {
+        call.type = static_cast<DrawCall::Type>(opcode);
+
+        switch (opcode) {
+        case DrawCommand::Draw: {
+            call.count         = reader.Read<uint32_t>();
+            call.startVertex   = reader.Read<uint32_t>();
+            call.startIndex    = 0;
+        } break;
+        case DrawCommand::DrawIndexed: {
+            call.count         = reader.Read<uint32_t>();
+            call.startIndex    = reader.Read<uint32_t>();
+            call.startVertex   = reader.Read<uint32_t>();
+        } break;
+        case DrawCommand::DrawInstanced: {
+            call.instanceCount = reader.Read<uint32_t>();
+            call.count         = reader.Read<uint32_t>();
+            call.startVertex   = reader.Read<uint32_t>();
+            call.startInstance = reader.Read<uint32_t>();
+            call.startIndex    = 0;
+        } break;
+        case DrawCommand::DrawIndexedInstanced: {
+            call.instanceCount = reader.Read<uint32_t>();
+            call.count         = reader.Read<uint32_t>();
+            call.startIndex    = reader.Read<uint32_t>();
+            call.startVertex   = reader.Read<uint32_t>();
+            call.startInstance = reader.Read<uint32_t>();
+        } break;
+        case DrawCommand::DrawInstancedIndirect:
+        case DrawCommand::DrawIndexedInstancedIndirect: {
+            call.indirectArgsBuffer = reader.Read<void*>();
+            call.indirectArgsOffset = static_cast<size_t>(reader.Read<uint64_t>());
+        } break;
+        case DrawCommand::MultiDrawIndexedIndirect: {
+            call.indirectArgsBuffer  = reader.Read<void*>();
+            call.indirectArgsOffset  = static_cast<size_t>(reader.Read<uint64_t>());
+            call.maxDrawCount        = reader.Read<uint32_t>();
+            call.indirectCountBuffer = reader.Read<void*>();
+            call.indirectCountOffset = static_cast<size_t>(reader.Read<uint64_t>());
+            call.indirectStride      = reader.Read<uint32_t>();
+        } break;
+        }
+    }
+};
+
+///
+/// DrawOverrides replaces constant buffers and shader resources of a recorded command stream
+/// when it is translated by a backend.
+///
+struct DrawOverrides final
+{
+    ConstantBufferHandle             constantBuffers[DrawCall::kMaxConstantBuffers];
+    ShaderResource                   shaderResources[DrawCall::kMaxShaderResources];
+
+    DrawQueue::ConstantBufferMask    constantBufferMask;
+    DrawQueue::ShaderResourceMask    shaderResourceMask;
+
+    SGFX_FORCE_INLINE bool isEmpty() const
+    {
+        return constantBufferMask.IsEmpty() && shaderResourceMask.IsEmpty();
+    }
+
+    SGFX_FORCE_INLINE void setConstantBuffer(uint32_t idx, ConstantBufferHandle resource)
+    {
+        constantBuffers[idx] = resource;
+        if (resource.value != nullptr)
+            constantBufferMask.Set(idx);
+        else
+            constantBufferMask.Reset(idx);
+    }
+
+    SGFX_FORCE_INLINE void setResource(uint32_t idx, bool isTexture, void* resource)
+    {
+        shaderResources[idx] = ShaderResource(isTexture, resource);
+        if (resource != nullptr)
+            shaderResourceMask.Set(idx);
+        else
+            shaderResourceMask.Reset(idx);
+    }
+};
+
+///
+/// DrawBundle is an immutable copy of the commands recorded into a draw queue and its children.
+/// Every captured stream starts from the empty state, just like it did in the queue.
+///
+class DrawBundle final
+{
+    PipelineStateHandle         state;
+    CommandBuffer               commands;
+    DynamicArray<size_t, 4, 16> streams; // start of every captured stream in the command buffer
+    uint32_t                    numDrawCalls = 0;
+
+    SGFX_FORCE_INLINE void capture(const DrawQueue* queue)
+    {
+        if (queue->getNumDrawCalls() != 0) {
+            streams.Add(commands.GetSize());
+            queue->getCommands().ForEachBlock([this](const uint8_t* data, size_t size) {
+                commands.Append(data, size);
+            });
+            numDrawCalls += queue->getNumDrawCalls();
+        }
+    }
+
+public:
+
+    SamplerStateHandle samplerStates[DrawQueue::kMaxSamplerStates];
+    DrawOverrides      overrides;
+
+    DrawBundle(const DrawQueue* queue) : state(queue->getState())
+    {
+        for (uint32_t i = 0; i < DrawQueue::kMaxSamplerStates; ++i)
+            samplerStates[i] = queue->samplerStates[i];
+
+        capture(queue);
+        for (const DrawQueue* child : queue->getChildren())
+            capture(child);
+    }
+
+    SGFX_FORCE_INLINE PipelineStateHandle  getState() const        { return state; }
+    SGFX_FORCE_INLINE uint32_t             getNumDrawCalls() const { return numDrawCalls; }
+    SGFX_FORCE_INLINE size_t               getNumStreams() const   { return streams.GetSize(); }
+
+    SGFX_FORCE_INLINE CommandReader getStream(size_t i) const
+    {
+        size_t begin = streams[i];
+        size_t end   = (i + 1 < streams.GetSize()) ? streams[i + 1] : commands.GetSize();
+        return CommandReader(commands.GetData() + begin, commands.GetData() + end);
+    }
+};
+
+///
+/// DrawQueueSorter merges several draw queues into a single list of command ranges ordered by
+/// sort key. Queues without sort keys form a single range with the key 0.
+///
+/// Sorting is a stable LSD radix sort over the 64 bit keys, byte passes that can not change the
+/// order (all keys share the same byte value) are skipped.
+///
+class DrawQueueSorter final
+{
+public:
+
+    struct Item final
+    {
+        const DrawQueue* queue;    // root queue, owns the pipeline and sampler states
+        const uint8_t*   begin;
+        const uint8_t*   end;
+    };
+
+private:
+
+    struct Entry final
+    {
+        uint64_t key;
+        size_t   index;
+    };
+
+    DynamicArray<Item, 1, 1024>  items;
+    DynamicArray<Entry, 1, 1024> entries;
+    DynamicArray<Entry, 1, 1024> scratch;
+
+    SGFX_FORCE_INLINE void AddRange(const DrawQueue* root, uint64_t key, const uint8_t* begin, const uint8_t* end)
+    {
+        entries.Add(Entry{ key, items.GetSize() });
+        items.Add(Item{ root, begin, end });
+    }
+
+    SGFX_FORCE_INLINE void AddStream(const DrawQueue* root, const DrawQueue* stream)
+    {
+        if (stream->getNumDrawCalls() == 0)
+            return;
+
+        const uint8_t* begin   = stream->getCommands().GetBegin();
+        const uint8_t* end     = stream->getCommands().GetEnd();
+        const uint8_t* segment = stream->getFirstSegment();
+
+        if (segment != begin)
+            AddRange(root, 0, begin, (segment != nullptr) ? segment : end); // no key
+
+        while (segment != nullptr) {
+            const uint8_t* next = DrawQueue::getNextSegment(segment);
+            AddRange(root, DrawQueue::getSegmentKey(segment), segment, (next != nullptr) ? next : end);
+            segment = next;
+        }
+    }
+
+public:
+
+    DrawQueueSorter() {}
+    DrawQueueSorter(const DrawQueueSorter&) = delete;
+    DrawQueueSorter& operator=(const DrawQueueSorter&) = delete;
+
+    SGFX_FORCE_INLINE size_t      GetSize() const            { return entries.GetSize(); }
+    SGFX_FORCE_INLINE bool        IsEmpty() const            { return entries.IsEmpty(); }
+    SGFX_FORCE_INLINE const Item& operator[](size_t i) const { return items[entries[i].index]; }
+
+    SGFX_FORCE_INLINE void Clear()
+    {
+        items.Clear();
+        entries.Clear();
+    }
+
+    // adds the queue and all its children
+    SGFX_FORCE_INLINE void Add(const DrawQueue* queue)
+    {
+        AddStream(queue, queue);
+        for (const DrawQueue* child : queue->getChildren())
+            AddStream(queue, child);
+    }
+
+    SGFX_FORCE_INLINE void Sort()
+    {
+        size_t count = entries.GetSize();
+        if (count < 2)
+            return;
+
+        size_t histogram[8][256];
+        std::memset(histogram, 0, sizeof(histogram));
+
+        for (const Entry& entry : entries) {
+            for (uint32_t pass = 0; pass < 8; ++pass)
+                histogram[pass][(entry.key >> (pass * 8)) & 0xFF]++;
+        }
+
+        scratch.Resize(count);
+
+        Entry* src = entries.GetData();
+        Entry* dst = scratch.GetData();
+
+        for (uint32_t pass = 0; pass < 8; ++pass) {
+            uint32_t shift   = pass * 8;
+            size_t*  buckets = histogram[pass];
+
+            if (buckets[(src[0].key >> shift) & 0xFF] == count)
+                continue; // every key has the same byte
+
+            size_t offset = 0;
+            for (uint32_t i = 0; i < 256; ++i) {
+                size_t bucketSize = buckets[i];
+                buckets[i] = offset;
+                offset += bucketSize;
+            }
+
+            for (size_t i = 0; i < count; ++i)
+                dst[buckets[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+            Entry* tmp = src;
+            src = dst;
+            dst = tmp;
+        }
+
+        if (src != entries.GetData())
+            std::memcpy(entries.GetData(), src, count * sizeof(Entry));
+    }
+};
+
+struct ComputeQueue final
+{
+    enum
+    {
+        kMaxSamplerStates = 8
+    };
+
+    enum
+    {
+        kMaxConstantBuffers = 8,
+        kMaxShaderResources = 128,
+        kMaxShaderResourcesRW = 8
+    };
+
+    SamplerStateHandle      samplerStates[kMaxSamplerStates];
+    ConstantBufferHandle    constantBuffers[kMaxConstantBuffers];
+    ShaderResource          shaderResourcesRW[kMaxShaderResourcesRW];
+
+    // grows up to the highest slot in use, most compute shaders only need a few
+    DynamicArray<ShaderResource, 4, 16> shaderResources;
 
     ComputeShaderHandle     shader;
 
@@ -1134,11 +3546,15 @@ struct ComputeQueue final
 
     SGFX_FORCE_INLINE void setResource(uint32_t idx, BufferHandle resource)
     {
+        if (idx >= shaderResources.GetSize())
+            shaderResources.Resize(idx + 1);
         shaderResources[idx] = ShaderResource(false, resource.value);
     }
 
     SGFX_FORCE_INLINE void setResource(uint32_t idx, TextureHandle resource)
     {
+        if (idx >= shaderResources.GetSize())
+            shaderResources.Resize(idx + 1);
         shaderResources[idx] = ShaderResource(true, resource.value);
     }
 
@@ -0,0 +1,1163 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+///
+/// Capture layer: compiles a backend into its own namespace and defines the public API on top of
+/// it. Every call is forwarded to the backend and, between capture::begin and capture::end, written
+/// to a capture file that sgfx-replay plays back. The format is described in sigrlinn_capture.hh.
+///
+/// The backend is selected with SGFX_CAPTURE_D3D11, SGFX_CAPTURE_GL4 or SGFX_CAPTURE_NULL.
+///
+#define SGFX_BACKEND_NS sgfx_backend
+
+#if defined(SGFX_CAPTURE_D3D11)
+#include "sigrlinn_d3d11.cc"
+#elif defined(SGFX_CAPTURE_GL4)
+#include "sigrlinn_gl4.cc"
+#else
+#include "sigrlinn_null.cc"
+#endif
+
+#include "sigrlinn_capture.hh"
+#include <stdio.h>
+#include <mutex>
+#include <unordered_map>
+
+namespace sgfx
+{
+
+using namespace SGFX_NS_INTERNAL;
+using namespace capture;
+
+// sizes and map state of the objects created while capturing, needed to write their contents
+struct CaptureObject final
+{
+    size_t     dataSize  = 0;
+    DataFormat format    = DataFormat::Count;
+    void*      mapped     = nullptr; // set while mapped for writing
+    size_t     mappedSize = 0;
+};
+
+// keeps the writer locked while a record is written, false if nothing is being captured
+class CaptureLock final
+{
+    std::unique_lock<std::recursive_mutex> lock;
+    bool                                   active = false;
+
+public:
+
+    CaptureLock() {}
+    CaptureLock(std::unique_lock<std::recursive_mutex>&& nlock, bool nactive) : lock(std::move(nlock)), active(nactive) {}
+    CaptureLock(CaptureLock&& other) : lock(std::move(other.lock)), active(other.active) {}
+
+    SGFX_FORCE_INLINE explicit operator bool() const { return active; }
+};
+
+///
+/// Child queues are recorded on worker threads and objects are created and released on any
+/// thread, so every record and every access to the object table happens under the writer lock:
+///
+///     if (CaptureLock lock = g_capture.Lock()) { ... }
+///
+/// The lock is recursive, records may be written from helpers called under it.
+///
+class CaptureWriter final
+{
+    FILE*    file       = nullptr;
+    uint64_t offset     = 0;
+    uint64_t frameBegin = 0;
+
+    std::recursive_mutex mutex;
+    std::atomic<bool>    active;
+
+    DynamicArray<uint64_t, 64, 64>          frames; // begin and end offset pairs
+    std::unordered_map<void*, CaptureObject> objects;
+
+    template <typename T>
+    SGFX_FORCE_INLINE void Write(const T& value)
+    {
+        fwrite(&value, sizeof(T), 1, file);
+        offset += sizeof(T);
+    }
+
+    template <typename T, int tag>
+    SGFX_FORCE_INLINE void Write(const Handle<T, tag>& handle)
+    {
+        Write<uint64_t>(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle.value)));
+    }
+
+    SGFX_FORCE_INLINE void WriteArgs() {}
+
+    template <typename T, typename ...Args>
+    SGFX_FORCE_INLINE void WriteArgs(const T& value, const Args&... args)
+    {
+        Write(value);
+        WriteArgs(args...);
+    }
+
+public:
+
+    CaptureWriter() : active(false) {}
+    ~CaptureWriter() { End(); }
+
+    // the flag skips the lock while nothing is being captured
+    SGFX_FORCE_INLINE CaptureLock Lock()
+    {
+        if (!active.load(std::memory_order_acquire))
+            return CaptureLock();
+
+        std::unique_lock<std::recursive_mutex> lock(mutex);
+        return CaptureLock(std::move(lock), file != nullptr);
+    }
+
+    bool Begin(const char* path)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        End();
+
+        file = fopen(path, "wb");
+        if (file == nullptr)
+            return false;
+
+        CaptureHeader header;
+        header.magic       = kMagic;
+        header.version     = kVersion;
+        header.pointerSize = sizeof(void*);
+        header.reserved    = 0;
+
+        offset = 0;
+        Write(header);
+
+        frameBegin = offset;
+        frames.Clear();
+        objects.clear();
+
+        active.store(true, std::memory_order_release);
+        return true;
+    }
+
+    void End()
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+        if (file == nullptr)
+            return;
+
+        active.store(false, std::memory_order_release);
+
+        Write<uint8_t>(CaptureCommand::End);
+
+        uint64_t tableOffset = offset;
+        Write<uint64_t>(frames.GetSize() / 2);
+        for (uint64_t value : frames)
+            Write(value);
+        Write(tableOffset);
+
+        fclose(file);
+        file = nullptr;
+    }
+
+    // writes a command with plain arguments, handles are written as their value
+    template <typename ...Args>
+    SGFX_FORCE_INLINE void Command(uint8_t command, const Args&... args)
+    {
+        Write(command);
+        WriteArgs(args...);
+    }
+
+    SGFX_FORCE_INLINE void Blob(const void* data, size_t size)
+    {
+        Write<uint64_t>(size);
+        if (size != 0) {
+            fwrite(data, 1, size, file);
+            offset += size;
+        }
+    }
+
+    SGFX_FORCE_INLINE void String(const char* str)
+    {
+        Blob(str, (str != nullptr) ? strlen(str) : 0);
+    }
+
+    template <typename T>
+    SGFX_FORCE_INLINE void Value(const T& value)
+    {
+        Write(value);
+    }
+
+    void FrameEnd()
+    {
+        frames.Add(frameBegin);
+        frames.Add(offset);
+        frameBegin = offset;
+    }
+
+    SGFX_FORCE_INLINE void AddObject(void* value, const CaptureObject& object)
+    {
+        if (value != nullptr)
+            objects[value] = object;
+    }
+
+    SGFX_FORCE_INLINE void RemoveObject(void* value)
+    {
+        objects.erase(value);
+    }
+
+    // null for objects created before the capture started
+    SGFX_FORCE_INLINE CaptureObject* GetObject(void* value)
+    {
+        auto it = objects.find(value);
+        return (it != objects.end()) ? &it->second : nullptr;
+    }
+};
+
+static CaptureWriter g_capture;
+
+//=============================================================================
+namespace capture
+{
+
+bool begin(const char* path)
+{
+    return g_capture.Begin(path);
+}
+
+void end()
+{
+    g_capture.End();
+}
+
+}
+
+//=============================================================================
+#if defined(SGFX_CAPTURE_D3D11)
+bool initD3D11(void* d3dDevice, void* d3dContext, void* d3dSwapChain)
+{
+    return SGFX_BACKEND_NS::initD3D11(d3dDevice, d3dContext, d3dSwapChain);
+}
+#elif defined(SGFX_CAPTURE_GL4)
+bool initOpenGL()
+{
+    return SGFX_BACKEND_NS::initOpenGL();
+}
+#else
+bool initNull(uint32_t backBufferWidth, uint32_t backBufferHeight)
+{
+    return SGFX_BACKEND_NS::initNull(backBufferWidth, backBufferHeight);
+}
+#endif
+
+void shutdown()
+{
+    g_capture.End();
+    SGFX_BACKEND_NS::shutdown();
+}
+
+void setAllocator(AllocFunc nalloc, FreeFunc nfree)
+{
+    SGFX_BACKEND_NS::setAllocator(nalloc, nfree);
+}
+
+void* allocate(size_t size)
+{
+    return SGFX_BACKEND_NS::allocate(size);
+}
+
+void deallocate(void* ptr)
+{
+    SGFX_BACKEND_NS::deallocate(ptr);
+}
+
+uint64_t getGPUCaps()
+{
+    return SGFX_BACKEND_NS::getGPUCaps();
+}
+
+bool compileShader(
+    const char*                 sourceCode,
+    size_t                      sourceCodeSize,
+    ShaderCompileVersion        version,
+    ShaderCompileTarget         target,
+    const ShaderCompileMacro*   macros,
+    size_t                      macrosSize,
+    uint64_t                    flags,
+    ErrorReportFunc             errorReport,
+
+    void*&  outData,
+    size_t& outDataSize
+)
+{
+    // only the bytecode handed to the create functions is captured
+    return SGFX_BACKEND_NS::compileShader(sourceCode, sourceCodeSize, version, target, macros, macrosSize, flags, errorReport, outData, outDataSize);
+}
+
+//=============================================================================
+template <typename Handle>
+static SGFX_FORCE_INLINE Handle captureShader(uint8_t command, Handle handle, const void* data, size_t dataSize)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(command);
+        g_capture.Blob(data, dataSize);
+        g_capture.Value(handle);
+    }
+    return handle;
+}
+
+template <typename Handle>
+static SGFX_FORCE_INLINE void captureRelease(uint8_t command, Handle handle)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(command, handle);
+        g_capture.RemoveObject(handle.value);
+    }
+}
+
+VertexShaderHandle createVertexShader(const void* data, size_t dataSize)
+{
+    return captureShader(CaptureCommand::CreateVertexShader, SGFX_BACKEND_NS::createVertexShader(data, dataSize), data, dataSize);
+}
+
+void releaseVertexShader(VertexShaderHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseVertexShader, handle);
+    SGFX_BACKEND_NS::releaseVertexShader(handle);
+}
+
+HullShaderHandle createHullShader(const void* data, size_t dataSize)
+{
+    return captureShader(CaptureCommand::CreateHullShader, SGFX_BACKEND_NS::createHullShader(data, dataSize), data, dataSize);
+}
+
+void releaseHullShader(HullShaderHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseHullShader, handle);
+    SGFX_BACKEND_NS::releaseHullShader(handle);
+}
+
+DomainShaderHandle createDomainShader(const void* data, size_t dataSize)
+{
+    return captureShader(CaptureCommand::CreateDomainShader, SGFX_BACKEND_NS::createDomainShader(data, dataSize), data, dataSize);
+}
+
+void releaseDomainShader(DomainShaderHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseDomainShader, handle);
+    SGFX_BACKEND_NS::releaseDomainShader(handle);
+}
+
+GeometryShaderHandle createGeometryShader(const void* data, size_t dataSize)
+{
+    return captureShader(CaptureCommand::CreateGeometryShader, SGFX_BACKEND_NS::createGeometryShader(data, dataSize), data, dataSize);
+}
+
+void releaseGeometryShader(GeometryShaderHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseGeometryShader, handle);
+    SGFX_BACKEND_NS::releaseGeometryShader(handle);
+}
+
+PixelShaderHandle createPixelShader(const void* data, size_t dataSize)
+{
+    return captureShader(CaptureCommand::CreatePixelShader, SGFX_BACKEND_NS::createPixelShader(data, dataSize), data, dataSize);
+}
+
+void releasePixelShader(PixelShaderHandle handle)
+{
+    captureRelease(CaptureCommand::ReleasePixelShader, handle);
+    SGFX_BACKEND_NS::releasePixelShader(handle);
+}
+
+SurfaceShaderHandle linkSurfaceShader(VertexShaderHandle vs, HullShaderHandle hs, DomainShaderHandle ds, GeometryShaderHandle gs, PixelShaderHandle ps)
+{
+    SurfaceShaderHandle handle = SGFX_BACKEND_NS::linkSurfaceShader(vs, hs, ds, gs, ps);
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::LinkSurfaceShader, vs, hs, ds, gs, ps, handle);
+    return handle;
+}
+
+void releaseSurfaceShader(SurfaceShaderHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseSurfaceShader, handle);
+    SGFX_BACKEND_NS::releaseSurfaceShader(handle);
+}
+
+//=============================================================================
+ComputeQueueHandle createComputeQueue(ComputeShaderHandle shader)
+{
+    ComputeQueueHandle handle = SGFX_BACKEND_NS::createComputeQueue(shader);
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::CreateComputeQueue, shader, handle);
+    return handle;
+}
+
+void releaseComputeQueue(ComputeQueueHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseComputeQueue, handle);
+    SGFX_BACKEND_NS::releaseComputeQueue(handle);
+}
+
+void setConstantBuffer(ComputeQueueHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ComputeSetConstantBuffer, handle, idx, buffer);
+    SGFX_BACKEND_NS::setConstantBuffer(handle, idx, buffer);
+}
+
+void setResource(ComputeQueueHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ComputeSetResourceBuffer, handle, idx, resource);
+    SGFX_BACKEND_NS::setResource(handle, idx, resource);
+}
+
+void setResource(ComputeQueueHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ComputeSetResourceTexture, handle, idx, resource);
+    SGFX_BACKEND_NS::setResource(handle, idx, resource);
+}
+
+void setResourceRW(ComputeQueueHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ComputeSetResourceRWBuffer, handle, idx, resource);
+    SGFX_BACKEND_NS::setResourceRW(handle, idx, resource);
+}
+
+void setResourceRW(ComputeQueueHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ComputeSetResourceRWTexture, handle, idx, resource);
+    SGFX_BACKEND_NS::setResourceRW(handle, idx, resource);
+}
+
+void submit(ComputeQueueHandle handle, uint32_t x, uint32_t y, uint32_t z)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ComputeSubmit, handle, x, y, z);
+    SGFX_BACKEND_NS::submit(handle, x, y, z);
+}
+
+ComputeShaderHandle createComputeShader(const void* data, size_t dataSize)
+{
+    return captureShader(CaptureCommand::CreateComputeShader, SGFX_BACKEND_NS::createComputeShader(data, dataSize), data, dataSize);
+}
+
+void releaseComputeShader(ComputeShaderHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseComputeShader, handle);
+    SGFX_BACKEND_NS::releaseComputeShader(handle);
+}
+
+//=============================================================================
+VertexFormatHandle createVertexFormat(
+    VertexElementDescriptor* elements,
+    size_t size,
+    void* shaderBytecode, size_t shaderBytecodeSize,
+    ErrorReportFunc errorReport
+)
+{
+    VertexFormatHandle handle = SGFX_BACKEND_NS::createVertexFormat(elements, size, shaderBytecode, shaderBytecodeSize, errorReport);
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(CaptureCommand::CreateVertexFormat, static_cast<uint64_t>(size));
+        for (size_t i = 0; i < size; ++i) {
+            g_capture.String(elements[i].semanticName);
+            g_capture.Value(elements[i]);
+        }
+        g_capture.Blob(shaderBytecode, shaderBytecodeSize);
+        g_capture.Value(handle);
+    }
+    return handle;
+}
+
+void releaseVertexFormat(VertexFormatHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseVertexFormat, handle);
+    SGFX_BACKEND_NS::releaseVertexFormat(handle);
+}
+
+PipelineStateHandle createPipelineState(const PipelineStateDescriptor& desc)
+{
+    PipelineStateHandle handle = SGFX_BACKEND_NS::createPipelineState(desc);
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::CreatePipelineState, desc, handle);
+    return handle;
+}
+
+void releasePipelineState(PipelineStateHandle handle)
+{
+    captureRelease(CaptureCommand::ReleasePipelineState, handle);
+    SGFX_BACKEND_NS::releasePipelineState(handle);
+}
+
+//=============================================================================
+BufferHandle createBuffer(uint32_t flags, const void* mem, size_t size, size_t stride)
+{
+    BufferHandle handle = SGFX_BACKEND_NS::createBuffer(flags, mem, size, stride);
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(CaptureCommand::CreateBuffer, flags, static_cast<uint8_t>(mem != nullptr));
+        g_capture.Blob(mem, (mem != nullptr) ? size : 0);
+        g_capture.Value(static_cast<uint64_t>(size));
+        g_capture.Value(static_cast<uint64_t>(stride));
+        g_capture.Value(handle);
+
+        CaptureObject object;
+        object.dataSize = size;
+        g_capture.AddObject(handle.value, object);
+    }
+    return handle;
+}
+
+void releaseBuffer(BufferHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseBuffer, handle);
+    SGFX_BACKEND_NS::releaseBuffer(handle);
+}
+
+bool isValid(BufferHandle handle)
+{
+    return SGFX_BACKEND_NS::isValid(handle);
+}
+
+static SGFX_FORCE_INLINE void* captureMapBuffer(BufferHandle handle, MapType type, size_t offset, size_t size, void* data)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(CaptureCommand::MapBuffer, handle, type, static_cast<uint64_t>(offset), static_cast<uint64_t>(size));
+
+        CaptureObject* object = g_capture.GetObject(handle.value);
+        if (object != nullptr) {
+            object->mapped     = (type != MapType::Read) ? data : nullptr;
+            object->mappedSize = size;
+        }
+    }
+    return data;
+}
+
+void* mapBuffer(BufferHandle handle, MapType type)
+{
+    size_t size = 0;
+    if (CaptureLock lock = g_capture.Lock()) {
+        CaptureObject* object = g_capture.GetObject(handle.value);
+        size = (object != nullptr) ? object->dataSize : 0;
+    }
+
+    return captureMapBuffer(handle, type, 0, size, SGFX_BACKEND_NS::mapBuffer(handle, type));
+}
+
+void* mapBuffer(BufferHandle handle, MapType type, size_t offset, size_t size)
+{
+    return captureMapBuffer(handle, type, offset, size, SGFX_BACKEND_NS::mapBuffer(handle, type, offset, size));
+}
+
+void unmapBuffer(BufferHandle handle)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        // the contents are only known once the application is done writing
+        CaptureObject* object = g_capture.GetObject(handle.value);
+        bool           write  = object != nullptr && object->mapped != nullptr;
+
+        g_capture.Command(CaptureCommand::UnmapBuffer, handle, static_cast<uint8_t>(write));
+        g_capture.Blob(write ? object->mapped : nullptr, write ? object->mappedSize : 0);
+
+        if (object != nullptr)
+            object->mapped = nullptr;
+    }
+    SGFX_BACKEND_NS::unmapBuffer(handle);
+}
+
+void copyBufferData(BufferHandle handle, size_t offset, size_t size, const void* mem)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(CaptureCommand::CopyBufferData, handle, static_cast<uint64_t>(offset));
+        g_capture.Blob(mem, size);
+    }
+    SGFX_BACKEND_NS::copyBufferData(handle, offset, size, mem);
+}
+
+void clearBufferRW(BufferHandle handle, uint32_t value)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ClearBufferRWUint, handle, value);
+    SGFX_BACKEND_NS::clearBufferRW(handle, value);
+}
+
+void clearBufferRW(BufferHandle handle, float value)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ClearBufferRWFloat, handle, value);
+    SGFX_BACKEND_NS::clearBufferRW(handle, value);
+}
+
+ConstantBufferHandle createConstantBuffer(const void* mem, size_t size)
+{
+    ConstantBufferHandle handle = SGFX_BACKEND_NS::createConstantBuffer(mem, size);
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(CaptureCommand::CreateConstantBuffer, static_cast<uint8_t>(mem != nullptr));
+        g_capture.Blob(mem, (mem != nullptr) ? size : 0);
+        g_capture.Value(static_cast<uint64_t>(size));
+        g_capture.Value(handle);
+
+        CaptureObject object;
+        object.dataSize = size;
+        g_capture.AddObject(handle.value, object);
+    }
+    return handle;
+}
+
+void updateConstantBuffer(ConstantBufferHandle handle, const void* mem)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        // the size of buffers created before the capture started is unknown, their updates are lost
+        CaptureObject* object = g_capture.GetObject(handle.value);
+        if (object != nullptr) {
+            g_capture.Command(CaptureCommand::UpdateConstantBuffer, handle);
+            g_capture.Blob(mem, object->dataSize);
+        }
+    }
+    SGFX_BACKEND_NS::updateConstantBuffer(handle, mem);
+}
+
+void releaseConstantBuffer(ConstantBufferHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseConstantBuffer, handle);
+    SGFX_BACKEND_NS::releaseConstantBuffer(handle);
+}
+
+SamplerStateHandle createSamplerState(const SamplerStateDescriptor& desc)
+{
+    SamplerStateHandle handle = SGFX_BACKEND_NS::createSamplerState(desc);
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::CreateSamplerState, desc, handle);
+    return handle;
+}
+
+void releaseSamplerState(SamplerStateHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseSamplerState, handle);
+    SGFX_BACKEND_NS::releaseSamplerState(handle);
+}
+
+//=============================================================================
+static SGFX_FORCE_INLINE TextureHandle captureTexture(
+    TextureHandle handle, uint8_t dimensions,
+    uint32_t width, uint32_t height, uint32_t depth,
+    DataFormat format, uint32_t numMipmaps, uint32_t flags
+)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(CaptureCommand::CreateTexture, dimensions, width, height, depth, format, numMipmaps, flags, handle);
+
+        CaptureObject object;
+        object.format = format;
+        g_capture.AddObject(handle.value, object);
+    }
+    return handle;
+}
+
+Texture1DHandle createTexture1D(uint32_t width, DataFormat format, uint32_t numMipmaps, uint32_t flags)
+{
+    return captureTexture(SGFX_BACKEND_NS::createTexture1D(width, format, numMipmaps, flags), 1, width, 1, 1, format, numMipmaps, flags);
+}
+
+Texture2DHandle createTexture2D(uint32_t width, uint32_t height, DataFormat format, uint32_t numMipmaps, uint32_t flags)
+{
+    return captureTexture(SGFX_BACKEND_NS::createTexture2D(width, height, format, numMipmaps, flags), 2, width, height, 1, format, numMipmaps, flags);
+}
+
+Texture3DHandle createTexture3D(uint32_t width, uint32_t height, uint32_t depth, DataFormat format, uint32_t numMipmaps, uint32_t flags)
+{
+    return captureTexture(SGFX_BACKEND_NS::createTexture3D(width, height, depth, format, numMipmaps, flags), 3, width, height, depth, format, numMipmaps, flags);
+}
+
+void clearTextureRW(TextureHandle handle, uint32_t value)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ClearTextureRWUint, handle, value);
+    SGFX_BACKEND_NS::clearTextureRW(handle, value);
+}
+
+void clearTextureRW(TextureHandle handle, float value)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ClearTextureRWFloat, handle, value);
+    SGFX_BACKEND_NS::clearTextureRW(handle, value);
+}
+
+void* mapTexture(TextureHandle handle, MapType type)
+{
+    // texture contents written through a map are not captured, textures are updated with updateTexture
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::MapTexture, handle, type);
+    return SGFX_BACKEND_NS::mapTexture(handle, type);
+}
+
+void unmapTexture(TextureHandle handle)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::UnmapTexture, handle);
+    SGFX_BACKEND_NS::unmapTexture(handle);
+}
+
+void updateTexture(
+    TextureHandle handle, const void* mem,
+    uint32_t mip,
+    size_t offsetX,  size_t sizeX,
+    size_t offsetY,  size_t sizeY,
+    size_t offsetZ,  size_t sizeZ,
+    size_t rowPitch, size_t depthPitch
+)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        CaptureObject* object = g_capture.GetObject(handle.value);
+
+        // rows of compressed formats are rows of 4x4 blocks
+        size_t numRows  = (object != nullptr && isCompressedFormat(object->format)) ? (sizeY + 3) / 4 : sizeY;
+        size_t dataSize = (sizeZ > 1) ? depthPitch * sizeZ : rowPitch * numRows;
+
+        g_capture.Command(
+            CaptureCommand::UpdateTexture, handle, mip,
+            static_cast<uint64_t>(offsetX),  static_cast<uint64_t>(sizeX),
+            static_cast<uint64_t>(offsetY),  static_cast<uint64_t>(sizeY),
+            static_cast<uint64_t>(offsetZ),  static_cast<uint64_t>(sizeZ),
+            static_cast<uint64_t>(rowPitch), static_cast<uint64_t>(depthPitch)
+        );
+        g_capture.Blob(mem, dataSize);
+    }
+    SGFX_BACKEND_NS::updateTexture(handle, mem, mip, offsetX, sizeX, offsetY, sizeY, offsetZ, sizeZ, rowPitch, depthPitch);
+}
+
+void releaseTexture(TextureHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseTexture, handle);
+    SGFX_BACKEND_NS::releaseTexture(handle);
+}
+
+bool isValid(TextureHandle handle)
+{
+    return SGFX_BACKEND_NS::isValid(handle);
+}
+
+void copyResource(TextureHandle src, TextureHandle dst)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::CopyTexture, src, dst);
+    SGFX_BACKEND_NS::copyResource(src, dst);
+}
+
+void copyResource(BufferHandle src, BufferHandle dst)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::CopyBuffer, src, dst);
+    SGFX_BACKEND_NS::copyResource(src, dst);
+}
+
+void copyResource(ConstantBufferHandle src, ConstantBufferHandle dst)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::CopyConstantBuffer, src, dst);
+    SGFX_BACKEND_NS::copyResource(src, dst);
+}
+
+Texture2DHandle getBackBuffer()
+{
+    Texture2DHandle handle = SGFX_BACKEND_NS::getBackBuffer();
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::GetBackBuffer, handle);
+    return handle;
+}
+
+//=============================================================================
+RenderTargetHandle createRenderTarget(const RenderTargetDescriptor& desc)
+{
+    RenderTargetHandle handle = SGFX_BACKEND_NS::createRenderTarget(desc);
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::CreateRenderTarget, desc, handle);
+    return handle;
+}
+
+void releaseRenderTarget(RenderTargetHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseRenderTarget, handle);
+    SGFX_BACKEND_NS::releaseRenderTarget(handle);
+}
+
+void setViewport(uint32_t width, uint32_t height, float minDepth, float maxDepth)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetViewport, width, height, minDepth, maxDepth);
+    SGFX_BACKEND_NS::setViewport(width, height, minDepth, maxDepth);
+}
+
+void setResourceRW(RenderTargetHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::RenderTargetSetResourceRWBuffer, handle, idx, resource);
+    SGFX_BACKEND_NS::setResourceRW(handle, idx, resource);
+}
+
+void setResourceRW(RenderTargetHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::RenderTargetSetResourceRWTexture, handle, idx, resource);
+    SGFX_BACKEND_NS::setResourceRW(handle, idx, resource);
+}
+
+void setRenderTarget(RenderTargetHandle handle)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetRenderTarget, handle);
+    SGFX_BACKEND_NS::setRenderTarget(handle);
+}
+
+void clearRenderTarget(RenderTargetHandle handle, uint32_t color)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ClearRenderTarget, handle, color);
+    SGFX_BACKEND_NS::clearRenderTarget(handle, color);
+}
+
+void clearRenderTarget(RenderTargetHandle handle, uint32_t slot, uint32_t color)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ClearRenderTargetSlot, handle, slot, color);
+    SGFX_BACKEND_NS::clearRenderTarget(handle, slot, color);
+}
+
+void clearDepthStencil(RenderTargetHandle handle, float depth, uint8_t stencil)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::ClearDepthStencil, handle, depth, stencil);
+    SGFX_BACKEND_NS::clearDepthStencil(handle, depth, stencil);
+}
+
+void present(uint32_t swapInterval)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(CaptureCommand::Present, swapInterval);
+        g_capture.FrameEnd();
+    }
+    SGFX_BACKEND_NS::present(swapInterval);
+}
+
+void endFrame()
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(CaptureCommand::EndFrame);
+        g_capture.FrameEnd();
+    }
+    SGFX_BACKEND_NS::endFrame();
+}
+
+// deferred release and fences don't change what is rendered and are not recorded
+void setDeferredRelease(bool enabled)
+{
+    SGFX_BACKEND_NS::setDeferredRelease(enabled);
+}
+
+DeferredReleaseStats getDeferredReleaseStats()
+{
+    return SGFX_BACKEND_NS::getDeferredReleaseStats();
+}
+
+FenceHandle insertFence()
+{
+    return SGFX_BACKEND_NS::insertFence();
+}
+
+bool isFenceSignaled(FenceHandle fence)
+{
+    return SGFX_BACKEND_NS::isFenceSignaled(fence);
+}
+
+bool waitFence(FenceHandle fence, uint64_t timeout)
+{
+    return SGFX_BACKEND_NS::waitFence(fence, timeout);
+}
+
+uint64_t getFrameIndex()
+{
+    return SGFX_BACKEND_NS::getFrameIndex();
+}
+
+uint64_t getCompletedFrameIndex()
+{
+    return SGFX_BACKEND_NS::getCompletedFrameIndex();
+}
+
+//=============================================================================
+DrawQueueHandle createDrawQueue(PipelineStateHandle state)
+{
+    DrawQueueHandle handle = SGFX_BACKEND_NS::createDrawQueue(state);
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::CreateDrawQueue, state, handle);
+    return handle;
+}
+
+void releaseDrawQueue(DrawQueueHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseDrawQueue, handle);
+    SGFX_BACKEND_NS::releaseDrawQueue(handle);
+}
+
+DrawQueueHandle createChildDrawQueue(DrawQueueHandle parent)
+{
+    DrawQueueHandle handle = SGFX_BACKEND_NS::createChildDrawQueue(parent);
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::CreateChildDrawQueue, parent, handle);
+    return handle;
+}
+
+void setSamplerState(DrawQueueHandle handle, uint32_t idx, SamplerStateHandle sampler)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetSamplerState, handle, idx, sampler);
+    SGFX_BACKEND_NS::setSamplerState(handle, idx, sampler);
+}
+
+void setPrimitiveTopology(DrawQueueHandle handle, PrimitiveTopology topology)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetPrimitiveTopology, handle, topology);
+    SGFX_BACKEND_NS::setPrimitiveTopology(handle, topology);
+}
+
+void setVertexBuffer(DrawQueueHandle handle, BufferHandle vb, uint32_t idx)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetVertexBuffer, handle, vb, idx);
+    SGFX_BACKEND_NS::setVertexBuffer(handle, vb, idx);
+}
+
+void setIndexBuffer(DrawQueueHandle handle, BufferHandle ib)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetIndexBuffer, handle, ib);
+    SGFX_BACKEND_NS::setIndexBuffer(handle, ib);
+}
+
+void setConstantBuffer(DrawQueueHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetConstantBuffer, handle, idx, buffer);
+    SGFX_BACKEND_NS::setConstantBuffer(handle, idx, buffer);
+}
+
+void setConstants(DrawQueueHandle handle, uint32_t idx, const void* data, size_t size)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(CaptureCommand::SetConstants, handle, idx);
+        g_capture.Blob(data, size);
+    }
+    SGFX_BACKEND_NS::setConstants(handle, idx, data, size);
+}
+
+void setResource(DrawQueueHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetResourceBuffer, handle, idx, resource);
+    SGFX_BACKEND_NS::setResource(handle, idx, resource);
+}
+
+void setResource(DrawQueueHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetResourceTexture, handle, idx, resource);
+    SGFX_BACKEND_NS::setResource(handle, idx, resource);
+}
+
+BindGroupHandle createBindGroup(const BindGroupDescriptor& desc)
+{
+    BindGroupHandle handle = SGFX_BACKEND_NS::createBindGroup(desc);
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::CreateBindGroup, desc, handle);
+    return handle;
+}
+
+void releaseBindGroup(BindGroupHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseBindGroup, handle);
+    SGFX_BACKEND_NS::releaseBindGroup(handle);
+}
+
+void setBindGroup(DrawQueueHandle handle, uint32_t idx, BindGroupHandle group)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetBindGroup, handle, idx, group);
+    SGFX_BACKEND_NS::setBindGroup(handle, idx, group);
+}
+
+void draw(DrawQueueHandle handle, uint32_t count, uint32_t startVertex)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::Draw, handle, count, startVertex);
+    SGFX_BACKEND_NS::draw(handle, count, startVertex);
+}
+
+void drawIndexed(DrawQueueHandle handle, uint32_t count, uint32_t startIndex, uint32_t startVertex)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::DrawIndexed, handle, count, startIndex, startVertex);
+    SGFX_BACKEND_NS::drawIndexed(handle, count, startIndex, startVertex);
+}
+
+void drawInstanced(DrawQueueHandle handle, uint32_t instanceCount, uint32_t count, uint32_t startVertex, uint32_t startInstance)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::DrawInstanced, handle, instanceCount, count, startVertex, startInstance);
+    SGFX_BACKEND_NS::drawInstanced(handle, instanceCount, count, startVertex, startInstance);
+}
+
+void drawIndexedInstanced(DrawQueueHandle handle, uint32_t instanceCount, uint32_t count, uint32_t startIndex, uint32_t startVertex, uint32_t startInstance)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::DrawIndexedInstanced, handle, instanceCount, count, startIndex, startVertex, startInstance);
+    SGFX_BACKEND_NS::drawIndexedInstanced(handle, instanceCount, count, startIndex, startVertex, startInstance);
+}
+
+void drawInstancedIndirect(DrawQueueHandle handle, BufferHandle indirectArgs, size_t argsOffset)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::DrawInstancedIndirect, handle, indirectArgs, static_cast<uint64_t>(argsOffset));
+    SGFX_BACKEND_NS::drawInstancedIndirect(handle, indirectArgs, argsOffset);
+}
+
+void drawIndexedInstancedIndirect(DrawQueueHandle handle, BufferHandle indirectArgs, size_t argsOffset)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::DrawIndexedInstancedIndirect, handle, indirectArgs, static_cast<uint64_t>(argsOffset));
+    SGFX_BACKEND_NS::drawIndexedInstancedIndirect(handle, indirectArgs, argsOffset);
+}
+
+void multiDrawIndexedIndirect(
+    DrawQueueHandle handle,
+    BufferHandle indirectArgs, size_t argsOffset, uint32_t maxDraws,
+    BufferHandle countBuffer,  size_t countOffset,
+    uint32_t stride
+)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(
+            CaptureCommand::MultiDrawIndexedIndirect, handle,
+            indirectArgs, static_cast<uint64_t>(argsOffset), maxDraws,
+            countBuffer,  static_cast<uint64_t>(countOffset),
+            stride
+        );
+    }
+    SGFX_BACKEND_NS::multiDrawIndexedIndirect(handle, indirectArgs, argsOffset, maxDraws, countBuffer, countOffset, stride);
+}
+
+void submit(DrawQueueHandle handle)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::Submit, handle);
+    SGFX_BACKEND_NS::submit(handle);
+}
+
+void flush()
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::Flush);
+    SGFX_BACKEND_NS::flush();
+}
+
+void setSortKey(DrawQueueHandle handle, uint64_t key)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetSortKey, handle, key);
+    SGFX_BACKEND_NS::setSortKey(handle, key);
+}
+
+void submit(const DrawQueueHandle* queues, size_t count)
+{
+    if (CaptureLock lock = g_capture.Lock()) {
+        g_capture.Command(CaptureCommand::SubmitMultiple, static_cast<uint64_t>(count));
+        for (size_t i = 0; i < count; ++i)
+            g_capture.Value(queues[i]);
+    }
+    SGFX_BACKEND_NS::submit(queues, count);
+}
+
+void setDrawMerging(DrawQueueHandle handle, bool enabled)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SetDrawMerging, handle, static_cast<uint8_t>(enabled));
+    SGFX_BACKEND_NS::setDrawMerging(handle, enabled);
+}
+
+uint32_t getNumMergedDrawCalls(DrawQueueHandle handle)
+{
+    return SGFX_BACKEND_NS::getNumMergedDrawCalls(handle);
+}
+
+DrawBundleHandle createDrawBundle(DrawQueueHandle handle)
+{
+    DrawBundleHandle bundle = SGFX_BACKEND_NS::createDrawBundle(handle);
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::CreateDrawBundle, handle, bundle);
+    return bundle;
+}
+
+void releaseDrawBundle(DrawBundleHandle handle)
+{
+    captureRelease(CaptureCommand::ReleaseDrawBundle, handle);
+    SGFX_BACKEND_NS::releaseDrawBundle(handle);
+}
+
+void setConstantBuffer(DrawBundleHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::BundleSetConstantBuffer, handle, idx, buffer);
+    SGFX_BACKEND_NS::setConstantBuffer(handle, idx, buffer);
+}
+
+void setResource(DrawBundleHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::BundleSetResourceBuffer, handle, idx, resource);
+    SGFX_BACKEND_NS::setResource(handle, idx, resource);
+}
+
+void setResource(DrawBundleHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::BundleSetResourceTexture, handle, idx, resource);
+    SGFX_BACKEND_NS::setResource(handle, idx, resource);
+}
+
+void submitBundle(DrawBundleHandle handle)
+{
+    if (CaptureLock lock = g_capture.Lock())
+        g_capture.Command(CaptureCommand::SubmitBundle, handle);
+    SGFX_BACKEND_NS::submitBundle(handle);
+}
+
+void beginPerfEvent(const wchar_t* name)
+{
+    SGFX_BACKEND_NS::beginPerfEvent(name);
+}
+
+void endPerfEvent()
+{
+    SGFX_BACKEND_NS::endPerfEvent();
+}
+
+}
@@ -0,0 +1,191 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+#pragma once
+
+#include <stdint.h>
+
+///
+/// Capture file format, shared by the capture layer and sgfx-replay.
+///
+/// The file starts with a CaptureHeader followed by the recorded calls: an opcode and its arguments
+/// in declaration order, written with the native layout of the capturing build. Handles are written
+/// as their uint64_t value and blobs as a uint64_t size followed by the bytes, descriptors are
+/// written as raw structs and the replay patches the handles inside. Calls that create an object
+/// write the returned handle last.
+///
+/// CaptureCommand::End closes the stream, it is followed by the frame table: the number of frames
+/// and the [begin, end) stream offsets of each one. The last 8 bytes of the file hold the offset
+/// of the frame table.
+///
+namespace sgfx
+{
+namespace capture
+{
+
+enum : uint32_t
+{
+    kMagic   = 0x58464753, // "SGFX"
+    kVersion = 3
+};
+
+struct CaptureHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t pointerSize; // captures only replay on builds with the same struct layout
+    uint32_t reserved;
+};
+
+// commands are grouped by replay phase, see getPhase
+namespace CaptureCommand {
+enum : uint8_t {
+    End = 0,
+
+    // objects
+    CreateVertexShader,             // blob, out handle
+    CreateHullShader,               // blob, out handle
+    CreateDomainShader,             // blob, out handle
+    CreateGeometryShader,           // blob, out handle
+    CreatePixelShader,              // blob, out handle
+    CreateComputeShader,            // blob, out handle
+    ReleaseVertexShader,            // handle
+    ReleaseHullShader,              // handle
+    ReleaseDomainShader,            // handle
+    ReleaseGeometryShader,          // handle
+    ReleasePixelShader,             // handle
+    ReleaseComputeShader,           // handle
+    LinkSurfaceShader,              // vs, hs, ds, gs, ps, out handle
+    ReleaseSurfaceShader,           // handle
+    CreateComputeQueue,             // shader, out handle
+    ReleaseComputeQueue,            // handle
+    CreateVertexFormat,             // uint64_t count, count * (string semanticName, VertexElementDescriptor), blob bytecode, out handle
+    ReleaseVertexFormat,            // handle
+    CreatePipelineState,            // PipelineStateDescriptor, out handle
+    ReleasePipelineState,           // handle
+    CreateBuffer,                   // uint32_t flags, uint8_t hasData, blob, uint64_t size, stride, out handle
+    ReleaseBuffer,                  // handle
+    CreateConstantBuffer,           // uint8_t hasData, blob, uint64_t size, out handle
+    ReleaseConstantBuffer,          // handle
+    CreateSamplerState,             // SamplerStateDescriptor, out handle
+    ReleaseSamplerState,            // handle
+    CreateTexture,                  // uint8_t dimensions, uint32_t width, height, depth, DataFormat, uint32_t numMipmaps, flags, out handle
+    ReleaseTexture,                 // handle
+    GetBackBuffer,                  // out handle
+    CreateRenderTarget,             // RenderTargetDescriptor, out handle
+    ReleaseRenderTarget,            // handle
+    CreateDrawQueue,                // pipeline state, out handle
+    CreateChildDrawQueue,           // parent, out handle
+    ReleaseDrawQueue,               // handle
+    CreateBindGroup,                // BindGroupDescriptor, out handle
+    ReleaseBindGroup,               // handle
+    CreateDrawBundle,               // draw queue, out handle
+    ReleaseDrawBundle,              // handle
+
+    // resource updates
+    MapBuffer,                      // handle, MapType, uint64_t offset, size
+    UnmapBuffer,                    // handle, uint8_t hasData, blob (the mapped range after a write map)
+    CopyBufferData,                 // handle, uint64_t offset, blob
+    ClearBufferRWUint,              // handle, uint32_t
+    ClearBufferRWFloat,             // handle, float
+    UpdateConstantBuffer,           // handle, blob
+    MapTexture,                     // handle, MapType
+    UnmapTexture,                   // handle
+    UpdateTexture,                  // handle, uint32_t mip, uint64_t offsetX, sizeX, offsetY, sizeY, offsetZ, sizeZ, rowPitch, depthPitch, blob
+    ClearTextureRWUint,             // handle, uint32_t
+    ClearTextureRWFloat,            // handle, float
+    CopyTexture,                    // src, dst
+    CopyBuffer,                     // src, dst
+    CopyConstantBuffer,             // src, dst
+
+    // recording
+    ComputeSetConstantBuffer,       // queue, uint32_t idx, handle
+    ComputeSetResourceBuffer,       // queue, uint32_t idx, handle
+    ComputeSetResourceTexture,      // queue, uint32_t idx, handle
+    ComputeSetResourceRWBuffer,     // queue, uint32_t idx, handle
+    ComputeSetResourceRWTexture,    // queue, uint32_t idx, handle
+    SetSamplerState,                // queue, uint32_t idx, handle
+    SetPrimitiveTopology,           // queue, PrimitiveTopology
+    SetVertexBuffer,                // queue, handle, uint32_t idx
+    SetIndexBuffer,                 // queue, handle
+    SetConstantBuffer,              // queue, uint32_t idx, handle
+    SetConstants,                   // queue, uint32_t idx, blob
+    SetResourceBuffer,              // queue, uint32_t idx, handle
+    SetResourceTexture,             // queue, uint32_t idx, handle
+    SetBindGroup,                   // queue, uint32_t idx, handle
+    Draw,                           // queue, uint32_t count, startVertex
+    DrawIndexed,                    // queue, uint32_t count, startIndex, startVertex
+    DrawInstanced,                  // queue, uint32_t instanceCount, count, startVertex, startInstance
+    DrawIndexedInstanced,           // queue, uint32_t instanceCount, count, startIndex, startVertex, startInstance
+    DrawInstancedIndirect,          // queue, buffer, uint64_t offset
+    DrawIndexedInstancedIndirect,   // queue, buffer, uint64_t offset
+    MultiDrawIndexedIndirect,       // queue, buffer, uint64_t offset, uint32_t maxDraws, count buffer, uint64_t count offset, uint32_t stride
+    SetSortKey,                     // queue, uint64_t key
+    SetDrawMerging,                 // queue, uint8_t enabled
+    BundleSetConstantBuffer,        // bundle, uint32_t idx, handle
+    BundleSetResourceBuffer,        // bundle, uint32_t idx, handle
+    BundleSetResourceTexture,       // bundle, uint32_t idx, handle
+
+    // submission
+    ComputeSubmit,                  // queue, uint32_t x, y, z
+    Submit,                         // queue
+    SubmitMultiple,                 // uint64_t count, count * queue
+    SubmitBundle,                   // bundle
+    SetViewport,                    // uint32_t width, height, float minDepth, maxDepth
+    RenderTargetSetResourceRWBuffer,  // render target, uint32_t slot, handle
+    RenderTargetSetResourceRWTexture, // render target, uint32_t slot, handle
+    SetRenderTarget,                // handle
+    ClearRenderTarget,              // handle, uint32_t color
+    ClearRenderTargetSlot,          // handle, uint32_t slot, uint32_t color
+    ClearDepthStencil,              // handle, float depth, uint8_t stencil
+    Flush,                          //
+    Present,                        // uint32_t swapInterval, ends a frame
+    EndFrame,                       // ends a frame
+
+    Count,
+
+    FirstUpdate = MapBuffer,
+    FirstRecord = ComputeSetConstantBuffer,
+    FirstSubmit = ComputeSubmit
+};
+}
+
+enum class Phase : uint32_t
+{
+    Objects,
+    Updates,
+    Recording,
+    Submission,
+
+    Count
+};
+
+inline Phase getPhase(uint8_t command)
+{
+    if (command >= CaptureCommand::FirstSubmit) return Phase::Submission;
+    if (command >= CaptureCommand::FirstRecord) return Phase::Recording;
+    if (command >= CaptureCommand::FirstUpdate) return Phase::Updates;
+    return Phase::Objects;
+}
+
+}
+}
@@ -22,12 +22,20 @@
 /// THE SOFTWARE.
 #include <d3d11.h>
 #include <d3dcompiler.h>
+#include <chrono>
 #include <memory>
+#include <thread>
 
 #pragma comment(lib, "d3d11.lib")
 #pragma comment(lib, "d3dcompiler.lib")
 
-#ifdef SGFX_USE_D3D11_1
+// D3D11.1 binds inline constants as ranges of one ring buffer, builds against SDKs without
+// d3d11_1.h turn it off
+#ifndef SGFX_USE_D3D11_1
+#define SGFX_USE_D3D11_1 1
+#endif
+
+#if SGFX_USE_D3D11_1
 #include <d3d11_1.h>
 #endif
 
@@ -39,6 +47,10 @@
 #define SGFX_NS_INTERNAL sgfx_ns_d3d11_internal
 #endif
 
+#ifndef SGFX_BACKEND_NS
+#define SGFX_BACKEND_NS sgfx // capture builds move the backend aside and wrap it
+#endif
+
 #ifndef SGFX_INTERNAL_IMPLEMENTATION
 #define SGFX_INTERNAL_IMPLEMENTATION 1
 #endif
@@ -49,21 +61,23 @@
 #   endif
 #else
 #   ifndef SGFX_FORCE_INLINE
-#   define SGFX_FORCE_INLINE __attribute__((always_inline))
+#   define SGFX_FORCE_INLINE inline __attribute__((always_inline))
 #   endif
 #endif
 
 #include "sigrlinn.hh"
 #include <stdlib.h>
 
-namespace sgfx
+namespace SGFX_BACKEND_NS
 {
 
+using namespace sgfx;
 using namespace SGFX_NS_INTERNAL;
 
 static D3D11_MAP MapMapType[MapType::Count] = {
     D3D11_MAP_READ,
-    D3D11_MAP_WRITE_DISCARD
+    D3D11_MAP_WRITE_DISCARD,
+    D3D11_MAP_WRITE_NO_OVERWRITE
 };
 static_assert((sizeof(MapMapType) / sizeof(D3D11_MAP)) == static_cast<uint32_t>(MapType::Count), "Mapping is broken!");
 
@@ -237,10 +251,17 @@ IDXGISwapChain*       g_pSwapChain         = nullptr;
 AllocFunc             g_allocFunc = sgfx_malloc;
 FreeFunc              g_freeFunc  = sgfx_free;
 
-#ifdef SGFX_USE_D3D11_1
-ID3DUserDefinedAnnotation* g_debugAnnotation = nullptr;
+#if SGFX_USE_D3D11_1
+ID3DUserDefinedAnnotation* g_debugAnnotation    = nullptr;
+ID3D11DeviceContext1*      g_pImmediateContext1 = nullptr; // null when constant buffer ranges can't be bound
 #endif
 
+// transient draw queue storage
+FrameArena            g_frameArena;
+
+// sorted submit, keeps its storage between frames
+DrawQueueSorter       g_drawQueueSorter;
+
 //=============================================================================
 struct DXSharedBuffer final
 {
@@ -260,12 +281,13 @@ struct DXSharedBuffer final
         if (dataUAV    != nullptr)      dataUAV->Release();
     }
 
-    SGFX_FORCE_INLINE void createIndirect(size_t stride)
+    // the indirect copy has the size of the data buffer, CopyResource needs identical sizes
+    SGFX_FORCE_INLINE void createIndirect(size_t size)
     {
         D3D11_BUFFER_DESC bufferDesc;
         bufferDesc.Usage                  = D3D11_USAGE_DEFAULT;
         bufferDesc.StructureByteStride    = 0;
-        bufferDesc.ByteWidth              = static_cast<UINT>(stride);
+        bufferDesc.ByteWidth              = static_cast<UINT>(size);
         bufferDesc.CPUAccessFlags         = 0;
         bufferDesc.MiscFlags              = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;
         bufferDesc.BindFlags              = 0;
@@ -310,7 +332,30 @@ struct DXSharedBuffer final
     }
 };
 
+// buffers and textures, translation loops resolve them from packed pages
+HandlePool<DXSharedBuffer> g_sharedBuffers;
+
 //=============================================================================
+// a constant buffer or a range of it in shader constants (16 bytes each), zero numConstants binds the
+// whole buffer. Ranges are only used for inline constants (see dxAllocateConstants)
+struct DXConstantRange final
+{
+    ID3D11Buffer* buffer        = nullptr;
+    UINT          firstConstant = 0;
+    UINT          numConstants  = 0;
+
+    SGFX_FORCE_INLINE DXConstantRange() {}
+    SGFX_FORCE_INLINE DXConstantRange(ID3D11Buffer* constantBuffer, UINT first = 0, UINT count = 0)
+        : buffer(constantBuffer), firstConstant(first), numConstants(count)
+    {}
+
+    SGFX_FORCE_INLINE bool operator==(const DXConstantRange& other) const
+    {
+        return buffer == other.buffer && firstConstant == other.firstConstant && numConstants == other.numConstants;
+    }
+};
+
+// setters only mark the slots, flush() binds the dirty ranges right before a draw or a dispatch
 struct DXStateCache final
 {
     enum
@@ -321,11 +366,10 @@ struct DXStateCache final
 
     uint32_t type;
 
-    ID3D11SamplerState*         samplerStates[DrawQueue::kMaxSamplerStates];
-    ID3D11Buffer*               constantBuffers[DrawCall::kMaxConstantBuffers];
-    ID3D11ShaderResourceView*   shaderResourceViews[DrawCall::kMaxShaderResources];
-    ID3D11UnorderedAccessView*  shaderUAVs[ComputeQueue::kMaxShaderResourcesRW];
-    uint32_t                    shaderUAVCounters[ComputeQueue::kMaxShaderResourcesRW];
+    BindingSlots<ID3D11SamplerState*,        DrawQueue::kMaxSamplerStates>         samplerStates;
+    BindingSlots<DXConstantRange,            DrawCall::kMaxConstantBuffers>        constantBuffers;
+    BindingSlots<ID3D11ShaderResourceView*,  DrawCall::kMaxShaderResources>        shaderResourceViews;
+    BindingSlots<ID3D11UnorderedAccessView*, ComputeQueue::kMaxShaderResourcesRW>  shaderUAVs;
 
     bool vs = false;
     bool hs = false;
@@ -333,117 +377,379 @@ struct DXStateCache final
     bool gs = false;
     bool ps = false;
 
-    SGFX_FORCE_INLINE DXStateCache(uint32_t newType)
-    {
-        clear();
+    SGFX_FORCE_INLINE DXStateCache(uint32_t newType) : type(newType) {}
 
-        type = newType;
+    // the next flush() unbinds everything that is bound
+    SGFX_FORCE_INLINE void reset()
+    {
+        samplerStates.Reset();
+        constantBuffers.Reset();
+        shaderResourceViews.Reset();
+        shaderUAVs.Reset();
     }
 
     SGFX_FORCE_INLINE void clear()
     {
-        std::memset(samplerStates, 0, sizeof(samplerStates));
-        std::memset(constantBuffers, 0, sizeof(constantBuffers));
-        std::memset(shaderResourceViews, 0, sizeof(shaderResourceViews));
-        std::memset(shaderUAVs, 0, sizeof(shaderUAVs));
-        std::memset(shaderUAVCounters, 0, sizeof(shaderUAVCounters));
-
-        if (vs) g_pImmediateContext->VSSetShaderResources(0, DrawCall::kMaxShaderResources, shaderResourceViews);
-        if (hs) g_pImmediateContext->HSSetShaderResources(0, DrawCall::kMaxShaderResources, shaderResourceViews);
-        if (ds) g_pImmediateContext->DSSetShaderResources(0, DrawCall::kMaxShaderResources, shaderResourceViews);
-        if (gs) g_pImmediateContext->GSSetShaderResources(0, DrawCall::kMaxShaderResources, shaderResourceViews);
-        if (ps) g_pImmediateContext->PSSetShaderResources(0, DrawCall::kMaxShaderResources, shaderResourceViews);
+        reset();
+        flush();
     }
 
-    SGFX_FORCE_INLINE void setSamplerStates(const SamplerStateHandle* handles)
+    SGFX_FORCE_INLINE void flush()
     {
-        for (UINT i = 0; i < DrawQueue::kMaxSamplerStates; ++i) {
-            ID3D11SamplerState* state = static_cast<ID3D11SamplerState*>(handles[i].value);
-            if (state != samplerStates[i]) {
-                samplerStates[i] = state;
-
-                if (type == SC_Draw) {
-                    if (vs) g_pImmediateContext->VSSetSamplers(i, 1, &state);
-                    if (hs) g_pImmediateContext->HSSetSamplers(i, 1, &state);
-                    if (ds) g_pImmediateContext->DSSetSamplers(i, 1, &state);
-                    if (gs) g_pImmediateContext->GSSetSamplers(i, 1, &state);
-                    if (ps) g_pImmediateContext->PSSetSamplers(i, 1, &state);
+        if (type == SC_Draw) {
+            samplerStates.Flush([this](UINT first, UINT count, ID3D11SamplerState* const* states) {
+                if (vs) g_pImmediateContext->VSSetSamplers(first, count, states);
+                if (hs) g_pImmediateContext->HSSetSamplers(first, count, states);
+                if (ds) g_pImmediateContext->DSSetSamplers(first, count, states);
+                if (gs) g_pImmediateContext->GSSetSamplers(first, count, states);
+                if (ps) g_pImmediateContext->PSSetSamplers(first, count, states);
+            });
+
+            constantBuffers.Flush([this](UINT first, UINT count, const DXConstantRange* ranges) {
+                ID3D11Buffer* states[DrawCall::kMaxConstantBuffers];
+                if (!getConstantBuffers(count, ranges, states)) {
+                    if (vs) g_pImmediateContext->VSSetConstantBuffers(first, count, states);
+                    if (hs) g_pImmediateContext->HSSetConstantBuffers(first, count, states);
+                    if (ds) g_pImmediateContext->DSSetConstantBuffers(first, count, states);
+                    if (gs) g_pImmediateContext->GSSetConstantBuffers(first, count, states);
+                    if (ps) g_pImmediateContext->PSSetConstantBuffers(first, count, states);
+                    return;
                 }
 
-                if (type == SC_Compute)
-                    g_pImmediateContext->CSSetSamplers(i, 1, &state);
-            }
+#if SGFX_USE_D3D11_1
+                // inline constants, whole buffers in the same run are bound one by one as well
+                for (UINT i = 0; i < count; ++i) {
+                    UINT slot = first + i;
+
+                    if (ranges[i].numConstants != 0) {
+                        const UINT* firstConstant = &ranges[i].firstConstant;
+                        const UINT* numConstants  = &ranges[i].numConstants;
+
+                        if (vs) g_pImmediateContext1->VSSetConstantBuffers1(slot, 1, &states[i], firstConstant, numConstants);
+                        if (hs) g_pImmediateContext1->HSSetConstantBuffers1(slot, 1, &states[i], firstConstant, numConstants);
+                        if (ds) g_pImmediateContext1->DSSetConstantBuffers1(slot, 1, &states[i], firstConstant, numConstants);
+                        if (gs) g_pImmediateContext1->GSSetConstantBuffers1(slot, 1, &states[i], firstConstant, numConstants);
+                        if (ps) g_pImmediateContext1->PSSetConstantBuffers1(slot, 1, &states[i], firstConstant, numConstants);
+                    } else {
+                        if (vs) g_pImmediateContext->VSSetConstantBuffers(slot, 1, &states[i]);
+                        if (hs) g_pImmediateContext->HSSetConstantBuffers(slot, 1, &states[i]);
+                        if (ds) g_pImmediateContext->DSSetConstantBuffers(slot, 1, &states[i]);
+                        if (gs) g_pImmediateContext->GSSetConstantBuffers(slot, 1, &states[i]);
+                        if (ps) g_pImmediateContext->PSSetConstantBuffers(slot, 1, &states[i]);
+                    }
+                }
+#endif
+            });
+
+            shaderResourceViews.Flush([this](UINT first, UINT count, ID3D11ShaderResourceView* const* states) {
+                if (vs) g_pImmediateContext->VSSetShaderResources(first, count, states);
+                if (hs) g_pImmediateContext->HSSetShaderResources(first, count, states);
+                if (ds) g_pImmediateContext->DSSetShaderResources(first, count, states);
+                if (gs) g_pImmediateContext->GSSetShaderResources(first, count, states);
+                if (ps) g_pImmediateContext->PSSetShaderResources(first, count, states);
+            });
+        }
+
+        if (type == SC_Compute) {
+            // UAVs go first, binding a UAV unbinds the SRVs of the same resource and not the other way around
+            shaderUAVs.Flush([](UINT first, UINT count, ID3D11UnorderedAccessView* const* states) {
+                static const UINT counters[ComputeQueue::kMaxShaderResourcesRW] = { 0 };
+                g_pImmediateContext->CSSetUnorderedAccessViews(first, count, states, counters);
+            });
+
+            samplerStates.Flush([](UINT first, UINT count, ID3D11SamplerState* const* states) {
+                g_pImmediateContext->CSSetSamplers(first, count, states);
+            });
+
+            constantBuffers.Flush([](UINT first, UINT count, const DXConstantRange* ranges) {
+                ID3D11Buffer* states[DrawCall::kMaxConstantBuffers];
+                getConstantBuffers(count, ranges, states);
+                g_pImmediateContext->CSSetConstantBuffers(first, count, states);
+            });
+
+            shaderResourceViews.Flush([](UINT first, UINT count, ID3D11ShaderResourceView* const* states) {
+                g_pImmediateContext->CSSetShaderResources(first, count, states);
+            });
         }
     }
 
-    SGFX_FORCE_INLINE void setConstantBuffers(const ConstantBufferHandle* handles)
+    SGFX_FORCE_INLINE void setSamplerState(UINT i, ID3D11SamplerState* state)
     {
-        for (UINT i = 0; i < DrawCall::kMaxConstantBuffers; ++i) {
-            ID3D11Buffer* state = static_cast<ID3D11Buffer*>(handles[i].value);
-            if (state != constantBuffers[i]) {
-                constantBuffers[i] = state;
-
-                if (type == SC_Draw) {
-                    if (vs) g_pImmediateContext->VSSetConstantBuffers(i, 1, &state);
-                    if (hs) g_pImmediateContext->HSSetConstantBuffers(i, 1, &state);
-                    if (ds) g_pImmediateContext->DSSetConstantBuffers(i, 1, &state);
-                    if (gs) g_pImmediateContext->GSSetConstantBuffers(i, 1, &state);
-                    if (ps) g_pImmediateContext->PSSetConstantBuffers(i, 1, &state);
-                }
+        samplerStates.Set(i, state);
+    }
 
-                if (type == SC_Compute)
-                    g_pImmediateContext->CSSetConstantBuffers(i, 1, &state);
-            }
-        }
+    SGFX_FORCE_INLINE void setSamplerStates(const SamplerStateHandle* handles)
+    {
+        for (UINT i = 0; i < DrawQueue::kMaxSamplerStates; ++i)
+            samplerStates.Set(i, static_cast<ID3D11SamplerState*>(handles[i].value));
     }
 
-    SGFX_FORCE_INLINE void setShaderResources(const ShaderResource* resources)
+    SGFX_FORCE_INLINE void setSamplerStates(UINT first, UINT count, ID3D11SamplerState* const* states)
     {
-        for (UINT i = 0; i < DrawCall::kMaxShaderResources; ++i) {
-            DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(resources[i].value);
-
-            ID3D11ShaderResourceView* state = nullptr;
-            if (buffer != nullptr)
-                state = buffer->dataView;
-
-            if (state != shaderResourceViews[i]) {
-                shaderResourceViews[i] = state;
-
-                if (type == SC_Draw) {
-                    if (vs) g_pImmediateContext->VSSetShaderResources(i, 1, &state);
-                    if (hs) g_pImmediateContext->HSSetShaderResources(i, 1, &state);
-                    if (ds) g_pImmediateContext->DSSetShaderResources(i, 1, &state);
-                    if (gs) g_pImmediateContext->GSSetShaderResources(i, 1, &state);
-                    if (ps) g_pImmediateContext->PSSetShaderResources(i, 1, &state);
-                }
+        samplerStates.Set(first, count, states);
+    }
 
-                if (type == SC_Compute)
-                    g_pImmediateContext->CSSetShaderResources(i, 1, &state);
-            }
+    // returns true if some of the slots are ranges
+    static SGFX_FORCE_INLINE bool getConstantBuffers(UINT count, const DXConstantRange* ranges, ID3D11Buffer** states)
+    {
+        bool hasRanges = false;
+        for (UINT i = 0; i < count; ++i) {
+            states[i]  = ranges[i].buffer;
+            hasRanges |= ranges[i].numConstants != 0;
         }
+        return hasRanges;
     }
 
-    SGFX_FORCE_INLINE void setShaderResourcesRW(const ShaderResource* resources)
+    SGFX_FORCE_INLINE void setConstantBuffers(UINT first, UINT count, ID3D11Buffer* const* states)
     {
-        for (UINT i = 0; i < ComputeQueue::kMaxShaderResourcesRW; ++i) {
-            DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(resources[i].value);
+        for (UINT i = 0; i < count; ++i)
+            constantBuffers.Set(first + i, states[i]);
+    }
+
+    SGFX_FORCE_INLINE void setShaderResources(UINT first, UINT count, ID3D11ShaderResourceView* const* states)
+    {
+        shaderResourceViews.Set(first, count, states);
+    }
+
+    SGFX_FORCE_INLINE void setConstantBuffer(UINT i, ID3D11Buffer* state)
+    {
+        constantBuffers.Set(i, state);
+    }
+
+    SGFX_FORCE_INLINE void setConstantRange(UINT i, const DXConstantRange& range)
+    {
+        constantBuffers.Set(i, range);
+    }
+
+    SGFX_FORCE_INLINE void setShaderResource(UINT i, ID3D11ShaderResourceView* state)
+    {
+        shaderResourceViews.Set(i, state);
+    }
+
+    SGFX_FORCE_INLINE void setShaderResourceRW(UINT i, ID3D11UnorderedAccessView* state)
+    {
+        shaderUAVs.Set(i, state);
+    }
+};
+
+// compute bindings stay across dispatches, draw submits unbind them so the resources can be read by draws
+DXStateCache g_computeStateCache(DXStateCache::SC_Compute);
+
+//=============================================================================
+// inline constants (see setConstants)
+// when the device supports D3D11.1 constant buffer offsets they are appended to a dynamic ring buffer
+// with no-overwrite maps and bound as ranges, the ring is discarded when it wraps so the driver keeps
+// the data of the draw calls in flight. Otherwise every slot has a dynamic buffer that is discarded
+// for each draw call
+struct DXConstantRing final
+{
+    enum
+    {
+        kSize          = 1024 * 1024,
+        kRangeAlign    = 16,  // ranges start and end at multiples of 16 constants
+        kConstantSize  = 16
+    };
+
+    ID3D11Buffer* buffer = nullptr;
+    UINT          offset = 0; // in constants
+
+    ID3D11Buffer* slotBuffers[DrawCall::kMaxConstantBuffers] = { nullptr };
+};
+
+static_assert(static_cast<size_t>(DrawQueue::kMaxConstantDataSize) <= DXConstantRing::kSize, "the constants of a draw call must fit in the ring");
+
+DXConstantRing g_constantRing;
+d3d11::Stats   g_stats;
+
+static SGFX_FORCE_INLINE ID3D11Buffer* dxCreateDynamicConstantBuffer(UINT size)
+{
+    D3D11_BUFFER_DESC bufferDesc;
+    std::memset(&bufferDesc, 0, sizeof(bufferDesc));
+    bufferDesc.ByteWidth      = size;
+    bufferDesc.Usage          = D3D11_USAGE_DYNAMIC;
+    bufferDesc.BindFlags      = D3D11_BIND_CONSTANT_BUFFER;
+    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 
-            ID3D11UnorderedAccessView* state = nullptr;
-            if (buffer != nullptr)
-                state = buffer->dataUAV;
+    ID3D11Buffer* buffer = nullptr;
+    if (FAILED(g_pd3dDevice->CreateBuffer(&bufferDesc, nullptr, &buffer)))
+        return nullptr;
+    return buffer;
+}
+
+static SGFX_FORCE_INLINE bool dxWriteConstants(ID3D11Buffer* buffer, D3D11_MAP mapType, UINT offset, const void* data, UINT size)
+{
+    D3D11_MAPPED_SUBRESOURCE mapped;
+    if (FAILED(g_pImmediateContext->Map(buffer, 0, mapType, 0, &mapped)))
+        return false;
+
+    std::memcpy(static_cast<uint8_t*>(mapped.pData) + offset, data, size);
+    g_pImmediateContext->Unmap(buffer, 0);
+    return true;
+}
+
+// copies the constants into the ring or the buffer of the slot, false when they couldn't be uploaded
+static bool dxAllocateConstants(UINT slot, const void* data, UINT size, DXConstantRange& range)
+{
+    DXConstantRing& ring = g_constantRing;
 
-            if (state != shaderUAVs[i]) {
-                shaderUAVs[i] = state;
+    // the slot buffers hold kMaxConstantDataSize bytes, setConstants only asserts in debug builds
+    if (size == 0 || size > DrawQueue::kMaxConstantDataSize)
+        return false;
 
-                if (type == SC_Compute)
-                    g_pImmediateContext->CSSetUnorderedAccessViews(i, 1, &state, shaderUAVCounters);
+#if SGFX_USE_D3D11_1
+    if (g_pImmediateContext1 != nullptr) {
+        const UINT kRangeSize = DXConstantRing::kRangeAlign * DXConstantRing::kConstantSize;
+        const UINT kCapacity  = DXConstantRing::kSize / DXConstantRing::kConstantSize;
+
+        UINT numConstants = ((size + kRangeSize - 1) / kRangeSize) * DXConstantRing::kRangeAlign;
+
+        if (ring.buffer == nullptr) {
+            ring.buffer = dxCreateDynamicConstantBuffer(DXConstantRing::kSize);
+            ring.offset = kCapacity;
+        }
+
+        // a ring that can't be created or mapped falls back to the slot buffers
+        if (ring.buffer != nullptr) {
+            D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+            if (ring.offset + numConstants > kCapacity) {
+                mapType     = D3D11_MAP_WRITE_DISCARD;
+                ring.offset = 0;
+
+                g_stats.numConstantRingDiscards += 1;
+            }
+
+            if (dxWriteConstants(ring.buffer, mapType, ring.offset * DXConstantRing::kConstantSize, data, size)) {
+                range        = DXConstantRange(ring.buffer, ring.offset, numConstants);
+                ring.offset += numConstants;
+
+                g_stats.numConstantDataBytes += size;
+                return true;
             }
         }
     }
+#endif
+
+    ID3D11Buffer*& buffer = ring.slotBuffers[slot];
+    if (buffer == nullptr) {
+        buffer = dxCreateDynamicConstantBuffer(DrawQueue::kMaxConstantDataSize);
+        if (buffer == nullptr)
+            return false;
+    }
+
+    if (!dxWriteConstants(buffer, D3D11_MAP_WRITE_DISCARD, 0, data, size))
+        return false;
+
+    range = DXConstantRange(buffer);
+
+    g_stats.numConstantDataBytes += size;
+    return true;
+}
+
+//=============================================================================
+// fences (see insertFence) are event queries, a fence value selects its query and the query is
+// reused once the value completed. Every frame ends with a fence too. If a query can't be created
+// the fence takes the value of the next one, so it stays pending until a later fence completes
+struct DXFenceTimeline final
+{
+    enum { kMaxPendingFences = 64 };
+
+    uint64_t     nextValue      = 1;
+    uint64_t     completedValue = 0;
+    ID3D11Query* queries[kMaxPendingFences] = { nullptr };
+
+    uint64_t     frameIndex     = 1;
+    uint64_t     completedFrame = 0;
+    uint64_t     frameFences[kMaxPendingFences] = { 0 }; // the fence that ends each frame
 };
 
+DXFenceTimeline g_fences;
+
+static SGFX_FORCE_INLINE bool dxIsQueryDone(ID3D11Query* query, UINT flags)
+{
+    BOOL done = FALSE;
+    return g_pImmediateContext->GetData(query, &done, sizeof(done), flags) == S_OK && done;
+}
+
+// the GPU finishes queries in order, so a finished query completes every fence before it
+static bool dxWaitForFence(uint64_t value, uint64_t timeout)
+{
+    if (value <= g_fences.completedValue)
+        return true;
+    if (value >= g_fences.nextValue)
+        return false; // not inserted yet, it completes with the next fence that is
+
+    ID3D11Query* query = g_fences.queries[value % DXFenceTimeline::kMaxPendingFences];
+    auto         start = std::chrono::high_resolution_clock::now();
+    while (!dxIsQueryDone(query, 0)) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start);
+        if (static_cast<uint64_t>(elapsed.count()) >= timeout)
+            return false;
+        std::this_thread::yield();
+    }
+
+    g_fences.completedValue = value;
+    return true;
+}
+
+static uint64_t dxInsertFence()
+{
+    // the oldest fence has to complete before its query is reused
+    if (g_fences.nextValue - g_fences.completedValue > DXFenceTimeline::kMaxPendingFences)
+        dxWaitForFence(g_fences.completedValue + 1, UINT64_MAX);
+
+    uint64_t      value = g_fences.nextValue;
+    ID3D11Query*& query = g_fences.queries[value % DXFenceTimeline::kMaxPendingFences];
+    if (query == nullptr) {
+        D3D11_QUERY_DESC queryDesc;
+        std::memset(&queryDesc, 0, sizeof(queryDesc));
+        queryDesc.Query = D3D11_QUERY_EVENT;
+
+        if (FAILED(g_pd3dDevice->CreateQuery(&queryDesc, &query))) {
+            query = nullptr;
+            return value; // never reported as complete before the work it follows
+        }
+    }
+
+    g_pImmediateContext->End(query);
+    g_fences.nextValue++;
+    return value;
+}
+
+DeferredReleaseQueue g_deferredReleases;
+
+static void dxReleaseDeferred(const DeferredReleaseQueue::Entry& entry)
+{
+    if (entry.type == DeferredReleaseQueue::Type::ConstantBuffer)
+        static_cast<ID3D11Buffer*>(entry.handle)->Release();
+    else
+        g_sharedBuffers.Release(entry.handle);
+}
+
+static SGFX_FORCE_INLINE bool dxDeferRelease(void* handle, DeferredReleaseQueue::Type type)
+{
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle);
+    return buffer != nullptr && g_deferredReleases.Push(handle, type, buffer->dataBufferSize);
+}
+
+// polls without flushing, oldest first
+static void dxUpdateCompletedFrames()
+{
+    while (g_fences.completedValue + 1 < g_fences.nextValue) {
+        if (!dxIsQueryDone(g_fences.queries[(g_fences.completedValue + 1) % DXFenceTimeline::kMaxPendingFences], D3D11_ASYNC_GETDATA_DONOTFLUSH))
+            break;
+        g_fences.completedValue++;
+    }
+
+    while (g_fences.completedFrame + 1 < g_fences.frameIndex) {
+        uint64_t fence = g_fences.frameFences[(g_fences.completedFrame + 1) % DXFenceTimeline::kMaxPendingFences];
+        if (fence > g_fences.completedValue)
+            break;
+        g_fences.completedFrame++;
+    }
+}
+
 //=============================================================================
-struct VertexFormatImpl final
+struct VertexFormatImpl final : public StateObject
 {
     ID3D11InputLayout* inputLayout;
 };
@@ -457,7 +763,9 @@ struct SurfaceShaderImpl final
     ID3D11PixelShader*    ps;
 };
 
-struct PipelineStateImpl final
+// the D3D11 runtime already returns the same rasterizer, blend, depth stencil and sampler objects
+// for identical descriptions, pipelines are interned on top of that by the native objects they use
+struct PipelineStateImpl final : public StateObject
 {
     ID3D11RasterizerState*   rasterizerState   = nullptr;
     ID3D11BlendState*        blendState        = nullptr;
@@ -473,6 +781,20 @@ struct PipelineStateImpl final
     DXStateCache             stateCache = DXStateCache(DXStateCache::SC_Draw);
 };
 
+// identical descriptors share one object
+StateCache<VertexFormatImpl>  g_vertexFormats;
+StateCache<PipelineStateImpl> g_pipelineStates;
+
+// bind group with the native objects resolved at creation
+struct DXBindGroupImpl final : public BindGroup
+{
+    ID3D11Buffer*             constantBuffers[BindGroupDescriptor::kMaxConstantBuffers];
+    ID3D11ShaderResourceView* shaderResourceViews[BindGroupDescriptor::kMaxShaderResources];
+    ID3D11SamplerState*       samplerStates[BindGroupDescriptor::kMaxSamplerStates];
+
+    SGFX_FORCE_INLINE DXBindGroupImpl(const BindGroupDescriptor& desc) : BindGroup(desc) {}
+};
+
 struct RenderTargetImpl final
 {
     UINT                        numRenderTargets = 0;
@@ -530,103 +852,369 @@ static SGFX_FORCE_INLINE UINT dxFormatStride(DataFormat format)
     }
 };
 
+// native objects bound by the last dxSetPipelineState, reset at the start of every submit since the
+// application may use the immediate context in between
+struct DXBoundPipeline final
+{
+    bool                     isValid           = false;
+    ID3D11RasterizerState*   rasterizerState   = nullptr;
+    ID3D11BlendState*        blendState        = nullptr;
+    ID3D11DepthStencilState* depthStencilState = nullptr;
+    UINT                     stencilRef        = 0;
+    VertexFormatImpl*        vertexFormat      = nullptr;
+    SurfaceShaderImpl*       shader            = nullptr;
+};
+
+DXBoundPipeline g_boundPipeline;
+
+// pipelines share the native sub-states, the ones that are already bound are skipped
 static void dxSetPipelineState(PipelineStateHandle handle)
 {
     if (handle != PipelineStateHandle::invalidHandle()) {
         PipelineStateImpl* impl = static_cast<PipelineStateImpl*>(handle.value);
+        bool               all  = !g_boundPipeline.isValid;
+
+        if (all || impl->rasterizerState != g_boundPipeline.rasterizerState)
+            g_pImmediateContext->RSSetState(impl->rasterizerState);
+        if (all || impl->blendState != g_boundPipeline.blendState)
+            g_pImmediateContext->OMSetBlendState(impl->blendState, nullptr, 0xffffffff);
+        if (all || impl->depthStencilState != g_boundPipeline.depthStencilState || impl->stencilRef != g_boundPipeline.stencilRef)
+            g_pImmediateContext->OMSetDepthStencilState(impl->depthStencilState, impl->stencilRef);
+
+        if (all || impl->vertexFormat != g_boundPipeline.vertexFormat) {
+            if (impl->vertexFormat != nullptr)
+                g_pImmediateContext->IASetInputLayout(impl->vertexFormat->inputLayout);
+            else
+                g_pImmediateContext->IASetInputLayout(nullptr);
+        }
+
+        if (all || impl->shader != g_boundPipeline.shader) {
+            g_pImmediateContext->VSSetShader(impl->shader->vs, nullptr, 0);
+            g_pImmediateContext->HSSetShader(impl->shader->hs, nullptr, 0);
+            g_pImmediateContext->DSSetShader(impl->shader->ds, nullptr, 0);
+            g_pImmediateContext->GSSetShader(impl->shader->gs, nullptr, 0);
+            g_pImmediateContext->PSSetShader(impl->shader->ps, nullptr, 0);
+        }
+
+        g_boundPipeline.isValid           = true;
+        g_boundPipeline.rasterizerState   = impl->rasterizerState;
+        g_boundPipeline.blendState        = impl->blendState;
+        g_boundPipeline.depthStencilState = impl->depthStencilState;
+        g_boundPipeline.stencilRef        = impl->stencilRef;
+        g_boundPipeline.vertexFormat      = impl->vertexFormat;
+        g_boundPipeline.shader            = impl->shader;
+    }
+}
+
+static SGFX_FORCE_INLINE void dxDrawCall(const DrawCall& call)
+{
+    switch (call.type) {
+    case DrawCall::Draw:                 { g_pImmediateContext->Draw(call.count, call.startVertex); } break;
+    case DrawCall::DrawIndexed:          { g_pImmediateContext->DrawIndexed(call.count, call.startIndex, call.startVertex); } break;
+    case DrawCall::DrawInstanced:        { g_pImmediateContext->DrawInstanced(call.count, call.instanceCount, call.startVertex, call.startInstance); } break;
+    case DrawCall::DrawIndexedInstanced: { g_pImmediateContext->DrawIndexedInstanced(call.count, call.instanceCount, call.startIndex, call.startVertex, call.startInstance); } break;
+
+    case DrawCall::DrawInstancedIndirect: {
+
+        DXSharedBuffer* buffer = g_sharedBuffers.Get(call.indirectArgsBuffer.value);
+        if (buffer == nullptr)
+            break;
+
+        // TODO: AppendConsumeBuffer support!
+        //g_pImmediateContext->CopyStructureCount(buffer->indirectBuffer, call.indirectArgsOffset, buffer->dataUAV);
+        g_pImmediateContext->CopyResource(buffer->indirectBuffer, buffer->dataBuffer);
+        g_pImmediateContext->DrawInstancedIndirect(buffer->indirectBuffer, static_cast<UINT>(call.indirectArgsOffset));
+    } break;
+
+    case DrawCall::DrawIndexedInstancedIndirect: {
+
+        DXSharedBuffer* buffer = g_sharedBuffers.Get(call.indirectArgsBuffer.value);
+        if (buffer == nullptr)
+            break;
+
+        // TODO: AppendConsumeBuffer support!
+        //g_pImmediateContext->CopyStructureCount(buffer->indirectBuffer, call.indirectArgsOffset, buffer->dataUAV);
+        g_pImmediateContext->CopyResource(buffer->indirectBuffer, buffer->dataBuffer);
+        g_pImmediateContext->DrawIndexedInstancedIndirect(buffer->indirectBuffer, static_cast<UINT>(call.indirectArgsOffset));
+    } break;
+
+    case DrawCall::MultiDrawIndexedIndirect: {
 
-        g_pImmediateContext->RSSetState(impl->rasterizerState);
-        g_pImmediateContext->OMSetBlendState(impl->blendState, nullptr, 0xffffffff);
-        g_pImmediateContext->OMSetDepthStencilState(impl->depthStencilState, impl->stencilRef);
+        DXSharedBuffer* buffer = g_sharedBuffers.Get(call.indirectArgsBuffer.value);
+        if (buffer == nullptr)
+            break;
 
-        if (impl->vertexFormat != nullptr)
-            g_pImmediateContext->IASetInputLayout(impl->vertexFormat->inputLayout);
-        else
-            g_pImmediateContext->IASetInputLayout(nullptr);
+        // D3D11 can't read the draw count on the GPU, every record is drawn
+        size_t stride = (call.indirectStride != 0) ? call.indirectStride : 5 * sizeof(UINT);
+        if (call.maxDrawCount == 0 || buffer->indirectBuffer == nullptr)
+            break;
+
+        // nothing is drawn unless the last record fits in the buffer
+        size_t end = call.indirectArgsOffset + (call.maxDrawCount - 1) * stride + 5 * sizeof(UINT);
+        if (end > buffer->dataBufferSize)
+            break;
+
+        g_pImmediateContext->CopyResource(buffer->indirectBuffer, buffer->dataBuffer);
+        for (uint32_t i = 0; i < call.maxDrawCount; ++i)
+            g_pImmediateContext->DrawIndexedInstancedIndirect(buffer->indirectBuffer, static_cast<UINT>(call.indirectArgsOffset + i * stride));
+    } break;
 
-        g_pImmediateContext->VSSetShader(impl->shader->vs, nullptr, 0);
-        g_pImmediateContext->HSSetShader(impl->shader->hs, nullptr, 0);
-        g_pImmediateContext->DSSetShader(impl->shader->ds, nullptr, 0);
-        g_pImmediateContext->GSSetShader(impl->shader->gs, nullptr, 0);
-        g_pImmediateContext->PSSetShader(impl->shader->ps, nullptr, 0);
     }
 }
 
-static void dxProcessDrawQueue(DrawQueue* queue)
+static void dxApplyOverrides(PipelineStateImpl* psimpl, const DrawOverrides& overrides)
 {
-    PipelineStateImpl* psimpl = static_cast<PipelineStateImpl*>(queue->getState().value);
+    overrides.constantBufferMask.ForEach([psimpl, &overrides](uint32_t i) {
+        psimpl->stateCache.setConstantBuffer(i, static_cast<ID3D11Buffer*>(overrides.constantBuffers[i].value));
+    });
 
-    dxSetPipelineState(queue->getState());
+    overrides.shaderResourceMask.ForEach([psimpl, &overrides](uint32_t i) {
+        DXSharedBuffer* buffer = g_sharedBuffers.Get(overrides.shaderResources[i].value);
+        psimpl->stateCache.setShaderResource(i, (buffer != nullptr) ? buffer->dataView : nullptr);
+    });
+}
 
-    psimpl->stateCache.setSamplerStates(queue->samplerStates);
+// resets the slots of the previous group that the next one does not cover, then binds the next one
+static void dxSetBindGroup(
+    PipelineStateImpl* psimpl, const SamplerStateHandle* samplerStates,
+    const DXBindGroupImpl* prev, const DXBindGroupImpl* next
+)
+{
+    if (prev != nullptr) {
+        BindGroup::ConstantBufferMask constantBufferMask = prev->constantBufferMask;
+        BindGroup::ShaderResourceMask shaderResourceMask = prev->shaderResourceMask;
+        BindGroup::SamplerStateMask   samplerStateMask   = prev->samplerStateMask;
+
+        if (next != nullptr) {
+            constantBufferMask = constantBufferMask.Exclude(next->constantBufferMask);
+            shaderResourceMask = shaderResourceMask.Exclude(next->shaderResourceMask);
+            samplerStateMask   = samplerStateMask.Exclude(next->samplerStateMask);
+        }
+
+        constantBufferMask.ForEach([psimpl](uint32_t i) { psimpl->stateCache.setConstantBuffer(i, nullptr); });
+        shaderResourceMask.ForEach([psimpl](uint32_t i) { psimpl->stateCache.setShaderResource(i, nullptr); });
+        samplerStateMask.ForEach([psimpl, samplerStates](uint32_t i) {
+            psimpl->stateCache.setSamplerState(i, static_cast<ID3D11SamplerState*>(samplerStates[i].value));
+        });
+    }
 
-    // process draw calls
-    for (const DrawCall& call: queue->getDrawCalls()) {
-        DXSharedBuffer* indexBuffer  = static_cast<DXSharedBuffer*>(call.indexBuffer.value);
-        UINT            offset       = 0;
+    if (next != nullptr) {
+        if (next->numConstantBuffers != 0)
+            psimpl->stateCache.setConstantBuffers(next->firstConstantBuffer, next->numConstantBuffers, next->constantBuffers);
+        if (next->numShaderResources != 0)
+            psimpl->stateCache.setShaderResources(next->firstShaderResource, next->numShaderResources, next->shaderResourceViews);
+        if (next->numSamplerStates != 0)
+            psimpl->stateCache.setSamplerStates(next->firstSamplerState, next->numSamplerStates, next->samplerStates);
+    }
+}
+
+// overridden slots are bound by dxApplyOverrides, the stream values are ignored for them
+// returns the number of draw calls that were merged
+static uint32_t dxProcessDrawCommands(
+    PipelineStateImpl* psimpl, const SamplerStateHandle* samplerStates,
+    CommandReader reader, bool merge, const DrawOverrides* overrides = nullptr
+)
+{
+    // process draw calls, the queue only records state changes
+    DrawCall       call;
+    DrawCallMerger merger(merge);
+
+    const DXBindGroupImpl* bindGroups[DrawCall::kMaxBindGroups] = { nullptr };
+
+    uint8_t opcode = 0;
+    while (reader.ReadOpcode(opcode)) {
+        if (opcode > DrawCommand::LastDraw)
+            merger.Flush(dxDrawCall);
 
-        g_pImmediateContext->IASetPrimitiveTopology(MapPrimitiveTopology[static_cast<size_t>(call.primitiveTopology)]);
-        if (psimpl->vertexFormat != nullptr) {
+        switch (opcode) {
+        case DrawCommand::SetPrimitiveTopology: {
+            uint8_t topology = reader.Read<uint8_t>();
+            g_pImmediateContext->IASetPrimitiveTopology(MapPrimitiveTopology[topology]);
+            merger.SetTopology(static_cast<PrimitiveTopology>(topology));
+        } break;
+
+        case DrawCommand::SetVertexBuffer: {
+            UINT            slot         = reader.Read<uint8_t>();
+            DXSharedBuffer* vertexBuffer = g_sharedBuffers.Get(reader.Read<void*>());
 
-            for (size_t i = 0; i < DrawCall::kMaxVertexBuffers; ++i) {
-                DXSharedBuffer* vertexBuffer = static_cast<DXSharedBuffer*>(call.vertexBuffers[i].value);
+            if (psimpl->vertexFormat != nullptr) {
+                ID3D11Buffer* vbuffer = nullptr;
+                UINT          stride  = 0;
+                UINT          offset  = 0;
 
-                // TODO: state cache for vertex buffers
                 if (vertexBuffer != nullptr) {
-                    ID3D11Buffer* vbuffer = nullptr;
-                    if (vertexBuffer != nullptr)
-                        vbuffer = static_cast<ID3D11Buffer*>(vertexBuffer->dataBuffer);
+                    vbuffer = static_cast<ID3D11Buffer*>(vertexBuffer->dataBuffer);
+                    stride  = static_cast<UINT>(vertexBuffer->dataBufferStride);
+                }
 
-                    UINT stride = static_cast<UINT>(vertexBuffer->dataBufferStride);
+                g_pImmediateContext->IASetVertexBuffers(slot, 1, &vbuffer, &stride, &offset);
+            }
+        } break;
+
+        case DrawCommand::SetIndexBuffer: {
+            DXSharedBuffer* indexBuffer = g_sharedBuffers.Get(reader.Read<void*>());
 
-                    g_pImmediateContext->IASetVertexBuffers(static_cast<UINT>(i), 1, &vbuffer, &stride, &offset);
-                } else break;
+            if (psimpl->vertexFormat != nullptr) {
+                ID3D11Buffer* ibuffer = nullptr;
+                if (indexBuffer != nullptr)
+                    ibuffer = static_cast<ID3D11Buffer*>(indexBuffer->dataBuffer);
+                g_pImmediateContext->IASetIndexBuffer(ibuffer, DXGI_FORMAT_R32_UINT, 0); // TODO: different index format
             }
+        } break;
 
-            ID3D11Buffer* ibuffer = nullptr;
-            if (indexBuffer != nullptr)
-                ibuffer = static_cast<ID3D11Buffer*>(indexBuffer->dataBuffer);
-            g_pImmediateContext->IASetIndexBuffer(ibuffer, DXGI_FORMAT_R32_UINT, 0); // TODO: different index format
-        }
+        case DrawCommand::SetConstantBuffer: {
+            UINT          slot   = reader.Read<uint8_t>();
+            ID3D11Buffer* buffer = static_cast<ID3D11Buffer*>(reader.Read<void*>());
 
-        // constant buffers
-        psimpl->stateCache.setConstantBuffers(call.constantBuffers);
+            if (overrides == nullptr || !overrides->constantBufferMask.Test(slot))
+                psimpl->stateCache.setConstantBuffer(slot, buffer);
+        } break;
 
-        // shader resources and textures
-        psimpl->stateCache.setShaderResources(call.shaderResources);
+        case DrawCommand::SetConstants: {
+            UINT           slot = reader.Read<uint8_t>();
+            uint32_t       size = reader.Read<uint32_t>();
+            const uint8_t* data = reader.ReadBytes(size);
 
-        switch (call.type) {
-        case DrawCall::Draw:                 { g_pImmediateContext->Draw(call.count, call.startVertex); } break;
-        case DrawCall::DrawIndexed:          { g_pImmediateContext->DrawIndexed(call.count, call.startIndex, call.startVertex); } break;
-        case DrawCall::DrawInstanced:        { g_pImmediateContext->DrawInstanced(call.count, call.instanceCount, call.startVertex, call.startInstance); } break;
-        case DrawCall::DrawIndexedInstanced: { g_pImmediateContext->DrawIndexedInstanced(call.count, call.instanceCount, call.startIndex, call.startVertex, call.startInstance); } break;
+            if (overrides == nullptr || !overrides->constantBufferMask.Test(slot)) {
+                // the slot is left unbound rather than keeping the constants of an earlier draw call
+                DXConstantRange range;
+                if (!dxAllocateConstants(slot, data, size, range))
+                    g_stats.numConstantUploadFailures += 1;
 
-        case DrawCall::DrawInstancedIndirect: {
+                psimpl->stateCache.setConstantRange(slot, range);
+            }
+        } break;
 
-            DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(call.indirectArgsBuffer.value);
+        case DrawCommand::SetResource: {
+            UINT            slot   = reader.Read<uint8_t>();
+            reader.Read<uint8_t>(); // textures and buffers share the same view type
+            DXSharedBuffer* buffer = g_sharedBuffers.Get(reader.Read<void*>());
 
-            // TODO: AppendConsumeBuffer support!
-            //g_pImmediateContext->CopyStructureCount(buffer->indirectBuffer, call.indirectArgsOffset, buffer->dataUAV);
-            g_pImmediateContext->CopyResource(buffer->indirectBuffer, buffer->dataBuffer);
-            g_pImmediateContext->DrawInstancedIndirect(buffer->indirectBuffer, static_cast<UINT>(call.indirectArgsOffset));
+            if (overrides == nullptr || !overrides->shaderResourceMask.Test(slot))
+                psimpl->stateCache.setShaderResource(slot, (buffer != nullptr) ? buffer->dataView : nullptr);
         } break;
 
-        case DrawCall::DrawIndexedInstancedIndirect: {
+        case DrawCommand::SetBindGroup: {
+            uint8_t                slot  = reader.Read<uint8_t>();
+            const DXBindGroupImpl* group = static_cast<const DXBindGroupImpl*>(static_cast<const BindGroup*>(reader.Read<void*>()));
 
-            DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(call.indirectArgsBuffer.value);
+            dxSetBindGroup(psimpl, samplerStates, bindGroups[slot], group);
+            bindGroups[slot] = group;
 
-            // TODO: AppendConsumeBuffer support!
-            //g_pImmediateContext->CopyStructureCount(buffer->indirectBuffer, call.indirectArgsOffset, buffer->dataUAV);
-            g_pImmediateContext->CopyResource(buffer->indirectBuffer, buffer->dataBuffer);
-            g_pImmediateContext->DrawIndexedInstancedIndirect(buffer->indirectBuffer, static_cast<UINT>(call.indirectArgsOffset));
+            if (overrides != nullptr)
+                dxApplyOverrides(psimpl, *overrides);
         } break;
 
+        case DrawCommand::Draw:
+        case DrawCommand::DrawIndexed:
+        case DrawCommand::DrawInstanced:
+        case DrawCommand::DrawIndexedInstanced:
+        case DrawCommand::DrawInstancedIndirect:
+        case DrawCommand::DrawIndexedInstancedIndirect:
+        case DrawCommand::MultiDrawIndexedIndirect: {
+            DrawQueue::readDrawCall(reader, opcode, call);
+
+            // draws that are merged share the bindings, state commands flush the merger first
+            psimpl->stateCache.flush();
+            merger.Add(call, dxDrawCall);
+        } break;
         }
     }
 
+    merger.Flush(dxDrawCall);
+    return merger.GetNumMerged();
+}
+
+static void dxProcessDrawQueue(DrawQueue* queue)
+{
+    g_computeStateCache.clear();
+    g_boundPipeline = DXBoundPipeline();
+
+    PipelineStateImpl* psimpl = static_cast<PipelineStateImpl*>(queue->getState().value);
+
+    dxSetPipelineState(queue->getState());
+
+    psimpl->stateCache.setSamplerStates(queue->samplerStates);
+
+    bool     merge     = queue->isMergingEnabled();
+    uint32_t numMerged = dxProcessDrawCommands(psimpl, queue->samplerStates, CommandReader(queue->getCommands()), merge);
+
+    // every command stream starts from the empty state, so reset bindings between children
+    for (const DrawQueue* child : queue->getChildren()) {
+        if (child->getNumDrawCalls() != 0) {
+            psimpl->stateCache.reset();
+            psimpl->stateCache.setSamplerStates(queue->samplerStates);
+            numMerged += dxProcessDrawCommands(psimpl, queue->samplerStates, CommandReader(child->getCommands()), merge);
+        }
+    }
+
+    queue->setNumMergedDrawCalls(numMerged);
+    psimpl->stateCache.clear();
+}
+
+static void dxProcessDrawBundle(const DrawBundle* bundle)
+{
+    g_computeStateCache.clear();
+    g_boundPipeline = DXBoundPipeline();
+
+    PipelineStateImpl* psimpl = static_cast<PipelineStateImpl*>(bundle->getState().value);
+
+    dxSetPipelineState(bundle->getState());
+
+    const DrawOverrides* overrides = bundle->overrides.isEmpty() ? nullptr : &bundle->overrides;
+
+    for (size_t i = 0; i < bundle->getNumStreams(); ++i) {
+        if (i != 0)
+            psimpl->stateCache.reset();
+
+        psimpl->stateCache.setSamplerStates(bundle->samplerStates);
+
+        if (overrides != nullptr)
+            dxApplyOverrides(psimpl, *overrides);
+
+        dxProcessDrawCommands(psimpl, bundle->samplerStates, bundle->getStream(i), false, overrides);
+    }
+
     psimpl->stateCache.clear();
 }
 
+static void dxProcessSortedDrawQueues(const DrawQueueSorter& sorter)
+{
+    g_computeStateCache.clear();
+    g_boundPipeline = DXBoundPipeline();
+
+    const DrawQueue*   queue  = nullptr;
+    PipelineStateImpl* psimpl = nullptr;
+
+    for (size_t i = 0; i < sorter.GetSize(); ++i) {
+        const DrawQueueSorter::Item& item = sorter[i];
+
+        if (item.queue != queue) {
+            queue = item.queue;
+
+            PipelineStateImpl* nextState = static_cast<PipelineStateImpl*>(queue->getState().value);
+            if (nextState != psimpl) {
+                if (psimpl != nullptr)
+                    psimpl->stateCache.clear();
+
+                psimpl = nextState;
+                dxSetPipelineState(queue->getState());
+            }
+        }
+
+        // every range is delta encoded from the empty state, so reset bindings between ranges. The
+        // slots diff against what the previous range bound, bindings it shares are not bound again
+        psimpl->stateCache.reset();
+        psimpl->stateCache.setSamplerStates(queue->samplerStates);
+
+        uint32_t numMerged = dxProcessDrawCommands(psimpl, queue->samplerStates, CommandReader(item.begin, item.end), queue->isMergingEnabled());
+        queue->setNumMergedDrawCalls(queue->getNumMergedDrawCalls() + numMerged);
+    }
+
+    if (psimpl != nullptr)
+        psimpl->stateCache.clear();
+}
+
 template <typename T, typename ...Args>
 static SGFX_FORCE_INLINE T* sgfx_new(Args&&... args)
 {
@@ -647,10 +1235,20 @@ bool initD3D11(void* d3dDevice, void* d3dContext, void* d3dSwapChain)
     g_pImmediateContext = static_cast<ID3D11DeviceContext*>(d3dContext);
     g_pSwapChain        = static_cast<IDXGISwapChain*>(d3dSwapChain);
 
-#ifdef SGFX_USE_D3D11_1
+#if SGFX_USE_D3D11_1
     HRESULT hr = g_pImmediateContext->QueryInterface(&g_debugAnnotation);
     if (FAILED(hr))
         g_debugAnnotation = nullptr; // probably redundant
+
+    // the constant ring needs both offsets and no-overwrite maps of constant buffers
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+    std::memset(&options, 0, sizeof(options));
+    hr = g_pd3dDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+    if (SUCCEEDED(hr) && options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer) {
+        hr = g_pImmediateContext->QueryInterface(&g_pImmediateContext1);
+        if (FAILED(hr))
+            g_pImmediateContext1 = nullptr;
+    }
 #endif
 
     return true;
@@ -658,9 +1256,29 @@ bool initD3D11(void* d3dDevice, void* d3dContext, void* d3dSwapChain)
 
 void shutdown()
 {
-#ifdef SGFX_USE_D3D11_1
+    g_computeStateCache.clear();
+
+    if (g_constantRing.buffer != nullptr)
+        g_constantRing.buffer->Release();
+    for (ID3D11Buffer* buffer : g_constantRing.slotBuffers) {
+        if (buffer != nullptr)
+            buffer->Release();
+    }
+    g_constantRing = DXConstantRing();
+
+    g_deferredReleases.RetireAll(dxReleaseDeferred);
+
+    for (ID3D11Query* query : g_fences.queries) {
+        if (query != nullptr)
+            query->Release();
+    }
+    g_fences = DXFenceTimeline();
+
+#if SGFX_USE_D3D11_1
     if (g_debugAnnotation)
         g_debugAnnotation->Release();
+    if (g_pImmediateContext1)
+        g_pImmediateContext1->Release();
 #endif
 }
 
@@ -905,7 +1523,7 @@ void releasePixelShader(PixelShaderHandle handle)
 
 SurfaceShaderHandle linkSurfaceShader(VertexShaderHandle vs, HullShaderHandle hs, DomainShaderHandle ds, GeometryShaderHandle gs, PixelShaderHandle ps)
 {
-    SurfaceShaderImpl* impl = sgfx::sgfx_new<SurfaceShaderImpl>();
+    SurfaceShaderImpl* impl = sgfx_new<SurfaceShaderImpl>();
     impl->vs = static_cast<ID3D11VertexShader*>(vs.value);
     impl->hs = static_cast<ID3D11HullShader*>(hs.value);
     impl->ds = static_cast<ID3D11DomainShader*>(ds.value);
@@ -924,7 +1542,7 @@ void releaseSurfaceShader(SurfaceShaderHandle handle)
 
 ComputeQueueHandle createComputeQueue(ComputeShaderHandle shader)
 {
-    ComputeQueue* queue = sgfx::sgfx_new<ComputeQueue>();
+    ComputeQueue* queue = sgfx_new<ComputeQueue>();
     queue->shader = shader;
 
     return ComputeQueueHandle(queue);
@@ -985,47 +1603,30 @@ void submit(ComputeQueueHandle handle, uint32_t x, uint32_t y, uint32_t z)
         ID3D11ComputeShader*    shader  = static_cast<ID3D11ComputeShader*>(queue->shader.value);
 
         // constant buffers are ID3D11Buffers effectively
-        ID3D11Buffer* constantBuffers[ComputeQueue::kMaxConstantBuffers] = { nullptr };
-        for (size_t i = 0; i < ComputeQueue::kMaxConstantBuffers; ++i)
-            constantBuffers[i] = static_cast<ID3D11Buffer*>(queue->constantBuffers[i].value);
-
-        // TODO: add statecache here!
-        g_pImmediateContext->CSSetConstantBuffers(0, ComputeQueue::kMaxConstantBuffers, constantBuffers);
-
-        // shader resources and textures
-        ID3D11ShaderResourceView* shaderResources[ComputeQueue::kMaxShaderResources] = { nullptr };
-        for (size_t i = 0; i < ComputeQueue::kMaxShaderResources; ++i) {
-            DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(queue->shaderResources[i].value);
-            if (buffer != nullptr)
-                shaderResources[i] = buffer->dataView;
-        }
+        for (UINT i = 0; i < ComputeQueue::kMaxConstantBuffers; ++i)
+            g_computeStateCache.setConstantBuffer(i, static_cast<ID3D11Buffer*>(queue->constantBuffers[i].value));
+
+        // shader resources and textures, slots above numShaderResources are unbound
+        UINT numShaderResources = static_cast<UINT>(queue->shaderResources.GetSize());
 
-        // TODO: add statecache here!
-        g_pImmediateContext->CSSetShaderResources(0, ComputeQueue::kMaxShaderResources, shaderResources);
+        g_computeStateCache.shaderResourceViews.Reset(numShaderResources);
+        for (UINT i = 0; i < numShaderResources; ++i) {
+            DXSharedBuffer* buffer = g_sharedBuffers.Get(queue->shaderResources[i].value);
+            g_computeStateCache.setShaderResource(i, (buffer != nullptr) ? buffer->dataView : nullptr);
+        }
 
         // UAVs
-        ID3D11UnorderedAccessView* shaderUAVs[ComputeQueue::kMaxShaderResourcesRW] = { nullptr };
-        for (size_t i = 0; i < ComputeQueue::kMaxShaderResourcesRW; ++i) {
-            DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(queue->shaderResourcesRW[i].value);
-            if (buffer != nullptr)
-                shaderUAVs[i] = buffer->dataUAV;
+        for (UINT i = 0; i < ComputeQueue::kMaxShaderResourcesRW; ++i) {
+            DXSharedBuffer* buffer = g_sharedBuffers.Get(queue->shaderResourcesRW[i].value);
+            g_computeStateCache.setShaderResourceRW(i, (buffer != nullptr) ? buffer->dataUAV : nullptr);
         }
 
-        // TODO: add statecache here!
-        uint32_t shaderUAVCounters[ComputeQueue::kMaxShaderResourcesRW] = { 0 };
-        g_pImmediateContext->CSSetUnorderedAccessViews(0, ComputeQueue::kMaxShaderResourcesRW, shaderUAVs, shaderUAVCounters);
+        // only the slots that changed since the previous dispatch are bound
+        g_computeStateCache.flush();
 
         // dispatch
         g_pImmediateContext->CSSetShader(shader, nullptr, 0);
         g_pImmediateContext->Dispatch(x, y, z);
-
-        // cleanup
-        ID3D11ShaderResourceView*   clearSRVs[ComputeQueue::kMaxShaderResources]            = { nullptr };
-        g_pImmediateContext->CSSetShaderResources(0, ComputeQueue::kMaxShaderResources, clearSRVs);
-
-        ID3D11UnorderedAccessView*  clearUAVs[ComputeQueue::kMaxShaderResourcesRW]          = { nullptr };
-        uint32_t                    clearUAVCounters[ComputeQueue::kMaxShaderResourcesRW]   = { 0 };
-        g_pImmediateContext->CSSetUnorderedAccessViews(0, ComputeQueue::kMaxShaderResourcesRW, clearUAVs, clearUAVCounters);
     }
 }
 
@@ -1056,33 +1657,46 @@ VertexFormatHandle createVertexFormat(
     if (elements == nullptr || size == 0)
         return VertexFormatHandle::invalidHandle();
 
-    size_t totalSize = size * sizeof(D3D11_INPUT_ELEMENT_DESC);
-    D3D11_INPUT_ELEMENT_DESC* inputData = reinterpret_cast<D3D11_INPUT_ELEMENT_DESC*>(alloca(totalSize));
-    std::memset(inputData, 0, totalSize);
+    // input layouts are validated against the shader signature, so the bytecode is a part of the key
+    StateKey key;
+    for (size_t i = 0; i < size; ++i)
+        addStateKey(key, elements[i]);
+    key.AddBlob(shaderBytecode, shaderBytecodeSize);
+
+    VertexFormatImpl* impl = g_vertexFormats.Acquire(key, [&]() -> VertexFormatImpl* {
+        size_t totalSize = size * sizeof(D3D11_INPUT_ELEMENT_DESC);
+        D3D11_INPUT_ELEMENT_DESC* inputData = reinterpret_cast<D3D11_INPUT_ELEMENT_DESC*>(alloca(totalSize));
+        std::memset(inputData, 0, totalSize);
+
+        for (size_t i = 0; i < size; ++i) {
+            inputData[i].SemanticName         = elements[i].semanticName;
+            inputData[i].SemanticIndex        = elements[i].semanticIndex;
+            inputData[i].Format               = MapDataFormat[static_cast<size_t>(elements[i].format)];
+            inputData[i].InputSlot            = elements[i].slot;
+            inputData[i].AlignedByteOffset    = static_cast<UINT>(elements[i].offset);
+            inputData[i].InputSlotClass       = elements[i].perInstanceData ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+            inputData[i].InstanceDataStepRate = elements[i].perInstanceData ? 1 : 0;
+        }
+
+        // validate first
+        if (FAILED(g_pd3dDevice->CreateInputLayout(inputData, static_cast<UINT>(size), shaderBytecode, shaderBytecodeSize, nullptr))) {
+            if (errorReport != nullptr) errorReport("Warning: VertexFormat validation failed!");
+        }
 
-    for (size_t i = 0; i < size; ++i) {
-        inputData[i].SemanticName         = elements[i].semanticName;
-        inputData[i].SemanticIndex        = elements[i].semanticIndex;
-        inputData[i].Format               = MapDataFormat[static_cast<size_t>(elements[i].format)];
-        inputData[i].InputSlot            = elements[i].slot;
-        inputData[i].AlignedByteOffset    = static_cast<UINT>(elements[i].offset);
-        inputData[i].InputSlotClass       = elements[i].perInstanceData ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
-        inputData[i].InstanceDataStepRate = elements[i].perInstanceData ? 1 : 0;
-    }
+        ID3D11InputLayout* layout = nullptr;
+        if (FAILED(g_pd3dDevice->CreateInputLayout(inputData, static_cast<UINT>(size), shaderBytecode, shaderBytecodeSize, &layout))) {
+            if (errorReport != nullptr) errorReport("Failed to create vertex format!");
+            return nullptr;
+        }
 
-    // validate first
-    if (FAILED(g_pd3dDevice->CreateInputLayout(inputData, static_cast<UINT>(size), shaderBytecode, shaderBytecodeSize, nullptr))) {
-        if (errorReport != nullptr) errorReport("Warning: VertexFormat validation failed!");
-    }
+        VertexFormatImpl* newImpl = sgfx_new<VertexFormatImpl>();
+        newImpl->inputLayout = layout;
+        return newImpl;
+    });
 
-    ID3D11InputLayout* layout = nullptr;
-    if (FAILED(g_pd3dDevice->CreateInputLayout(inputData, static_cast<UINT>(size), shaderBytecode, shaderBytecodeSize, &layout))) {
-        if (errorReport != nullptr) errorReport("Failed to create vertex format!");
+    if (impl == nullptr)
         return VertexFormatHandle::invalidHandle();
-    }
 
-    VertexFormatImpl* impl = sgfx_new<VertexFormatImpl>();
-    impl->inputLayout = layout;
     return VertexFormatHandle(impl);
 }
 
@@ -1090,8 +1704,10 @@ void releaseVertexFormat(VertexFormatHandle handle)
 {
     if (handle != VertexFormatHandle::invalidHandle()) {
         VertexFormatImpl* impl = static_cast<VertexFormatImpl*>(handle.value);
-        impl->inputLayout->Release();
-        sgfx_delete(impl);
+        if (g_vertexFormats.Release(impl)) {
+            impl->inputLayout->Release();
+            sgfx_delete(impl);
+        }
     }
 }
 
@@ -1178,21 +1794,45 @@ PipelineStateHandle createPipelineState(const PipelineStateDescriptor& desc)
         return PipelineStateHandle::invalidHandle();
     }
 
-    PipelineStateImpl* impl = sgfx::sgfx_new<PipelineStateImpl>();
-    impl->rasterizerState   = rasterizerState;
-    impl->blendState        = blendState;
-    impl->depthStencilState = depthStencilState;
+    // the stencil reference is only used when stencil is enabled
+    UINT stencilRef = dsState.stencilEnabled ? dsState.stencilRef : 0;
+
+    StateKey key;
+    key.AddPointer(rasterizerState);
+    key.AddPointer(blendState);
+    key.AddPointer(depthStencilState);
+    key.Add(stencilRef);
+    key.AddPointer(desc.shader.value);
+    key.AddPointer(desc.vertexFormat.value);
 
-    impl->shader       = static_cast<SurfaceShaderImpl*>(desc.shader.value);
-    impl->vertexFormat = static_cast<VertexFormatImpl*>(desc.vertexFormat.value);
+    bool created = false;
+    PipelineStateImpl* impl = g_pipelineStates.Acquire(key, [&]() {
+        PipelineStateImpl* newImpl = sgfx_new<PipelineStateImpl>();
+        newImpl->rasterizerState   = rasterizerState;
+        newImpl->blendState        = blendState;
+        newImpl->depthStencilState = depthStencilState;
 
-    impl->stencilRef = dsState.stencilRef;
+        newImpl->shader       = static_cast<SurfaceShaderImpl*>(desc.shader.value);
+        newImpl->vertexFormat = static_cast<VertexFormatImpl*>(desc.vertexFormat.value);
 
-    impl->stateCache.vs = impl->shader->vs != nullptr;
-    impl->stateCache.hs = impl->shader->hs != nullptr;
-    impl->stateCache.ds = impl->shader->ds != nullptr;
-    impl->stateCache.gs = impl->shader->gs != nullptr;
-    impl->stateCache.ps = impl->shader->ps != nullptr;
+        newImpl->stencilRef = stencilRef;
+
+        newImpl->stateCache.vs = newImpl->shader->vs != nullptr;
+        newImpl->stateCache.hs = newImpl->shader->hs != nullptr;
+        newImpl->stateCache.ds = newImpl->shader->ds != nullptr;
+        newImpl->stateCache.gs = newImpl->shader->gs != nullptr;
+        newImpl->stateCache.ps = newImpl->shader->ps != nullptr;
+
+        created = true;
+        return newImpl;
+    });
+
+    // the existing pipeline holds its own references to the same native objects
+    if (!created) {
+        rasterizerState->Release();
+        blendState->Release();
+        depthStencilState->Release();
+    }
 
     return PipelineStateHandle(impl);
 }
@@ -1201,10 +1841,12 @@ void releasePipelineState(PipelineStateHandle handle)
 {
     if (handle != PipelineStateHandle::invalidHandle()) {
         PipelineStateImpl* impl = static_cast<PipelineStateImpl*>(handle.value);
-        impl->rasterizerState->Release();
-        impl->blendState->Release();
-        impl->depthStencilState->Release();
-        sgfx::sgfx_delete(impl);
+        if (g_pipelineStates.Release(impl)) {
+            impl->rasterizerState->Release();
+            impl->blendState->Release();
+            impl->depthStencilState->Release();
+            sgfx_delete(impl);
+        }
     }
 }
 
@@ -1279,46 +1921,62 @@ BufferHandle createBuffer(uint32_t flags, const void* mem, size_t size, size_t s
         return BufferHandle::invalidHandle();
     }
 
-    DXSharedBuffer* buffer = sgfx_new<DXSharedBuffer>();
+    DXSharedBuffer* buffer = nullptr;
+    void*           handle = g_sharedBuffers.Create(buffer);
+    if (handle == nullptr) { // out of handles
+        d3dbuffer->Release();
+        return BufferHandle::invalidHandle();
+    }
     buffer->dataBuffer          = d3dbuffer;
+    buffer->dataBufferSize      = size;
     buffer->dataBufferStride    = stride;
 
-    if (isIndirect)   buffer->createIndirect(stride);
+    if (isIndirect)   buffer->createIndirect(size);
     if (isStructured) buffer->createView(size / stride);
     if (isUAV)        buffer->createUAV(size / stride, isCounter, isAppend);
 
-    return BufferHandle(buffer);
+    return BufferHandle(handle);
 }
 
 void releaseBuffer(BufferHandle handle)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
-        sgfx::sgfx_delete(buffer);
-    }
+    if (!dxDeferRelease(handle.value, DeferredReleaseQueue::Type::Buffer))
+        g_sharedBuffers.Release(handle.value);
 }
 
-void* mapBuffer(BufferHandle handle, MapType type)
+bool isValid(BufferHandle handle)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    return g_sharedBuffers.IsValid(handle.value);
+}
+
+void* mapBuffer(BufferHandle handle, MapType type, size_t offset, size_t size)
+{
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr && size != 0 && offset + size <= buffer->dataBufferSize) {
 
         D3D11_MAPPED_SUBRESOURCE mappedData;
         std::memset(&mappedData, 0, sizeof(mappedData));
 
+        // D3D11 always maps the whole buffer, no overwrite needs 11.1 for buffers bound as shader resources
         if (FAILED(g_pImmediateContext->Map(buffer->dataBuffer, 0, MapMapType[static_cast<size_t>(type)], 0, &mappedData))) {
             return nullptr;
         }
 
-        return mappedData.pData;
+        return static_cast<uint8_t*>(mappedData.pData) + offset;
     }
     return nullptr;
 }
 
+void* mapBuffer(BufferHandle handle, MapType type)
+{
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    return (buffer != nullptr) ? mapBuffer(handle, type, 0, buffer->dataBufferSize) : nullptr;
+}
+
 void unmapBuffer(BufferHandle handle)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
 
         g_pImmediateContext->Unmap(buffer->dataBuffer, 0);
     }
@@ -1326,8 +1984,8 @@ void unmapBuffer(BufferHandle handle)
 
 void copyBufferData(BufferHandle handle, size_t offset, size_t size, const void* mem)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
 
         D3D11_BOX box;
         box.left   = static_cast<UINT>(offset);
@@ -1349,8 +2007,8 @@ void copyBufferData(BufferHandle handle, size_t offset, size_t size, const void*
 
 void clearBufferRW(BufferHandle handle, uint32_t value)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
 
         uint32_t d3dValues[4] = { value, 0, 0, 0 };
 
@@ -1361,8 +2019,8 @@ void clearBufferRW(BufferHandle handle, uint32_t value)
 
 void clearBufferRW(BufferHandle handle, float value)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
 
         float d3dValues[4] = { value, 0.F, 0.0F, 0.0F };
 
@@ -1409,7 +2067,11 @@ void releaseConstantBuffer(ConstantBufferHandle handle)
 {
     if (handle != ConstantBufferHandle::invalidHandle()) {
         ID3D11Buffer* buffer = static_cast<ID3D11Buffer*>(handle.value);
-        buffer->Release();
+
+        D3D11_BUFFER_DESC bufferDesc;
+        buffer->GetDesc(&bufferDesc);
+        if (!g_deferredReleases.Push(buffer, DeferredReleaseQueue::Type::ConstantBuffer, bufferDesc.ByteWidth))
+            buffer->Release();
     }
 }
 
@@ -1432,6 +2094,7 @@ SamplerStateHandle createSamplerState(const SamplerStateDescriptor& desc)
     samplerDesc.MinLOD         = desc.minLod;
     samplerDesc.MaxLOD         = desc.maxLod;
 
+    // identical descriptions return the existing sampler with one more reference
     ID3D11SamplerState* sampler = nullptr;
     if (FAILED(g_pd3dDevice->CreateSamplerState(&samplerDesc, &sampler))) {
         // TODO: error handling
@@ -1527,12 +2190,22 @@ Texture1DHandle createTexture1D(uint32_t width, DataFormat format, uint32_t numM
         }
     }
 
-    DXSharedBuffer* texture = sgfx::sgfx_new<DXSharedBuffer>();
-    texture->dataBuffer = d3dTexture;
-    texture->dataView   = d3dResourceView;
-    texture->dataUAV    = d3dUAV;
+    DXSharedBuffer* texture = nullptr;
+    void*           handle  = g_sharedBuffers.Create(texture);
+    if (handle == nullptr) { // out of handles
+        d3dTexture->Release();
+        if (d3dResourceView != nullptr)
+            d3dResourceView->Release();
+        if (d3dUAV != nullptr)
+            d3dUAV->Release();
+        return Texture1DHandle::invalidHandle();
+    }
+    texture->dataBuffer     = d3dTexture;
+    texture->dataView       = d3dResourceView;
+    texture->dataUAV        = d3dUAV;
+    texture->dataBufferSize = getTextureDataSize(format, width, 1, 1, numMipmaps);
 
-    return Texture1DHandle(texture);
+    return Texture1DHandle(handle);
 }
 
 Texture2DHandle createTexture2D(uint32_t width, uint32_t height, DataFormat format, uint32_t numMipmaps, uint32_t flags)
@@ -1638,12 +2311,22 @@ Texture2DHandle createTexture2D(uint32_t width, uint32_t height, DataFormat form
         }
     }
 
-    DXSharedBuffer* texture = sgfx::sgfx_new<DXSharedBuffer>();
-    texture->dataBuffer = d3dTexture;
-    texture->dataView   = d3dResourceView;
-    texture->dataUAV    = d3dUAV;
+    DXSharedBuffer* texture = nullptr;
+    void*           handle  = g_sharedBuffers.Create(texture);
+    if (handle == nullptr) { // out of handles
+        d3dTexture->Release();
+        if (d3dResourceView != nullptr)
+            d3dResourceView->Release();
+        if (d3dUAV != nullptr)
+            d3dUAV->Release();
+        return Texture2DHandle::invalidHandle();
+    }
+    texture->dataBuffer     = d3dTexture;
+    texture->dataView       = d3dResourceView;
+    texture->dataUAV        = d3dUAV;
+    texture->dataBufferSize = getTextureDataSize(format, width, height, 1, numMipmaps);
 
-    return Texture2DHandle(texture);
+    return Texture2DHandle(handle);
 }
 
 Texture3DHandle createTexture3D(uint32_t width, uint32_t height, uint32_t depth, DataFormat format, uint32_t numMipmaps, uint32_t flags)
@@ -1727,18 +2410,28 @@ Texture3DHandle createTexture3D(uint32_t width, uint32_t height, uint32_t depth,
         }
     }
 
-    DXSharedBuffer* texture = sgfx::sgfx_new<DXSharedBuffer>();
-    texture->dataBuffer = d3dTexture;
-    texture->dataView   = d3dResourceView;
-    texture->dataUAV    = d3dUAV;
+    DXSharedBuffer* texture = nullptr;
+    void*           handle  = g_sharedBuffers.Create(texture);
+    if (handle == nullptr) { // out of handles
+        d3dTexture->Release();
+        if (d3dResourceView != nullptr)
+            d3dResourceView->Release();
+        if (d3dUAV != nullptr)
+            d3dUAV->Release();
+        return Texture3DHandle::invalidHandle();
+    }
+    texture->dataBuffer     = d3dTexture;
+    texture->dataView       = d3dResourceView;
+    texture->dataUAV        = d3dUAV;
+    texture->dataBufferSize = getTextureDataSize(format, width, height, depth, numMipmaps);
 
-    return Texture3DHandle(texture);
+    return Texture3DHandle(handle);
 }
 
 void clearTextureRW(TextureHandle handle, uint32_t value)
 {
-    if (handle != TextureHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
 
         uint32_t d3dValues[4] = { value, 0, 0, 0 };
 
@@ -1749,8 +2442,8 @@ void clearTextureRW(TextureHandle handle, uint32_t value)
 
 void clearTextureRW(TextureHandle handle, float value)
 {
-    if (handle != TextureHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
 
         float d3dValues[4] = { value, 0.F, 0.0F, 0.0F };
 
@@ -1761,8 +2454,8 @@ void clearTextureRW(TextureHandle handle, float value)
 
 void* mapTexture(TextureHandle handle, MapType type)
 {
-    if (handle != TextureHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
 
         D3D11_MAPPED_SUBRESOURCE mappedData;
         std::memset(&mappedData, 0, sizeof(mappedData));
@@ -1778,8 +2471,8 @@ void* mapTexture(TextureHandle handle, MapType type)
 
 void unmapTexture(TextureHandle handle)
 {
-    if (handle != TextureHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
 
         g_pImmediateContext->Unmap(buffer->dataBuffer, 0);
     }
@@ -1794,8 +2487,8 @@ void updateTexture(
     size_t rowPitch, size_t depthPitch
 )
 {
-    if (handle != TextureHandle::invalidHandle()) {
-        DXSharedBuffer* texture  = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* texture  = g_sharedBuffers.Get(handle.value);
+    if (texture != nullptr) {
 
         D3D11_BOX box;
         box.left   = static_cast<UINT>(offsetX);
@@ -1811,28 +2504,31 @@ void updateTexture(
 
 void releaseTexture(TextureHandle handle)
 {
-    if (handle != TextureHandle::invalidHandle()) {
-        DXSharedBuffer* texture = static_cast<DXSharedBuffer*>(handle.value);
-        sgfx::sgfx_delete(texture);
-    }
+    if (!dxDeferRelease(handle.value, DeferredReleaseQueue::Type::Texture))
+        g_sharedBuffers.Release(handle.value);
+}
+
+bool isValid(TextureHandle handle)
+{
+    return g_sharedBuffers.IsValid(handle.value);
 }
 
 void copyResource(TextureHandle src, TextureHandle dst)
 {
-    if (src != dst && src != TextureHandle::invalidHandle()) {
-        DXSharedBuffer* dxSrc = static_cast<DXSharedBuffer*>(src.value);
-        DXSharedBuffer* dxDst = static_cast<DXSharedBuffer*>(dst.value);
+    DXSharedBuffer* dxSrc = g_sharedBuffers.Get(src.value);
+    DXSharedBuffer* dxDst = g_sharedBuffers.Get(dst.value);
 
+    if (dxSrc != dxDst && dxSrc != nullptr && dxDst != nullptr) {
         g_pImmediateContext->CopyResource(dxDst->dataBuffer, dxSrc->dataBuffer);
     }
 }
 
 void copyResource(BufferHandle src, BufferHandle dst)
 {
-    if (src != dst && src != BufferHandle::invalidHandle()) {
-        DXSharedBuffer* dxSrc = static_cast<DXSharedBuffer*>(src.value);
-        DXSharedBuffer* dxDst = static_cast<DXSharedBuffer*>(dst.value);
+    DXSharedBuffer* dxSrc = g_sharedBuffers.Get(src.value);
+    DXSharedBuffer* dxDst = g_sharedBuffers.Get(dst.value);
 
+    if (dxSrc != dxDst && dxSrc != nullptr && dxDst != nullptr) {
         g_pImmediateContext->CopyResource(dxDst->dataBuffer, dxSrc->dataBuffer);
     }
 }
@@ -1849,13 +2545,17 @@ void copyResource(ConstantBufferHandle src, ConstantBufferHandle dst)
 
 Texture2DHandle getBackBuffer()
 {
-    DXSharedBuffer* buffer = sgfx_new<DXSharedBuffer>();
+    DXSharedBuffer* buffer = nullptr;
+    void*           handle = g_sharedBuffers.Create(buffer);
+    if (handle == nullptr)
+        return Texture2DHandle::invalidHandle(); // out of handles
     if (FAILED(g_pSwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (LPVOID*)&buffer->dataBuffer))) {
         // TODO: error handling
+        g_sharedBuffers.Release(handle);
         return Texture2DHandle::invalidHandle();
     }
 
-    return Texture2DHandle(buffer);
+    return Texture2DHandle(handle);
 }
 
 RenderTargetHandle createRenderTarget(const RenderTargetDescriptor& desc)
@@ -1865,7 +2565,7 @@ RenderTargetHandle createRenderTarget(const RenderTargetDescriptor& desc)
     impl->numRenderTargets = desc.numColorTextures;
 
     for (uint32_t i = 0; i < desc.numColorTextures; ++i) {
-        DXSharedBuffer* textureResource = static_cast<DXSharedBuffer*>(desc.colorTextures[i].value);
+        DXSharedBuffer* textureResource = g_sharedBuffers.Get(desc.colorTextures[i].value);
 
         D3D11_RENDER_TARGET_VIEW_DESC rtDesc;
         std::memset(&rtDesc, 0, sizeof(rtDesc));
@@ -1875,7 +2575,7 @@ RenderTargetHandle createRenderTarget(const RenderTargetDescriptor& desc)
         rtDesc.Texture2D.MipSlice = 0;
 
         ID3D11RenderTargetView* renderTargetView = nullptr;
-        if (FAILED(g_pd3dDevice->CreateRenderTargetView(textureResource->dataBuffer, &rtDesc, &renderTargetView))) {
+        if (textureResource == nullptr || FAILED(g_pd3dDevice->CreateRenderTargetView(textureResource->dataBuffer, &rtDesc, &renderTargetView))) {
             // TODO: error handling
             sgfx_delete(impl);
             return RenderTargetHandle::invalidHandle();
@@ -1884,7 +2584,7 @@ RenderTargetHandle createRenderTarget(const RenderTargetDescriptor& desc)
         impl->renderTargetViews[i] = renderTargetView;
     }
 
-    DXSharedBuffer* depthStencilResource = static_cast<DXSharedBuffer*>(desc.depthStencilTexture.value);
+    DXSharedBuffer* depthStencilResource = g_sharedBuffers.Get(desc.depthStencilTexture.value);
 
     if (depthStencilResource != nullptr) {
         D3D11_DEPTH_STENCIL_VIEW_DESC dsDesc;
@@ -1946,11 +2646,9 @@ void setResourceRW(RenderTargetHandle handle, uint32_t idx, BufferHandle resourc
         RenderTargetImpl* rtimpl = static_cast<RenderTargetImpl*>(handle.value);
 
         ID3D11UnorderedAccessView* uav = nullptr;
-        if (resource != BufferHandle::invalidHandle()) {
-            DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(resource.value);
-
+        DXSharedBuffer* buffer = g_sharedBuffers.Get(resource.value);
+        if (buffer != nullptr)
             uav = buffer->dataUAV;
-        }
 
         rtimpl->unorderedAccessViews[idx] = uav;
     }
@@ -1962,11 +2660,9 @@ void setResourceRW(RenderTargetHandle handle, uint32_t idx, TextureHandle resour
         RenderTargetImpl* rtimpl = static_cast<RenderTargetImpl*>(handle.value);
 
         ID3D11UnorderedAccessView* uav = nullptr;
-        if (resource != TextureHandle::invalidHandle()) {
-            DXSharedBuffer* texture = static_cast<DXSharedBuffer*>(resource.value);
-
+        DXSharedBuffer* texture = g_sharedBuffers.Get(resource.value);
+        if (texture != nullptr)
             uav = texture->dataUAV;
-        }
 
         rtimpl->unorderedAccessViews[idx] = uav;
     }
@@ -2038,16 +2734,65 @@ void clearDepthStencil(RenderTargetHandle handle, float depth, uint8_t stencil)
     }
 }
 
+void endFrame()
+{
+    g_computeStateCache.clear();
+    g_frameArena.Reset();
+
+    dxUpdateCompletedFrames();
+    g_fences.frameFences[g_fences.frameIndex % DXFenceTimeline::kMaxPendingFences] = dxInsertFence();
+    g_fences.frameIndex++;
+
+    g_deferredReleases.Retire(g_fences.frameIndex - 1, g_fences.completedFrame, dxReleaseDeferred);
+}
+
+void setDeferredRelease(bool enabled)
+{
+    g_deferredReleases.SetEnabled(enabled);
+}
+
+DeferredReleaseStats getDeferredReleaseStats()
+{
+    return g_deferredReleases.GetStats();
+}
+
+FenceHandle insertFence()
+{
+    return FenceHandle(reinterpret_cast<void*>(static_cast<uintptr_t>(dxInsertFence())));
+}
+
+bool isFenceSignaled(FenceHandle fence)
+{
+    return dxWaitForFence(reinterpret_cast<uintptr_t>(fence.value), 0);
+}
+
+bool waitFence(FenceHandle fence, uint64_t timeout)
+{
+    return dxWaitForFence(reinterpret_cast<uintptr_t>(fence.value), timeout);
+}
+
+uint64_t getFrameIndex()
+{
+    return g_fences.frameIndex;
+}
+
+uint64_t getCompletedFrameIndex()
+{
+    dxUpdateCompletedFrames();
+    return g_fences.completedFrame;
+}
+
 void present(uint32_t swapInterval)
 {
     g_pSwapChain->Present(swapInterval, 0);
+    endFrame();
 }
 
 // draw queue stuff is similar for all APIs
 
 DrawQueueHandle createDrawQueue(PipelineStateHandle state)
 {
-    DrawQueue* queue = sgfx_new<DrawQueue>(state);
+    DrawQueue* queue = sgfx_new<DrawQueue>(&g_frameArena, state);
     return DrawQueueHandle(queue);
 }
 
@@ -2059,6 +2804,15 @@ void releaseDrawQueue(DrawQueueHandle handle)
     }
 }
 
+DrawQueueHandle createChildDrawQueue(DrawQueueHandle parent)
+{
+    if (parent != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = sgfx_new<DrawQueue>(static_cast<DrawQueue*>(parent.value));
+        return DrawQueueHandle(queue);
+    }
+    return DrawQueueHandle::invalidHandle();
+}
+
 void setSamplerState(DrawQueueHandle handle, uint32_t idx, SamplerStateHandle sampler)
 {
     if (handle != DrawQueueHandle::invalidHandle()) {
@@ -2099,6 +2853,14 @@ void setConstantBuffer(DrawQueueHandle handle, uint32_t idx, ConstantBufferHandl
     }
 }
 
+void setConstants(DrawQueueHandle handle, uint32_t idx, const void* data, size_t size)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setConstants(idx, data, size);
+    }
+}
+
 void setResource(DrawQueueHandle handle, uint32_t idx, BufferHandle resource)
 {
     if (handle != DrawQueueHandle::invalidHandle()) {
@@ -2115,6 +2877,47 @@ void setResource(DrawQueueHandle handle, uint32_t idx, TextureHandle resource)
     }
 }
 
+BindGroupHandle createBindGroup(const BindGroupDescriptor& desc)
+{
+    if (!BindGroup::IsValid(desc))
+        return BindGroupHandle::invalidHandle(); // TODO: error handling
+
+    DXBindGroupImpl* impl = sgfx_new<DXBindGroupImpl>(desc);
+
+    for (uint32_t i = 0; i < desc.numConstantBuffers; ++i)
+        impl->constantBuffers[i] = static_cast<ID3D11Buffer*>(desc.constantBuffers[i].value);
+
+    // textures and buffers share the same view type
+    for (uint32_t i = 0; i < desc.numShaderResources; ++i) {
+        DXSharedBuffer* buffer = g_sharedBuffers.Get(desc.buffers[i].value);
+        if (buffer == nullptr)
+            buffer = g_sharedBuffers.Get(desc.textures[i].value);
+
+        impl->shaderResourceViews[i] = (buffer != nullptr) ? buffer->dataView : nullptr;
+    }
+
+    for (uint32_t i = 0; i < desc.numSamplerStates; ++i)
+        impl->samplerStates[i] = static_cast<ID3D11SamplerState*>(desc.samplerStates[i].value);
+
+    return BindGroupHandle(static_cast<BindGroup*>(impl));
+}
+
+void releaseBindGroup(BindGroupHandle handle)
+{
+    if (handle != BindGroupHandle::invalidHandle()) {
+        DXBindGroupImpl* impl = static_cast<DXBindGroupImpl*>(static_cast<BindGroup*>(handle.value));
+        sgfx_delete(impl);
+    }
+}
+
+void setBindGroup(DrawQueueHandle handle, uint32_t idx, BindGroupHandle group)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setBindGroup(idx, group);
+    }
+}
+
 void draw(DrawQueueHandle handle, uint32_t count, uint32_t startVertex)
 {
     if (handle != DrawQueueHandle::invalidHandle()) {
@@ -2163,17 +2966,136 @@ void drawIndexedInstancedIndirect(DrawQueueHandle handle, BufferHandle indirectA
     }
 }
 
+void multiDrawIndexedIndirect(
+    DrawQueueHandle handle,
+    BufferHandle indirectArgs, size_t argsOffset, uint32_t maxDraws,
+    BufferHandle countBuffer,  size_t countOffset,
+    uint32_t stride
+)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->multiDrawIndexedIndirect(indirectArgs, argsOffset, maxDraws, countBuffer, countOffset, stride);
+    }
+}
+
 void submit(DrawQueueHandle handle)
 {
     if (handle != DrawQueueHandle::invalidHandle()) {
         DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
-        if (queue->getDrawCalls().GetSize() != 0) {
+        queue->setNumMergedDrawCalls(0);
+        if (!queue->isEmpty()) {
             dxProcessDrawQueue(queue);
             queue->clear();
         }
     }
 }
 
+void setSortKey(DrawQueueHandle handle, uint64_t key)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setSortKey(key);
+    }
+}
+
+void submit(const DrawQueueHandle* queues, size_t count)
+{
+    g_drawQueueSorter.Clear();
+
+    for (size_t i = 0; i < count; ++i) {
+        DrawQueueHandle handle = queues[i];
+        if (handle != DrawQueueHandle::invalidHandle()) {
+            DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+            queue->setNumMergedDrawCalls(0);
+            g_drawQueueSorter.Add(queue);
+        }
+    }
+
+    if (!g_drawQueueSorter.IsEmpty()) {
+        g_drawQueueSorter.Sort();
+        dxProcessSortedDrawQueues(g_drawQueueSorter);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        DrawQueueHandle handle = queues[i];
+        if (handle != DrawQueueHandle::invalidHandle())
+            static_cast<DrawQueue*>(handle.value)->clear();
+    }
+}
+
+void setDrawMerging(DrawQueueHandle handle, bool enabled)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setMergingEnabled(enabled);
+    }
+}
+
+uint32_t getNumMergedDrawCalls(DrawQueueHandle handle)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        return queue->getNumMergedDrawCalls();
+    }
+    return 0;
+}
+
+DrawBundleHandle createDrawBundle(DrawQueueHandle handle)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        if (queue->getState() == PipelineStateHandle::invalidHandle() || queue->isEmpty())
+            return DrawBundleHandle::invalidHandle(); // TODO: error handling
+
+        DrawBundle* bundle = sgfx_new<DrawBundle>(queue);
+        queue->clear();
+
+        return DrawBundleHandle(bundle);
+    }
+    return DrawBundleHandle::invalidHandle();
+}
+
+void releaseDrawBundle(DrawBundleHandle handle)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        sgfx_delete(bundle);
+    }
+}
+
+void setConstantBuffer(DrawBundleHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        bundle->overrides.setConstantBuffer(idx, buffer);
+    }
+}
+
+void setResource(DrawBundleHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        bundle->overrides.setResource(idx, false, resource.value);
+    }
+}
+
+void setResource(DrawBundleHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        bundle->overrides.setResource(idx, true, resource.value);
+    }
+}
+
+void submitBundle(DrawBundleHandle handle)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        dxProcessDrawBundle(bundle);
+    }
+}
+
 void flush()
 {
     g_pImmediateContext->Flush();
@@ -2181,7 +3103,7 @@ void flush()
 
 void beginPerfEvent(const wchar_t* name)
 {
-#ifdef SGFX_USE_D3D11_1
+#if SGFX_USE_D3D11_1
     if (g_debugAnnotation)
         g_debugAnnotation->BeginEvent(name);
 #endif
@@ -2189,16 +3111,41 @@ void beginPerfEvent(const wchar_t* name)
 
 void endPerfEvent()
 {
-#ifdef SGFX_USE_D3D11_1
+#if SGFX_USE_D3D11_1
     if (g_debugAnnotation)
         g_debugAnnotation->EndEvent();
 #endif
 }
 
-// D3D11 interop
+}
+
+// D3D11 backend statistics, not part of the wrapped API
+namespace sgfx
+{
 namespace d3d11
 {
 
+const Stats& getStats()
+{
+    return SGFX_BACKEND_NS::g_stats;
+}
+
+void resetStats()
+{
+    SGFX_BACKEND_NS::g_stats = Stats();
+}
+
+}
+}
+
+// D3D11 interop, not part of the wrapped API
+namespace sgfx
+{
+namespace d3d11
+{
+
+using namespace SGFX_BACKEND_NS;
+
 ID3D11Buffer* getNativeBuffer(ConstantBufferHandle handle)
 {
     return static_cast<ID3D11Buffer*>(handle.value);
@@ -2206,8 +3153,8 @@ ID3D11Buffer* getNativeBuffer(ConstantBufferHandle handle)
 
 ID3D11Resource* getNativeResource(BufferHandle handle)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
         return buffer->dataBuffer;
     }
     return nullptr;
@@ -2215,8 +3162,8 @@ ID3D11Resource* getNativeResource(BufferHandle handle)
 
 ID3D11ShaderResourceView* getNativeSRV(BufferHandle handle)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
         return buffer->dataView;
     }
     return nullptr;
@@ -2224,8 +3171,8 @@ ID3D11ShaderResourceView* getNativeSRV(BufferHandle handle)
 
 ID3D11UnorderedAccessView* getNativeUAV(BufferHandle handle)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
         return buffer->dataUAV;
     }
     return nullptr;
@@ -2233,8 +3180,8 @@ ID3D11UnorderedAccessView* getNativeUAV(BufferHandle handle)
 
 ID3D11Resource* getNativeResource(TextureHandle handle)
 {
-    if (handle != TextureHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
         return buffer->dataBuffer;
     }
     return nullptr;
@@ -2242,8 +3189,8 @@ ID3D11Resource* getNativeResource(TextureHandle handle)
 
 ID3D11ShaderResourceView* getNativeSRV(TextureHandle handle)
 {
-    if (handle != TextureHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
         return buffer->dataView;
     }
     return nullptr;
@@ -2251,8 +3198,8 @@ ID3D11ShaderResourceView* getNativeSRV(TextureHandle handle)
 
 ID3D11UnorderedAccessView* getNativeUAV(TextureHandle handle)
 {
-    if (handle != TextureHandle::invalidHandle()) {
-        DXSharedBuffer* buffer = static_cast<DXSharedBuffer*>(handle.value);
+    DXSharedBuffer* buffer = g_sharedBuffers.Get(handle.value);
+    if (buffer != nullptr) {
         return buffer->dataUAV;
     }
     return nullptr;
@@ -29,6 +29,7 @@
 #pragma comment(lib, "d3dcompiler.lib")
 
 #include <memory>
+#include <atomic>
 #include <cstdlib>
 
 namespace sgfx
@@ -245,13 +246,22 @@ static inline void sgfx_delete(T* t)
 }
 
 //=============================================================================
+// lock-free, descriptors may be allocated and freed from any thread
+// the free list links are indices kept outside of the heap, the head is tagged against ABA
 struct DXDescriptorAllocator final
 {
+    enum : uint32_t
+    {
+        kEndOfList = 0xFFFFFFFF
+    };
+
     ID3D12DescriptorHeap*   d3dHeap   = nullptr;
     size_t                  stride    = 0;
     size_t                  poolSize  = 0;
+    size_t                  heapStart = 0;
 
-    void**                  freeList  = nullptr;
+    std::unique_ptr<std::atomic<uint32_t>[]> links;
+    std::atomic<uint64_t>                    freeList { kEndOfList };
 
     inline void init(ID3D12DescriptorHeap* heap, size_t hstride, size_t hpoolSize)
     {
@@ -260,35 +270,41 @@ struct DXDescriptorAllocator final
         poolSize = hpoolSize;
 
         D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = d3dHeap->GetCPUDescriptorHandleForHeapStart();
+        heapStart = cpuHandle.ptr;
 
-        freeList = reinterpret_cast<void**>(cpuHandle.ptr);
+        links.reset(new std::atomic<uint32_t>[poolSize]);
+        for (size_t i = 0; i < poolSize; ++i)
+            links[i].store(i + 1 < poolSize ? static_cast<uint32_t>(i + 1) : kEndOfList, std::memory_order_relaxed);
 
-        void** ptr = freeList;
-        for (size_t i = 0; i < poolSize - 1; ++i) {
-            size_t address = reinterpret_cast<size_t>(ptr);
-            *ptr           = reinterpret_cast<void*>(address + stride);
-            ptr            = reinterpret_cast<void**>(*ptr);
-        }
-        *ptr = nullptr;
+        freeList.store(poolSize > 0 ? 0 : kEndOfList, std::memory_order_release);
     }
 
     D3D12_CPU_DESCRIPTOR_HANDLE allocateDescriptor()
     {
-        if (freeList == nullptr)
-            return { 0 };
-
-        void* ptr = freeList;
-        freeList  = reinterpret_cast<void**>(*freeList);
-
-        return { reinterpret_cast<size_t>(ptr) };
+        uint64_t head = freeList.load(std::memory_order_acquire);
+        for (;;) {
+            uint32_t index = static_cast<uint32_t>(head);
+            if (index == kEndOfList)
+                return { 0 };
+
+            uint64_t next = ((head >> 32) + 1) << 32 | links[index].load(std::memory_order_relaxed);
+            if (freeList.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+                return { heapStart + index * stride };
+        }
     }
 
     void freeDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE handle)
     {
-        void* ptr = reinterpret_cast<void*>(handle.ptr);
+        uint32_t index = static_cast<uint32_t>((handle.ptr - heapStart) / stride);
 
-        *(reinterpret_cast<void**>(ptr)) = freeList;
-        freeList = reinterpret_cast<void**>(ptr);
+        uint64_t head = freeList.load(std::memory_order_relaxed);
+        for (;;) {
+            links[index].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+
+            uint64_t next = ((head >> 32) + 1) << 32 | index;
+            if (freeList.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed))
+                return;
+        }
     }
 };
 
@@ -370,16 +386,16 @@ struct DXSharedBuffer final
             dataBuffer->Release();
     }
 
-    inline void* map(MapType type)
+    inline void* map(MapType type, size_t offset, size_t size)
     {
         mappedType  = type;
-        mappedRange = { 0, dataSize };
+        mappedRange = { offset, offset + size };
 
         void* data = nullptr;
         HRESULT hr = dataBuffer->Map(0, &mappedRange, &data);
         if (SUCCEEDED(hr)) {
             mapped = true;
-            return data;
+            return static_cast<uint8_t*>(data) + offset;
         }
 
         return nullptr;
@@ -389,7 +405,7 @@ struct DXSharedBuffer final
     {
         if (mapped) {
             mapped = false;
-            if (mappedType == MapType::Write)
+            if (mappedType != MapType::Read)
                 dataBuffer->Unmap(0, &mappedRange);
             else
                 dataBuffer->Unmap(0, nullptr);
@@ -1090,7 +1106,18 @@ void* mapBuffer(BufferHandle handle, MapType type)
 {
     if (handle != BufferHandle::invalidHandle()) {
         DXSharedBuffer* impl = static_cast<DXSharedBuffer*>(handle.value);
-        return impl->map(type);
+        return impl->map(type, 0, impl->dataSize);
+    }
+
+    return nullptr;
+}
+
+void* mapBuffer(BufferHandle handle, MapType type, size_t offset, size_t size)
+{
+    if (handle != BufferHandle::invalidHandle()) {
+        DXSharedBuffer* impl = static_cast<DXSharedBuffer*>(handle.value);
+        if (offset + size <= impl->dataSize)
+            return impl->map(type, offset, size);
     }
 
     return nullptr;
@@ -21,14 +21,22 @@
 /// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 /// THE SOFTWARE.
 #include "GL/glew.h"
+#include <cstring>
 #include <memory>
+#include <thread>
 
+#ifdef _MSC_VER
 #pragma comment(lib, "opengl32.lib")
+#endif
 
 #ifndef SGFX_NS_INTERNAL
 #define SGFX_NS_INTERNAL sgfx_ns_opengl_internal
 #endif
 
+#ifndef SGFX_BACKEND_NS
+#define SGFX_BACKEND_NS sgfx // capture builds move the backend aside and wrap it
+#endif
+
 #ifndef SGFX_INTERNAL_IMPLEMENTATION
 #define SGFX_INTERNAL_IMPLEMENTATION 1
 #endif // !SGFX_INTERNAL_IMPLEMENTATION
@@ -39,15 +47,17 @@
 #   endif
 #else
 #   ifndef SGFX_FORCE_INLINE
-#   define SGFX_FORCE_INLINE __attribute__((always_inline))
+#   define SGFX_FORCE_INLINE inline __attribute__((always_inline))
 #   endif
 #endif
 
 #include "sigrlinn.hh"
+#include <stdlib.h>
 
-namespace sgfx
+namespace SGFX_BACKEND_NS
 {
 
+using namespace sgfx;
 using namespace SGFX_NS_INTERNAL;
 
 struct GLTexFilter final
@@ -60,20 +70,21 @@ struct GLTexFilter final
     {}
 };
 
-static GLenum MapMapType[MapType::Count] = {
-    GL_READ_ONLY,
-    GL_WRITE_ONLY
+static GLbitfield MapMapType[static_cast<size_t>(MapType::Count)] = {
+    GL_MAP_READ_BIT,
+    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT,
+    GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT
 };
-static_assert((sizeof(MapMapType) / sizeof(GLenum)) == static_cast<uint32_t>(MapType::Count), "Mapping is broken!");
+static_assert((sizeof(MapMapType) / sizeof(GLbitfield)) == static_cast<uint32_t>(MapType::Count), "Mapping is broken!");
 
-static GLenum MapPrimitiveTopology[PrimitiveTopology::Count] = {
+static GLenum MapPrimitiveTopology[static_cast<size_t>(PrimitiveTopology::Count)] = {
     GL_TRIANGLES,
     GL_TRIANGLE_STRIP,
     GL_POINTS
 };
 static_assert((sizeof(MapPrimitiveTopology) / sizeof(GLenum)) == static_cast<size_t>(PrimitiveTopology::Count), "Mapping is broken!");
 
-static GLTexFilter MapTextureFilter[TextureFilter::Count] = {
+static GLTexFilter MapTextureFilter[static_cast<size_t>(TextureFilter::Count)] = {
     GLTexFilter(GL_NEAREST, GL_NEAREST_MIPMAP_NEAREST),
     GLTexFilter(GL_NEAREST, GL_NEAREST_MIPMAP_LINEAR),
     GLTexFilter(GL_NEAREST, GL_LINEAR_MIPMAP_NEAREST),
@@ -86,7 +97,7 @@ static GLTexFilter MapTextureFilter[TextureFilter::Count] = {
 };
 static_assert((sizeof(MapTextureFilter) / sizeof(GLTexFilter)) == static_cast<size_t>(TextureFilter::Count), "Mapping is broken!");
 
-static GLenum MapAddressMode[AddressMode::Count] = {
+static GLenum MapAddressMode[static_cast<size_t>(AddressMode::Count)] = {
     GL_REPEAT,
     GL_MIRRORED_REPEAT,
     GL_CLAMP_TO_EDGE,
@@ -94,7 +105,7 @@ static GLenum MapAddressMode[AddressMode::Count] = {
 };
 static_assert((sizeof(MapAddressMode) / sizeof(GLenum)) == static_cast<size_t>(AddressMode::Count), "Mapping is broken!");
 
-static GLenum MapDataFormat[DataFormat::Count] = {
+static GLenum MapDataFormat[static_cast<size_t>(DataFormat::Count)] = {
     GL_COMPRESSED_RGB_S3TC_DXT1_EXT,         // DXT1
     GL_COMPRESSED_RGBA_S3TC_DXT3_EXT,        // DXT3
     GL_COMPRESSED_RGBA_S3TC_DXT5_EXT,        // DXT5
@@ -147,25 +158,25 @@ static GLenum MapDataFormat[DataFormat::Count] = {
 };
 static_assert((sizeof(MapDataFormat) / sizeof(GLenum)) == static_cast<size_t>(DataFormat::Count), "Mapping is broken!");
 
-static GLenum MapFillMode[FillMode::Count] = {
+static GLenum MapFillMode[static_cast<size_t>(FillMode::Count)] = {
     GL_FILL,
     GL_LINE
 };
 static_assert((sizeof(MapFillMode) / sizeof(GLenum)) == static_cast<size_t>(FillMode::Count), "Mapping is broken!");
 
-static GLenum MapCullMode[CullMode::Count] = {
+static GLenum MapCullMode[static_cast<size_t>(CullMode::Count)] = {
     GL_BACK,
     GL_FRONT
 };
 static_assert((sizeof(MapCullMode) / sizeof(GLenum)) == static_cast<size_t>(CullMode::Count), "Mapping is broken!");
 
-static GLenum MapCounterDirection[CounterDirection::Count] = {
+static GLenum MapCounterDirection[static_cast<size_t>(CounterDirection::Count)] = {
     GL_CW,
     GL_CCW
 };
 static_assert((sizeof(MapCounterDirection) / sizeof(GLenum)) == static_cast<size_t>(CounterDirection::Count), "Mapping is broken!");
 
-static GLenum MapBlendFactor[BlendFactor::Count] = {
+static GLenum MapBlendFactor[static_cast<size_t>(BlendFactor::Count)] = {
     GL_ZERO,
     GL_ONE,
     GL_SRC_ALPHA,
@@ -179,22 +190,22 @@ static GLenum MapBlendFactor[BlendFactor::Count] = {
 };
 static_assert((sizeof(MapBlendFactor) / sizeof(GLenum)) == static_cast<size_t>(BlendFactor::Count), "Mapping is broken!");
 
-static GLenum MapBlendOp[BlendOp::Count] = {
-    GL_ADD,
-    GL_SUBTRACT,
+static GLenum MapBlendOp[static_cast<size_t>(BlendOp::Count)] = {
+    GL_FUNC_ADD,
+    GL_FUNC_SUBTRACT,
     GL_FUNC_REVERSE_SUBTRACT,
     GL_MIN,
     GL_MAX
 };
 static_assert((sizeof(MapBlendOp) / sizeof(GLenum)) == static_cast<size_t>(BlendOp::Count), "Mapping is broken!");
 
-static GLboolean MapDepthWriteMask[DepthWriteMask::Count] = {
+static GLboolean MapDepthWriteMask[static_cast<size_t>(DepthWriteMask::Count)] = {
     GL_FALSE,
     GL_TRUE
 };
 static_assert((sizeof(MapBlendOp) / sizeof(GLenum)) == static_cast<size_t>(BlendOp::Count), "Mapping is broken!");
 
-static GLenum MapComparisonFunc[ComparisonFunc::Count] = {
+static GLenum MapComparisonFunc[static_cast<size_t>(ComparisonFunc::Count)] = {
     GL_ALWAYS,
     GL_NEVER,
     GL_LESS,
@@ -206,7 +217,7 @@ static GLenum MapComparisonFunc[ComparisonFunc::Count] = {
 };
 static_assert((sizeof(MapComparisonFunc) / sizeof(GLenum)) == static_cast<size_t>(ComparisonFunc::Count), "Mapping is broken!");
 
-static GLenum MapStencilOp[StencilOp::Count] = {
+static GLenum MapStencilOp[static_cast<size_t>(StencilOp::Count)] = {
     GL_KEEP,
     GL_ZERO,
     GL_REPLACE,
@@ -217,7 +228,7 @@ static_assert((sizeof(MapStencilOp) / sizeof(GLenum)) == static_cast<size_t>(Ste
 
 //-------------------------------------------------------------------------------------------------
 
-struct GLSamplerStateImpl final
+struct GLSamplerStateImpl final : public StateObject
 {
     GLuint samplerID = 0;
 
@@ -233,22 +244,87 @@ struct GLShaderImpl final
     SGFX_FORCE_INLINE ~GLShaderImpl() { glDeleteShader(shaderID); }
 };
 
+// compute shaders are linked into their own program
+struct GLComputeShaderImpl final
+{
+    GLuint programID = 0;
+
+    SGFX_FORCE_INLINE GLComputeShaderImpl(GLuint program) : programID(program) {}
+    SGFX_FORCE_INLINE ~GLComputeShaderImpl() { glDeleteProgram(programID); }
+};
+
+// frames in flight, endFrame fences the commands of every frame. Memory written by the CPU for a
+// frame (streaming buffers, the constant ring) is reused once the GPU completed that frame
+struct GLFrameFences final
+{
+    enum
+    {
+        kMaxFramesInFlight = 3
+    };
+
+    uint64_t frameIndex     = 1; // frame being recorded
+    uint64_t completedFrame = 0; // the GPU is done with this frame and the ones before it
+    GLsync   fences[kMaxFramesInFlight] = { nullptr }; // of the fenced frames after completedFrame
+};
+
+// fences inserted by the application (see insertFence), a fence value selects its sync object
+struct GLFenceTimeline final
+{
+    enum { kMaxPendingFences = 64 };
+
+    uint64_t nextValue      = 1;
+    uint64_t completedValue = 0;
+    GLsync   fences[kMaxPendingFences] = { nullptr };
+};
+
+// persistently mapped copy of a streaming buffer
+struct GLStreamingRegion final
+{
+    GLuint   bufferID = 0;
+    uint8_t* data     = nullptr;
+    uint64_t frame    = 0; // the last frame that could read the copy
+};
+
 struct GLBufferImpl final
 {
     GLuint bufferID = 0;
 
+    GLuint counterID = 0; // atomic counter of GPUCounter and GPUAppend buffers
+
     bool isImmutable  = false;
     bool isStructured = false;
     bool isConstant   = false;
+    bool hasCounter   = false;
+    bool isStreaming  = false;
 
     size_t dataSize   = 0;
     size_t dataStride = 0;
 
-    SGFX_FORCE_INLINE GLBufferImpl()  { glGenBuffers(1, &bufferID); }
-    SGFX_FORCE_INLINE ~GLBufferImpl() { glDeleteBuffers(1, &bufferID); }
+    uint32_t writeEpoch = 0; // g_writeEpoch of the last dispatch that wrote the buffer
+
+    // streaming buffers (CPU writes only) have a copy per frame in flight, bufferID is the current
+    // one and every write map moves to the next copy (see mapBuffer)
+    GLStreamingRegion* regions = nullptr;
+    uint32_t           region  = 0;
+
+    // the names are generated by GL_createBufferStorage, zero while the creation is deferred
+    SGFX_FORCE_INLINE ~GLBufferImpl()
+    {
+        if (regions != nullptr) {
+            for (uint32_t i = 0; i < GLFrameFences::kMaxFramesInFlight; ++i) {
+                if (regions[i].bufferID != 0)
+                    glDeleteBuffers(1, &regions[i].bufferID);
+            }
+            delete [] regions;
+        } else if (bufferID != 0) {
+            glDeleteBuffers(1, &bufferID);
+        }
+
+        if (counterID != 0) glDeleteBuffers(1, &counterID);
+    }
 };
 
-struct GLVertexFormatImpl final // VF is a VAO with bound attribs
+struct GLVertexFormatImpl final : public StateObject // VF is a VAO with bound attribs
 {
     GLuint vaoID = 0;
 
@@ -256,6 +332,38 @@ struct GLVertexFormatImpl final // VF is a VAO with bound attribs
     SGFX_FORCE_INLINE ~GLVertexFormatImpl() { glDeleteVertexArrays(1, &vaoID); }
 };
 
+// pipeline sub-states are interned separately, pipelines that differ in one of them share the others
+struct GLRasterizerStateImpl final : public StateObject
+{
+    RasterizerState desc;
+};
+
+struct GLBlendStateImpl final : public StateObject
+{
+    BlendState desc;
+};
+
+struct GLDepthStencilStateImpl final : public StateObject
+{
+    DepthStencilState desc;
+};
+
+struct GLPipelineStateImpl final : public StateObject
+{
+    GLRasterizerStateImpl*   rasterizerState   = nullptr;
+    GLBlendStateImpl*        blendState        = nullptr;
+    GLDepthStencilStateImpl* depthStencilState = nullptr;
+    GLVertexFormatImpl*      vertexFormat      = nullptr;
+};
+
+// identical descriptors share one object
+static StateCache<GLSamplerStateImpl>      g_samplerStates;
+static StateCache<GLVertexFormatImpl>      g_vertexFormats;
+static StateCache<GLRasterizerStateImpl>   g_rasterizerStates;
+static StateCache<GLBlendStateImpl>        g_blendStates;
+static StateCache<GLDepthStencilStateImpl> g_depthStencilStates;
+static StateCache<GLPipelineStateImpl>     g_pipelineStates;
+
 struct GLTextureImpl final
 {
     GLuint textureID = 0;
@@ -264,10 +372,107 @@ struct GLTextureImpl final
     GLenum   glInternalFormat = 0;
     GLenum   glType           = 0;
 
-    SGFX_FORCE_INLINE GLTextureImpl()  { glGenTextures(1, &textureID); }
-    SGFX_FORCE_INLINE ~GLTextureImpl() { glDeleteTextures(1, &textureID); }
+    uint32_t writeEpoch       = 0; // g_writeEpoch of the last dispatch that wrote the texture
+    size_t   dataSize         = 0; // estimated, for the deferred release stats
+
+    // the name is generated by GL_createTextureStorage, zero while the creation is deferred
+    SGFX_FORCE_INLINE ~GLTextureImpl() { if (textureID != 0) glDeleteTextures(1, &textureID); }
+};
+
+// buffers and textures, translation loops resolve them from packed pages
+static HandlePool<GLBufferImpl>  g_buffers;
+static HandlePool<GLTextureImpl> g_textures;
+
+// buffers and textures may be created and released from any thread, GL calls are only made on the
+// thread that called initOpenGL, other threads queue them and the context thread runs the queue
+// before it submits or maps anything
+struct GLPendingTask final
+{
+    enum class Type : uint32_t
+    {
+        CreateBuffer,
+        CreateTexture,
+        DeleteBuffer,
+        DeleteTexture
+    };
+
+    Type     type       = Type::CreateBuffer;
+    void*    handle     = nullptr; // create
+    GLuint   name       = 0;       // delete
+    GLuint   counterName = 0;      // delete, GPUCounter and GPUAppend buffers
+
+    uint8_t* data       = nullptr; // copy of the initial buffer data, delete []
+    GLenum   usage      = 0;
+
+    GLenum   format     = 0;
+    uint32_t width      = 0;
+    uint32_t height     = 0;
+    uint32_t depth      = 0;
+    uint32_t numMipmaps = 0;
+};
+
+static std::thread::id                g_contextThread;
+static std::mutex                     g_pendingMutex;
+static DynamicArray<GLPendingTask>    g_pendingTasks;
+static std::atomic<uint32_t>          g_numPendingTasks(0);
+
+// a buffer bound to an indexed target, size 0 binds the whole buffer
+struct GLBufferRange final
+{
+    GLuint     bufferID = 0;
+    GLintptr   offset   = 0;
+    GLsizeiptr size     = 0;
+
+    SGFX_FORCE_INLINE GLBufferRange() {}
+    SGFX_FORCE_INLINE GLBufferRange(GLuint id, GLintptr rangeOffset = 0, GLsizeiptr rangeSize = 0)
+        : bufferID(id), offset(rangeOffset), size(rangeSize)
+    {}
+
+    SGFX_FORCE_INLINE bool operator==(const GLBufferRange& other) const
+    {
+        return bufferID == other.bufferID && offset == other.offset && size == other.size;
+    }
+};
+
+// bind group with the object names resolved at creation, resource slots hold either a texture or
+// a storage buffer, the other array has zero there
+struct GLBindGroupImpl final : public BindGroup
+{
+    GLBufferRange uniformBuffers[BindGroupDescriptor::kMaxConstantBuffers];
+    GLuint textures[BindGroupDescriptor::kMaxShaderResources];
+    GLuint storageBuffers[BindGroupDescriptor::kMaxShaderResources];
+    GLuint samplers[BindGroupDescriptor::kMaxSamplerStates];
+
+    // handles of the buffers and textures above, looked up when they may have pending compute writes
+    void*  constantBufferHandles[BindGroupDescriptor::kMaxConstantBuffers];
+    void*  resourceHandles[BindGroupDescriptor::kMaxShaderResources];
+
+    bool   hasTextures         = false;
+    bool   hasStorageBuffers   = false;
+    bool   hasStreamingBuffers = false; // the names change with every map, resolved again when bound
+
+    inline GLBindGroupImpl(const BindGroupDescriptor& desc) : BindGroup(desc) {}
 };
 
+// draw and compute bindings, the translation only marks slots and GL_flushBindings binds the changed
+// ranges before a draw or a dispatch. Images and atomic counters are only bound by compute queues
+struct GLBindings final
+{
+    enum
+    {
+        kStorageBindingRW = 8 // read-write buffers of compute queues follow the read-only ones
+    };
+
+    BindingSlots<GLBufferRange, DrawCall::kMaxConstantBuffers> uniformBuffers;
+    BindingSlots<GLuint, DrawCall::kMaxShaderResources>       textures;
+    BindingSlots<GLuint, DrawCall::kMaxShaderResources>       storageBuffers;
+    BindingSlots<GLuint, DrawCall::kMaxSamplerStates>         samplers;
+    BindingSlots<GLuint, ComputeQueue::kMaxShaderResourcesRW> images;
+    BindingSlots<GLuint, ComputeQueue::kMaxShaderResourcesRW> atomicCounters;
+};
+
+static GLBindings g_bindings;
+
 //-------------------------------------------------------------------------------------------------
 
 static SGFX_FORCE_INLINE GLenum GL_getInternalFormat(DataFormat format)
@@ -351,6 +556,230 @@ static SGFX_FORCE_INLINE GLenum GL_getInternalType(DataFormat format)
     return 0;
 }
 
+static SGFX_FORCE_INLINE bool GL_isContextThread()
+{
+    return std::this_thread::get_id() == g_contextThread;
+}
+
+// GL unbinds deleted names itself, the binding slots must not keep them or a reused name would
+// be taken as already bound
+static SGFX_FORCE_INLINE void GL_forgetBuffer(GLuint bufferID, GLuint counterID)
+{
+    g_bindings.uniformBuffers.Forget(bufferID);
+    g_bindings.storageBuffers.Forget(bufferID);
+    g_bindings.atomicCounters.Forget(counterID);
+}
+
+static SGFX_FORCE_INLINE void GL_forgetTexture(GLuint textureID)
+{
+    g_bindings.textures.Forget(textureID);
+    g_bindings.images.Forget(textureID);
+}
+
+// a copy is immutable storage with dynamic storage allowed, so copyBufferData still works on it
+static SGFX_FORCE_INLINE void GL_createStreamingRegion(GLStreamingRegion& region, size_t size, const void* mem)
+{
+    const GLbitfield mapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &region.bufferID);
+    glNamedBufferStorageEXT(region.bufferID, size, mem, mapFlags | GL_DYNAMIC_STORAGE_BIT);
+    region.data = static_cast<uint8_t*>(glMapNamedBufferRangeEXT(region.bufferID, 0, size, mapFlags));
+}
+
+// the copies of a streaming buffer are immutable storage mapped once, writes need no driver call.
+// The first copy gets the initial data, a write map discards the contents anyway
+static SGFX_FORCE_INLINE void GL_createStreamingStorage(GLBufferImpl* impl, const void* mem)
+{
+    impl->regions = new GLStreamingRegion[GLFrameFences::kMaxFramesInFlight];
+    impl->region  = 0;
+
+    for (uint32_t i = 0; i < GLFrameFences::kMaxFramesInFlight; ++i)
+        GL_createStreamingRegion(impl->regions[i], impl->dataSize, (i == 0) ? mem : nullptr);
+
+    impl->bufferID = impl->regions[0].bufferID;
+}
+
+static SGFX_FORCE_INLINE void GL_createBufferStorage(GLBufferImpl* impl, const void* mem, GLenum usage)
+{
+    if (impl->isStreaming) {
+        GL_createStreamingStorage(impl, mem);
+        return;
+    }
+
+    glGenBuffers(1, &impl->bufferID);
+    glNamedBufferDataEXT(impl->bufferID, impl->dataSize, mem, usage);
+
+    // the hidden counter starts at zero
+    if (impl->hasCounter) {
+        GLuint initialCount = 0;
+        glGenBuffers(1, &impl->counterID);
+        glNamedBufferDataEXT(impl->counterID, sizeof(initialCount), &initialCount, GL_DYNAMIC_COPY);
+    }
+}
+
+static SGFX_FORCE_INLINE void GL_createTextureStorage(GLTextureImpl* impl, GLenum format, uint32_t width, uint32_t height, uint32_t depth, uint32_t numMipmaps)
+{
+    glGenTextures(1, &impl->textureID);
+
+    switch (impl->numDimensions) {
+    case 1: { glTextureStorage1DEXT(impl->textureID, GL_TEXTURE_1D, numMipmaps, format, width); } break;
+    case 2: { glTextureStorage2DEXT(impl->textureID, GL_TEXTURE_2D, numMipmaps, format, width, height); } break;
+    case 3: { glTextureStorage3DEXT(impl->textureID, GL_TEXTURE_3D, numMipmaps, format, width, height, depth); } break;
+    }
+}
+
+static SGFX_FORCE_INLINE void GL_queueTask(const GLPendingTask& task)
+{
+    g_pendingTasks.Add(task); // g_pendingMutex is locked by the caller
+    g_numPendingTasks.fetch_add(1, std::memory_order_release);
+}
+
+// context thread only, objects released before their creation ran are skipped
+static SGFX_FORCE_INLINE void GL_processPendingTasks()
+{
+    if (g_numPendingTasks.load(std::memory_order_acquire) == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(g_pendingMutex);
+    for (GLPendingTask& task : g_pendingTasks) {
+        switch (task.type) {
+        case GLPendingTask::Type::CreateBuffer: {
+            GLBufferImpl* impl = g_buffers.Get(task.handle);
+            if (impl != nullptr)
+                GL_createBufferStorage(impl, task.data, task.usage);
+            delete [] task.data;
+        } break;
+        case GLPendingTask::Type::CreateTexture: {
+            GLTextureImpl* impl = g_textures.Get(task.handle);
+            if (impl != nullptr)
+                GL_createTextureStorage(impl, task.format, task.width, task.height, task.depth, task.numMipmaps);
+        } break;
+        case GLPendingTask::Type::DeleteBuffer: {
+            GL_forgetBuffer(task.name, task.counterName);
+            glDeleteBuffers(1, &task.name);
+            if (task.counterName != 0)
+                glDeleteBuffers(1, &task.counterName);
+        } break;
+        case GLPendingTask::Type::DeleteTexture: {
+            GL_forgetTexture(task.name);
+            glDeleteTextures(1, &task.name);
+        } break;
+        }
+    }
+    g_pendingTasks.Clear();
+    g_numPendingTasks.store(0, std::memory_order_relaxed);
+}
+
+static SGFX_FORCE_INLINE void GL_initBuffer(void* handle, GLBufferImpl* impl, const void* mem, GLenum usage)
+{
+    if (GL_isContextThread()) {
+        GL_createBufferStorage(impl, mem, usage);
+        return;
+    }
+
+    GLPendingTask task;
+    task.type   = GLPendingTask::Type::CreateBuffer;
+    task.handle = handle;
+    task.usage  = usage;
+    if (mem != nullptr) {
+        task.data = new uint8_t[impl->dataSize];
+        std::memcpy(task.data, mem, impl->dataSize);
+    }
+
+    std::lock_guard<std::mutex> lock(g_pendingMutex);
+    GL_queueTask(task);
+}
+
+static SGFX_FORCE_INLINE void GL_initTexture(void* handle, GLTextureImpl* impl, DataFormat format, uint32_t width, uint32_t height, uint32_t depth, uint32_t numMipmaps)
+{
+    GLenum glFormat = MapDataFormat[static_cast<size_t>(format)];
+    impl->dataSize  = getTextureDataSize(format, width, height, depth, numMipmaps);
+    if (GL_isContextThread()) {
+        GL_createTextureStorage(impl, glFormat, width, height, depth, numMipmaps);
+        return;
+    }
+
+    GLPendingTask task;
+    task.type       = GLPendingTask::Type::CreateTexture;
+    task.handle     = handle;
+    task.format     = glFormat;
+    task.width      = width;
+    task.height     = height;
+    task.depth      = depth;
+    task.numMipmaps = numMipmaps;
+
+    std::lock_guard<std::mutex> lock(g_pendingMutex);
+    GL_queueTask(task);
+}
+
+// the lock keeps a queued creation from running between reading the name and releasing the slot
+static SGFX_FORCE_INLINE void GL_releaseBuffer(void* handle)
+{
+    if (GL_isContextThread()) {
+        GLBufferImpl* impl = g_buffers.Get(handle);
+        if (impl != nullptr) {
+            GL_forgetBuffer(impl->bufferID, impl->counterID);
+            if (impl->regions != nullptr) {
+                for (uint32_t i = 0; i < GLFrameFences::kMaxFramesInFlight; ++i)
+                    GL_forgetBuffer(impl->regions[i].bufferID, 0);
+            }
+        }
+        g_buffers.Release(handle);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_pendingMutex);
+    GLBufferImpl* impl = g_buffers.Get(handle);
+    if (impl != nullptr && impl->bufferID != 0) {
+        GLPendingTask task;
+        task.type        = GLPendingTask::Type::DeleteBuffer;
+        task.name        = impl->bufferID;
+        task.counterName = impl->counterID;
+
+        // the other copies of a streaming buffer go with their own tasks
+        if (impl->regions != nullptr) {
+            for (uint32_t i = 0; i < GLFrameFences::kMaxFramesInFlight; ++i) {
+                GLStreamingRegion& region = impl->regions[i];
+                if (region.bufferID != impl->bufferID) {
+                    GLPendingTask regionTask;
+                    regionTask.type = GLPendingTask::Type::DeleteBuffer;
+                    regionTask.name = region.bufferID;
+                    GL_queueTask(regionTask);
+                }
+                region.bufferID = 0;
+            }
+        }
+        GL_queueTask(task);
+
+        impl->bufferID  = 0;
+        impl->counterID = 0;
+    }
+    g_buffers.Release(handle);
+}
+
+static SGFX_FORCE_INLINE void GL_releaseTexture(void* handle)
+{
+    if (GL_isContextThread()) {
+        GLTextureImpl* impl = g_textures.Get(handle);
+        if (impl != nullptr)
+            GL_forgetTexture(impl->textureID);
+        g_textures.Release(handle);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(g_pendingMutex);
+    GLTextureImpl* impl = g_textures.Get(handle);
+    if (impl != nullptr && impl->textureID != 0) {
+        GLPendingTask task;
+        task.type = GLPendingTask::Type::DeleteTexture;
+        task.name = impl->textureID;
+        GL_queueTask(task);
+
+        impl->textureID = 0;
+    }
+    g_textures.Release(handle);
+}
+
 static SGFX_FORCE_INLINE GLint GL_getInternalSize(DataFormat format)
 {
     switch (format) {
@@ -409,324 +838,1441 @@ static SGFX_FORCE_INLINE GLsizei GL_getInternalStride(DataFormat format)
     }
 }
 
-static void GL_setPipelineState(PipelineStateHandle handle)
+// capabilities toggled by the pipeline states
+enum class GLCapability : uint32_t
 {
-    if (handle != PipelineStateHandle::invalidHandle()) {
-        PipelineStateDescriptor* state = static_cast<PipelineStateDescriptor*>(handle.value);
+    CullFace,
+    Blend,
+    SampleAlphaToCoverage,
+    DepthTest,
+    StencilTest,
 
-        // vao
-        GLVertexFormatImpl* vertexFormat = static_cast<GLVertexFormatImpl*>(state->vertexFormat.value);
-        if (vertexFormat != nullptr)
-            glBindVertexArray(vertexFormat->vaoID);
-        else
-            glBindVertexArray(0);
+    Count
+};
 
-        // rasterizer state
-        const RasterizerState& rs = state->rasterizerState;
-        glPolygonMode(GL_FRONT_AND_BACK, MapFillMode[static_cast<uint32_t>(rs.fillMode)]);
-        glEnable(GL_CULL_FACE);
-        glCullFace(MapCullMode[static_cast<size_t>(rs.cullMode)]);
-        glFrontFace(MapCounterDirection[static_cast<size_t>(rs.counterDirection)]);
+static GLenum MapCapability[static_cast<size_t>(GLCapability::Count)] = {
+    GL_CULL_FACE,
+    GL_BLEND,
+    GL_SAMPLE_ALPHA_TO_COVERAGE,
+    GL_DEPTH_TEST,
+    GL_STENCIL_TEST
+};
+static_assert((sizeof(MapCapability) / sizeof(GLenum)) == static_cast<size_t>(GLCapability::Count), "Mapping is broken!");
 
-        // blend state
-        const BlendState& bs = state->blendState;
+// shadow copy of the context state set by the pipeline states, a call only reaches the driver when
+// its arguments differ from the shadow. Every call has at least one enum or boolean argument, so
+// the invalidated shadow (all bits set) never matches and the next call of each kind goes through
+struct GLStateShadow final
+{
+    uint32_t capabilities[static_cast<size_t>(GLCapability::Count)];
+    uint32_t polygonMode;
+    uint32_t cullFace;
+    uint32_t frontFace;
+    uint32_t colorMask[RenderTargetSlot::Count];
+    uint32_t blendFunc[RenderTargetSlot::Count][4];     // src, dst, src alpha, dst alpha
+    uint32_t blendEquation[RenderTargetSlot::Count][2]; // color, alpha
+    uint32_t depthFunc;
+    uint32_t depthMask;
+    uint32_t stencilMask;
+    uint32_t stencilFunc[2][3];                         // front and back: func, ref, mask
+    uint32_t stencilOp[2][3];                           // front and back: fail, depth fail, pass
+    uint32_t vertexArray;
+    uint32_t program;
+};
 
-        if (bs.blendDesc.blendEnabled || bs.separateBlendEnabled)
-            glEnable(GL_BLEND);
-        else
-            glDisable(GL_BLEND);
-
-        if (bs.blendDesc.blendEnabled) {
-            uint8_t colorMask = static_cast<uint8_t>(bs.blendDesc.writeMask);
-            glColorMask(
-                colorMask & static_cast<uint8_t>(ColorWriteMask::Red),
-                colorMask & static_cast<uint8_t>(ColorWriteMask::Green),
-                colorMask & static_cast<uint8_t>(ColorWriteMask::Blue),
-                colorMask & static_cast<uint8_t>(ColorWriteMask::Alpha)
-            );
-            glBlendFuncSeparate(
-                MapBlendFactor[static_cast<size_t>(bs.blendDesc.srcBlend)],
-                MapBlendFactor[static_cast<size_t>(bs.blendDesc.dstBlend)],
-                MapBlendFactor[static_cast<size_t>(bs.blendDesc.srcBlendAlpha)],
-                MapBlendFactor[static_cast<size_t>(bs.blendDesc.dstBlendAlpha)]
-            );
-            glBlendEquationSeparate(
-                MapBlendOp[static_cast<size_t>(bs.blendDesc.blendOp)],
-                MapBlendOp[static_cast<size_t>(bs.blendDesc.blendOpAlpha)]
-            );
-        }
+static GLStateShadow g_stateShadow;
+static gl4::Stats    g_stats;
 
-        if (bs.separateBlendEnabled) {
-            for (uint32_t i = 0; i < RenderTargetSlot::Count; ++i) {
-                uint8_t colorMask = static_cast<uint8_t>(bs.renderTargetBlendDesc[i].writeMask);
-                glColorMaski(
-                    i,
-                    colorMask & static_cast<uint8_t>(ColorWriteMask::Red),
-                    colorMask & static_cast<uint8_t>(ColorWriteMask::Green),
-                    colorMask & static_cast<uint8_t>(ColorWriteMask::Blue),
-                    colorMask & static_cast<uint8_t>(ColorWriteMask::Alpha)
-                );
-                glBlendFuncSeparatei(
-                    i,
-                    MapBlendFactor[static_cast<size_t>(bs.renderTargetBlendDesc[i].srcBlend)],
-                    MapBlendFactor[static_cast<size_t>(bs.renderTargetBlendDesc[i].dstBlend)],
-                    MapBlendFactor[static_cast<size_t>(bs.renderTargetBlendDesc[i].srcBlendAlpha)],
-                    MapBlendFactor[static_cast<size_t>(bs.renderTargetBlendDesc[i].dstBlendAlpha)]
-                );
-                glBlendEquationSeparatei(
-                    i,
-                    MapBlendOp[static_cast<size_t>(bs.renderTargetBlendDesc[i].blendOp)],
-                    MapBlendOp[static_cast<size_t>(bs.renderTargetBlendDesc[i].blendOpAlpha)]
-                );
-            }
-        }
+static SGFX_FORCE_INLINE void GL_invalidateStateShadow()
+{
+    std::memset(&g_stateShadow, 0xFF, sizeof(g_stateShadow));
+}
 
-        if (bs.alphaToCoverageEnabled)
-            glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
-        else
-            glDisable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+// stores the value in the shadow, returns false when it was already there and the call can be skipped
+template <typename T>
+static SGFX_FORCE_INLINE bool GL_updateShadow(T& shadow, const T& value)
+{
+    if (std::memcmp(&shadow, &value, sizeof(T)) == 0) {
+        g_stats.numSkippedStateCalls += 1;
+        return false;
+    }
 
-        // depth stencil state
-        const DepthStencilState& ds = state->depthStencilState;
+    std::memcpy(&shadow, &value, sizeof(T));
+    g_stats.numStateCalls += 1;
+    return true;
+}
 
-        if (ds.depthEnabled) {
-            glEnable(GL_DEPTH_TEST);
-            glDepthFunc(MapComparisonFunc[static_cast<size_t>(ds.depthFunc)]);
-            glDepthMask(MapDepthWriteMask[static_cast<size_t>(ds.writeMask)]);
-        } else {
-            glDisable(GL_DEPTH_TEST);
-        }
+// same for calls that set the value of all render targets at once
+template <typename T, size_t N>
+static SGFX_FORCE_INLINE bool GL_updateShadowAll(T (&shadow)[N], const T& value)
+{
+    size_t i = 0;
+    while (i < N && std::memcmp(&shadow[i], &value, sizeof(T)) == 0)
+        ++i;
 
-        if (ds.stencilEnabled) {
-            glEnable(GL_STENCIL_TEST);
-            glStencilMask(ds.stencilWriteMask);
-            glStencilFuncSeparate(
-                GL_FRONT,
-                MapComparisonFunc[static_cast<size_t>(ds.frontFaceStencilDesc.stencilFunc)],
-                ds.stencilRef,
-                0xFF
-            );
-            glStencilFuncSeparate(
-                GL_BACK,
-                MapComparisonFunc[static_cast<size_t>(ds.backFaceStencilDesc.stencilFunc)],
-                ds.stencilRef,
-                0xFF
-            );
-            glStencilOpSeparate(
-                GL_FRONT,
-                MapStencilOp[static_cast<size_t>(ds.frontFaceStencilDesc.failOp)],
-                MapStencilOp[static_cast<size_t>(ds.frontFaceStencilDesc.depthFailOp)],
-                MapStencilOp[static_cast<size_t>(ds.frontFaceStencilDesc.passOp)]
-            );
-            glStencilOpSeparate(
-                GL_BACK,
-                MapStencilOp[static_cast<size_t>(ds.backFaceStencilDesc.failOp)],
-                MapStencilOp[static_cast<size_t>(ds.backFaceStencilDesc.depthFailOp)],
-                MapStencilOp[static_cast<size_t>(ds.backFaceStencilDesc.passOp)]
-            );
-        } else {
-            glDisable(GL_STENCIL_TEST);
-        }
+    if (i == N) {
+        g_stats.numSkippedStateCalls += 1;
+        return false;
     }
+
+    for (i = 0; i < N; ++i)
+        std::memcpy(&shadow[i], &value, sizeof(T));
+    g_stats.numStateCalls += 1;
+    return true;
 }
 
-static void GL_processDrawQueue(DrawQueue* queue)
+static SGFX_FORCE_INLINE void GL_setCapability(GLCapability capability, bool enabled)
 {
-    GL_setPipelineState(queue->getState());
-
-    // set sampler states
-    GLuint samplers[DrawQueue::kMaxSamplerStates] = { 0 };
-    for (size_t i = 0; i < DrawQueue::kMaxSamplerStates; ++i) {
-        GLSamplerStateImpl* samplerState = static_cast<GLSamplerStateImpl*>(queue->samplerStates[i].value);
-
-        if (samplerState != nullptr)
-            samplers[i] = samplerState->samplerID;
+    size_t idx = static_cast<size_t>(capability);
+    if (GL_updateShadow(g_stateShadow.capabilities[idx], static_cast<uint32_t>(enabled))) {
+        if (enabled)
+            glEnable(MapCapability[idx]);
+        else
+            glDisable(MapCapability[idx]);
     }
-    glBindSamplers(0, DrawQueue::kMaxSamplerStates, samplers);
+}
 
-    // process draw calls
-    for (const DrawCall& call: queue->getDrawCalls()) {
+static SGFX_FORCE_INLINE void GL_bindVertexArray(GLuint vaoID)
+{
+    if (GL_updateShadow(g_stateShadow.vertexArray, static_cast<uint32_t>(vaoID)))
+        glBindVertexArray(vaoID);
+}
 
-        // vertex and index buffers
-        GLBufferImpl* vertexBuffer = static_cast<GLBufferImpl*>(call.vertexBuffers[0].value);
-        GLBufferImpl* indexBuffer  = static_cast<GLBufferImpl*>(call.indexBuffer.value);
+static SGFX_FORCE_INLINE void GL_useProgram(GLuint programID)
+{
+    if (GL_updateShadow(g_stateShadow.program, static_cast<uint32_t>(programID)))
+        glUseProgram(programID);
+}
 
-        GLuint vbuffer = 0;
-        if (vertexBuffer != nullptr)
-            vbuffer = vertexBuffer->bufferID;
+static SGFX_FORCE_INLINE uint32_t GL_getColorMask(ColorWriteMask writeMask)
+{
+    return static_cast<uint8_t>(writeMask) & static_cast<uint8_t>(ColorWriteMask::All);
+}
 
-        GLuint ibuffer = 0;
-        if (indexBuffer != nullptr)
-            ibuffer = indexBuffer->bufferID;
+static SGFX_FORCE_INLINE void GL_setColorMask(uint32_t colorMask)
+{
+    if (GL_updateShadowAll(g_stateShadow.colorMask, colorMask)) {
+        glColorMask(
+            (colorMask & static_cast<uint8_t>(ColorWriteMask::Red))   != 0,
+            (colorMask & static_cast<uint8_t>(ColorWriteMask::Green)) != 0,
+            (colorMask & static_cast<uint8_t>(ColorWriteMask::Blue))  != 0,
+            (colorMask & static_cast<uint8_t>(ColorWriteMask::Alpha)) != 0
+        );
+    }
+}
 
-        glBindBuffer(GL_ARRAY_BUFFER, vbuffer);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibuffer);
+static SGFX_FORCE_INLINE void GL_setColorMask(GLuint idx, uint32_t colorMask)
+{
+    if (GL_updateShadow(g_stateShadow.colorMask[idx], colorMask)) {
+        glColorMaski(
+            idx,
+            (colorMask & static_cast<uint8_t>(ColorWriteMask::Red))   != 0,
+            (colorMask & static_cast<uint8_t>(ColorWriteMask::Green)) != 0,
+            (colorMask & static_cast<uint8_t>(ColorWriteMask::Blue))  != 0,
+            (colorMask & static_cast<uint8_t>(ColorWriteMask::Alpha)) != 0
+        );
+    }
+}
 
-        // constant buffers
-        GLuint constantBuffers[DrawCall::kMaxConstantBuffers] = { 0 };
-        for (size_t i = 0; i < DrawCall::kMaxConstantBuffers; ++i) {
-            GLBufferImpl* buffer = static_cast<GLBufferImpl*>(call.constantBuffers[i].value);
+static void GL_applyRasterizerState(const GLRasterizerStateImpl* state)
+{
+    const RasterizerState& rs = state->desc;
 
-            if (buffer != nullptr)
-                constantBuffers[i] = buffer->bufferID;
-        }
-        glBindBuffersBase(GL_UNIFORM_BUFFER, 0, DrawCall::kMaxConstantBuffers, constantBuffers);
-
-        // shader resources
-        // this is a tricky part, because it can be either a buffer or a texture
-        // this code attempts to bind as much stuff as possible with a single call
-        enum SRVType {
-            SRV_None,
-            SRV_Texture,
-            SRV_Buffer
-        };
+    uint32_t polygonMode = MapFillMode[static_cast<uint32_t>(rs.fillMode)];
+    uint32_t cullFace    = MapCullMode[static_cast<size_t>(rs.cullMode)];
+    uint32_t frontFace   = MapCounterDirection[static_cast<size_t>(rs.counterDirection)];
 
-        GLsizei count = 0;
-        GLuint  shaderResources[DrawCall::kMaxShaderResources] = { 0 };
-        
-        SRVType prevType    = call.shaderResources[0].isTexture ? SRV_Texture : SRV_Buffer;
-        SRVType currentType = SRV_None;
-        GLsizei lastIndex   = 0;
+    if (GL_updateShadow(g_stateShadow.polygonMode, polygonMode))
+        glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
 
-        for (GLsizei i = 0; i < DrawCall::kMaxShaderResources; ++i) {
-            const ShaderResource& resource = call.shaderResources[i];
+    // CullMode::None has no cull face, culling is disabled instead
+    GL_setCapability(GLCapability::CullFace, rs.cullMode != CullMode::None);
+    if (rs.cullMode != CullMode::None && GL_updateShadow(g_stateShadow.cullFace, cullFace))
+        glCullFace(cullFace);
+    if (GL_updateShadow(g_stateShadow.frontFace, frontFace))
+        glFrontFace(frontFace);
+}
 
-            if (resource.isTexture)
-                currentType = SRV_Texture;
-            else
-                currentType = SRV_Buffer;
-
-            if (resource.isTexture) {
-                if (prevType != currentType) { // flush buffers
-                    glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, i, count, shaderResources);
-                    lastIndex = i;
-                    count     = 0;
-                    prevType  = currentType;
-                }
+static void GL_applyBlendState(const GLBlendStateImpl* state)
+{
+    const BlendState& bs = state->desc;
 
-                GLTextureImpl* texture = static_cast<GLTextureImpl*>(resource.value);
-                shaderResources[count] = texture->textureID;
-                count++;
-            } else {
-                if (prevType != currentType) { // flush textures
-                    glBindTextures(i, count, shaderResources);
-                    lastIndex = i;
-                    count     = 0;
-                    prevType  = currentType;
-                }
+    GL_setCapability(GLCapability::Blend, bs.blendDesc.blendEnabled || bs.separateBlendEnabled);
 
-                GLBufferImpl* buffer   = static_cast<GLBufferImpl*>(resource.value);
-                shaderResources[count] = buffer->bufferID;
-                count++;
-            }
-        }
+    if (bs.blendDesc.blendEnabled) {
+        const BlendDesc& desc = bs.blendDesc;
 
-        // bind remaining resources
-        if (count != 0) {
-            switch (currentType) {
-            case SRV_None:    {} break;
-            case SRV_Texture: { glBindTextures(lastIndex, count, shaderResources); } break;
-            case SRV_Buffer:  { glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, lastIndex, count, shaderResources); } break;
-            }
-        }
+        uint32_t blendFunc[4] = {
+            MapBlendFactor[static_cast<size_t>(desc.srcBlend)],
+            MapBlendFactor[static_cast<size_t>(desc.dstBlend)],
+            MapBlendFactor[static_cast<size_t>(desc.srcBlendAlpha)],
+            MapBlendFactor[static_cast<size_t>(desc.dstBlendAlpha)]
+        };
+        uint32_t blendEquation[2] = {
+            MapBlendOp[static_cast<size_t>(desc.blendOp)],
+            MapBlendOp[static_cast<size_t>(desc.blendOpAlpha)]
+        };
 
-        // draw
-        GLenum topology = MapPrimitiveTopology[static_cast<size_t>(call.primitiveTopology)];
+        GL_setColorMask(GL_getColorMask(desc.writeMask));
+        if (GL_updateShadowAll(g_stateShadow.blendFunc, blendFunc))
+            glBlendFuncSeparate(blendFunc[0], blendFunc[1], blendFunc[2], blendFunc[3]);
+        if (GL_updateShadowAll(g_stateShadow.blendEquation, blendEquation))
+            glBlendEquationSeparate(blendEquation[0], blendEquation[1]);
+    }
 
-        switch (call.type) {
-        case DrawCall::Draw:                 { glDrawArrays(topology, call.count, call.startVertex); } break;
-        case DrawCall::DrawIndexed:          { glDrawElements(topology, call.count, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid*>(call.startIndex)); } break;
-        case DrawCall::DrawInstanced:        { glDrawArraysInstanced(topology, 0, call.instanceCount, call.count); } break;
-        case DrawCall::DrawIndexedInstanced: { glDrawElementsInstanced(topology, call.instanceCount, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid*>(call.startIndex), call.count); } break;
+    if (bs.separateBlendEnabled) {
+        for (GLuint i = 0; i < RenderTargetSlot::Count; ++i) {
+            const BlendDesc& desc = bs.renderTargetBlendDesc[i];
+
+            uint32_t blendFunc[4] = {
+                MapBlendFactor[static_cast<size_t>(desc.srcBlend)],
+                MapBlendFactor[static_cast<size_t>(desc.dstBlend)],
+                MapBlendFactor[static_cast<size_t>(desc.srcBlendAlpha)],
+                MapBlendFactor[static_cast<size_t>(desc.dstBlendAlpha)]
+            };
+            uint32_t blendEquation[2] = {
+                MapBlendOp[static_cast<size_t>(desc.blendOp)],
+                MapBlendOp[static_cast<size_t>(desc.blendOpAlpha)]
+            };
+
+            GL_setColorMask(i, GL_getColorMask(desc.writeMask));
+            if (GL_updateShadow(g_stateShadow.blendFunc[i], blendFunc))
+                glBlendFuncSeparatei(i, blendFunc[0], blendFunc[1], blendFunc[2], blendFunc[3]);
+            if (GL_updateShadow(g_stateShadow.blendEquation[i], blendEquation))
+                glBlendEquationSeparatei(i, blendEquation[0], blendEquation[1]);
         }
     }
-}
 
-//=============================================================================
-bool initOpenGL()
-{
-    glewInit();
-    return true;
+    GL_setCapability(GLCapability::SampleAlphaToCoverage, bs.alphaToCoverageEnabled);
 }
 
-void shutdown()
-{}
-
-uint64_t getGPUCaps()
+static SGFX_FORCE_INLINE void GL_applyStencilFace(GLenum face, uint32_t (&shadowFunc)[3], uint32_t (&shadowOp)[3], const StencilDesc& desc, uint32_t stencilRef)
 {
-    return 0; // not implemented yet
-}
-
-//-------------------------------------------------------------------------------------------------
-bool compileShader(
-    const char*          sourceCode,
-    size_t               sourceCodeSize,
-    ShaderCompileVersion version,
-    ShaderCompileTarget  target,
-    ShaderCompileMacro*  macros,
-    size_t               macrosSize,
-    uint64_t             flags,
-    ErrorReportFunc      errorFunc,
+    uint32_t stencilFunc[3] = {
+        MapComparisonFunc[static_cast<size_t>(desc.stencilFunc)],
+        stencilRef,
+        0xFF
+    };
+    uint32_t stencilOp[3] = {
+        MapStencilOp[static_cast<size_t>(desc.failOp)],
+        MapStencilOp[static_cast<size_t>(desc.depthFailOp)],
+        MapStencilOp[static_cast<size_t>(desc.passOp)]
+    };
 
-    void*&  outData, // delete []
-    size_t& outDataSize
-)
-{
-    return false;
+    if (GL_updateShadow(shadowFunc, stencilFunc))
+        glStencilFuncSeparate(face, stencilFunc[0], static_cast<GLint>(stencilFunc[1]), stencilFunc[2]);
+    if (GL_updateShadow(shadowOp, stencilOp))
+        glStencilOpSeparate(face, stencilOp[0], stencilOp[1], stencilOp[2]);
 }
 
-VertexFormatHandle createVertexFormat(
-    VertexElementDescriptor* elements,
-    size_t                   size,
-    void* shaderBytecode, size_t shaderBytecodeSize,
-    ErrorReportFunc          errorReport
-)
+static void GL_applyDepthStencilState(const GLDepthStencilStateImpl* state)
 {
-    GLVertexFormatImpl* impl = new GLVertexFormatImpl;
-
-    glBindVertexArray(impl->vaoID);
-    for (GLuint i = 0; i < size; ++i) {
-        glVertexAttribPointer(
-            i,
-            GL_getInternalSize(elements[i].format),
-            GL_getInternalType(elements[i].format),
-            false,
-            GL_getInternalStride(elements[i].format),
-            reinterpret_cast<const GLvoid*>(elements[i].offset)
-        );
-        glEnableVertexAttribArray(i);
+    const DepthStencilState& ds = state->desc;
+
+    GL_setCapability(GLCapability::DepthTest, ds.depthEnabled);
+    if (ds.depthEnabled) {
+        uint32_t depthFunc = MapComparisonFunc[static_cast<size_t>(ds.depthFunc)];
+        uint32_t depthMask = MapDepthWriteMask[static_cast<size_t>(ds.writeMask)];
+
+        if (GL_updateShadow(g_stateShadow.depthFunc, depthFunc))
+            glDepthFunc(depthFunc);
+        if (GL_updateShadow(g_stateShadow.depthMask, depthMask))
+            glDepthMask(static_cast<GLboolean>(depthMask));
     }
-    glBindVertexArray(0);
 
-    return VertexFormatHandle(impl);
-}
+    GL_setCapability(GLCapability::StencilTest, ds.stencilEnabled);
+    if (ds.stencilEnabled) {
+        uint32_t stencilMask = ds.stencilWriteMask;
+        if (GL_updateShadow(g_stateShadow.stencilMask, stencilMask))
+            glStencilMask(stencilMask);
 
-void releaseVertexFormat(VertexFormatHandle handle)
-{
-    if (handle != VertexFormatHandle::invalidHandle()) {
-        GLVertexFormatImpl* impl = static_cast<GLVertexFormatImpl*>(handle.value);
-        delete impl;
+        GL_applyStencilFace(GL_FRONT, g_stateShadow.stencilFunc[0], g_stateShadow.stencilOp[0], ds.frontFaceStencilDesc, ds.stencilRef);
+        GL_applyStencilFace(GL_BACK,  g_stateShadow.stencilFunc[1], g_stateShadow.stencilOp[1], ds.backFaceStencilDesc,  ds.stencilRef);
     }
 }
 
-PipelineStateHandle createPipelineState(const PipelineStateDescriptor& desc)
+// sub-states applied by the last GL_setPipelineState, reset at the start of every submit. The sub-states
+// of the first pipeline are applied in full then and the state shadow drops what is already set
+struct GLBoundPipeline final
 {
-    PipelineStateDescriptor* ret = new PipelineStateDescriptor;
-    std::memcpy(ret, &desc, sizeof(PipelineStateDescriptor));
-    return PipelineStateHandle(ret);
-}
+    bool                           isValid           = false;
+    const GLVertexFormatImpl*      vertexFormat      = nullptr;
+    const GLRasterizerStateImpl*   rasterizerState   = nullptr;
+    const GLBlendStateImpl*        blendState        = nullptr;
+    const GLDepthStencilStateImpl* depthStencilState = nullptr;
+};
 
-void releasePipelineState(PipelineStateHandle handle)
+static GLBoundPipeline g_boundPipeline;
+
+// sub-states are interned, so a sub-state shared with the previous pipeline is already applied
+static void GL_setPipelineState(PipelineStateHandle handle)
 {
     if (handle != PipelineStateHandle::invalidHandle()) {
-        PipelineStateDescriptor* desc = static_cast<PipelineStateDescriptor*>(handle.value);
-        delete desc;
+        GLPipelineStateImpl* state = static_cast<GLPipelineStateImpl*>(handle.value);
+        bool                 all   = !g_boundPipeline.isValid;
+
+        // vao
+        if (all || state->vertexFormat != g_boundPipeline.vertexFormat)
+            GL_bindVertexArray((state->vertexFormat != nullptr) ? state->vertexFormat->vaoID : 0);
+
+        if (all || state->rasterizerState != g_boundPipeline.rasterizerState)
+            GL_applyRasterizerState(state->rasterizerState);
+        if (all || state->blendState != g_boundPipeline.blendState)
+            GL_applyBlendState(state->blendState);
+        if (all || state->depthStencilState != g_boundPipeline.depthStencilState)
+            GL_applyDepthStencilState(state->depthStencilState);
+
+        g_boundPipeline.isValid           = true;
+        g_boundPipeline.vertexFormat      = state->vertexFormat;
+        g_boundPipeline.rasterizerState   = state->rasterizerState;
+        g_boundPipeline.blendState        = state->blendState;
+        g_boundPipeline.depthStencilState = state->depthStencilState;
     }
 }
 
-BufferHandle createBuffer(uint32_t flags, const void* mem, size_t size, size_t stride)
+//=============================================================================
+static inline void* sgfx_malloc(size_t size)
 {
-    GLBufferImpl* impl = new GLBufferImpl;
+    return malloc(size);
+}
+
+static inline void sgfx_free(void* ptr)
+{
+    return free(ptr);
+}
+
+//=============================================================================
+
+static AllocFunc       g_allocFunc = sgfx_malloc;
+static FreeFunc        g_freeFunc  = sgfx_free;
+
+// transient draw queue storage
+static FrameArena      g_frameArena;
+
+// sorted submit, keeps its storage between frames
+static DrawQueueSorter g_drawQueueSorter;
+
+static GLFrameFences g_frames;
+
+// polls the fences of the frames in flight, oldest first
+static void GL_updateCompletedFrames()
+{
+    while (g_frames.completedFrame + 1 < g_frames.frameIndex) {
+        GLsync& fence = g_frames.fences[(g_frames.completedFrame + 1) % GLFrameFences::kMaxFramesInFlight];
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            break;
+
+        glDeleteSync(fence);
+        fence = nullptr;
+        g_frames.completedFrame++;
+    }
+}
+
+// blocks until the GPU is done with frame, the frame being recorded has no fence yet and returns false
+static bool GL_waitForFrame(uint64_t frame)
+{
+    if (frame >= g_frames.frameIndex)
+        return false;
+
+    GL_updateCompletedFrames();
+    if (g_frames.completedFrame >= frame)
+        return true;
+
+    g_stats.numFrameStalls += 1;
+    while (g_frames.completedFrame < frame) {
+        GLsync& fence = g_frames.fences[(g_frames.completedFrame + 1) % GLFrameFences::kMaxFramesInFlight];
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+
+        glDeleteSync(fence);
+        fence = nullptr;
+        g_frames.completedFrame++;
+    }
+    return true;
+}
+
+// endFrame, the CPU runs at most kMaxFramesInFlight frames ahead
+static void GL_fenceFrame()
+{
+    const uint64_t kMaxFramesInFlight = GLFrameFences::kMaxFramesInFlight;
+
+    if (g_frames.frameIndex - g_frames.completedFrame > kMaxFramesInFlight)
+        GL_waitForFrame(g_frames.frameIndex - kMaxFramesInFlight);
+
+    g_frames.fences[g_frames.frameIndex % kMaxFramesInFlight] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    g_frames.frameIndex++;
+
+    GL_updateCompletedFrames();
+}
+
+static void GL_releaseFrameFences()
+{
+    for (GLsync& fence : g_frames.fences) {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    g_frames.completedFrame = g_frames.frameIndex - 1;
+}
+
+static GLFenceTimeline g_fences;
+
+// the GPU signals fences in order, so a signaled fence completes every fence before it
+static void GL_completeFences(uint64_t value)
+{
+    while (g_fences.completedValue < value) {
+        GLsync& fence = g_fences.fences[(g_fences.completedValue + 1) % GLFenceTimeline::kMaxPendingFences];
+        glDeleteSync(fence);
+        fence = nullptr;
+        g_fences.completedValue++;
+    }
+}
+
+static bool GL_waitForFence(uint64_t value, GLuint64 timeout)
+{
+    if (value <= g_fences.completedValue)
+        return true;
+    if (value >= g_fences.nextValue)
+        return false; // TODO: error handling, the fence was never inserted
+
+    GLsync fence  = g_fences.fences[value % GLFenceTimeline::kMaxPendingFences];
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+        return false;
+
+    GL_completeFences(value);
+    return true;
+}
+
+static void GL_releaseFences()
+{
+    for (GLsync& fence : g_fences.fences) {
+        if (fence != nullptr)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    g_fences.completedValue = g_fences.nextValue - 1;
+}
+
+static DeferredReleaseQueue g_deferredReleases;
+
+static void GL_releaseDeferred(const DeferredReleaseQueue::Entry& entry)
+{
+    switch (entry.type) {
+    case DeferredReleaseQueue::Type::Buffer:
+    case DeferredReleaseQueue::Type::ConstantBuffer: { GL_releaseBuffer(entry.handle);  } break;
+    case DeferredReleaseQueue::Type::Texture:        { GL_releaseTexture(entry.handle); } break;
+    }
+}
+
+// streaming buffers hold one copy per frame in flight
+static SGFX_FORCE_INLINE bool GL_deferBufferRelease(void* handle, DeferredReleaseQueue::Type type)
+{
+    GLBufferImpl* impl = g_buffers.Get(handle);
+    if (impl == nullptr)
+        return false;
+
+    size_t size = impl->dataSize * ((impl->isStreaming) ? GLFrameFences::kMaxFramesInFlight : 1);
+    return g_deferredReleases.Push(handle, type, size);
+}
+
+// inline constants of all submits in a frame (see setConstants), copied into a persistently mapped
+// buffer and bound as ranges. The buffer has one region per frame in flight, a frame reuses the
+// region of the frame kMaxFramesInFlight before it. A frame that doesn't fit its region replaces
+// the buffer with a larger one, GL keeps the old storage alive for the pending draw calls.
+// Without endFrame calls there is only one endless frame, a full region then gets a new buffer
+// of the same size so the ring doesn't grow without bound
+struct GLConstantRing final
+{
+    enum
+    {
+        kMinRegionSize = 64 * 1024,
+        kMaxRegionSize = 16 * 1024 * 1024
+    };
+
+    GLuint   bufferID   = 0;
+    uint8_t* data       = nullptr;
+    size_t   regionSize = 0;
+    size_t   alignment  = 0; // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+    size_t   offset     = 0; // in the region of frame
+    uint64_t frame      = 0; // frame that writes the region
+};
+
+static GLConstantRing g_constantRing;
+
+static SGFX_FORCE_INLINE void GL_releaseConstantRing()
+{
+    GLConstantRing& ring = g_constantRing;
+
+    if (ring.bufferID != 0) {
+        GLuint bufferID = ring.bufferID;
+        g_bindings.uniformBuffers.ForgetIf([bufferID](const GLBufferRange& range) { return range.bufferID == bufferID; });
+        glDeleteBuffers(1, &ring.bufferID);
+    }
+
+    ring.bufferID = 0;
+    ring.data     = nullptr;
+    ring.offset   = 0;
+}
+
+static void GL_createConstantRing(size_t regionSize)
+{
+    GL_releaseConstantRing();
+
+    GLConstantRing& ring = g_constantRing;
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const size_t     size  = regionSize * GLFrameFences::kMaxFramesInFlight;
+
+    glGenBuffers(1, &ring.bufferID);
+    glNamedBufferStorageEXT(ring.bufferID, size, nullptr, flags);
+
+    ring.data       = static_cast<uint8_t*>(glMapNamedBufferRangeEXT(ring.bufferID, 0, size, flags));
+    ring.regionSize = regionSize;
+    ring.alignment  = (alignment > 0) ? static_cast<size_t>(alignment) : 256;
+}
+
+// copies the constants into the region of the current frame, returns the range to bind
+static GLBufferRange GL_allocateConstants(const uint8_t* data, uint32_t size)
+{
+    GLConstantRing& ring = g_constantRing;
+
+    // the first allocation of a frame waits until the GPU is done with the previous user of the region
+    if (ring.frame != g_frames.frameIndex) {
+        ring.frame  = g_frames.frameIndex;
+        ring.offset = 0;
+
+        if (ring.frame > GLFrameFences::kMaxFramesInFlight)
+            GL_waitForFrame(ring.frame - GLFrameFences::kMaxFramesInFlight);
+    }
+
+    size_t alignedSize = (size + ring.alignment - 1) & ~(ring.alignment - 1);
+    if (ring.data == nullptr || ring.offset + alignedSize > ring.regionSize) {
+        // frameIndex only advances in endFrame
+        bool   countsFrames = g_frames.frameIndex > 1;
+        size_t regionSize   = GLConstantRing::kMinRegionSize;
+        while (regionSize < ring.regionSize)
+            regionSize *= 2;
+        if (ring.data != nullptr && countsFrames && regionSize < GLConstantRing::kMaxRegionSize)
+            regionSize *= 2;
+
+        GL_createConstantRing(regionSize);
+        if (ring.data == nullptr)
+            return GLBufferRange(); // TODO: error handling
+    }
+
+    size_t offset = (ring.frame % GLFrameFences::kMaxFramesInFlight) * ring.regionSize + ring.offset;
+    std::memcpy(ring.data + offset, data, size);
+
+    ring.offset += alignedSize;
+    g_stats.numConstantDataBytes += size;
+
+    return GLBufferRange(ring.bufferID, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size));
+}
+
+static SGFX_FORCE_INLINE void GL_flushBindings()
+{
+    g_bindings.uniformBuffers.Flush([](GLuint first, GLsizei count, const GLBufferRange* ranges) {
+        GLuint ids[DrawCall::kMaxConstantBuffers];
+        bool   hasRanges = false;
+
+        for (GLsizei i = 0; i < count; ++i) {
+            ids[i]     = ranges[i].bufferID;
+            hasRanges |= ranges[i].size != 0;
+        }
+
+        if (!hasRanges) {
+            glBindBuffersBase(GL_UNIFORM_BUFFER, first, count, ids);
+            return;
+        }
+
+        // inline constants, whole buffers in the same run are bound one by one as well
+        for (GLsizei i = 0; i < count; ++i) {
+            if (ranges[i].size != 0)
+                glBindBufferRange(GL_UNIFORM_BUFFER, first + i, ids[i], ranges[i].offset, ranges[i].size);
+            else
+                glBindBufferBase(GL_UNIFORM_BUFFER, first + i, ids[i]);
+        }
+    });
+    g_bindings.textures.Flush([](GLuint first, GLsizei count, const GLuint* ids) {
+        glBindTextures(first, count, ids);
+    });
+    g_bindings.storageBuffers.Flush([](GLuint first, GLsizei count, const GLuint* ids) {
+        glBindBuffersBase(GL_SHADER_STORAGE_BUFFER, first, count, ids);
+    });
+    g_bindings.samplers.Flush([](GLuint first, GLsizei count, const GLuint* ids) {
+        glBindSamplers(first, count, ids);
+    });
+    g_bindings.images.Flush([](GLuint first, GLsizei count, const GLuint* ids) {
+        glBindImageTextures(first, count, ids);
+    });
+    g_bindings.atomicCounters.Flush([](GLuint first, GLsizei count, const GLuint* ids) {
+        glBindBuffersBase(GL_ATOMIC_COUNTER_BUFFER, first, count, ids);
+    });
+}
+
+// every command stream starts from the empty state, the next draw unbinds what the stream does not set
+static SGFX_FORCE_INLINE void GL_resetBindings()
+{
+    g_bindings.uniformBuffers.Reset();
+    g_bindings.textures.Reset();
+    g_bindings.storageBuffers.Reset();
+    g_bindings.samplers.Reset();
+    g_bindings.images.Reset();
+    g_bindings.atomicCounters.Reset();
+}
+
+// unbinds everything at the end of a submit, deleted names can be reused by the next objects
+static SGFX_FORCE_INLINE void GL_clearBindings()
+{
+    GL_resetBindings();
+    GL_flushBindings();
+}
+
+// the ways a resource written by a dispatch can be read next, one glMemoryBarrier bit each
+enum class GLBarrier : uint32_t
+{
+    VertexAttribArray,
+    ElementArray,
+    Uniform,
+    TextureFetch,
+    ShaderImageAccess,
+    Command,
+    BufferUpdate,
+    TextureUpdate,
+    AtomicCounter,
+    ShaderStorage,
+
+    Count
+};
+
+static GLbitfield MapBarrier[static_cast<size_t>(GLBarrier::Count)] = {
+    GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT,
+    GL_ELEMENT_ARRAY_BARRIER_BIT,
+    GL_UNIFORM_BARRIER_BIT,
+    GL_TEXTURE_FETCH_BARRIER_BIT,
+    GL_SHADER_IMAGE_ACCESS_BARRIER_BIT,
+    GL_COMMAND_BARRIER_BIT,
+    GL_BUFFER_UPDATE_BARRIER_BIT,
+    GL_TEXTURE_UPDATE_BARRIER_BIT,
+    GL_ATOMIC_COUNTER_BARRIER_BIT,
+    GL_SHADER_STORAGE_BARRIER_BIT
+};
+static_assert((sizeof(MapBarrier) / sizeof(GLbitfield)) == static_cast<size_t>(GLBarrier::Count), "Mapping is broken!");
+
+// every dispatch that writes something starts a new epoch and stamps the resources it wrote with it.
+// A barrier bit issued at epoch E covers all writes up to E for that kind of access, so a read only
+// needs the bit when its resource was written after the last barrier of its kind
+static uint32_t   g_writeEpoch = 0;
+static uint32_t   g_barrierEpochs[static_cast<size_t>(GLBarrier::Count)] = { 0 };
+static GLbitfield g_pendingBarriers = 0; // GLBarrier bits, not GL bits
+
+static SGFX_FORCE_INLINE bool GL_isBarrierOutstanding(GLBarrier barrier)
+{
+    return g_writeEpoch > g_barrierEpochs[static_cast<size_t>(barrier)];
+}
+
+static SGFX_FORCE_INLINE void GL_requireBarrier(uint32_t writeEpoch, GLBarrier barrier)
+{
+    if (writeEpoch > g_barrierEpochs[static_cast<size_t>(barrier)])
+        g_pendingBarriers |= 1U << static_cast<uint32_t>(barrier);
+}
+
+// issues the bits required since the last flush in one call, before the draw or dispatch that reads
+static SGFX_FORCE_INLINE void GL_flushBarriers()
+{
+    if (g_pendingBarriers == 0)
+        return;
+
+    GLbitfield bits = 0;
+    for (uint32_t i = 0; i < static_cast<uint32_t>(GLBarrier::Count); ++i) {
+        if (g_pendingBarriers & (1U << i)) {
+            bits |= MapBarrier[i];
+            g_barrierEpochs[i] = g_writeEpoch;
+        }
+    }
+
+    glMemoryBarrier(bits);
+    g_pendingBarriers = 0;
+    g_stats.numMemoryBarriers += 1;
+}
+
+// bind groups only keep names, their resources are looked up while a dispatch may have written them
+static void GL_requireBarriers(const GLBindGroupImpl* group)
+{
+    if (GL_isBarrierOutstanding(GLBarrier::Uniform)) {
+        for (uint32_t i = 0; i < group->numConstantBuffers; ++i) {
+            GLBufferImpl* buffer = g_buffers.Get(group->constantBufferHandles[i]);
+            if (buffer != nullptr)
+                GL_requireBarrier(buffer->writeEpoch, GLBarrier::Uniform);
+        }
+    }
+
+    bool textures = group->hasTextures       && GL_isBarrierOutstanding(GLBarrier::TextureFetch);
+    bool buffers  = group->hasStorageBuffers && GL_isBarrierOutstanding(GLBarrier::ShaderStorage);
+    if (textures || buffers) {
+        for (uint32_t i = 0; i < group->numShaderResources; ++i) {
+            if (group->textures[i] != 0) {
+                GLTextureImpl* texture = g_textures.Get(group->resourceHandles[i]);
+                if (texture != nullptr)
+                    GL_requireBarrier(texture->writeEpoch, GLBarrier::TextureFetch);
+            } else {
+                GLBufferImpl* buffer = g_buffers.Get(group->resourceHandles[i]);
+                if (buffer != nullptr)
+                    GL_requireBarrier(buffer->writeEpoch, GLBarrier::ShaderStorage);
+            }
+        }
+    }
+}
+
+static void GL_bindResource(GLuint slot, bool isTexture, void* resource)
+{
+    if (isTexture) {
+        GLTextureImpl* texture = g_textures.Get(resource);
+        if (texture != nullptr)
+            GL_requireBarrier(texture->writeEpoch, GLBarrier::TextureFetch);
+        g_bindings.textures.Set(slot, (texture != nullptr) ? texture->textureID : 0);
+    } else {
+        GLBufferImpl* buffer = g_buffers.Get(resource);
+        if (buffer != nullptr)
+            GL_requireBarrier(buffer->writeEpoch, GLBarrier::ShaderStorage);
+        g_bindings.storageBuffers.Set(slot, (buffer != nullptr) ? buffer->bufferID : 0);
+    }
+}
+
+static void GL_applyOverrides(const DrawOverrides& overrides)
+{
+    overrides.constantBufferMask.ForEach([&overrides](uint32_t i) {
+        GLBufferImpl* buffer = g_buffers.Get(overrides.constantBuffers[i].value);
+        if (buffer != nullptr)
+            GL_requireBarrier(buffer->writeEpoch, GLBarrier::Uniform);
+        g_bindings.uniformBuffers.Set(i, (buffer != nullptr) ? buffer->bufferID : 0);
+    });
+
+    overrides.shaderResourceMask.ForEach([&overrides](uint32_t i) {
+        GL_bindResource(i, overrides.shaderResources[i].isTexture, overrides.shaderResources[i].value);
+    });
+}
+
+// indices are always 32 bit, startIndex becomes a byte offset into the bound index buffer
+static SGFX_FORCE_INLINE const GLvoid* GL_getIndexOffset(uint32_t startIndex)
+{
+    return reinterpret_cast<const GLvoid*>(static_cast<uintptr_t>(startIndex) * sizeof(GLuint));
+}
+
+// the indirect argument layouts of D3D11 and GL match, so the same args buffer works on both
+static SGFX_FORCE_INLINE void GL_drawCall(GLenum topology, const DrawCall& call)
+{
+    switch (call.type) {
+    case DrawCall::Draw: {
+        glDrawArrays(topology, call.startVertex, call.count);
+    } break;
+    case DrawCall::DrawIndexed: {
+        glDrawElementsBaseVertex(topology, call.count, GL_UNSIGNED_INT, GL_getIndexOffset(call.startIndex), call.startVertex);
+    } break;
+    case DrawCall::DrawInstanced: {
+        glDrawArraysInstancedBaseInstance(topology, call.startVertex, call.count, call.instanceCount, call.startInstance);
+    } break;
+    case DrawCall::DrawIndexedInstanced: {
+        glDrawElementsInstancedBaseVertexBaseInstance(
+            topology, call.count, GL_UNSIGNED_INT, GL_getIndexOffset(call.startIndex),
+            call.instanceCount, call.startVertex, call.startInstance
+        );
+    } break;
+
+    case DrawCall::DrawInstancedIndirect:
+    case DrawCall::DrawIndexedInstancedIndirect: {
+        GLBufferImpl* argsBuffer = g_buffers.Get(call.indirectArgsBuffer.value);
+        if (argsBuffer == nullptr)
+            break;
+
+        const GLvoid* argsOffset = reinterpret_cast<const GLvoid*>(call.indirectArgsOffset);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, argsBuffer->bufferID);
+
+        if (call.type == DrawCall::DrawInstancedIndirect)
+            glDrawArraysIndirect(topology, argsOffset);
+        else
+            glDrawElementsIndirect(topology, GL_UNSIGNED_INT, argsOffset);
+    } break;
+
+    case DrawCall::MultiDrawIndexedIndirect: {
+        GLBufferImpl* argsBuffer  = g_buffers.Get(call.indirectArgsBuffer.value);
+        GLBufferImpl* countBuffer = g_buffers.Get(call.indirectCountBuffer.value);
+        if (argsBuffer == nullptr)
+            break;
+
+        const GLvoid* argsOffset = reinterpret_cast<const GLvoid*>(call.indirectArgsOffset);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, argsBuffer->bufferID);
+
+        // without ARB_indirect_parameters all records are drawn
+        if (countBuffer != nullptr && GLEW_ARB_indirect_parameters) {
+            glBindBuffer(GL_PARAMETER_BUFFER_ARB, countBuffer->bufferID);
+            glMultiDrawElementsIndirectCountARB(
+                topology, GL_UNSIGNED_INT, argsOffset,
+                static_cast<GLintptr>(call.indirectCountOffset), call.maxDrawCount, call.indirectStride
+            );
+        } else {
+            glMultiDrawElementsIndirect(topology, GL_UNSIGNED_INT, argsOffset, call.maxDrawCount, call.indirectStride);
+        }
+    } break;
+
+    default: {} break;
+    }
+}
+
+static void GL_setSamplerStates(const SamplerStateHandle* samplerStates)
+{
+    for (uint32_t i = 0; i < DrawQueue::kMaxSamplerStates; ++i) {
+        GLSamplerStateImpl* samplerState = static_cast<GLSamplerStateImpl*>(samplerStates[i].value);
+        g_bindings.samplers.Set(i, (samplerState != nullptr) ? samplerState->samplerID : 0);
+    }
+}
+
+// the slots of the previous group are reset before the next one is set, only the slots that differ are bound
+static void GL_setBindGroup(const SamplerStateHandle* samplerStates, const GLBindGroupImpl* prev, const GLBindGroupImpl* next)
+{
+    static const GLuint        kNullIDs[DrawCall::kMaxShaderResources] = { 0 };
+    static const GLBufferRange kNullRanges[DrawCall::kMaxConstantBuffers];
+
+    if (prev != nullptr) {
+        g_bindings.uniformBuffers.Set(prev->firstConstantBuffer, prev->numConstantBuffers, kNullRanges);
+        if (prev->hasTextures)
+            g_bindings.textures.Set(prev->firstShaderResource, prev->numShaderResources, kNullIDs);
+        if (prev->hasStorageBuffers)
+            g_bindings.storageBuffers.Set(prev->firstShaderResource, prev->numShaderResources, kNullIDs);
+        if (prev->numSamplerStates != 0)
+            GL_setSamplerStates(samplerStates);
+    }
+
+    if (next != nullptr) {
+        const GLBufferRange* uniformBuffers = next->uniformBuffers;
+        const GLuint*        storageBuffers = next->storageBuffers;
+
+        GLBufferRange streamingUniformBuffers[BindGroupDescriptor::kMaxConstantBuffers];
+        GLuint        streamingStorageBuffers[BindGroupDescriptor::kMaxShaderResources];
+
+        if (next->hasStreamingBuffers) {
+            for (uint32_t i = 0; i < next->numConstantBuffers; ++i) {
+                GLBufferImpl* buffer = g_buffers.Get(next->constantBufferHandles[i]);
+                streamingUniformBuffers[i] = (buffer != nullptr) ? buffer->bufferID : 0;
+            }
+            for (uint32_t i = 0; i < next->numShaderResources; ++i) {
+                GLBufferImpl* buffer = (next->storageBuffers[i] != 0) ? g_buffers.Get(next->resourceHandles[i]) : nullptr;
+                streamingStorageBuffers[i] = (buffer != nullptr) ? buffer->bufferID : 0;
+            }
+
+            uniformBuffers = streamingUniformBuffers;
+            storageBuffers = streamingStorageBuffers;
+        }
+
+        g_bindings.uniformBuffers.Set(next->firstConstantBuffer, next->numConstantBuffers, uniformBuffers);
+        if (next->hasTextures)
+            g_bindings.textures.Set(next->firstShaderResource, next->numShaderResources, next->textures);
+        if (next->hasStorageBuffers)
+            g_bindings.storageBuffers.Set(next->firstShaderResource, next->numShaderResources, storageBuffers);
+        g_bindings.samplers.Set(next->firstSamplerState, next->numSamplerStates, next->samplers);
+    }
+}
+
+// overridden slots are bound by GL_applyOverrides, the stream values are ignored for them
+// returns the number of draw calls that were merged
+static uint32_t GL_processDrawCommands(
+    const SamplerStateHandle* samplerStates,
+    CommandReader reader, bool merge, const DrawOverrides* overrides = nullptr
+)
+{
+    // process draw calls, the queue only records state changes
+    DrawCall       call;
+    DrawCallMerger merger(merge);
+    GLenum         topology = MapPrimitiveTopology[static_cast<size_t>(PrimitiveTopology::TriangleList)];
+
+    const GLBindGroupImpl* bindGroups[DrawCall::kMaxBindGroups] = { nullptr };
+
+    auto issue = [&topology](const DrawCall& drawCall) { GL_drawCall(topology, drawCall); };
+
+    uint8_t opcode = 0;
+    while (reader.ReadOpcode(opcode)) {
+        if (opcode > DrawCommand::LastDraw)
+            merger.Flush(issue);
+
+        switch (opcode) {
+        case DrawCommand::SetPrimitiveTopology: {
+            uint8_t value = reader.Read<uint8_t>();
+            topology = MapPrimitiveTopology[value];
+            merger.SetTopology(static_cast<PrimitiveTopology>(value));
+        } break;
+
+        case DrawCommand::SetVertexBuffer: {
+            uint8_t       slot         = reader.Read<uint8_t>();
+            GLBufferImpl* vertexBuffer = g_buffers.Get(reader.Read<void*>());
+
+            // vertex layout lives in the VAO, only the first stream is bound
+            if (slot == 0) {
+                if (vertexBuffer != nullptr)
+                    GL_requireBarrier(vertexBuffer->writeEpoch, GLBarrier::VertexAttribArray);
+                glBindBuffer(GL_ARRAY_BUFFER, (vertexBuffer != nullptr) ? vertexBuffer->bufferID : 0);
+            }
+        } break;
+
+        case DrawCommand::SetIndexBuffer: {
+            GLBufferImpl* indexBuffer = g_buffers.Get(reader.Read<void*>());
+            if (indexBuffer != nullptr)
+                GL_requireBarrier(indexBuffer->writeEpoch, GLBarrier::ElementArray);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (indexBuffer != nullptr) ? indexBuffer->bufferID : 0);
+        } break;
+
+        case DrawCommand::SetConstantBuffer: {
+            GLuint        slot   = reader.Read<uint8_t>();
+            GLBufferImpl* buffer = g_buffers.Get(reader.Read<void*>());
+
+            if (overrides == nullptr || !overrides->constantBufferMask.Test(slot)) {
+                if (buffer != nullptr)
+                    GL_requireBarrier(buffer->writeEpoch, GLBarrier::Uniform);
+                g_bindings.uniformBuffers.Set(slot, (buffer != nullptr) ? buffer->bufferID : 0);
+            }
+        } break;
+
+        case DrawCommand::SetConstants: {
+            GLuint         slot = reader.Read<uint8_t>();
+            uint32_t       size = reader.Read<uint32_t>();
+            const uint8_t* data = reader.ReadBytes(size);
+
+            if (overrides == nullptr || !overrides->constantBufferMask.Test(slot))
+                g_bindings.uniformBuffers.Set(slot, GL_allocateConstants(data, size));
+        } break;
+
+        case DrawCommand::SetResource: {
+            // shader resources can be either a buffer or a texture
+            GLuint slot      = reader.Read<uint8_t>();
+            bool   isTexture = reader.Read<uint8_t>() != 0;
+            void*  resource  = reader.Read<void*>();
+
+            if (overrides == nullptr || !overrides->shaderResourceMask.Test(slot))
+                GL_bindResource(slot, isTexture, resource);
+        } break;
+
+        case DrawCommand::SetBindGroup: {
+            uint8_t                slot  = reader.Read<uint8_t>();
+            const GLBindGroupImpl* group = static_cast<const GLBindGroupImpl*>(static_cast<const BindGroup*>(reader.Read<void*>()));
+
+            GL_setBindGroup(samplerStates, bindGroups[slot], group);
+            bindGroups[slot] = group;
+            if (group != nullptr)
+                GL_requireBarriers(group);
+
+            if (overrides != nullptr)
+                GL_applyOverrides(*overrides);
+        } break;
+
+        case DrawCommand::Draw:
+        case DrawCommand::DrawIndexed:
+        case DrawCommand::DrawInstanced:
+        case DrawCommand::DrawIndexedInstanced:
+        case DrawCommand::DrawInstancedIndirect:
+        case DrawCommand::DrawIndexedInstancedIndirect:
+        case DrawCommand::MultiDrawIndexedIndirect: {
+            DrawQueue::readDrawCall(reader, opcode, call);
+
+            if (call.type >= DrawCall::DrawInstancedIndirect) {
+                GLBufferImpl* argsBuffer  = g_buffers.Get(call.indirectArgsBuffer.value);
+                GLBufferImpl* countBuffer = (call.type == DrawCall::MultiDrawIndexedIndirect) ? g_buffers.Get(call.indirectCountBuffer.value) : nullptr;
+                if (argsBuffer != nullptr)
+                    GL_requireBarrier(argsBuffer->writeEpoch, GLBarrier::Command);
+                if (countBuffer != nullptr)
+                    GL_requireBarrier(countBuffer->writeEpoch, GLBarrier::Command);
+            }
+
+            // draws that are merged share the bindings, state commands flush the merger first
+            GL_flushBindings();
+            GL_flushBarriers();
+            merger.Add(call, issue);
+        } break;
+        }
+    }
+
+    merger.Flush(issue);
+    return merger.GetNumMerged();
+}
+
+static void GL_processDrawQueue(DrawQueue* queue)
+{
+    g_boundPipeline = GLBoundPipeline();
+
+    GL_setPipelineState(queue->getState());
+    GL_setSamplerStates(queue->samplerStates);
+
+    bool     merge     = queue->isMergingEnabled();
+    uint32_t numMerged = GL_processDrawCommands(queue->samplerStates, CommandReader(queue->getCommands()), merge);
+
+    // children are walked in place, in creation order, bindings are reset between them
+    for (const DrawQueue* child : queue->getChildren()) {
+        if (child->getNumDrawCalls() != 0) {
+            GL_resetBindings();
+            GL_setSamplerStates(queue->samplerStates);
+            numMerged += GL_processDrawCommands(queue->samplerStates, CommandReader(child->getCommands()), merge);
+        }
+    }
+
+    queue->setNumMergedDrawCalls(numMerged);
+    GL_clearBindings();
+}
+
+static void GL_processDrawBundle(const DrawBundle* bundle)
+{
+    g_boundPipeline = GLBoundPipeline();
+
+    GL_setPipelineState(bundle->getState());
+
+    const DrawOverrides* overrides = bundle->overrides.isEmpty() ? nullptr : &bundle->overrides;
+
+    for (size_t i = 0; i < bundle->getNumStreams(); ++i) {
+        if (i != 0)
+            GL_resetBindings();
+
+        GL_setSamplerStates(bundle->samplerStates);
+
+        if (overrides != nullptr)
+            GL_applyOverrides(*overrides);
+
+        GL_processDrawCommands(bundle->samplerStates, bundle->getStream(i), false, overrides);
+    }
+
+    GL_clearBindings();
+}
+
+static void GL_processSortedDrawQueues(const DrawQueueSorter& sorter)
+{
+    g_boundPipeline = GLBoundPipeline();
+
+    const DrawQueue* queue = nullptr;
+    void*            state = nullptr;
+
+    for (size_t i = 0; i < sorter.GetSize(); ++i) {
+        const DrawQueueSorter::Item& item = sorter[i];
+
+        if (item.queue != queue) {
+            queue = item.queue;
+
+            PipelineStateHandle nextState = queue->getState();
+            if (nextState.value != state) {
+                state = nextState.value;
+                GL_setPipelineState(nextState);
+            }
+        }
+
+        // every range is delta encoded from the empty state, so reset bindings between ranges. The
+        // slots diff against what the previous range bound, bindings it shares are not bound again
+        GL_resetBindings();
+        GL_setSamplerStates(queue->samplerStates);
+
+        uint32_t numMerged = GL_processDrawCommands(queue->samplerStates, CommandReader(item.begin, item.end), queue->isMergingEnabled());
+        queue->setNumMergedDrawCalls(queue->getNumMergedDrawCalls() + numMerged);
+    }
+
+    GL_clearBindings();
+}
+
+//=============================================================================
+bool initOpenGL()
+{
+    glewInit();
+    g_contextThread = std::this_thread::get_id();
+    GL_invalidateStateShadow();
+    return true;
+}
+
+void shutdown()
+{
+    g_deferredReleases.RetireAll(GL_releaseDeferred);
+    GL_releaseConstantRing();
+    GL_releaseFrameFences();
+    GL_releaseFences();
+}
+
+void setAllocator(AllocFunc nalloc, FreeFunc nfree)
+{
+    g_allocFunc = nalloc;
+    g_freeFunc  = nfree;
+}
+
+void* allocate(size_t size)
+{
+    return g_allocFunc(size);
+}
+
+void deallocate(void* ptr)
+{
+    return g_freeFunc(ptr);
+}
+
+uint64_t getGPUCaps()
+{
+    uint64_t caps = 0;
+
+    // default features, the blend state and integer and float formats are core in GL 4
+    caps |= GPUCaps::AlphaToCoverage;
+    caps |= GPUCaps::SeparateBlend;
+
+    caps |= GPUCaps::TextureFormatInteger;
+    caps |= GPUCaps::TextureFormatFloat;
+
+    if (GLEW_EXT_texture_compression_s3tc)
+        caps |= GPUCaps::TextureCompressionDXT;
+
+    // compute shaders read and write buffers as shader storage blocks
+    if (GLEW_ARB_compute_shader)
+        caps |= GPUCaps::ComputeShader;
+
+    if (GLEW_ARB_shader_storage_buffer_object) {
+        caps |= GPUCaps::StructuredBuffer;
+        caps |= GPUCaps::RWStructuredBuffer;
+    }
+
+    // geometry and tessellation shaders, render targets, texture and cubemap arrays and stream
+    // output are not implemented by this backend and are never reported, neither are the PVR and
+    // ETC formats it has no mapping for
+    return caps;
+}
+
+//-------------------------------------------------------------------------------------------------
+bool compileShader(
+    const char*                 sourceCode,
+    size_t                      sourceCodeSize,
+    ShaderCompileVersion        version,
+    ShaderCompileTarget         target,
+    const ShaderCompileMacro*   macros,
+    size_t                      macrosSize,
+    uint64_t                    flags,
+    ErrorReportFunc             errorFunc,
+
+    void*&  outData, // delete []
+    size_t& outDataSize
+)
+{
+    return false;
+}
+
+//-------------------------------------------------------------------------------------------------
+ComputeQueueHandle createComputeQueue(ComputeShaderHandle shader)
+{
+    ComputeQueue* queue = new ComputeQueue;
+    queue->shader = shader;
+
+    return ComputeQueueHandle(queue);
+}
+
+void releaseComputeQueue(ComputeQueueHandle handle)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        delete queue;
+    }
+}
+
+void setConstantBuffer(ComputeQueueHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        queue->setConstantBuffer(idx, buffer);
+    }
+}
+
+void setResource(ComputeQueueHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        queue->setResource(idx, resource);
+    }
+}
+
+void setResource(ComputeQueueHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        queue->setResource(idx, resource);
+    }
+}
+
+void setResourceRW(ComputeQueueHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        queue->setResourceRW(idx, resource);
+    }
+}
+
+void setResourceRW(ComputeQueueHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        queue->setResourceRW(idx, resource);
+    }
+}
+
+// bindings stay in place between dispatches, only the slots that changed are bound and only the
+// barriers for resources written by earlier dispatches are issued
+void submit(ComputeQueueHandle handle, uint32_t x, uint32_t y, uint32_t z)
+{
+    if (handle == ComputeQueueHandle::invalidHandle())
+        return;
+
+    GL_processPendingTasks();
+
+    ComputeQueue*        queue  = static_cast<ComputeQueue*>(handle.value);
+    GLComputeShaderImpl* shader = static_cast<GLComputeShaderImpl*>(queue->shader.value);
+    if (shader == nullptr)
+        return;
+
+    GL_useProgram(shader->programID);
+    GL_setSamplerStates(queue->samplerStates);
+
+    for (uint32_t i = 0; i < ComputeQueue::kMaxConstantBuffers; ++i) {
+        GLBufferImpl* buffer = g_buffers.Get(queue->constantBuffers[i].value);
+        if (buffer != nullptr)
+            GL_requireBarrier(buffer->writeEpoch, GLBarrier::Uniform);
+        g_bindings.uniformBuffers.Set(i, (buffer != nullptr) ? buffer->bufferID : 0);
+    }
+
+    // read-only resources, buffers past the read-only storage bindings are dropped
+    uint32_t numShaderResources = static_cast<uint32_t>(queue->shaderResources.GetSize());
+    if (numShaderResources > DrawCall::kMaxShaderResources)
+        numShaderResources = DrawCall::kMaxShaderResources;
+
+    g_bindings.textures.Reset(numShaderResources);
+    for (uint32_t i = 0; i < numShaderResources; ++i) {
+        const ShaderResource& resource = queue->shaderResources[i];
+
+        GLTextureImpl* texture = resource.isTexture ? g_textures.Get(resource.value) : nullptr;
+        if (texture != nullptr)
+            GL_requireBarrier(texture->writeEpoch, GLBarrier::TextureFetch);
+        g_bindings.textures.Set(i, (texture != nullptr) ? texture->textureID : 0);
+    }
+
+    for (uint32_t i = 0; i < GLBindings::kStorageBindingRW; ++i) {
+        const ShaderResource* resource = (i < numShaderResources) ? &queue->shaderResources[i] : nullptr;
+
+        GLBufferImpl* buffer = (resource != nullptr && !resource->isTexture) ? g_buffers.Get(resource->value) : nullptr;
+        if (buffer != nullptr)
+            GL_requireBarrier(buffer->writeEpoch, GLBarrier::ShaderStorage);
+        g_bindings.storageBuffers.Set(i, (buffer != nullptr) ? buffer->bufferID : 0);
+    }
+
+    // read-write resources, textures go to image units, buffers to storage bindings and their counters
+    GLBufferImpl*  buffersRW[ComputeQueue::kMaxShaderResourcesRW];
+    GLTextureImpl* texturesRW[ComputeQueue::kMaxShaderResourcesRW];
+
+    for (uint32_t i = 0; i < ComputeQueue::kMaxShaderResourcesRW; ++i) {
+        const ShaderResource& resource = queue->shaderResourcesRW[i];
+
+        buffersRW[i]  = resource.isTexture ? nullptr : g_buffers.Get(resource.value);
+        texturesRW[i] = resource.isTexture ? g_textures.Get(resource.value) : nullptr;
+
+        GLuint bufferID  = 0;
+        GLuint counterID = 0;
+        GLuint textureID = 0;
+
+        if (buffersRW[i] != nullptr) {
+            bufferID  = buffersRW[i]->bufferID;
+            counterID = buffersRW[i]->counterID;
+
+            GL_requireBarrier(buffersRW[i]->writeEpoch, GLBarrier::ShaderStorage);
+            if (counterID != 0)
+                GL_requireBarrier(buffersRW[i]->writeEpoch, GLBarrier::AtomicCounter);
+        }
+
+        if (texturesRW[i] != nullptr) {
+            textureID = texturesRW[i]->textureID;
+            GL_requireBarrier(texturesRW[i]->writeEpoch, GLBarrier::ShaderImageAccess);
+        }
+
+        g_bindings.storageBuffers.Set(GLBindings::kStorageBindingRW + i, bufferID);
+        g_bindings.atomicCounters.Set(i, counterID);
+        g_bindings.images.Set(i, textureID);
+    }
+
+    GL_flushBindings();
+    GL_flushBarriers();
+
+    glDispatchCompute(x, y, z);
+
+    // stamp what the dispatch wrote, the next reads of these resources need a barrier
+    ++g_writeEpoch;
+    for (uint32_t i = 0; i < ComputeQueue::kMaxShaderResourcesRW; ++i) {
+        if (buffersRW[i] != nullptr)
+            buffersRW[i]->writeEpoch = g_writeEpoch;
+        if (texturesRW[i] != nullptr)
+            texturesRW[i]->writeEpoch = g_writeEpoch;
+    }
+}
+
+// data is the GLSL source of the shader, dataSize its length
+ComputeShaderHandle createComputeShader(const void* data, size_t dataSize)
+{
+    const GLchar* source = static_cast<const GLchar*>(data);
+    GLint         length = static_cast<GLint>(dataSize);
+    GLint         status = GL_FALSE;
+
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &source, &length);
+    glCompileShader(shader);
+
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        glDeleteShader(shader);
+        return ComputeShaderHandle::invalidHandle(); // TODO: error handling
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDetachShader(program, shader);
+    glDeleteShader(shader);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        glDeleteProgram(program);
+        return ComputeShaderHandle::invalidHandle(); // TODO: error handling
+    }
+
+    return ComputeShaderHandle(new GLComputeShaderImpl(program));
+}
+
+void releaseComputeShader(ComputeShaderHandle handle)
+{
+    if (handle != ComputeShaderHandle::invalidHandle()) {
+        GLComputeShaderImpl* impl = static_cast<GLComputeShaderImpl*>(handle.value);
+
+        // a program in use is only deleted once it is unbound
+        if (g_stateShadow.program == impl->programID)
+            GL_useProgram(0);
+        delete impl;
+    }
+}
+
+VertexFormatHandle createVertexFormat(
+    VertexElementDescriptor* elements,
+    size_t                   size,
+    void* shaderBytecode, size_t shaderBytecodeSize,
+    ErrorReportFunc          errorReport
+)
+{
+    StateKey key;
+    for (size_t i = 0; i < size; ++i)
+        addStateKey(key, elements[i]);
+
+    GLVertexFormatImpl* impl = g_vertexFormats.Acquire(key, [elements, size]() {
+        GLVertexFormatImpl* newImpl = new GLVertexFormatImpl;
+
+        GL_bindVertexArray(newImpl->vaoID);
+        for (GLuint i = 0; i < size; ++i) {
+            glVertexAttribPointer(
+                i,
+                GL_getInternalSize(elements[i].format),
+                GL_getInternalType(elements[i].format),
+                false,
+                GL_getInternalStride(elements[i].format),
+                reinterpret_cast<const GLvoid*>(elements[i].offset)
+            );
+            glEnableVertexAttribArray(i);
+        }
+        GL_bindVertexArray(0);
+
+        return newImpl;
+    });
+
+    return VertexFormatHandle(impl);
+}
+
+void releaseVertexFormat(VertexFormatHandle handle)
+{
+    if (handle != VertexFormatHandle::invalidHandle()) {
+        GLVertexFormatImpl* impl = static_cast<GLVertexFormatImpl*>(handle.value);
+        if (g_vertexFormats.Release(impl)) {
+            // deleting the bound vertex array binds zero, the name may be reused
+            if (g_stateShadow.vertexArray == impl->vaoID)
+                g_stateShadow.vertexArray = 0;
+            delete impl;
+        }
+    }
+}
+
+template <typename T, typename Desc>
+static SGFX_FORCE_INLINE T* GL_acquireSubState(StateCache<T>& cache, const Desc& desc)
+{
+    StateKey key;
+    addStateKey(key, desc);
+
+    return cache.Acquire(key, [&desc]() {
+        T* impl = new T;
+        impl->desc = desc;
+        return impl;
+    });
+}
+
+template <typename T>
+static SGFX_FORCE_INLINE void GL_releaseSubState(StateCache<T>& cache, T* impl)
+{
+    if (cache.Release(impl))
+        delete impl;
+}
+
+// no GL calls here, the sub-states are applied by GL_setPipelineState
+PipelineStateHandle createPipelineState(const PipelineStateDescriptor& desc)
+{
+    GLRasterizerStateImpl*   rasterizerState   = GL_acquireSubState(g_rasterizerStates, desc.rasterizerState);
+    GLBlendStateImpl*        blendState        = GL_acquireSubState(g_blendStates, desc.blendState);
+    GLDepthStencilStateImpl* depthStencilState = GL_acquireSubState(g_depthStencilStates, desc.depthStencilState);
+    GLVertexFormatImpl*      vertexFormat      = static_cast<GLVertexFormatImpl*>(desc.vertexFormat.value);
+
+    StateKey key;
+    key.AddPointer(rasterizerState);
+    key.AddPointer(blendState);
+    key.AddPointer(depthStencilState);
+    key.AddPointer(vertexFormat);
+
+    bool created = false;
+    GLPipelineStateImpl* impl = g_pipelineStates.Acquire(key, [&]() {
+        GLPipelineStateImpl* newImpl = new GLPipelineStateImpl;
+        newImpl->rasterizerState   = rasterizerState;
+        newImpl->blendState        = blendState;
+        newImpl->depthStencilState = depthStencilState;
+        newImpl->vertexFormat      = vertexFormat;
+
+        created = true;
+        return newImpl;
+    });
+
+    // the existing pipeline holds its own references
+    if (!created) {
+        GL_releaseSubState(g_rasterizerStates, rasterizerState);
+        GL_releaseSubState(g_blendStates, blendState);
+        GL_releaseSubState(g_depthStencilStates, depthStencilState);
+    }
+
+    return PipelineStateHandle(impl);
+}
+
+void releasePipelineState(PipelineStateHandle handle)
+{
+    if (handle != PipelineStateHandle::invalidHandle()) {
+        GLPipelineStateImpl* impl = static_cast<GLPipelineStateImpl*>(handle.value);
+        if (g_pipelineStates.Release(impl)) {
+            GL_releaseSubState(g_rasterizerStates, impl->rasterizerState);
+            GL_releaseSubState(g_blendStates, impl->blendState);
+            GL_releaseSubState(g_depthStencilStates, impl->depthStencilState);
+            delete impl;
+        }
+    }
+}
+
+BufferHandle createBuffer(uint32_t flags, const void* mem, size_t size, size_t stride)
+{
+    GLBufferImpl* impl   = nullptr;
+    void*         handle = g_buffers.Create(impl);
+    if (handle == nullptr)
+        return BufferHandle::invalidHandle(); // out of handles
 
     enum class AccessFrequency { Static, Dynamic };
     enum class AccessNature    { Draw,   Read, Copy };
@@ -776,108 +2322,176 @@ BufferHandle createBuffer(uint32_t flags, const void* mem, size_t size, size_t s
 
     impl->isImmutable  = isImmutable; // TODO: proper immutable buffers with glBufferStorage
     impl->isStructured = (flags & BufferFlags::StructuredBuffer) != 0;
+    impl->hasCounter   = (flags & (BufferFlags::GPUCounter | BufferFlags::GPUAppend)) != 0;
     impl->dataSize     = size;
     impl->dataStride   = stride;
 
-    glNamedBufferDataEXT(impl->bufferID, size, mem, glUsage);
+    // buffers that are only written by the CPU are streamed through persistently mapped copies
+    const uint32_t kNotStreamed = BufferFlags::CPURead | BufferFlags::GPUWrite | BufferFlags::GPUCounter | BufferFlags::GPUAppend | BufferFlags::StreamOutput;
+    impl->isStreaming = (flags & BufferFlags::CPUWrite) && !(flags & kNotStreamed) && size != 0 && GLEW_ARB_buffer_storage;
 
-    return BufferHandle(impl);
+    GL_initBuffer(handle, impl, mem, glUsage);
+
+    return BufferHandle(handle);
 }
 
 void releaseBuffer(BufferHandle handle)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        GLBufferImpl* impl = static_cast<GLBufferImpl*>(handle.value);
-        delete impl;
-    }
+    if (!GL_deferBufferRelease(handle.value, DeferredReleaseQueue::Type::Buffer))
+        GL_releaseBuffer(handle.value);
 }
 
-void* mapBuffer(BufferHandle handle, MapType type)
+bool isValid(BufferHandle handle)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        GLBufferImpl* impl = static_cast<GLBufferImpl*>(handle.value);
+    return g_buffers.IsValid(handle.value);
+}
 
-        return glMapNamedBufferEXT(impl->bufferID, MapMapType[static_cast<uint64_t>(type)]);
+// a write map of a streaming buffer moves to its next copy and returns the persistent mapping, the
+// copy is only waited for when it may still be read by an earlier frame in flight
+static SGFX_FORCE_INLINE void* GL_mapStreamingBuffer(GLBufferImpl* impl)
+{
+    impl->regions[impl->region].frame = g_frames.frameIndex;
+    impl->region = (impl->region + 1) % GLFrameFences::kMaxFramesInFlight;
+
+    GLStreamingRegion& region = impl->regions[impl->region];
+    if (region.frame > g_frames.completedFrame && !GL_waitForFrame(region.frame)) {
+        // the frame being recorded has no fence to wait for (mapped more often than there are
+        // copies, or endFrame isn't called): orphan the copy, GL keeps the old storage alive
+        // for the draw calls that still read it
+        GL_forgetBuffer(region.bufferID, 0);
+        glDeleteBuffers(1, &region.bufferID);
+        GL_createStreamingRegion(region, impl->dataSize, nullptr);
+
+        g_stats.numStreamingOrphans += 1;
     }
 
-    return nullptr;
+    impl->bufferID = region.bufferID;
+    g_stats.numStreamingMaps += 1;
+
+    return region.data;
 }
 
-void unmapBuffer(BufferHandle handle)
+void* mapBuffer(BufferHandle handle, MapType type, size_t offset, size_t size)
+{
+    GL_processPendingTasks();
+    GLBufferImpl* impl = g_buffers.Get(handle.value);
+    if (impl == nullptr || size == 0 || offset + size > impl->dataSize)
+        return nullptr; // TODO: error handling
+
+    if (impl->regions != nullptr) {
+        // no overwrite keeps writing the current copy, the application does not touch ranges in use
+        switch (type) {
+        case MapType::Write: {
+            return static_cast<uint8_t*>(GL_mapStreamingBuffer(impl)) + offset;
+        }
+        case MapType::WriteNoOverwrite: {
+            g_stats.numStreamingMaps += 1;
+            return impl->regions[impl->region].data + offset;
+        }
+        default: {
+            return nullptr; // TODO: error handling, streaming buffers are write only
+        }
+        }
+    }
+
+    GL_requireBarrier(impl->writeEpoch, GLBarrier::BufferUpdate);
+    GL_flushBarriers();
+    return glMapNamedBufferRangeEXT(impl->bufferID, offset, size, MapMapType[static_cast<uint64_t>(type)]);
+}
+
+void* mapBuffer(BufferHandle handle, MapType type)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        GLBufferImpl* impl = static_cast<GLBufferImpl*>(handle.value);
+    GLBufferImpl* impl = g_buffers.Get(handle.value);
+    return (impl != nullptr) ? mapBuffer(handle, type, 0, impl->dataSize) : nullptr;
+}
 
+void unmapBuffer(BufferHandle handle)
+{
+    GL_processPendingTasks();
+    GLBufferImpl* impl = g_buffers.Get(handle.value);
+    if (impl != nullptr && impl->regions == nullptr) {
         glUnmapNamedBufferEXT(impl->bufferID);
     }
 }
 
 void copyBufferData(BufferHandle handle, size_t offset, size_t size, const void* mem)
 {
-    if (handle != BufferHandle::invalidHandle()) {
-        GLBufferImpl* impl = static_cast<GLBufferImpl*>(handle.value);
-
+    GL_processPendingTasks();
+    GLBufferImpl* impl = g_buffers.Get(handle.value);
+    if (impl != nullptr) {
+        GL_requireBarrier(impl->writeEpoch, GLBarrier::BufferUpdate);
+        GL_flushBarriers();
         glNamedBufferSubDataEXT(impl->bufferID, offset, size, mem);
     }
 }
 
 ConstantBufferHandle createConstantBuffer(const void* mem, size_t size)
 {
-    GLBufferImpl* impl = new GLBufferImpl;
+    GLBufferImpl* impl   = nullptr;
+    void*         handle = g_buffers.Create(impl);
+    if (handle == nullptr)
+        return ConstantBufferHandle::invalidHandle(); // out of handles
 
     impl->isImmutable  = false;
     impl->isStructured = false;
     impl->isConstant   = false;
     impl->dataSize     = size;
 
-    glNamedBufferDataEXT(impl->bufferID, size, mem, GL_DYNAMIC_DRAW);
+    GL_initBuffer(handle, impl, mem, GL_DYNAMIC_DRAW);
 
-    return ConstantBufferHandle(impl);
+    return ConstantBufferHandle(handle);
 }
 
 void updateConstantBuffer(ConstantBufferHandle handle, const void* mem)
 {
-    if (handle != ConstantBufferHandle::invalidHandle()) {
-        GLBufferImpl* impl = static_cast<GLBufferImpl*>(handle.value);
-
+    GL_processPendingTasks();
+    GLBufferImpl* impl = g_buffers.Get(handle.value);
+    if (impl != nullptr) {
+        GL_requireBarrier(impl->writeEpoch, GLBarrier::BufferUpdate);
+        GL_flushBarriers();
         glNamedBufferSubDataEXT(impl->bufferID, 0, impl->dataSize, mem);
     }
 }
 
 void releaseConstantBuffer(ConstantBufferHandle handle)
 {
-    if (handle != ConstantBufferHandle::invalidHandle()) {
-        GLBufferImpl* impl = static_cast<GLBufferImpl*>(handle.value);
-        delete impl;
-    }
+    if (!GL_deferBufferRelease(handle.value, DeferredReleaseQueue::Type::ConstantBuffer))
+        GL_releaseBuffer(handle.value);
 }
 
 SamplerStateHandle createSamplerState(const SamplerStateDescriptor& desc)
 {
-    GLSamplerStateImpl* impl = new GLSamplerStateImpl;
-
-    // filter
-    const GLTexFilter& filterImpl = MapTextureFilter[static_cast<uint64_t>(desc.filter)];
-
-    // color
-    float fcolor[4];
-    fcolor[0] = static_cast<float>((desc.borderColor >> 0)  & 0xFF) / 255.0F;
-    fcolor[1] = static_cast<float>((desc.borderColor >> 8)  & 0xFF) / 255.0F;
-    fcolor[2] = static_cast<float>((desc.borderColor >> 16) & 0xFF) / 255.0F;
-    fcolor[3] = static_cast<float>((desc.borderColor >> 24) & 0xFF) / 255.0F;
-
-    // init sampler
-    glSamplerParameteri (impl->samplerID, GL_TEXTURE_MIN_FILTER, filterImpl.min);
-    glSamplerParameteri (impl->samplerID, GL_TEXTURE_MAG_FILTER, filterImpl.mag);
-    glSamplerParameteri (impl->samplerID, GL_TEXTURE_WRAP_S, MapAddressMode[static_cast<size_t>(desc.addressU)]);
-    glSamplerParameteri (impl->samplerID, GL_TEXTURE_WRAP_T, MapAddressMode[static_cast<size_t>(desc.addressV)]);
-    glSamplerParameteri (impl->samplerID, GL_TEXTURE_WRAP_R, MapAddressMode[static_cast<size_t>(desc.addressW)]);
-    glSamplerParameterf (impl->samplerID, GL_TEXTURE_LOD_BIAS, desc.lodBias);
-    glSamplerParameteri (impl->samplerID, GL_TEXTURE_MAX_ANISOTROPY_EXT, desc.maxAnisotropy);
-    glSamplerParameteri (impl->samplerID, GL_TEXTURE_COMPARE_MODE, MapComparisonFunc[static_cast<size_t>(desc.comparisonFunc)]);
-    glSamplerParameterfv(impl->samplerID, GL_TEXTURE_BORDER_COLOR, fcolor);
-    glSamplerParameterf (impl->samplerID, GL_TEXTURE_MIN_LOD, desc.minLod);
-    glSamplerParameterf (impl->samplerID, GL_TEXTURE_MAX_LOD, desc.maxLod);
+    StateKey key;
+    addStateKey(key, desc);
+
+    GLSamplerStateImpl* impl = g_samplerStates.Acquire(key, [&desc]() {
+        GLSamplerStateImpl* newImpl = new GLSamplerStateImpl;
+
+        // filter
+        const GLTexFilter& filterImpl = MapTextureFilter[static_cast<uint64_t>(desc.filter)];
+
+        // color
+        float fcolor[4];
+        fcolor[0] = static_cast<float>((desc.borderColor >> 0)  & 0xFF) / 255.0F;
+        fcolor[1] = static_cast<float>((desc.borderColor >> 8)  & 0xFF) / 255.0F;
+        fcolor[2] = static_cast<float>((desc.borderColor >> 16) & 0xFF) / 255.0F;
+        fcolor[3] = static_cast<float>((desc.borderColor >> 24) & 0xFF) / 255.0F;
+
+        // init sampler
+        glSamplerParameteri (newImpl->samplerID, GL_TEXTURE_MIN_FILTER, filterImpl.min);
+        glSamplerParameteri (newImpl->samplerID, GL_TEXTURE_MAG_FILTER, filterImpl.mag);
+        glSamplerParameteri (newImpl->samplerID, GL_TEXTURE_WRAP_S, MapAddressMode[static_cast<size_t>(desc.addressU)]);
+        glSamplerParameteri (newImpl->samplerID, GL_TEXTURE_WRAP_T, MapAddressMode[static_cast<size_t>(desc.addressV)]);
+        glSamplerParameteri (newImpl->samplerID, GL_TEXTURE_WRAP_R, MapAddressMode[static_cast<size_t>(desc.addressW)]);
+        glSamplerParameterf (newImpl->samplerID, GL_TEXTURE_LOD_BIAS, desc.lodBias);
+        glSamplerParameteri (newImpl->samplerID, GL_TEXTURE_MAX_ANISOTROPY_EXT, desc.maxAnisotropy);
+        glSamplerParameteri (newImpl->samplerID, GL_TEXTURE_COMPARE_MODE, MapComparisonFunc[static_cast<size_t>(desc.comparisonFunc)]);
+        glSamplerParameterfv(newImpl->samplerID, GL_TEXTURE_BORDER_COLOR, fcolor);
+        glSamplerParameterf (newImpl->samplerID, GL_TEXTURE_MIN_LOD, desc.minLod);
+        glSamplerParameterf (newImpl->samplerID, GL_TEXTURE_MAX_LOD, desc.maxLod);
+
+        return newImpl;
+    });
 
     return SamplerStateHandle(impl);
 }
@@ -886,65 +2500,54 @@ void releaseSamplerState(SamplerStateHandle handle)
 {
     if (handle != SamplerStateHandle::invalidHandle()) {
         GLSamplerStateImpl* impl = static_cast<GLSamplerStateImpl*>(handle.value);
-        delete impl;
+        if (g_samplerStates.Release(impl))
+            delete impl;
     }
 }
 
 Texture1DHandle createTexture1D(uint32_t width, DataFormat format, uint32_t numMipmaps, uint32_t flags)
 {
-    GLTextureImpl* impl = new GLTextureImpl;
+    GLTextureImpl* impl   = nullptr;
+    void*          handle = g_textures.Create(impl);
+    if (handle == nullptr)
+        return Texture1DHandle::invalidHandle(); // out of handles
     impl->numDimensions    = 1;
     impl->glInternalFormat = GL_getInternalFormat(format);
     impl->glType           = GL_getInternalType(format);
 
-    glTextureStorage1DEXT(
-        impl->textureID,
-        GL_TEXTURE_1D,
-        numMipmaps,
-        MapDataFormat[static_cast<size_t>(format)],
-        width
-    );
+    GL_initTexture(handle, impl, format, width, 1, 1, numMipmaps);
 
-    return Texture1DHandle(impl);
+    return Texture1DHandle(handle);
 }
 
 Texture2DHandle createTexture2D(uint32_t width, uint32_t height, DataFormat format, uint32_t numMipmaps, uint32_t flags)
 {
-    GLTextureImpl* impl = new GLTextureImpl;
+    GLTextureImpl* impl   = nullptr;
+    void*          handle = g_textures.Create(impl);
+    if (handle == nullptr)
+        return Texture2DHandle::invalidHandle(); // out of handles
     impl->numDimensions    = 2;
     impl->glInternalFormat = GL_getInternalFormat(format);
     impl->glType           = GL_getInternalType(format);
 
-    glTextureStorage2DEXT(
-        impl->textureID,
-        GL_TEXTURE_2D,
-        numMipmaps,
-        MapDataFormat[static_cast<size_t>(format)],
-        width,
-        height
-    );
+    GL_initTexture(handle, impl, format, width, height, 1, numMipmaps);
 
-    return Texture2DHandle(impl);
+    return Texture2DHandle(handle);
 }
 
 Texture3DHandle createTexture3D(uint32_t width, uint32_t height, uint32_t depth, DataFormat format, uint32_t numMipmaps, uint32_t flags)
 {
-    GLTextureImpl* impl = new GLTextureImpl;
+    GLTextureImpl* impl   = nullptr;
+    void*          handle = g_textures.Create(impl);
+    if (handle == nullptr)
+        return Texture3DHandle::invalidHandle(); // out of handles
     impl->numDimensions    = 3;
     impl->glInternalFormat = GL_getInternalFormat(format);
     impl->glType           = GL_getInternalType(format);
 
-    glTextureStorage3DEXT(
-        impl->textureID,
-        GL_TEXTURE_3D,
-        numMipmaps,
-        MapDataFormat[static_cast<size_t>(format)],
-        width,
-        height,
-        depth
-    );
+    GL_initTexture(handle, impl, format, width, height, depth, numMipmaps);
 
-    return Texture3DHandle(impl);
+    return Texture3DHandle(handle);
 }
 
 void updateTexture(
@@ -956,8 +2559,11 @@ void updateTexture(
     size_t rowPitch, size_t depthPitch
 )
 {
-    if (handle != TextureHandle::invalidHandle()) {
-        GLTextureImpl* impl = static_cast<GLTextureImpl*>(handle.value);
+    GL_processPendingTasks();
+    GLTextureImpl* impl = g_textures.Get(handle.value);
+    if (impl != nullptr) {
+        GL_requireBarrier(impl->writeEpoch, GLBarrier::TextureUpdate);
+        GL_flushBarriers();
 
         if (impl->numDimensions == 1) {
             glTextureSubImage1DEXT(
@@ -994,17 +2600,73 @@ void updateTexture(
 
 void releaseTexture(TextureHandle handle)
 {
-    if (handle != TextureHandle::invalidHandle()) {
-        GLTextureImpl* impl = static_cast<GLTextureImpl*>(handle.value);
-        delete impl;
-    }
+    GLTextureImpl* impl = g_textures.Get(handle.value);
+    if (impl == nullptr || !g_deferredReleases.Push(handle.value, DeferredReleaseQueue::Type::Texture, impl->dataSize))
+        GL_releaseTexture(handle.value);
+}
+
+bool isValid(TextureHandle handle)
+{
+    return g_textures.IsValid(handle.value);
+}
+
+void endFrame()
+{
+    GL_processPendingTasks();
+    GL_fenceFrame();
+    g_frameArena.Reset();
+
+    g_deferredReleases.Retire(g_frames.frameIndex - 1, g_frames.completedFrame, GL_releaseDeferred);
+}
+
+void setDeferredRelease(bool enabled)
+{
+    g_deferredReleases.SetEnabled(enabled);
+}
+
+DeferredReleaseStats getDeferredReleaseStats()
+{
+    return g_deferredReleases.GetStats();
+}
+
+FenceHandle insertFence()
+{
+    // the oldest fence has to complete before its sync object is reused
+    if (g_fences.nextValue - g_fences.completedValue > GLFenceTimeline::kMaxPendingFences)
+        GL_waitForFence(g_fences.completedValue + 1, GL_TIMEOUT_IGNORED);
+
+    uint64_t value = g_fences.nextValue++;
+    g_fences.fences[value % GLFenceTimeline::kMaxPendingFences] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    return FenceHandle(reinterpret_cast<void*>(static_cast<uintptr_t>(value)));
+}
+
+bool isFenceSignaled(FenceHandle fence)
+{
+    return GL_waitForFence(reinterpret_cast<uintptr_t>(fence.value), 0);
+}
+
+bool waitFence(FenceHandle fence, uint64_t timeout)
+{
+    return GL_waitForFence(reinterpret_cast<uintptr_t>(fence.value), timeout);
+}
+
+uint64_t getFrameIndex()
+{
+    return g_frames.frameIndex;
+}
+
+uint64_t getCompletedFrameIndex()
+{
+    GL_updateCompletedFrames();
+    return g_frames.completedFrame;
 }
 
 // draw queue stuff is similar for all APIs
 
 DrawQueueHandle createDrawQueue(PipelineStateHandle state)
 {
-    DrawQueue* queue = new DrawQueue(state);
+    DrawQueue* queue = new DrawQueue(&g_frameArena, state);
     return DrawQueueHandle(queue);
 }
 
@@ -1016,6 +2678,15 @@ void releaseDrawQueue(DrawQueueHandle handle)
     }
 }
 
+DrawQueueHandle createChildDrawQueue(DrawQueueHandle parent)
+{
+    if (parent != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = new DrawQueue(static_cast<DrawQueue*>(parent.value));
+        return DrawQueueHandle(queue);
+    }
+    return DrawQueueHandle::invalidHandle();
+}
+
 void setSamplerState(DrawQueueHandle handle, uint32_t idx, SamplerStateHandle sampler)
 {
     if (handle != DrawQueueHandle::invalidHandle()) {
@@ -1056,6 +2727,14 @@ void setConstantBuffer(DrawQueueHandle handle, uint32_t idx, ConstantBufferHandl
     }
 }
 
+void setConstants(DrawQueueHandle handle, uint32_t idx, const void* data, size_t size)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setConstants(idx, data, size);
+    }
+}
+
 void setResource(DrawQueueHandle handle, uint32_t idx, BufferHandle resource)
 {
     if (handle != DrawQueueHandle::invalidHandle()) {
@@ -1072,6 +2751,63 @@ void setResource(DrawQueueHandle handle, uint32_t idx, TextureHandle resource)
     }
 }
 
+// resolves the object names, so buffers and textures created on other threads need the context
+// thread to process them first
+BindGroupHandle createBindGroup(const BindGroupDescriptor& desc)
+{
+    if (!BindGroup::IsValid(desc))
+        return BindGroupHandle::invalidHandle(); // TODO: error handling
+
+    if (GL_isContextThread())
+        GL_processPendingTasks();
+
+    GLBindGroupImpl* impl = new GLBindGroupImpl(desc);
+
+    for (uint32_t i = 0; i < desc.numConstantBuffers; ++i) {
+        GLBufferImpl* buffer = g_buffers.Get(desc.constantBuffers[i].value);
+        impl->uniformBuffers[i]        = (buffer != nullptr) ? buffer->bufferID : 0;
+        impl->constantBufferHandles[i] = desc.constantBuffers[i].value;
+
+        impl->hasStreamingBuffers |= buffer != nullptr && buffer->isStreaming;
+    }
+
+    for (uint32_t i = 0; i < desc.numShaderResources; ++i) {
+        GLBufferImpl*  buffer  = g_buffers.Get(desc.buffers[i].value);
+        GLTextureImpl* texture = (buffer == nullptr) ? g_textures.Get(desc.textures[i].value) : nullptr;
+
+        impl->storageBuffers[i]  = (buffer != nullptr)  ? buffer->bufferID   : 0;
+        impl->textures[i]        = (texture != nullptr) ? texture->textureID : 0;
+        impl->resourceHandles[i] = (buffer != nullptr)  ? desc.buffers[i].value : desc.textures[i].value;
+
+        impl->hasStorageBuffers   |= buffer != nullptr;
+        impl->hasTextures         |= texture != nullptr;
+        impl->hasStreamingBuffers |= buffer != nullptr && buffer->isStreaming;
+    }
+
+    for (uint32_t i = 0; i < desc.numSamplerStates; ++i) {
+        GLSamplerStateImpl* samplerState = static_cast<GLSamplerStateImpl*>(desc.samplerStates[i].value);
+        impl->samplers[i] = (samplerState != nullptr) ? samplerState->samplerID : 0;
+    }
+
+    return BindGroupHandle(static_cast<BindGroup*>(impl));
+}
+
+void releaseBindGroup(BindGroupHandle handle)
+{
+    if (handle != BindGroupHandle::invalidHandle()) {
+        GLBindGroupImpl* impl = static_cast<GLBindGroupImpl*>(static_cast<BindGroup*>(handle.value));
+        delete impl;
+    }
+}
+
+void setBindGroup(DrawQueueHandle handle, uint32_t idx, BindGroupHandle group)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setBindGroup(idx, group);
+    }
+}
+
 void draw(DrawQueueHandle handle, uint32_t count, uint32_t startVertex)
 {
     if (handle != DrawQueueHandle::invalidHandle()) {
@@ -1104,13 +2840,178 @@ void drawIndexedInstanced(DrawQueueHandle handle, uint32_t instanceCount, uint32
     }
 }
 
+void drawInstancedIndirect(DrawQueueHandle handle, BufferHandle indirectArgs, size_t argsOffset)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->drawInstancedIndirect(indirectArgs, argsOffset);
+    }
+}
+
+void drawIndexedInstancedIndirect(DrawQueueHandle handle, BufferHandle indirectArgs, size_t argsOffset)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->drawIndexedInstancedIndirect(indirectArgs, argsOffset);
+    }
+}
+
+void multiDrawIndexedIndirect(
+    DrawQueueHandle handle,
+    BufferHandle indirectArgs, size_t argsOffset, uint32_t maxDraws,
+    BufferHandle countBuffer,  size_t countOffset,
+    uint32_t stride
+)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->multiDrawIndexedIndirect(indirectArgs, argsOffset, maxDraws, countBuffer, countOffset, stride);
+    }
+}
+
 void submit(DrawQueueHandle handle)
+{
+    GL_processPendingTasks();
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setNumMergedDrawCalls(0);
+        if (!queue->isEmpty()) {
+            GL_processDrawQueue(queue);
+            queue->clear();
+        }
+    }
+}
+
+DrawBundleHandle createDrawBundle(DrawQueueHandle handle)
 {
     if (handle != DrawQueueHandle::invalidHandle()) {
         DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
-        GL_processDrawQueue(queue);
+        if (queue->getState() == PipelineStateHandle::invalidHandle() || queue->isEmpty())
+            return DrawBundleHandle::invalidHandle(); // TODO: error handling
+
+        DrawBundle* bundle = new DrawBundle(queue);
         queue->clear();
+
+        return DrawBundleHandle(bundle);
+    }
+    return DrawBundleHandle::invalidHandle();
+}
+
+void releaseDrawBundle(DrawBundleHandle handle)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        delete bundle;
+    }
+}
+
+void setConstantBuffer(DrawBundleHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        bundle->overrides.setConstantBuffer(idx, buffer);
+    }
+}
+
+void setResource(DrawBundleHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        bundle->overrides.setResource(idx, false, resource.value);
+    }
+}
+
+void setResource(DrawBundleHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        bundle->overrides.setResource(idx, true, resource.value);
+    }
+}
+
+void submitBundle(DrawBundleHandle handle)
+{
+    GL_processPendingTasks();
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        GL_processDrawBundle(bundle);
+    }
+}
+
+void setSortKey(DrawQueueHandle handle, uint64_t key)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setSortKey(key);
+    }
+}
+
+void submit(const DrawQueueHandle* queues, size_t count)
+{
+    GL_processPendingTasks();
+
+    g_drawQueueSorter.Clear();
+
+    for (size_t i = 0; i < count; ++i) {
+        DrawQueueHandle handle = queues[i];
+        if (handle != DrawQueueHandle::invalidHandle()) {
+            DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+            queue->setNumMergedDrawCalls(0);
+            g_drawQueueSorter.Add(queue);
+        }
+    }
+
+    if (!g_drawQueueSorter.IsEmpty()) {
+        g_drawQueueSorter.Sort();
+        GL_processSortedDrawQueues(g_drawQueueSorter);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        DrawQueueHandle handle = queues[i];
+        if (handle != DrawQueueHandle::invalidHandle())
+            static_cast<DrawQueue*>(handle.value)->clear();
+    }
+}
+
+void setDrawMerging(DrawQueueHandle handle, bool enabled)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setMergingEnabled(enabled);
+    }
+}
+
+uint32_t getNumMergedDrawCalls(DrawQueueHandle handle)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        return queue->getNumMergedDrawCalls();
     }
+    return 0;
 }
 
 }
+
+// GL4 backend statistics, not part of the wrapped API
+namespace sgfx
+{
+namespace gl4
+{
+
+const Stats& getStats()
+{
+    return SGFX_BACKEND_NS::g_stats;
+}
+
+void resetStats()
+{
+    SGFX_BACKEND_NS::g_stats = Stats();
+}
+
+void resetStateCache()
+{
+    SGFX_BACKEND_NS::GL_invalidateStateShadow();
+}
+
+}
+}
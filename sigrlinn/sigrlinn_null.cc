@@ -0,0 +1,1620 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+///
+/// Null backend: resources are plain memory and submits walk the draw queues
+/// without talking to a GPU, the work is counted in sgfx::null::Stats.
+///
+#include <memory>
+
+#ifndef SGFX_NS_INTERNAL
+#define SGFX_NS_INTERNAL sgfx_ns_null_internal
+#endif
+
+#ifndef SGFX_BACKEND_NS
+#define SGFX_BACKEND_NS sgfx // capture builds move the backend aside and wrap it
+#endif
+
+#ifndef SGFX_INTERNAL_IMPLEMENTATION
+#define SGFX_INTERNAL_IMPLEMENTATION 1
+#endif
+
+#ifdef _MSC_VER
+#   ifndef SGFX_FORCE_INLINE
+#   define SGFX_FORCE_INLINE __forceinline
+#   endif
+#else
+#   ifndef SGFX_FORCE_INLINE
+#   define SGFX_FORCE_INLINE inline __attribute__((always_inline))
+#   endif
+#endif
+
+#include "sigrlinn.hh"
+#include <stdlib.h>
+
+namespace SGFX_BACKEND_NS
+{
+
+using namespace sgfx;
+using namespace SGFX_NS_INTERNAL;
+
+//=============================================================================
+static inline void* sgfx_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+static inline void sgfx_free(void* ptr)
+{
+    return free(ptr);
+}
+
+//=============================================================================
+
+static AllocFunc       g_allocFunc = sgfx_malloc;
+static FreeFunc        g_freeFunc  = sgfx_free;
+
+// transient draw queue storage
+static FrameArena      g_frameArena;
+
+// sorted submit, keeps its storage between frames
+static DrawQueueSorter g_drawQueueSorter;
+
+static null::Stats     g_stats;
+
+// there is no GPU, fences and frames complete as soon as they are issued
+static uint64_t        g_numFences  = 0;
+static uint64_t        g_frameIndex = 1;
+
+// destroyed by the endFrame of the frame that released them
+static DeferredReleaseQueue g_deferredReleases;
+
+// resources may be created on any thread, their initial data is counted here and folded into
+// g_stats.numBytesUploaded by getStats
+static std::atomic<uint64_t> g_numBytesCreated(0);
+
+//=============================================================================
+template <typename T, typename ...Args>
+static SGFX_FORCE_INLINE T* sgfx_new(Args&&... args)
+{
+    return new (g_allocFunc(sizeof(T))) T(static_cast<Args&&>(args)...);
+}
+
+template <typename T>
+static SGFX_FORCE_INLINE void sgfx_delete(T* t)
+{
+    t->~T();
+    g_freeFunc(t);
+}
+
+//=============================================================================
+// buffers, constant buffers and textures all own a plain block of memory
+struct NullMemory final
+{
+    uint8_t* data     = nullptr;
+    size_t   dataSize = 0;
+
+    SGFX_FORCE_INLINE NullMemory() {}
+    SGFX_FORCE_INLINE ~NullMemory()
+    {
+        if (data != nullptr)
+            g_freeFunc(data);
+    }
+
+    SGFX_FORCE_INLINE bool create(const void* mem, size_t size)
+    {
+        data = static_cast<uint8_t*>(g_allocFunc(size != 0 ? size : 1));
+        if (data == nullptr)
+            return false;
+
+        dataSize = size;
+
+        if (mem != nullptr) {
+            std::memcpy(data, mem, size);
+            g_numBytesCreated.fetch_add(size, std::memory_order_relaxed);
+        } else {
+            std::memset(data, 0, size);
+        }
+        return true;
+    }
+
+    template <typename T>
+    SGFX_FORCE_INLINE void fill(T value)
+    {
+        for (size_t i = 0; i + sizeof(T) <= dataSize; i += sizeof(T))
+            std::memcpy(data + i, &value, sizeof(T));
+    }
+};
+
+// buffers and textures share the same pool, like views do on D3D11
+struct NullResource final
+{
+    NullMemory memory;
+    uint32_t   flags      = 0;
+    size_t     dataStride = 0; // buffers only
+
+    // textures only
+    DataFormat format     = DataFormat::Count;
+    uint32_t   width      = 0;
+    uint32_t   height     = 0;
+    uint32_t   depth      = 0;
+    uint32_t   numMipmaps = 0;
+};
+
+struct NullConstantBufferImpl final
+{
+    NullMemory memory;
+};
+
+struct NullShaderImpl final
+{
+    size_t dataSize = 0;
+};
+
+struct NullSurfaceShaderImpl final
+{
+    VertexShaderHandle   vs;
+    HullShaderHandle     hs;
+    DomainShaderHandle   ds;
+    GeometryShaderHandle gs;
+    PixelShaderHandle    ps;
+};
+
+struct NullVertexFormatImpl final : public StateObject
+{
+    size_t numElements = 0;
+};
+
+struct NullPipelineStateImpl final : public StateObject
+{
+    PipelineStateDescriptor desc;
+};
+
+struct NullSamplerStateImpl final : public StateObject
+{
+    SamplerStateDescriptor desc;
+};
+
+struct NullRenderTargetImpl final
+{
+    RenderTargetDescriptor desc;
+};
+
+static HandlePool<NullResource> g_resources;
+
+// identical descriptors share one object
+static StateCache<NullVertexFormatImpl>  g_vertexFormats;
+static StateCache<NullPipelineStateImpl> g_pipelineStates;
+static StateCache<NullSamplerStateImpl>  g_samplerStates;
+
+static Texture2DHandle          g_backBuffer;
+
+//=============================================================================
+// row pitch, number of rows and slice pitch of a mip level, rows are block rows for compressed formats
+struct NullMipLayout final
+{
+    size_t offset     = 0;
+    size_t rowPitch   = 0;
+    size_t numRows    = 0;
+    size_t slicePitch = 0;
+    size_t depth      = 0;
+};
+
+static NullMipLayout nullMipLayout(DataFormat format, uint32_t width, uint32_t height, uint32_t depth, uint32_t mip)
+{
+    size_t block = isCompressedFormat(format) ? 4 : 1;
+
+    NullMipLayout layout;
+    for (uint32_t i = 0; i <= mip; ++i) {
+        size_t mipWidth  = (width  >> i) != 0 ? (width  >> i) : 1;
+        size_t mipHeight = (height >> i) != 0 ? (height >> i) : 1;
+        size_t mipDepth  = (depth  >> i) != 0 ? (depth  >> i) : 1;
+
+        layout.offset    += layout.slicePitch * layout.depth;
+        layout.rowPitch   = ((mipWidth + block - 1) / block) * getFormatSize(format);
+        layout.numRows    = (mipHeight + block - 1) / block;
+        layout.slicePitch = layout.rowPitch * layout.numRows;
+        layout.depth      = mipDepth;
+    }
+    return layout;
+}
+
+static TextureHandle nullCreateTexture(uint32_t width, uint32_t height, uint32_t depth, DataFormat format, uint32_t numMipmaps, uint32_t flags)
+{
+    if (getFormatSize(format) == 0 || width == 0 || height == 0 || depth == 0)
+        return TextureHandle::invalidHandle(); // TODO: error handling
+
+    if (numMipmaps == 0)
+        numMipmaps = 1;
+
+    // the layout of the mip past the last one starts where the storage ends
+    NullMipLayout end = nullMipLayout(format, width, height, depth, numMipmaps);
+
+    NullResource* texture = nullptr;
+    void*         handle  = g_resources.Create(texture);
+    if (handle == nullptr)
+        return TextureHandle::invalidHandle(); // out of handles
+
+    texture->flags      = flags;
+    texture->format     = format;
+    texture->width      = width;
+    texture->height     = height;
+    texture->depth      = depth;
+    texture->numMipmaps = numMipmaps;
+
+    if (!texture->memory.create(nullptr, end.offset)) {
+        g_resources.Release(handle);
+        return TextureHandle::invalidHandle(); // TODO: error handling
+    }
+
+    return TextureHandle(handle);
+}
+
+static void nullReleaseDeferred(const DeferredReleaseQueue::Entry& entry)
+{
+    if (entry.type == DeferredReleaseQueue::Type::ConstantBuffer)
+        sgfx_delete(static_cast<NullConstantBufferImpl*>(entry.handle));
+    else
+        g_resources.Release(entry.handle);
+}
+
+//=============================================================================
+// reads a uint32_t from a buffer, used to count indirect draws like the GPU would execute them
+static SGFX_FORCE_INLINE bool nullReadBuffer(BufferHandle handle, size_t offset, uint32_t& value)
+{
+    NullResource* buffer = g_resources.Get(handle.value);
+    if (buffer == nullptr || offset + sizeof(uint32_t) > buffer->memory.dataSize)
+        return false;
+
+    std::memcpy(&value, buffer->memory.data + offset, sizeof(uint32_t));
+    return true;
+}
+
+// indirect args are laid out like D3D11 ones, count and instance count come first
+static SGFX_FORCE_INLINE void nullIndirectDraw(BufferHandle args, size_t offset)
+{
+    uint32_t count         = 0;
+    uint32_t instanceCount = 0;
+
+    if (nullReadBuffer(args, offset, count) && nullReadBuffer(args, offset + sizeof(uint32_t), instanceCount)) {
+        g_stats.numDrawCalls += 1;
+        g_stats.numVertices  += static_cast<uint64_t>(count) * instanceCount;
+        g_stats.numInstances += instanceCount;
+    }
+}
+
+static SGFX_FORCE_INLINE void nullDrawCall(const DrawCall& call)
+{
+    switch (call.type) {
+    case DrawCall::Draw:
+    case DrawCall::DrawIndexed: {
+        g_stats.numDrawCalls += 1;
+        g_stats.numVertices  += call.count;
+        g_stats.numInstances += 1;
+    } break;
+
+    case DrawCall::DrawInstanced:
+    case DrawCall::DrawIndexedInstanced: {
+        g_stats.numDrawCalls += 1;
+        g_stats.numVertices  += static_cast<uint64_t>(call.count) * call.instanceCount;
+        g_stats.numInstances += call.instanceCount;
+    } break;
+
+    case DrawCall::DrawInstancedIndirect:
+    case DrawCall::DrawIndexedInstancedIndirect: {
+        g_stats.numIndirectDrawCalls += 1;
+        nullIndirectDraw(call.indirectArgsBuffer, call.indirectArgsOffset);
+    } break;
+
+    case DrawCall::MultiDrawIndexedIndirect: {
+        g_stats.numIndirectDrawCalls += 1;
+
+        uint32_t numDraws = call.maxDrawCount;
+        uint32_t count    = 0;
+        if (nullReadBuffer(call.indirectCountBuffer, call.indirectCountOffset, count) && count < numDraws)
+            numDraws = count;
+
+        // like D3D11, nothing is drawn unless the last of maxDrawCount records fits in the buffer
+        size_t        stride = (call.indirectStride != 0) ? call.indirectStride : 5 * sizeof(uint32_t);
+        NullResource* args   = g_resources.Get(call.indirectArgsBuffer.value);
+        if (args == nullptr || call.maxDrawCount == 0 ||
+            call.indirectArgsOffset + (call.maxDrawCount - 1) * stride + 5 * sizeof(uint32_t) > args->memory.dataSize)
+            break;
+
+        for (uint32_t i = 0; i < numDraws; ++i)
+            nullIndirectDraw(call.indirectArgsBuffer, call.indirectArgsOffset + i * stride);
+    } break;
+
+    }
+}
+
+// slot values the way a GPU backend tracks them, flushes count the ranges it would bind
+struct NullBindings final
+{
+    BindingSlots<void*, DrawCall::kMaxConstantBuffers>          constantBuffers;
+    BindingSlots<void*, DrawCall::kMaxShaderResources>          resources;
+    BindingSlots<void*, ComputeQueue::kMaxShaderResourcesRW>    resourcesRW;
+};
+
+static NullBindings g_drawBindings;
+static NullBindings g_computeBindings;
+
+static void nullFlushBindings(NullBindings& bindings)
+{
+    auto count = [](uint32_t, uint32_t, void* const*) { g_stats.numBindCalls += 1; };
+
+    bindings.resourcesRW.Flush(count);
+    bindings.constantBuffers.Flush(count);
+    bindings.resources.Flush(count);
+}
+
+// every command stream starts from the empty state, the next draw unbinds what the stream does not set
+static void nullResetBindings(NullBindings& bindings)
+{
+    bindings.constantBuffers.Reset();
+    bindings.resources.Reset();
+    bindings.resourcesRW.Reset();
+}
+
+static void nullClearBindings(NullBindings& bindings)
+{
+    nullResetBindings(bindings);
+    nullFlushBindings(bindings);
+}
+
+// null bind groups keep no resources, the group itself stands in for the values of its slots
+static void nullSetBindGroup(const BindGroup* prev, const BindGroup* next)
+{
+    void* value = const_cast<BindGroup*>(next);
+
+    if (prev != nullptr) {
+        BindGroup::ConstantBufferMask constantBufferMask = prev->constantBufferMask;
+        BindGroup::ShaderResourceMask shaderResourceMask = prev->shaderResourceMask;
+
+        if (next != nullptr) {
+            constantBufferMask = constantBufferMask.Exclude(next->constantBufferMask);
+            shaderResourceMask = shaderResourceMask.Exclude(next->shaderResourceMask);
+        }
+
+        constantBufferMask.ForEach([](uint32_t i) { g_drawBindings.constantBuffers.Set(i, nullptr); });
+        shaderResourceMask.ForEach([](uint32_t i) { g_drawBindings.resources.Set(i, nullptr); });
+    }
+
+    if (next != nullptr) {
+        next->constantBufferMask.ForEach([value](uint32_t i) { g_drawBindings.constantBuffers.Set(i, value); });
+        next->shaderResourceMask.ForEach([value](uint32_t i) { g_drawBindings.resources.Set(i, value); });
+    }
+}
+
+static void nullApplyOverrides(const DrawOverrides& overrides)
+{
+    overrides.constantBufferMask.ForEach([&overrides](uint32_t i) {
+        g_stats.numConstantBufferBindings += 1;
+        g_drawBindings.constantBuffers.Set(i, overrides.constantBuffers[i].value);
+    });
+
+    overrides.shaderResourceMask.ForEach([&overrides](uint32_t i) {
+        g_stats.numResourceBindings += 1;
+        g_drawBindings.resources.Set(i, overrides.shaderResources[i].value);
+    });
+}
+
+// overridden slots are bound by nullApplyOverrides, the stream values are ignored for them
+// returns the number of draw calls that were merged
+static uint32_t nullProcessDrawCommands(CommandReader reader, bool merge, const DrawOverrides* overrides = nullptr)
+{
+    DrawCall       call;
+    DrawCallMerger merger(merge);
+
+    const BindGroup* bindGroups[DrawCall::kMaxBindGroups] = { nullptr };
+
+    uint8_t opcode = 0;
+    while (reader.ReadOpcode(opcode)) {
+        g_stats.numCommands += 1;
+
+        if (opcode > DrawCommand::LastDraw)
+            merger.Flush(nullDrawCall);
+
+        switch (opcode) {
+        case DrawCommand::SetPrimitiveTopology: {
+            uint8_t topology = reader.Read<uint8_t>();
+            merger.SetTopology(static_cast<PrimitiveTopology>(topology));
+        } break;
+
+        case DrawCommand::SetVertexBuffer: {
+            reader.Read<uint8_t>();
+            reader.Read<void*>();
+            g_stats.numBufferBindings += 1;
+        } break;
+
+        case DrawCommand::SetIndexBuffer: {
+            reader.Read<void*>();
+            g_stats.numBufferBindings += 1;
+        } break;
+
+        case DrawCommand::SetConstantBuffer: {
+            uint32_t slot   = reader.Read<uint8_t>();
+            void*    buffer = reader.Read<void*>();
+
+            if (overrides == nullptr || !overrides->constantBufferMask.Test(slot)) {
+                g_stats.numConstantBufferBindings += 1;
+                g_drawBindings.constantBuffers.Set(slot, buffer);
+            }
+        } break;
+
+        case DrawCommand::SetConstants: {
+            // a GPU backend copies the data into its constant ring and binds the range, the data
+            // pointer stands in for the range so every draw call rebinds the slot
+            uint32_t       slot = reader.Read<uint8_t>();
+            uint32_t       size = reader.Read<uint32_t>();
+            const uint8_t* data = reader.ReadBytes(size);
+
+            if (overrides == nullptr || !overrides->constantBufferMask.Test(slot)) {
+                g_stats.numConstantBufferBindings += 1;
+                g_stats.numBytesUploaded          += size;
+                g_drawBindings.constantBuffers.Set(slot, const_cast<uint8_t*>(data));
+            }
+        } break;
+
+        case DrawCommand::SetResource: {
+            uint32_t slot     = reader.Read<uint8_t>();
+            reader.Read<uint8_t>();
+            void*    resource = reader.Read<void*>();
+
+            if (overrides == nullptr || !overrides->shaderResourceMask.Test(slot)) {
+                g_stats.numResourceBindings += 1;
+                g_drawBindings.resources.Set(slot, resource);
+            }
+        } break;
+
+        case DrawCommand::SetBindGroup: {
+            uint8_t          slot  = reader.Read<uint8_t>();
+            const BindGroup* group = static_cast<const BindGroup*>(reader.Read<void*>());
+            g_stats.numBindGroupBindings += 1;
+
+            nullSetBindGroup(bindGroups[slot], group);
+            bindGroups[slot] = group;
+
+            if (overrides != nullptr)
+                nullApplyOverrides(*overrides);
+        } break;
+
+        case DrawCommand::Draw:
+        case DrawCommand::DrawIndexed:
+        case DrawCommand::DrawInstanced:
+        case DrawCommand::DrawIndexedInstanced:
+        case DrawCommand::DrawInstancedIndirect:
+        case DrawCommand::DrawIndexedInstancedIndirect:
+        case DrawCommand::MultiDrawIndexedIndirect: {
+            DrawQueue::readDrawCall(reader, opcode, call);
+
+            nullFlushBindings(g_drawBindings);
+            merger.Add(call, nullDrawCall);
+        } break;
+        }
+    }
+
+    merger.Flush(nullDrawCall);
+
+    g_stats.numMergedDrawCalls += merger.GetNumMerged();
+    return merger.GetNumMerged();
+}
+
+static SGFX_FORCE_INLINE void nullCountRecordedBytes(const DrawQueue* queue)
+{
+    g_stats.numBytesRecorded += queue->getCommands().GetSize();
+    for (const DrawQueue* child : queue->getChildren())
+        g_stats.numBytesRecorded += child->getCommands().GetSize();
+}
+
+static void nullProcessDrawQueue(DrawQueue* queue)
+{
+    nullClearBindings(g_computeBindings);
+    g_stats.numPipelineStates += 1;
+
+    bool     merge     = queue->isMergingEnabled();
+    uint32_t numMerged = nullProcessDrawCommands(CommandReader(queue->getCommands()), merge);
+
+    for (const DrawQueue* child : queue->getChildren()) {
+        if (child->getNumDrawCalls() != 0) {
+            nullResetBindings(g_drawBindings);
+            numMerged += nullProcessDrawCommands(CommandReader(child->getCommands()), merge);
+        }
+    }
+
+    queue->setNumMergedDrawCalls(numMerged);
+    nullClearBindings(g_drawBindings);
+}
+
+static void nullProcessDrawBundle(const DrawBundle* bundle)
+{
+    nullClearBindings(g_computeBindings);
+    g_stats.numPipelineStates += 1;
+
+    const DrawOverrides* overrides = bundle->overrides.isEmpty() ? nullptr : &bundle->overrides;
+
+    for (size_t i = 0; i < bundle->getNumStreams(); ++i) {
+        if (i != 0)
+            nullResetBindings(g_drawBindings);
+
+        if (overrides != nullptr)
+            nullApplyOverrides(*overrides);
+
+        nullProcessDrawCommands(bundle->getStream(i), false, overrides);
+    }
+
+    nullClearBindings(g_drawBindings);
+}
+
+static void nullProcessSortedDrawQueues(const DrawQueueSorter& sorter)
+{
+    nullClearBindings(g_computeBindings);
+
+    const DrawQueue* queue = nullptr;
+    void*            state = nullptr;
+
+    for (size_t i = 0; i < sorter.GetSize(); ++i) {
+        const DrawQueueSorter::Item& item = sorter[i];
+
+        if (item.queue != queue) {
+            queue = item.queue;
+
+            if (queue->getState().value != state) {
+                state = queue->getState().value;
+                g_stats.numPipelineStates += 1;
+            }
+        }
+
+        // every range is delta encoded from the empty state, so reset bindings between ranges. The
+        // slots diff against what the previous range bound, bindings it shares are not bound again
+        nullResetBindings(g_drawBindings);
+
+        uint32_t numMerged = nullProcessDrawCommands(CommandReader(item.begin, item.end), queue->isMergingEnabled());
+        queue->setNumMergedDrawCalls(queue->getNumMergedDrawCalls() + numMerged);
+    }
+
+    nullClearBindings(g_drawBindings);
+}
+
+//=============================================================================
+bool initNull(uint32_t backBufferWidth, uint32_t backBufferHeight)
+{
+    TextureHandle backBuffer = nullCreateTexture(backBufferWidth, backBufferHeight, 1, DataFormat::RGBA8, 1, TextureFlags::RenderTarget);
+    g_backBuffer = Texture2DHandle(backBuffer.value);
+
+    return g_backBuffer != Texture2DHandle::invalidHandle();
+}
+
+void shutdown()
+{
+    g_deferredReleases.RetireAll(nullReleaseDeferred);
+
+    g_resources.Release(g_backBuffer.value);
+    g_backBuffer = Texture2DHandle::invalidHandle();
+}
+
+void setAllocator(AllocFunc nalloc, FreeFunc nfree)
+{
+    g_allocFunc = nalloc;
+    g_freeFunc  = nfree;
+}
+
+void* allocate(size_t size)
+{
+    return g_allocFunc(size);
+}
+
+void deallocate(void* ptr)
+{
+    return g_freeFunc(ptr);
+}
+
+uint64_t getGPUCaps()
+{
+    // report everything so callers take the same paths they take on a D3D11 device
+    uint64_t caps = 0;
+
+    caps |= GPUCaps::GeometryShader;
+    caps |= GPUCaps::TessellationShader;
+    caps |= GPUCaps::ComputeShader;
+    caps |= GPUCaps::MultipleRenderTargets;
+    caps |= GPUCaps::TextureArray;
+    caps |= GPUCaps::CubemapArray;
+    caps |= GPUCaps::StreamOutput;
+    caps |= GPUCaps::AlphaToCoverage;
+    caps |= GPUCaps::SeparateBlend;
+    caps |= GPUCaps::StructuredBuffer;
+    caps |= GPUCaps::RWStructuredBuffer;
+
+    caps |= GPUCaps::TextureCompressionDXT;
+    caps |= GPUCaps::TextureFormatInteger;
+    caps |= GPUCaps::TextureFormatFloat;
+
+    return caps;
+}
+
+//-------------------------------------------------------------------------------------------------
+bool compileShader(
+    const char*                 sourceCode,
+    size_t                      sourceCodeSize,
+    ShaderCompileVersion        version,
+    ShaderCompileTarget         target,
+    const ShaderCompileMacro*   macros,
+    size_t                      macrosSize,
+    uint64_t                    flags,
+    ErrorReportFunc             errorReport,
+
+    void*&  outData,
+    size_t& outDataSize
+)
+{
+    // there is no compiler to run, the source is handed back as the bytecode
+    outData = allocate(sourceCodeSize);
+    if (outData == nullptr) {
+        if (errorReport != nullptr)
+            errorReport("Failed to allocate shader bytecode");
+        return false;
+    }
+
+    std::memcpy(outData, sourceCode, sourceCodeSize);
+    outDataSize = sourceCodeSize;
+
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+template <typename Handle>
+static SGFX_FORCE_INLINE Handle nullCreateShader(const void* data, size_t dataSize)
+{
+    if (data == nullptr || dataSize == 0)
+        return Handle::invalidHandle(); // TODO: error handling
+
+    NullShaderImpl* impl = sgfx_new<NullShaderImpl>();
+    impl->dataSize = dataSize;
+
+    return Handle(impl);
+}
+
+template <typename Handle>
+static SGFX_FORCE_INLINE void nullReleaseShader(Handle handle)
+{
+    if (handle != Handle::invalidHandle()) {
+        NullShaderImpl* impl = static_cast<NullShaderImpl*>(handle.value);
+        sgfx_delete(impl);
+    }
+}
+
+VertexShaderHandle createVertexShader(const void* data, size_t dataSize)
+{
+    return nullCreateShader<VertexShaderHandle>(data, dataSize);
+}
+
+void releaseVertexShader(VertexShaderHandle handle)
+{
+    nullReleaseShader(handle);
+}
+
+HullShaderHandle createHullShader(const void* data, size_t dataSize)
+{
+    return nullCreateShader<HullShaderHandle>(data, dataSize);
+}
+
+void releaseHullShader(HullShaderHandle handle)
+{
+    nullReleaseShader(handle);
+}
+
+DomainShaderHandle createDomainShader(const void* data, size_t dataSize)
+{
+    return nullCreateShader<DomainShaderHandle>(data, dataSize);
+}
+
+void releaseDomainShader(DomainShaderHandle handle)
+{
+    nullReleaseShader(handle);
+}
+
+GeometryShaderHandle createGeometryShader(const void* data, size_t dataSize)
+{
+    return nullCreateShader<GeometryShaderHandle>(data, dataSize);
+}
+
+void releaseGeometryShader(GeometryShaderHandle handle)
+{
+    nullReleaseShader(handle);
+}
+
+PixelShaderHandle createPixelShader(const void* data, size_t dataSize)
+{
+    return nullCreateShader<PixelShaderHandle>(data, dataSize);
+}
+
+void releasePixelShader(PixelShaderHandle handle)
+{
+    nullReleaseShader(handle);
+}
+
+SurfaceShaderHandle linkSurfaceShader(VertexShaderHandle vs, HullShaderHandle hs, DomainShaderHandle ds, GeometryShaderHandle gs, PixelShaderHandle ps)
+{
+    NullSurfaceShaderImpl* impl = sgfx_new<NullSurfaceShaderImpl>();
+    impl->vs = vs;
+    impl->hs = hs;
+    impl->ds = ds;
+    impl->gs = gs;
+    impl->ps = ps;
+
+    return SurfaceShaderHandle(impl);
+}
+
+void releaseSurfaceShader(SurfaceShaderHandle handle)
+{
+    if (handle != SurfaceShaderHandle::invalidHandle()) {
+        NullSurfaceShaderImpl* impl = static_cast<NullSurfaceShaderImpl*>(handle.value);
+        sgfx_delete(impl);
+    }
+}
+
+ComputeQueueHandle createComputeQueue(ComputeShaderHandle shader)
+{
+    ComputeQueue* queue = sgfx_new<ComputeQueue>();
+    queue->shader = shader;
+
+    return ComputeQueueHandle(queue);
+}
+
+void releaseComputeQueue(ComputeQueueHandle handle)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        sgfx_delete(queue);
+    }
+}
+
+void setConstantBuffer(ComputeQueueHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        queue->setConstantBuffer(idx, buffer);
+    }
+}
+
+void setResource(ComputeQueueHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        queue->setResource(idx, resource);
+    }
+}
+
+void setResource(ComputeQueueHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        queue->setResource(idx, resource);
+    }
+}
+
+void setResourceRW(ComputeQueueHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        queue->setResourceRW(idx, resource);
+    }
+}
+
+void setResourceRW(ComputeQueueHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+        queue->setResourceRW(idx, resource);
+    }
+}
+
+void submit(ComputeQueueHandle handle, uint32_t x, uint32_t y, uint32_t z)
+{
+    if (handle != ComputeQueueHandle::invalidHandle()) {
+        ComputeQueue* queue = static_cast<ComputeQueue*>(handle.value);
+
+        // resolve the bindings like a GPU backend would, only the slots that changed are bound
+        for (uint32_t i = 0; i < ComputeQueue::kMaxConstantBuffers; ++i) {
+            if (queue->constantBuffers[i] != ConstantBufferHandle::invalidHandle())
+                g_stats.numConstantBufferBindings += 1;
+            g_computeBindings.constantBuffers.Set(i, queue->constantBuffers[i].value);
+        }
+
+        uint32_t numShaderResources = static_cast<uint32_t>(queue->shaderResources.GetSize());
+
+        g_computeBindings.resources.Reset(numShaderResources);
+        for (uint32_t i = 0; i < numShaderResources; ++i) {
+            NullResource* resource = g_resources.Get(queue->shaderResources[i].value);
+            if (resource != nullptr)
+                g_stats.numResourceBindings += 1;
+            g_computeBindings.resources.Set(i, resource);
+        }
+
+        for (uint32_t i = 0; i < ComputeQueue::kMaxShaderResourcesRW; ++i) {
+            NullResource* resource = g_resources.Get(queue->shaderResourcesRW[i].value);
+            if (resource != nullptr)
+                g_stats.numResourceBindings += 1;
+            g_computeBindings.resourcesRW.Set(i, resource);
+        }
+
+        nullFlushBindings(g_computeBindings);
+
+        g_stats.numDispatches   += 1;
+        g_stats.numThreadGroups += static_cast<uint64_t>(x) * y * z;
+    }
+}
+
+ComputeShaderHandle createComputeShader(const void* data, size_t dataSize)
+{
+    return nullCreateShader<ComputeShaderHandle>(data, dataSize);
+}
+
+void releaseComputeShader(ComputeShaderHandle handle)
+{
+    nullReleaseShader(handle);
+}
+
+VertexFormatHandle createVertexFormat(
+    VertexElementDescriptor* elements,
+    size_t size,
+    void* shaderBytecode, size_t shaderBytecodeSize,
+    ErrorReportFunc errorReport
+)
+{
+    if (elements == nullptr || size == 0) {
+        if (errorReport != nullptr)
+            errorReport("Vertex format has no elements");
+        return VertexFormatHandle::invalidHandle();
+    }
+
+    StateKey key;
+    for (size_t i = 0; i < size; ++i)
+        addStateKey(key, elements[i]);
+    key.AddBlob(shaderBytecode, shaderBytecodeSize);
+
+    NullVertexFormatImpl* impl = g_vertexFormats.Acquire(key, [size]() {
+        NullVertexFormatImpl* newImpl = sgfx_new<NullVertexFormatImpl>();
+        newImpl->numElements = size;
+        return newImpl;
+    });
+
+    return VertexFormatHandle(impl);
+}
+
+void releaseVertexFormat(VertexFormatHandle handle)
+{
+    if (handle != VertexFormatHandle::invalidHandle()) {
+        NullVertexFormatImpl* impl = static_cast<NullVertexFormatImpl*>(handle.value);
+        if (g_vertexFormats.Release(impl))
+            sgfx_delete(impl);
+    }
+}
+
+PipelineStateHandle createPipelineState(const PipelineStateDescriptor& desc)
+{
+    if (desc.shader == SurfaceShaderHandle::invalidHandle())
+        return PipelineStateHandle::invalidHandle(); // TODO: error handling
+
+    StateKey key;
+    addStateKey(key, desc.rasterizerState);
+    addStateKey(key, desc.blendState);
+    addStateKey(key, desc.depthStencilState);
+    key.AddPointer(desc.shader.value);
+    key.AddPointer(desc.vertexFormat.value);
+
+    NullPipelineStateImpl* impl = g_pipelineStates.Acquire(key, [&desc]() {
+        NullPipelineStateImpl* newImpl = sgfx_new<NullPipelineStateImpl>();
+        newImpl->desc = desc;
+        return newImpl;
+    });
+
+    return PipelineStateHandle(impl);
+}
+
+void releasePipelineState(PipelineStateHandle handle)
+{
+    if (handle != PipelineStateHandle::invalidHandle()) {
+        NullPipelineStateImpl* impl = static_cast<NullPipelineStateImpl*>(handle.value);
+        if (g_pipelineStates.Release(impl))
+            sgfx_delete(impl);
+    }
+}
+
+//=============================================================================
+BufferHandle createBuffer(uint32_t flags, const void* mem, size_t size, size_t stride)
+{
+    NullResource* buffer = nullptr;
+    void*         handle = g_resources.Create(buffer);
+    if (handle == nullptr)
+        return BufferHandle::invalidHandle(); // out of handles
+
+    buffer->flags      = flags;
+    buffer->dataStride = stride;
+
+    if (!buffer->memory.create(mem, size)) {
+        g_resources.Release(handle);
+        return BufferHandle::invalidHandle(); // TODO: error handling
+    }
+
+    return BufferHandle(handle);
+}
+
+void releaseBuffer(BufferHandle handle)
+{
+    NullResource* buffer = g_resources.Get(handle.value);
+    if (buffer == nullptr || !g_deferredReleases.Push(handle.value, DeferredReleaseQueue::Type::Buffer, buffer->memory.dataSize))
+        g_resources.Release(handle.value);
+}
+
+bool isValid(BufferHandle handle)
+{
+    return g_resources.IsValid(handle.value);
+}
+
+void* mapBuffer(BufferHandle handle, MapType type)
+{
+    NullResource* buffer = g_resources.Get(handle.value);
+    if (buffer != nullptr)
+        return buffer->memory.data;
+
+    return nullptr;
+}
+
+void* mapBuffer(BufferHandle handle, MapType type, size_t offset, size_t size)
+{
+    NullResource* buffer = g_resources.Get(handle.value);
+    if (buffer != nullptr && size != 0 && offset + size <= buffer->memory.dataSize)
+        return buffer->memory.data + offset;
+
+    return nullptr;
+}
+
+void unmapBuffer(BufferHandle handle)
+{}
+
+void copyBufferData(BufferHandle handle, size_t offset, size_t size, const void* mem)
+{
+    NullResource* buffer = g_resources.Get(handle.value);
+    if (buffer != nullptr && offset + size <= buffer->memory.dataSize) {
+        std::memcpy(buffer->memory.data + offset, mem, size);
+        g_stats.numBytesUploaded += size;
+    }
+}
+
+void clearBufferRW(BufferHandle handle, uint32_t value)
+{
+    NullResource* buffer = g_resources.Get(handle.value);
+    if (buffer != nullptr)
+        buffer->memory.fill(value);
+}
+
+void clearBufferRW(BufferHandle handle, float value)
+{
+    NullResource* buffer = g_resources.Get(handle.value);
+    if (buffer != nullptr)
+        buffer->memory.fill(value);
+}
+
+ConstantBufferHandle createConstantBuffer(const void* mem, size_t size)
+{
+    NullConstantBufferImpl* impl = sgfx_new<NullConstantBufferImpl>();
+
+    if (!impl->memory.create(mem, size)) {
+        sgfx_delete(impl);
+        return ConstantBufferHandle::invalidHandle(); // TODO: error handling
+    }
+
+    return ConstantBufferHandle(impl);
+}
+
+void updateConstantBuffer(ConstantBufferHandle handle, const void* mem)
+{
+    if (handle != ConstantBufferHandle::invalidHandle()) {
+        NullConstantBufferImpl* impl = static_cast<NullConstantBufferImpl*>(handle.value);
+
+        std::memcpy(impl->memory.data, mem, impl->memory.dataSize);
+        g_stats.numBytesUploaded += impl->memory.dataSize;
+    }
+}
+
+void releaseConstantBuffer(ConstantBufferHandle handle)
+{
+    if (handle != ConstantBufferHandle::invalidHandle()) {
+        NullConstantBufferImpl* impl = static_cast<NullConstantBufferImpl*>(handle.value);
+        if (!g_deferredReleases.Push(impl, DeferredReleaseQueue::Type::ConstantBuffer, impl->memory.dataSize))
+            sgfx_delete(impl);
+    }
+}
+
+SamplerStateHandle createSamplerState(const SamplerStateDescriptor& desc)
+{
+    StateKey key;
+    addStateKey(key, desc);
+
+    NullSamplerStateImpl* impl = g_samplerStates.Acquire(key, [&desc]() {
+        NullSamplerStateImpl* newImpl = sgfx_new<NullSamplerStateImpl>();
+        newImpl->desc = desc;
+        return newImpl;
+    });
+
+    return SamplerStateHandle(impl);
+}
+
+void releaseSamplerState(SamplerStateHandle handle)
+{
+    if (handle != SamplerStateHandle::invalidHandle()) {
+        NullSamplerStateImpl* impl = static_cast<NullSamplerStateImpl*>(handle.value);
+        if (g_samplerStates.Release(impl))
+            sgfx_delete(impl);
+    }
+}
+
+Texture1DHandle createTexture1D(uint32_t width, DataFormat format, uint32_t numMipmaps, uint32_t flags)
+{
+    return Texture1DHandle(nullCreateTexture(width, 1, 1, format, numMipmaps, flags).value);
+}
+
+Texture2DHandle createTexture2D(uint32_t width, uint32_t height, DataFormat format, uint32_t numMipmaps, uint32_t flags)
+{
+    return Texture2DHandle(nullCreateTexture(width, height, 1, format, numMipmaps, flags).value);
+}
+
+Texture3DHandle createTexture3D(uint32_t width, uint32_t height, uint32_t depth, DataFormat format, uint32_t numMipmaps, uint32_t flags)
+{
+    return Texture3DHandle(nullCreateTexture(width, height, depth, format, numMipmaps, flags).value);
+}
+
+void clearTextureRW(TextureHandle handle, uint32_t value)
+{
+    NullResource* texture = g_resources.Get(handle.value);
+    if (texture != nullptr)
+        texture->memory.fill(value);
+}
+
+void clearTextureRW(TextureHandle handle, float value)
+{
+    NullResource* texture = g_resources.Get(handle.value);
+    if (texture != nullptr)
+        texture->memory.fill(value);
+}
+
+void* mapTexture(TextureHandle handle, MapType type)
+{
+    NullResource* texture = g_resources.Get(handle.value);
+    if (texture != nullptr)
+        return texture->memory.data; // first mip
+
+    return nullptr;
+}
+
+void unmapTexture(TextureHandle handle)
+{}
+
+void updateTexture(
+    TextureHandle handle, const void* mem,
+    uint32_t mip,
+    size_t offsetX,  size_t sizeX,
+    size_t offsetY,  size_t sizeY,
+    size_t offsetZ,  size_t sizeZ,
+    size_t rowPitch, size_t depthPitch
+)
+{
+    NullResource* texture = g_resources.Get(handle.value);
+    if (texture == nullptr || mip >= texture->numMipmaps)
+        return;
+
+    NullMipLayout layout = nullMipLayout(texture->format, texture->width, texture->height, texture->depth, mip);
+
+    // compressed formats are copied in whole blocks
+    size_t block    = isCompressedFormat(texture->format) ? 4 : 1;
+    size_t unitSize = getFormatSize(texture->format);
+
+    size_t firstColumn = offsetX / block;
+    size_t firstRow    = offsetY / block;
+    size_t rowSize     = ((sizeX + block - 1) / block) * unitSize;
+    size_t numRows     = (sizeY + block - 1) / block;
+
+    if (firstColumn * unitSize + rowSize > layout.rowPitch || firstRow + numRows > layout.numRows || offsetZ + sizeZ > layout.depth)
+        return; // TODO: error handling
+
+    const uint8_t* src = static_cast<const uint8_t*>(mem);
+    uint8_t*       dst = texture->memory.data + layout.offset + offsetZ * layout.slicePitch + firstRow * layout.rowPitch + firstColumn * unitSize;
+
+    for (size_t z = 0; z < sizeZ; ++z) {
+        for (size_t y = 0; y < numRows; ++y)
+            std::memcpy(dst + z * layout.slicePitch + y * layout.rowPitch, src + z * depthPitch + y * rowPitch, rowSize);
+    }
+
+    g_stats.numBytesUploaded += rowSize * numRows * sizeZ;
+}
+
+void releaseTexture(TextureHandle handle)
+{
+    NullResource* texture = g_resources.Get(handle.value);
+    if (texture == nullptr || !g_deferredReleases.Push(handle.value, DeferredReleaseQueue::Type::Texture, texture->memory.dataSize))
+        g_resources.Release(handle.value);
+}
+
+bool isValid(TextureHandle handle)
+{
+    return g_resources.IsValid(handle.value);
+}
+
+static void nullCopyResource(void* src, void* dst)
+{
+    NullResource* nullSrc = g_resources.Get(src);
+    NullResource* nullDst = g_resources.Get(dst);
+
+    if (nullSrc != nullDst && nullSrc != nullptr && nullDst != nullptr) {
+        size_t size = nullSrc->memory.dataSize < nullDst->memory.dataSize ? nullSrc->memory.dataSize : nullDst->memory.dataSize;
+        std::memcpy(nullDst->memory.data, nullSrc->memory.data, size);
+    }
+}
+
+void copyResource(TextureHandle src, TextureHandle dst)
+{
+    nullCopyResource(src.value, dst.value);
+}
+
+void copyResource(BufferHandle src, BufferHandle dst)
+{
+    nullCopyResource(src.value, dst.value);
+}
+
+void copyResource(ConstantBufferHandle src, ConstantBufferHandle dst)
+{
+    if (src != dst && src != ConstantBufferHandle::invalidHandle() && dst != ConstantBufferHandle::invalidHandle()) {
+        NullConstantBufferImpl* nullSrc = static_cast<NullConstantBufferImpl*>(src.value);
+        NullConstantBufferImpl* nullDst = static_cast<NullConstantBufferImpl*>(dst.value);
+
+        size_t size = nullSrc->memory.dataSize < nullDst->memory.dataSize ? nullSrc->memory.dataSize : nullDst->memory.dataSize;
+        std::memcpy(nullDst->memory.data, nullSrc->memory.data, size);
+    }
+}
+
+Texture2DHandle getBackBuffer()
+{
+    return g_backBuffer;
+}
+
+//=============================================================================
+RenderTargetHandle createRenderTarget(const RenderTargetDescriptor& desc)
+{
+    if (desc.numColorTextures > RenderTargetSlot::Count)
+        return RenderTargetHandle::invalidHandle(); // TODO: error handling
+
+    NullRenderTargetImpl* impl = sgfx_new<NullRenderTargetImpl>();
+    impl->desc = desc;
+
+    return RenderTargetHandle(impl);
+}
+
+void releaseRenderTarget(RenderTargetHandle handle)
+{
+    if (handle != RenderTargetHandle::invalidHandle()) {
+        NullRenderTargetImpl* impl = static_cast<NullRenderTargetImpl*>(handle.value);
+        sgfx_delete(impl);
+    }
+}
+
+void setViewport(uint32_t width, uint32_t height, float minDepth, float maxDepth)
+{}
+
+void setResourceRW(RenderTargetHandle handle, uint32_t idx, BufferHandle resource)
+{}
+
+void setResourceRW(RenderTargetHandle handle, uint32_t idx, TextureHandle resource)
+{}
+
+void setRenderTarget(RenderTargetHandle handle)
+{}
+
+// clears do not touch the memory, they would only add a memset to the CPU timings
+void clearRenderTarget(RenderTargetHandle handle, uint32_t color)
+{}
+
+void clearRenderTarget(RenderTargetHandle handle, uint32_t slot, uint32_t color)
+{}
+
+void clearDepthStencil(RenderTargetHandle handle, float depth, uint8_t stencil)
+{}
+
+void endFrame()
+{
+    nullClearBindings(g_computeBindings);
+    g_frameArena.Reset();
+    g_frameIndex++;
+
+    g_deferredReleases.Retire(g_frameIndex - 1, g_frameIndex - 1, nullReleaseDeferred);
+}
+
+void setDeferredRelease(bool enabled)
+{
+    g_deferredReleases.SetEnabled(enabled);
+}
+
+DeferredReleaseStats getDeferredReleaseStats()
+{
+    return g_deferredReleases.GetStats();
+}
+
+FenceHandle insertFence()
+{
+    return FenceHandle(reinterpret_cast<void*>(static_cast<uintptr_t>(++g_numFences)));
+}
+
+bool isFenceSignaled(FenceHandle fence)
+{
+    return reinterpret_cast<uintptr_t>(fence.value) <= g_numFences;
+}
+
+bool waitFence(FenceHandle fence, uint64_t timeout)
+{
+    return reinterpret_cast<uintptr_t>(fence.value) <= g_numFences;
+}
+
+uint64_t getFrameIndex()
+{
+    return g_frameIndex;
+}
+
+uint64_t getCompletedFrameIndex()
+{
+    return g_frameIndex - 1;
+}
+
+void present(uint32_t swapInterval)
+{
+    endFrame();
+}
+
+// draw queue stuff is similar for all APIs
+
+DrawQueueHandle createDrawQueue(PipelineStateHandle state)
+{
+    DrawQueue* queue = sgfx_new<DrawQueue>(&g_frameArena, state);
+    return DrawQueueHandle(queue);
+}
+
+void releaseDrawQueue(DrawQueueHandle handle)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        sgfx_delete(queue);
+    }
+}
+
+DrawQueueHandle createChildDrawQueue(DrawQueueHandle parent)
+{
+    if (parent != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = sgfx_new<DrawQueue>(static_cast<DrawQueue*>(parent.value));
+        return DrawQueueHandle(queue);
+    }
+    return DrawQueueHandle::invalidHandle();
+}
+
+void setSamplerState(DrawQueueHandle handle, uint32_t idx, SamplerStateHandle sampler)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setSamplerState(idx, sampler);
+    }
+}
+
+void setPrimitiveTopology(DrawQueueHandle handle, PrimitiveTopology topology)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setPrimitiveTopology(topology);
+    }
+}
+
+void setVertexBuffer(DrawQueueHandle handle, BufferHandle vb, uint32_t idx)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setVertexBuffer(idx, vb);
+    }
+}
+
+void setIndexBuffer(DrawQueueHandle handle, BufferHandle ib)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setIndexBuffer(ib);
+    }
+}
+
+void setConstantBuffer(DrawQueueHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setConstantBuffer(idx, buffer);
+    }
+}
+
+void setConstants(DrawQueueHandle handle, uint32_t idx, const void* data, size_t size)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setConstants(idx, data, size);
+    }
+}
+
+void setResource(DrawQueueHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setResource(idx, resource);
+    }
+}
+
+void setResource(DrawQueueHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setResource(idx, resource);
+    }
+}
+
+BindGroupHandle createBindGroup(const BindGroupDescriptor& desc)
+{
+    if (!BindGroup::IsValid(desc))
+        return BindGroupHandle::invalidHandle(); // TODO: error handling
+
+    BindGroup* group = sgfx_new<BindGroup>(desc);
+    return BindGroupHandle(group);
+}
+
+void releaseBindGroup(BindGroupHandle handle)
+{
+    if (handle != BindGroupHandle::invalidHandle()) {
+        BindGroup* group = static_cast<BindGroup*>(handle.value);
+        sgfx_delete(group);
+    }
+}
+
+void setBindGroup(DrawQueueHandle handle, uint32_t idx, BindGroupHandle group)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setBindGroup(idx, group);
+    }
+}
+
+void draw(DrawQueueHandle handle, uint32_t count, uint32_t startVertex)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->draw(count, startVertex);
+    }
+}
+
+void drawIndexed(DrawQueueHandle handle, uint32_t count, uint32_t startIndex, uint32_t startVertex)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->drawIndexed(count, startIndex, startVertex);
+    }
+}
+
+void drawInstanced(DrawQueueHandle handle, uint32_t instanceCount, uint32_t count, uint32_t startVertex, uint32_t startInstance)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->drawInstanced(instanceCount, count, startVertex, startInstance);
+    }
+}
+
+void drawIndexedInstanced(DrawQueueHandle handle, uint32_t instanceCount, uint32_t count, uint32_t startIndex, uint32_t startVertex, uint32_t startInstance)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->drawIndexedInstanced(instanceCount, count, startIndex, startVertex, startInstance);
+    }
+}
+
+void drawInstancedIndirect(DrawQueueHandle handle, BufferHandle indirectArgs, size_t argsOffset)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->drawInstancedIndirect(indirectArgs, argsOffset);
+    }
+}
+
+void drawIndexedInstancedIndirect(DrawQueueHandle handle, BufferHandle indirectArgs, size_t argsOffset)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->drawIndexedInstancedIndirect(indirectArgs, argsOffset);
+    }
+}
+
+void multiDrawIndexedIndirect(
+    DrawQueueHandle handle,
+    BufferHandle indirectArgs, size_t argsOffset, uint32_t maxDraws,
+    BufferHandle countBuffer,  size_t countOffset,
+    uint32_t stride
+)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->multiDrawIndexedIndirect(indirectArgs, argsOffset, maxDraws, countBuffer, countOffset, stride);
+    }
+}
+
+void submit(DrawQueueHandle handle)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setNumMergedDrawCalls(0);
+        g_stats.numSubmits += 1;
+        if (!queue->isEmpty()) {
+            nullCountRecordedBytes(queue);
+            nullProcessDrawQueue(queue);
+            queue->clear();
+        }
+    }
+}
+
+void setSortKey(DrawQueueHandle handle, uint64_t key)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setSortKey(key);
+    }
+}
+
+void submit(const DrawQueueHandle* queues, size_t count)
+{
+    g_drawQueueSorter.Clear();
+
+    for (size_t i = 0; i < count; ++i) {
+        DrawQueueHandle handle = queues[i];
+        if (handle != DrawQueueHandle::invalidHandle()) {
+            DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+            queue->setNumMergedDrawCalls(0);
+            nullCountRecordedBytes(queue);
+            g_drawQueueSorter.Add(queue);
+            g_stats.numSubmits += 1;
+        }
+    }
+
+    if (!g_drawQueueSorter.IsEmpty()) {
+        g_drawQueueSorter.Sort();
+        nullProcessSortedDrawQueues(g_drawQueueSorter);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        DrawQueueHandle handle = queues[i];
+        if (handle != DrawQueueHandle::invalidHandle())
+            static_cast<DrawQueue*>(handle.value)->clear();
+    }
+}
+
+void setDrawMerging(DrawQueueHandle handle, bool enabled)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        queue->setMergingEnabled(enabled);
+    }
+}
+
+uint32_t getNumMergedDrawCalls(DrawQueueHandle handle)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        return queue->getNumMergedDrawCalls();
+    }
+    return 0;
+}
+
+DrawBundleHandle createDrawBundle(DrawQueueHandle handle)
+{
+    if (handle != DrawQueueHandle::invalidHandle()) {
+        DrawQueue* queue = static_cast<DrawQueue*>(handle.value);
+        if (queue->getState() == PipelineStateHandle::invalidHandle() || queue->isEmpty())
+            return DrawBundleHandle::invalidHandle(); // TODO: error handling
+
+        DrawBundle* bundle = sgfx_new<DrawBundle>(queue);
+        queue->clear();
+
+        return DrawBundleHandle(bundle);
+    }
+    return DrawBundleHandle::invalidHandle();
+}
+
+void releaseDrawBundle(DrawBundleHandle handle)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        sgfx_delete(bundle);
+    }
+}
+
+void setConstantBuffer(DrawBundleHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        bundle->overrides.setConstantBuffer(idx, buffer);
+    }
+}
+
+void setResource(DrawBundleHandle handle, uint32_t idx, BufferHandle resource)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        bundle->overrides.setResource(idx, false, resource.value);
+    }
+}
+
+void setResource(DrawBundleHandle handle, uint32_t idx, TextureHandle resource)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        bundle->overrides.setResource(idx, true, resource.value);
+    }
+}
+
+void submitBundle(DrawBundleHandle handle)
+{
+    if (handle != DrawBundleHandle::invalidHandle()) {
+        DrawBundle* bundle = static_cast<DrawBundle*>(handle.value);
+        g_stats.numSubmits += 1;
+        nullProcessDrawBundle(bundle);
+    }
+}
+
+void flush()
+{}
+
+void beginPerfEvent(const wchar_t* name)
+{}
+
+void endPerfEvent()
+{}
+
+}
+
+// null backend statistics, not part of the wrapped API
+namespace sgfx
+{
+namespace null
+{
+
+const Stats& getStats()
+{
+    SGFX_BACKEND_NS::g_stats.numBytesUploaded += SGFX_BACKEND_NS::g_numBytesCreated.exchange(0, std::memory_order_relaxed);
+    return SGFX_BACKEND_NS::g_stats;
+}
+
+void resetStats()
+{
+    SGFX_BACKEND_NS::g_stats = Stats();
+    SGFX_BACKEND_NS::g_numBytesCreated.store(0, std::memory_order_relaxed);
+}
+
+}
+}
@@ -0,0 +1,253 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+///
+/// Shader cache: compileShader results stored on disk, built on the public API so it works on top
+/// of every backend and the capture and threaded layers.
+///
+/// An entry is named after a 64 bit FNV-1a hash of everything that reaches the compiler: the source,
+/// the macros, the target, the version and the flags. D3DCompile runs without an include handler,
+/// so the source and the macros are the whole preprocessed input. The file holds a CacheHeader and
+/// the bytecode, it is written to a temporary file first and renamed, so a reader never sees a
+/// partial entry and processes that compile the same shader at the same time both succeed.
+///
+#include "sigrlinn.hh"
+
+#include <atomic>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define SGFX_GETPID _getpid
+#else
+#include <unistd.h>
+#define SGFX_GETPID getpid
+#endif
+
+namespace sgfx
+{
+namespace shadercache
+{
+
+enum : uint32_t
+{
+    kMagic   = 0x43584753, // "SGXC"
+    kVersion = 1,          // bump when the key or the file layout changes
+
+    kMaxPath = 1024
+};
+
+struct CacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t dataSize;
+};
+
+static std::atomic<uint64_t> g_numHits(0);
+static std::atomic<uint64_t> g_numMisses(0);
+static std::atomic<uint64_t> g_numFailedWrites(0);
+static std::atomic<uint32_t> g_tempCounter(0);
+
+static inline uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL; // FNV-1a
+    }
+    return hash;
+}
+
+template <typename T>
+static inline uint64_t hashValue(uint64_t hash, const T& value)
+{
+    return hashBytes(hash, &value, sizeof(value));
+}
+
+// strings are hashed with their terminator, so "AB" "C" and "A" "BC" give different keys
+static inline uint64_t hashString(uint64_t hash, const char* str)
+{
+    if (str == nullptr)
+        str = "";
+    return hashBytes(hash, str, std::strlen(str) + 1);
+}
+
+static uint64_t makeKey(
+    const char* sourceCode, size_t sourceCodeSize,
+    ShaderCompileVersion version, ShaderCompileTarget target,
+    const ShaderCompileMacro* macros, size_t macrosSize,
+    uint64_t flags
+)
+{
+    uint64_t hash = 14695981039346656037ULL;
+
+    hash = hashValue(hash, static_cast<uint32_t>(kVersion));
+    hash = hashValue(hash, static_cast<uint64_t>(sourceCodeSize));
+    hash = hashBytes(hash, sourceCode, sourceCodeSize);
+
+    hash = hashValue(hash, static_cast<uint64_t>(macrosSize));
+    for (size_t i = 0; i < macrosSize; ++i) {
+        hash = hashString(hash, macros[i].name);
+        hash = hashString(hash, macros[i].value);
+    }
+
+    hash = hashValue(hash, static_cast<uint32_t>(target));
+    hash = hashValue(hash, static_cast<uint32_t>(version));
+    hash = hashValue(hash, flags);
+
+    return hash;
+}
+
+// returns false when the entry is missing or does not match the key
+static bool readEntry(const char* path, uint64_t key, void*& outData, size_t& outDataSize)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    CacheHeader header;
+    bool        valid =
+        fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic   == kMagic   &&
+        header.version == kVersion &&
+        header.key     == key;
+
+    void* data = nullptr;
+    if (valid) {
+        data  = allocate(static_cast<size_t>(header.dataSize));
+        valid = data != nullptr && fread(data, 1, static_cast<size_t>(header.dataSize), file) == header.dataSize;
+    }
+    fclose(file);
+
+    if (!valid) {
+        if (data != nullptr)
+            deallocate(data);
+        return false;
+    }
+
+    outData     = data;
+    outDataSize = static_cast<size_t>(header.dataSize);
+    return true;
+}
+
+static bool writeEntry(const char* directory, const char* path, uint64_t key, const void* data, size_t dataSize)
+{
+    char tempPath[kMaxPath];
+    int  length = snprintf(
+        tempPath, sizeof(tempPath), "%s/%016llx.%d.%u.tmp",
+        directory, static_cast<unsigned long long>(key),
+        static_cast<int>(SGFX_GETPID()), g_tempCounter.fetch_add(1, std::memory_order_relaxed)
+    );
+    if (length < 0 || length >= static_cast<int>(kMaxPath))
+        return false;
+
+    FILE* file = fopen(tempPath, "wb");
+    if (file == nullptr)
+        return false;
+
+    CacheHeader header;
+    header.magic    = kMagic;
+    header.version  = kVersion;
+    header.key      = key;
+    header.dataSize = dataSize;
+
+    bool written =
+        fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(data, 1, dataSize, file) == dataSize;
+    written = (fclose(file) == 0) && written;
+
+    // rename does not replace an existing file on Windows, an entry stored by another process
+    // in the meantime has the same contents
+    if (written && rename(tempPath, path) == 0)
+        return true;
+
+    remove(tempPath);
+
+    FILE* existing = fopen(path, "rb");
+    if (existing != nullptr) {
+        fclose(existing);
+        return written;
+    }
+    return false;
+}
+
+bool compileShader(
+    const char*                 directory,
+    const char*                 sourceCode,
+    size_t                      sourceCodeSize,
+    ShaderCompileVersion        version,
+    ShaderCompileTarget         target,
+    const ShaderCompileMacro*   macros,
+    size_t                      macrosSize,
+    uint64_t                    flags,
+    ErrorReportFunc             errorFunc,
+
+    void*&  outData,
+    size_t& outDataSize
+)
+{
+    uint64_t key = makeKey(sourceCode, sourceCodeSize, version, target, macros, macrosSize, flags);
+
+    // without a directory, or with one too long for the path, this is a plain compileShader
+    char path[kMaxPath];
+    bool cached = false;
+    if (directory != nullptr) {
+        int length = snprintf(path, sizeof(path), "%s/%016llx.bin", directory, static_cast<unsigned long long>(key));
+        cached = length > 0 && length < static_cast<int>(kMaxPath);
+    }
+
+    if (cached && readEntry(path, key, outData, outDataSize)) {
+        g_numHits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    if (!sgfx::compileShader(sourceCode, sourceCodeSize, version, target, macros, macrosSize, flags, errorFunc, outData, outDataSize))
+        return false;
+
+    g_numMisses.fetch_add(1, std::memory_order_relaxed);
+    if (!cached || !writeEntry(directory, path, key, outData, outDataSize))
+        g_numFailedWrites.fetch_add(1, std::memory_order_relaxed);
+
+    return true;
+}
+
+Stats getStats()
+{
+    Stats stats;
+    stats.numHits         = g_numHits.load(std::memory_order_relaxed);
+    stats.numMisses       = g_numMisses.load(std::memory_order_relaxed);
+    stats.numFailedWrites = g_numFailedWrites.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void resetStats()
+{
+    g_numHits.store(0, std::memory_order_relaxed);
+    g_numMisses.store(0, std::memory_order_relaxed);
+    g_numFailedWrites.store(0, std::memory_order_relaxed);
+}
+
+}
+}
@@ -0,0 +1,1056 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+
+///
+/// Threaded layer: compiles a backend into its own namespace and defines the public API on top of
+/// it. Between threaded::start and threaded::stop the calls made on the recording thread are
+/// written into a single producer, single consumer ring as closures and a render thread runs them
+/// against the backend, so the application records frame N + 1 while the driver works on frame N.
+///
+/// Calls that return a value wait until the render thread ran them. Buffers and textures are
+/// created on the calling thread, the backends allow that from any thread. Calls made on other
+/// threads, or while threaded mode is off, go straight to the backend.
+///
+/// The backend is selected with SGFX_THREADED_D3D11, SGFX_THREADED_GL4 or SGFX_THREADED_NULL.
+///
+#define SGFX_BACKEND_NS sgfx_backend
+
+#if defined(SGFX_THREADED_D3D11)
+#include "sigrlinn_d3d11.cc"
+#elif defined(SGFX_THREADED_GL4)
+#include "sigrlinn_gl4.cc"
+#else
+#include "sigrlinn_null.cc"
+#endif
+
+#include <thread>
+#include <condition_variable>
+#include <unordered_map>
+
+namespace sgfx
+{
+
+using namespace SGFX_NS_INTERNAL;
+
+class RenderThread final
+{
+    enum : size_t
+    {
+        kAlignment = 16,
+        kSpinCount = 256 // yields before the render thread goes to sleep
+    };
+
+    // queued calls are a Record followed by the closure and its data, a null execute skips to the
+    // start of the ring
+    struct Record
+    {
+        void   (*execute)(Record* record);
+        size_t size;
+    };
+
+    template <typename F>
+    struct Call final
+    {
+        Record record;
+        F      func;
+
+        SGFX_FORCE_INLINE Call(const F& nfunc) : func(nfunc) {}
+
+        static void Execute(Record* record)
+        {
+            Call* call = reinterpret_cast<Call*>(record);
+            call->func();
+            call->~Call();
+        }
+    };
+
+    // the data is copied right after the closure, func gets the copy
+    template <typename F>
+    struct DataCall final
+    {
+        Record record;
+        F      func;
+
+        SGFX_FORCE_INLINE DataCall(const F& nfunc) : func(nfunc) {}
+
+        static void Execute(Record* record)
+        {
+            DataCall* call = reinterpret_cast<DataCall*>(record);
+            call->func(reinterpret_cast<const uint8_t*>(call) + AlignSize(sizeof(DataCall)));
+            call->~DataCall();
+        }
+    };
+
+    static SGFX_FORCE_INLINE size_t AlignSize(size_t size) { return (size + kAlignment - 1) & ~(kAlignment - 1); }
+
+    uint8_t*                ring     = nullptr;
+    size_t                  ringSize = 0;
+    uint64_t                writeEnd = 0;  // recording thread only
+    std::atomic<uint64_t>   writePos;      // published by the recording thread
+    std::atomic<uint64_t>   readPos;       // published by the render thread
+
+    std::thread             thread;
+    std::thread::id         recordingThread;
+    bool                    exitRequested = false; // render thread only
+
+    std::atomic<bool>       sleeping;
+    std::mutex              sleepMutex;
+    std::condition_variable wakeUp;
+
+    uint64_t                numFramesQueued = 0; // recording thread only
+    std::atomic<uint64_t>   numFramesDone;
+
+    threaded::Descriptor    desc;
+
+    SGFX_FORCE_INLINE Record* GetRecord(uint64_t pos) const { return reinterpret_cast<Record*>(ring + pos % ringSize); }
+
+    // waits for the render thread when the ring is full, records never wrap around
+    SGFX_FORCE_INLINE uint8_t* Allocate(size_t size)
+    {
+        size_t offset = writeEnd % ringSize;
+        if (offset + size > ringSize) {
+            size_t padding = ringSize - offset;
+            while (writeEnd + padding - readPos.load(std::memory_order_acquire) > ringSize)
+                std::this_thread::yield();
+
+            Record* record  = GetRecord(writeEnd);
+            record->execute = nullptr;
+            record->size    = padding;
+            writeEnd += padding;
+        }
+
+        while (writeEnd + size - readPos.load(std::memory_order_acquire) > ringSize)
+            std::this_thread::yield();
+
+        return ring + writeEnd % ringSize;
+    }
+
+    SGFX_FORCE_INLINE void Commit(Record* record, void (*execute)(Record*), size_t size)
+    {
+        record->execute = execute;
+        record->size    = size;
+        writeEnd += size;
+
+        // sequentially consistent, pairs with the sleeping flag in Idle
+        writePos.store(writeEnd);
+        if (sleeping.load()) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wakeUp.notify_one();
+        }
+    }
+
+    void Idle(uint64_t pos)
+    {
+        for (size_t i = 0; i < kSpinCount; ++i) {
+            if (writePos.load(std::memory_order_acquire) != pos)
+                return;
+            std::this_thread::yield();
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping.store(true);
+        while (writePos.load() == pos)
+            wakeUp.wait(lock);
+        sleeping.store(false);
+    }
+
+    void Run()
+    {
+        if (desc.threadStart != nullptr)
+            desc.threadStart(desc.userData);
+
+        uint64_t pos = readPos.load(std::memory_order_relaxed);
+        while (!exitRequested) {
+            if (pos == writePos.load(std::memory_order_acquire)) {
+                Idle(pos);
+                continue;
+            }
+
+            Record* record = GetRecord(pos);
+            size_t  size   = record->size;
+            if (record->execute != nullptr)
+                record->execute(record);
+
+            pos += size;
+            readPos.store(pos, std::memory_order_release);
+        }
+
+        if (desc.threadExit != nullptr)
+            desc.threadExit(desc.userData);
+    }
+
+public:
+
+    RenderThread() : writePos(0), readPos(0), sleeping(false), numFramesDone(0) {}
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    ~RenderThread() { Stop(); }
+
+    SGFX_FORCE_INLINE bool IsRecordingThread() const { return recordingThread == std::this_thread::get_id(); }
+
+    bool Start(const threaded::Descriptor& ndesc)
+    {
+        Stop();
+
+        desc     = ndesc;
+        ringSize = AlignSize(desc.ringSize);
+        if (ringSize < kAlignment * 64)
+            return false;
+
+        ring = static_cast<uint8_t*>(SGFX_BACKEND_NS::allocate(ringSize));
+        if (ring == nullptr)
+            return false;
+
+        writeEnd        = 0;
+        numFramesQueued = 0;
+        exitRequested   = false;
+        writePos.store(0);
+        readPos.store(0);
+        numFramesDone.store(0);
+
+        recordingThread = std::this_thread::get_id();
+        thread          = std::thread(&RenderThread::Run, this);
+        return true;
+    }
+
+    void Stop()
+    {
+        if (!IsRecordingThread())
+            return;
+
+        Wait([this] { exitRequested = true; });
+        thread.join();
+
+        recordingThread = std::thread::id();
+        SGFX_BACKEND_NS::deallocate(ring);
+        ring = nullptr;
+    }
+
+    void Finish()
+    {
+        Wait([] {});
+    }
+
+    template <typename F>
+    SGFX_FORCE_INLINE void Queue(const F& func)
+    {
+        if (!IsRecordingThread()) {
+            func();
+            return;
+        }
+
+        static_assert(alignof(Call<F>) <= kAlignment, "Closure alignment is too large");
+
+        size_t  size   = AlignSize(sizeof(Call<F>));
+        Record* record = reinterpret_cast<Record*>(Allocate(size));
+        ::new (record) Call<F>(func);
+        Commit(record, &Call<F>::Execute, size);
+    }
+
+    // func(const void* data) gets a copy of the data that lives until it returns, null data is
+    // passed through but still queued in order with the other calls
+    template <typename F>
+    SGFX_FORCE_INLINE void QueueData(const void* data, size_t dataSize, const F& func)
+    {
+        if (!IsRecordingThread()) {
+            func(data);
+            return;
+        }
+
+        if (data == nullptr) {
+            Queue([func] { func(nullptr); });
+            return;
+        }
+
+        static_assert(alignof(DataCall<F>) <= kAlignment, "Closure alignment is too large");
+
+        size_t size = AlignSize(sizeof(DataCall<F>)) + AlignSize(dataSize);
+        if (size > ringSize / 4) {
+            // too large for the ring, the copy goes through the allocator
+            uint8_t* copy = static_cast<uint8_t*>(SGFX_BACKEND_NS::allocate(dataSize));
+            std::memcpy(copy, data, dataSize);
+            Queue([func, copy] { func(copy); SGFX_BACKEND_NS::deallocate(copy); });
+            return;
+        }
+
+        Record* record = reinterpret_cast<Record*>(Allocate(size));
+        ::new (record) DataCall<F>(func);
+        std::memcpy(reinterpret_cast<uint8_t*>(record) + AlignSize(sizeof(DataCall<F>)), data, dataSize);
+        Commit(record, &DataCall<F>::Execute, size);
+    }
+
+    // runs func on the render thread and waits for it
+    template <typename F>
+    SGFX_FORCE_INLINE void Wait(const F& func)
+    {
+        if (!IsRecordingThread()) {
+            func();
+            return;
+        }
+
+        std::atomic<bool> done(false);
+        Queue([&func, &done] { func(); done.store(true, std::memory_order_release); });
+        while (!done.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    }
+
+    template <typename R, typename F>
+    SGFX_FORCE_INLINE R Get(const F& func)
+    {
+        R result;
+        Wait([&result, &func] { result = func(); });
+        return result;
+    }
+
+    // queues the call that ends a frame and waits while too many frames are in flight
+    template <typename F>
+    SGFX_FORCE_INLINE void FrameEnd(const F& func)
+    {
+        if (!IsRecordingThread()) {
+            func();
+            return;
+        }
+
+        Queue([this, func] { func(); numFramesDone.fetch_add(1, std::memory_order_release); });
+        ++numFramesQueued;
+
+        while (numFramesQueued - numFramesDone.load(std::memory_order_acquire) > desc.maxFramesInFlight)
+            std::this_thread::yield();
+    }
+};
+
+static RenderThread g_renderThread;
+
+// sizes and formats of buffers and textures, the data of queued updates has to be copied
+struct ThreadedObject final
+{
+    size_t     dataSize = 0;
+    DataFormat format   = DataFormat::Count;
+};
+
+static std::mutex                               g_objectsMutex; // objects are created on any thread
+static std::unordered_map<void*, ThreadedObject> g_objects;
+
+static SGFX_FORCE_INLINE void addObject(void* value, const ThreadedObject& object)
+{
+    if (value != nullptr) {
+        std::lock_guard<std::mutex> lock(g_objectsMutex);
+        g_objects[value] = object;
+    }
+}
+
+static SGFX_FORCE_INLINE void removeObject(void* value)
+{
+    std::lock_guard<std::mutex> lock(g_objectsMutex);
+    g_objects.erase(value);
+}
+
+static SGFX_FORCE_INLINE ThreadedObject getObject(void* value)
+{
+    std::lock_guard<std::mutex> lock(g_objectsMutex);
+    auto it = g_objects.find(value);
+    return (it != g_objects.end()) ? it->second : ThreadedObject();
+}
+
+//=============================================================================
+namespace threaded
+{
+
+bool start(const Descriptor& desc)
+{
+    return g_renderThread.Start(desc);
+}
+
+void stop()
+{
+    g_renderThread.Stop();
+}
+
+void finish()
+{
+    g_renderThread.Finish();
+}
+
+}
+
+//=============================================================================
+#if defined(SGFX_THREADED_D3D11)
+bool initD3D11(void* d3dDevice, void* d3dContext, void* d3dSwapChain)
+{
+    return g_renderThread.Get<bool>([=] { return SGFX_BACKEND_NS::initD3D11(d3dDevice, d3dContext, d3dSwapChain); });
+}
+#elif defined(SGFX_THREADED_GL4)
+bool initOpenGL()
+{
+    return g_renderThread.Get<bool>([] { return SGFX_BACKEND_NS::initOpenGL(); });
+}
+#else
+bool initNull(uint32_t backBufferWidth, uint32_t backBufferHeight)
+{
+    return g_renderThread.Get<bool>([=] { return SGFX_BACKEND_NS::initNull(backBufferWidth, backBufferHeight); });
+}
+#endif
+
+void shutdown()
+{
+    g_renderThread.Wait([] { SGFX_BACKEND_NS::shutdown(); });
+}
+
+void setAllocator(AllocFunc nalloc, FreeFunc nfree)
+{
+    g_renderThread.Wait([=] { SGFX_BACKEND_NS::setAllocator(nalloc, nfree); });
+}
+
+void* allocate(size_t size)
+{
+    return SGFX_BACKEND_NS::allocate(size);
+}
+
+void deallocate(void* ptr)
+{
+    SGFX_BACKEND_NS::deallocate(ptr);
+}
+
+uint64_t getGPUCaps()
+{
+    return g_renderThread.Get<uint64_t>([] { return SGFX_BACKEND_NS::getGPUCaps(); });
+}
+
+bool compileShader(
+    const char*                 sourceCode,
+    size_t                      sourceCodeSize,
+    ShaderCompileVersion        version,
+    ShaderCompileTarget         target,
+    const ShaderCompileMacro*   macros,
+    size_t                      macrosSize,
+    uint64_t                    flags,
+    ErrorReportFunc             errorReport,
+
+    void*&  outData,
+    size_t& outDataSize
+)
+{
+    // does not touch the device
+    return SGFX_BACKEND_NS::compileShader(sourceCode, sourceCodeSize, version, target, macros, macrosSize, flags, errorReport, outData, outDataSize);
+}
+
+//=============================================================================
+VertexShaderHandle createVertexShader(const void* data, size_t dataSize)
+{
+    return g_renderThread.Get<VertexShaderHandle>([=] { return SGFX_BACKEND_NS::createVertexShader(data, dataSize); });
+}
+
+void releaseVertexShader(VertexShaderHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseVertexShader(handle); });
+}
+
+HullShaderHandle createHullShader(const void* data, size_t dataSize)
+{
+    return g_renderThread.Get<HullShaderHandle>([=] { return SGFX_BACKEND_NS::createHullShader(data, dataSize); });
+}
+
+void releaseHullShader(HullShaderHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseHullShader(handle); });
+}
+
+DomainShaderHandle createDomainShader(const void* data, size_t dataSize)
+{
+    return g_renderThread.Get<DomainShaderHandle>([=] { return SGFX_BACKEND_NS::createDomainShader(data, dataSize); });
+}
+
+void releaseDomainShader(DomainShaderHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseDomainShader(handle); });
+}
+
+GeometryShaderHandle createGeometryShader(const void* data, size_t dataSize)
+{
+    return g_renderThread.Get<GeometryShaderHandle>([=] { return SGFX_BACKEND_NS::createGeometryShader(data, dataSize); });
+}
+
+void releaseGeometryShader(GeometryShaderHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseGeometryShader(handle); });
+}
+
+PixelShaderHandle createPixelShader(const void* data, size_t dataSize)
+{
+    return g_renderThread.Get<PixelShaderHandle>([=] { return SGFX_BACKEND_NS::createPixelShader(data, dataSize); });
+}
+
+void releasePixelShader(PixelShaderHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releasePixelShader(handle); });
+}
+
+SurfaceShaderHandle linkSurfaceShader(VertexShaderHandle vs, HullShaderHandle hs, DomainShaderHandle ds, GeometryShaderHandle gs, PixelShaderHandle ps)
+{
+    return g_renderThread.Get<SurfaceShaderHandle>([=] { return SGFX_BACKEND_NS::linkSurfaceShader(vs, hs, ds, gs, ps); });
+}
+
+void releaseSurfaceShader(SurfaceShaderHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseSurfaceShader(handle); });
+}
+
+//=============================================================================
+ComputeQueueHandle createComputeQueue(ComputeShaderHandle shader)
+{
+    return g_renderThread.Get<ComputeQueueHandle>([=] { return SGFX_BACKEND_NS::createComputeQueue(shader); });
+}
+
+void releaseComputeQueue(ComputeQueueHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseComputeQueue(handle); });
+}
+
+void setConstantBuffer(ComputeQueueHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setConstantBuffer(handle, idx, buffer); });
+}
+
+void setResource(ComputeQueueHandle handle, uint32_t idx, BufferHandle resource)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setResource(handle, idx, resource); });
+}
+
+void setResource(ComputeQueueHandle handle, uint32_t idx, TextureHandle resource)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setResource(handle, idx, resource); });
+}
+
+void setResourceRW(ComputeQueueHandle handle, uint32_t idx, BufferHandle resource)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setResourceRW(handle, idx, resource); });
+}
+
+void setResourceRW(ComputeQueueHandle handle, uint32_t idx, TextureHandle resource)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setResourceRW(handle, idx, resource); });
+}
+
+void submit(ComputeQueueHandle handle, uint32_t x, uint32_t y, uint32_t z)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::submit(handle, x, y, z); });
+}
+
+ComputeShaderHandle createComputeShader(const void* data, size_t dataSize)
+{
+    return g_renderThread.Get<ComputeShaderHandle>([=] { return SGFX_BACKEND_NS::createComputeShader(data, dataSize); });
+}
+
+void releaseComputeShader(ComputeShaderHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseComputeShader(handle); });
+}
+
+//=============================================================================
+VertexFormatHandle createVertexFormat(
+    VertexElementDescriptor* elements,
+    size_t size,
+    void* shaderBytecode, size_t shaderBytecodeSize,
+    ErrorReportFunc errorReport
+)
+{
+    return g_renderThread.Get<VertexFormatHandle>([=] {
+        return SGFX_BACKEND_NS::createVertexFormat(elements, size, shaderBytecode, shaderBytecodeSize, errorReport);
+    });
+}
+
+void releaseVertexFormat(VertexFormatHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseVertexFormat(handle); });
+}
+
+PipelineStateHandle createPipelineState(const PipelineStateDescriptor& desc)
+{
+    return g_renderThread.Get<PipelineStateHandle>([&desc] { return SGFX_BACKEND_NS::createPipelineState(desc); });
+}
+
+void releasePipelineState(PipelineStateHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releasePipelineState(handle); });
+}
+
+//=============================================================================
+BufferHandle createBuffer(uint32_t flags, const void* mem, size_t size, size_t stride)
+{
+    BufferHandle handle = SGFX_BACKEND_NS::createBuffer(flags, mem, size, stride);
+
+    ThreadedObject object;
+    object.dataSize = size;
+    addObject(handle.value, object);
+
+    return handle;
+}
+
+void releaseBuffer(BufferHandle handle)
+{
+    removeObject(handle.value);
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseBuffer(handle); });
+}
+
+bool isValid(BufferHandle handle)
+{
+    return SGFX_BACKEND_NS::isValid(handle);
+}
+
+void* mapBuffer(BufferHandle handle, MapType type)
+{
+    return g_renderThread.Get<void*>([=] { return SGFX_BACKEND_NS::mapBuffer(handle, type); });
+}
+
+void* mapBuffer(BufferHandle handle, MapType type, size_t offset, size_t size)
+{
+    return g_renderThread.Get<void*>([=] { return SGFX_BACKEND_NS::mapBuffer(handle, type, offset, size); });
+}
+
+void unmapBuffer(BufferHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::unmapBuffer(handle); });
+}
+
+void copyBufferData(BufferHandle handle, size_t offset, size_t size, const void* mem)
+{
+    g_renderThread.QueueData(mem, size, [=](const void* data) { SGFX_BACKEND_NS::copyBufferData(handle, offset, size, data); });
+}
+
+void clearBufferRW(BufferHandle handle, uint32_t value)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::clearBufferRW(handle, value); });
+}
+
+void clearBufferRW(BufferHandle handle, float value)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::clearBufferRW(handle, value); });
+}
+
+ConstantBufferHandle createConstantBuffer(const void* mem, size_t size)
+{
+    ConstantBufferHandle handle = SGFX_BACKEND_NS::createConstantBuffer(mem, size);
+
+    ThreadedObject object;
+    object.dataSize = size;
+    addObject(handle.value, object);
+
+    return handle;
+}
+
+void updateConstantBuffer(ConstantBufferHandle handle, const void* mem)
+{
+    size_t dataSize = getObject(handle.value).dataSize;
+    g_renderThread.QueueData(mem, dataSize, [=](const void* data) { SGFX_BACKEND_NS::updateConstantBuffer(handle, data); });
+}
+
+void releaseConstantBuffer(ConstantBufferHandle handle)
+{
+    removeObject(handle.value);
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseConstantBuffer(handle); });
+}
+
+SamplerStateHandle createSamplerState(const SamplerStateDescriptor& desc)
+{
+    return g_renderThread.Get<SamplerStateHandle>([&desc] { return SGFX_BACKEND_NS::createSamplerState(desc); });
+}
+
+void releaseSamplerState(SamplerStateHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseSamplerState(handle); });
+}
+
+//=============================================================================
+template <typename Handle>
+static SGFX_FORCE_INLINE Handle addTexture(Handle handle, DataFormat format)
+{
+    ThreadedObject object;
+    object.format = format;
+    addObject(handle.value, object);
+
+    return handle;
+}
+
+Texture1DHandle createTexture1D(uint32_t width, DataFormat format, uint32_t numMipmaps, uint32_t flags)
+{
+    return addTexture(SGFX_BACKEND_NS::createTexture1D(width, format, numMipmaps, flags), format);
+}
+
+Texture2DHandle createTexture2D(uint32_t width, uint32_t height, DataFormat format, uint32_t numMipmaps, uint32_t flags)
+{
+    return addTexture(SGFX_BACKEND_NS::createTexture2D(width, height, format, numMipmaps, flags), format);
+}
+
+Texture3DHandle createTexture3D(uint32_t width, uint32_t height, uint32_t depth, DataFormat format, uint32_t numMipmaps, uint32_t flags)
+{
+    return addTexture(SGFX_BACKEND_NS::createTexture3D(width, height, depth, format, numMipmaps, flags), format);
+}
+
+void clearTextureRW(TextureHandle handle, uint32_t value)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::clearTextureRW(handle, value); });
+}
+
+void clearTextureRW(TextureHandle handle, float value)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::clearTextureRW(handle, value); });
+}
+
+void* mapTexture(TextureHandle handle, MapType type)
+{
+    return g_renderThread.Get<void*>([=] { return SGFX_BACKEND_NS::mapTexture(handle, type); });
+}
+
+void unmapTexture(TextureHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::unmapTexture(handle); });
+}
+
+void updateTexture(
+    TextureHandle handle, const void* mem,
+    uint32_t mip,
+    size_t offsetX,  size_t sizeX,
+    size_t offsetY,  size_t sizeY,
+    size_t offsetZ,  size_t sizeZ,
+    size_t rowPitch, size_t depthPitch
+)
+{
+    // rows of compressed formats are rows of 4x4 blocks
+    size_t numRows  = isCompressedFormat(getObject(handle.value).format) ? (sizeY + 3) / 4 : sizeY;
+    size_t dataSize = (sizeZ > 1) ? depthPitch * sizeZ : rowPitch * numRows;
+
+    g_renderThread.QueueData(mem, dataSize, [=](const void* data) {
+        SGFX_BACKEND_NS::updateTexture(handle, data, mip, offsetX, sizeX, offsetY, sizeY, offsetZ, sizeZ, rowPitch, depthPitch);
+    });
+}
+
+void releaseTexture(TextureHandle handle)
+{
+    removeObject(handle.value);
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseTexture(handle); });
+}
+
+bool isValid(TextureHandle handle)
+{
+    return SGFX_BACKEND_NS::isValid(handle);
+}
+
+void copyResource(TextureHandle src, TextureHandle dst)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::copyResource(src, dst); });
+}
+
+void copyResource(BufferHandle src, BufferHandle dst)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::copyResource(src, dst); });
+}
+
+void copyResource(ConstantBufferHandle src, ConstantBufferHandle dst)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::copyResource(src, dst); });
+}
+
+Texture2DHandle getBackBuffer()
+{
+    return g_renderThread.Get<Texture2DHandle>([] { return SGFX_BACKEND_NS::getBackBuffer(); });
+}
+
+//=============================================================================
+RenderTargetHandle createRenderTarget(const RenderTargetDescriptor& desc)
+{
+    return g_renderThread.Get<RenderTargetHandle>([&desc] { return SGFX_BACKEND_NS::createRenderTarget(desc); });
+}
+
+void releaseRenderTarget(RenderTargetHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseRenderTarget(handle); });
+}
+
+void setViewport(uint32_t width, uint32_t height, float minDepth, float maxDepth)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setViewport(width, height, minDepth, maxDepth); });
+}
+
+void setResourceRW(RenderTargetHandle handle, uint32_t idx, BufferHandle resource)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setResourceRW(handle, idx, resource); });
+}
+
+void setResourceRW(RenderTargetHandle handle, uint32_t idx, TextureHandle resource)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setResourceRW(handle, idx, resource); });
+}
+
+void setRenderTarget(RenderTargetHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setRenderTarget(handle); });
+}
+
+void clearRenderTarget(RenderTargetHandle handle, uint32_t color)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::clearRenderTarget(handle, color); });
+}
+
+void clearRenderTarget(RenderTargetHandle handle, uint32_t slot, uint32_t color)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::clearRenderTarget(handle, slot, color); });
+}
+
+void clearDepthStencil(RenderTargetHandle handle, float depth, uint8_t stencil)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::clearDepthStencil(handle, depth, stencil); });
+}
+
+void present(uint32_t swapInterval)
+{
+    g_renderThread.FrameEnd([=] { SGFX_BACKEND_NS::present(swapInterval); });
+}
+
+void endFrame()
+{
+    g_renderThread.FrameEnd([] { SGFX_BACKEND_NS::endFrame(); });
+}
+
+void setDeferredRelease(bool enabled)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setDeferredRelease(enabled); });
+}
+
+DeferredReleaseStats getDeferredReleaseStats()
+{
+    return g_renderThread.Get<DeferredReleaseStats>([] { return SGFX_BACKEND_NS::getDeferredReleaseStats(); });
+}
+
+FenceHandle insertFence()
+{
+    return g_renderThread.Get<FenceHandle>([] { return SGFX_BACKEND_NS::insertFence(); });
+}
+
+bool isFenceSignaled(FenceHandle fence)
+{
+    return g_renderThread.Get<bool>([=] { return SGFX_BACKEND_NS::isFenceSignaled(fence); });
+}
+
+bool waitFence(FenceHandle fence, uint64_t timeout)
+{
+    return g_renderThread.Get<bool>([=] { return SGFX_BACKEND_NS::waitFence(fence, timeout); });
+}
+
+uint64_t getFrameIndex()
+{
+    return g_renderThread.Get<uint64_t>([] { return SGFX_BACKEND_NS::getFrameIndex(); });
+}
+
+uint64_t getCompletedFrameIndex()
+{
+    return g_renderThread.Get<uint64_t>([] { return SGFX_BACKEND_NS::getCompletedFrameIndex(); });
+}
+
+//=============================================================================
+DrawQueueHandle createDrawQueue(PipelineStateHandle state)
+{
+    return g_renderThread.Get<DrawQueueHandle>([=] { return SGFX_BACKEND_NS::createDrawQueue(state); });
+}
+
+void releaseDrawQueue(DrawQueueHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseDrawQueue(handle); });
+}
+
+DrawQueueHandle createChildDrawQueue(DrawQueueHandle parent)
+{
+    return g_renderThread.Get<DrawQueueHandle>([=] { return SGFX_BACKEND_NS::createChildDrawQueue(parent); });
+}
+
+void setSamplerState(DrawQueueHandle handle, uint32_t idx, SamplerStateHandle sampler)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setSamplerState(handle, idx, sampler); });
+}
+
+void setPrimitiveTopology(DrawQueueHandle handle, PrimitiveTopology topology)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setPrimitiveTopology(handle, topology); });
+}
+
+void setVertexBuffer(DrawQueueHandle handle, BufferHandle vb, uint32_t idx)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setVertexBuffer(handle, vb, idx); });
+}
+
+void setIndexBuffer(DrawQueueHandle handle, BufferHandle ib)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setIndexBuffer(handle, ib); });
+}
+
+void setConstantBuffer(DrawQueueHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setConstantBuffer(handle, idx, buffer); });
+}
+
+void setConstants(DrawQueueHandle handle, uint32_t idx, const void* data, size_t size)
+{
+    g_renderThread.QueueData(data, size, [=](const void* copy) { SGFX_BACKEND_NS::setConstants(handle, idx, copy, size); });
+}
+
+void setResource(DrawQueueHandle handle, uint32_t idx, BufferHandle resource)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setResource(handle, idx, resource); });
+}
+
+void setResource(DrawQueueHandle handle, uint32_t idx, TextureHandle resource)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setResource(handle, idx, resource); });
+}
+
+BindGroupHandle createBindGroup(const BindGroupDescriptor& desc)
+{
+    return g_renderThread.Get<BindGroupHandle>([&desc] { return SGFX_BACKEND_NS::createBindGroup(desc); });
+}
+
+void releaseBindGroup(BindGroupHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseBindGroup(handle); });
+}
+
+void setBindGroup(DrawQueueHandle handle, uint32_t idx, BindGroupHandle group)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setBindGroup(handle, idx, group); });
+}
+
+void draw(DrawQueueHandle handle, uint32_t count, uint32_t startVertex)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::draw(handle, count, startVertex); });
+}
+
+void drawIndexed(DrawQueueHandle handle, uint32_t count, uint32_t startIndex, uint32_t startVertex)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::drawIndexed(handle, count, startIndex, startVertex); });
+}
+
+void drawInstanced(DrawQueueHandle handle, uint32_t instanceCount, uint32_t count, uint32_t startVertex, uint32_t startInstance)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::drawInstanced(handle, instanceCount, count, startVertex, startInstance); });
+}
+
+void drawIndexedInstanced(DrawQueueHandle handle, uint32_t instanceCount, uint32_t count, uint32_t startIndex, uint32_t startVertex, uint32_t startInstance)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::drawIndexedInstanced(handle, instanceCount, count, startIndex, startVertex, startInstance); });
+}
+
+void drawInstancedIndirect(DrawQueueHandle handle, BufferHandle indirectArgs, size_t argsOffset)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::drawInstancedIndirect(handle, indirectArgs, argsOffset); });
+}
+
+void drawIndexedInstancedIndirect(DrawQueueHandle handle, BufferHandle indirectArgs, size_t argsOffset)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::drawIndexedInstancedIndirect(handle, indirectArgs, argsOffset); });
+}
+
+void multiDrawIndexedIndirect(
+    DrawQueueHandle handle,
+    BufferHandle indirectArgs, size_t argsOffset, uint32_t maxDraws,
+    BufferHandle countBuffer,  size_t countOffset,
+    uint32_t stride
+)
+{
+    g_renderThread.Queue([=] {
+        SGFX_BACKEND_NS::multiDrawIndexedIndirect(handle, indirectArgs, argsOffset, maxDraws, countBuffer, countOffset, stride);
+    });
+}
+
+void submit(DrawQueueHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::submit(handle); });
+}
+
+void flush()
+{
+    g_renderThread.Queue([] { SGFX_BACKEND_NS::flush(); });
+}
+
+void setSortKey(DrawQueueHandle handle, uint64_t key)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setSortKey(handle, key); });
+}
+
+void submit(const DrawQueueHandle* queues, size_t count)
+{
+    g_renderThread.QueueData(queues, count * sizeof(DrawQueueHandle), [=](const void* data) {
+        SGFX_BACKEND_NS::submit(static_cast<const DrawQueueHandle*>(data), count);
+    });
+}
+
+void setDrawMerging(DrawQueueHandle handle, bool enabled)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setDrawMerging(handle, enabled); });
+}
+
+uint32_t getNumMergedDrawCalls(DrawQueueHandle handle)
+{
+    return g_renderThread.Get<uint32_t>([=] { return SGFX_BACKEND_NS::getNumMergedDrawCalls(handle); });
+}
+
+DrawBundleHandle createDrawBundle(DrawQueueHandle handle)
+{
+    return g_renderThread.Get<DrawBundleHandle>([=] { return SGFX_BACKEND_NS::createDrawBundle(handle); });
+}
+
+void releaseDrawBundle(DrawBundleHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::releaseDrawBundle(handle); });
+}
+
+void setConstantBuffer(DrawBundleHandle handle, uint32_t idx, ConstantBufferHandle buffer)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setConstantBuffer(handle, idx, buffer); });
+}
+
+void setResource(DrawBundleHandle handle, uint32_t idx, BufferHandle resource)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setResource(handle, idx, resource); });
+}
+
+void setResource(DrawBundleHandle handle, uint32_t idx, TextureHandle resource)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::setResource(handle, idx, resource); });
+}
+
+void submitBundle(DrawBundleHandle handle)
+{
+    g_renderThread.Queue([=] { SGFX_BACKEND_NS::submitBundle(handle); });
+}
+
+void beginPerfEvent(const wchar_t* name)
+{
+    size_t size = (name != nullptr) ? (wcslen(name) + 1) * sizeof(wchar_t) : 0;
+    g_renderThread.QueueData(name, size, [](const void* data) { SGFX_BACKEND_NS::beginPerfEvent(static_cast<const wchar_t*>(data)); });
+}
+
+void endPerfEvent()
+{
+    g_renderThread.Queue([] { SGFX_BACKEND_NS::endPerfEvent(); });
+}
+
+}
@@ -0,0 +1,238 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SGFX_NS_INTERNAL sgfx_ns_test_internal
+#define SGFX_INTERNAL_IMPLEMENTATION 1
+
+#ifdef _MSC_VER
+#   define SGFX_FORCE_INLINE __forceinline
+#else
+#   define SGFX_FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+#include "sigrlinn.hh"
+
+// BindingSlots test, does not need a GPU
+//
+// Drives the slots the way a backend does on submit and records every bind call of Flush, then
+// compares the calls with the expected contiguous ranges. Covers Forget for names the API unbinds
+// itself and the Reset done between child queues, bundle streams and sorted submit ranges.
+
+namespace sgfx
+{
+void* allocate(size_t size) { return malloc(size); }
+void  deallocate(void* ptr) { free(ptr); }
+}
+
+using namespace sgfx;
+using namespace sgfx::SGFX_NS_INTERNAL;
+
+enum
+{
+    kNumSlots = 128 // two words, so ranges can cross a word boundary
+};
+
+typedef BindingSlots<uint32_t, kNumSlots> Slots;
+
+// one bind call of Flush
+struct BindCall
+{
+    uint32_t              first;
+    std::vector<uint32_t> values;
+};
+
+static int g_numFailures = 0;
+
+static void expect(const char* name, bool ok)
+{
+    printf("%s %s\n", ok ? "ok  " : "FAIL", name);
+    if (!ok)
+        g_numFailures++;
+}
+
+static std::vector<BindCall> flush(Slots& slots)
+{
+    std::vector<BindCall> calls;
+    slots.Flush([&calls](uint32_t first, uint32_t count, const uint32_t* values) {
+        BindCall call;
+        call.first = first;
+        call.values.assign(values, values + count);
+        calls.push_back(call);
+    });
+    return calls;
+}
+
+static void printCalls(const char* prefix, const std::vector<BindCall>& calls)
+{
+    printf("    %s:", prefix);
+    for (const BindCall& call : calls) {
+        printf(" %u:[", call.first);
+        for (size_t i = 0; i < call.values.size(); ++i)
+            printf(i == 0 ? "%u" : " %u", call.values[i]);
+        printf("]");
+    }
+    printf("\n");
+}
+
+// expected lists the calls as first, count and count values
+static void expectCalls(const char* name, const std::vector<BindCall>& calls, const std::vector<uint32_t>& expected)
+{
+    std::vector<BindCall> expectedCalls;
+    for (size_t i = 0; i < expected.size();) {
+        BindCall call;
+        call.first = expected[i];
+        call.values.assign(expected.begin() + i + 2, expected.begin() + i + 2 + expected[i + 1]);
+        expectedCalls.push_back(call);
+        i += 2 + expected[i + 1];
+    }
+
+    bool ok = calls.size() == expectedCalls.size();
+    for (size_t i = 0; ok && i < calls.size(); ++i)
+        ok = calls[i].first == expectedCalls[i].first && calls[i].values == expectedCalls[i].values;
+
+    expect(name, ok);
+    if (!ok) {
+        printCalls("expected", expectedCalls);
+        printCalls("got     ", calls);
+    }
+}
+
+static void testRanges()
+{
+    Slots slots;
+    expectCalls("nothing set, nothing bound", flush(slots), {});
+
+    slots.Set(0, 1);
+    slots.Set(1, 2);
+    slots.Set(2, 3);
+    slots.Set(5, 4);
+    expectCalls("contiguous slots are one call", flush(slots), { 0, 3, 1, 2, 3,  5, 1, 4 });
+
+    slots.Set(0, 1);
+    slots.Set(1, 2);
+    expectCalls("unchanged values are not bound again", flush(slots), {});
+
+    slots.Set(1, 7);
+    slots.Set(1, 2);
+    expectCalls("a value set back before the flush is not bound again", flush(slots), {});
+
+    slots.Set(62, 8);
+    slots.Set(63, 9);
+    slots.Set(64, 10);
+    slots.Set(65, 11);
+    expectCalls("ranges cross word boundaries", flush(slots), { 62, 4, 8, 9, 10, 11 });
+
+    uint32_t values[3] = { 12, 2, 13 };
+    slots.Set(0, 3, values);
+    expectCalls("Set of a range marks only the changed slots", flush(slots), { 0, 1, 12,  2, 1, 13 });
+
+    slots.Set(127, 14);
+    expectCalls("the last slot", flush(slots), { 127, 1, 14 });
+}
+
+static void testForget()
+{
+    Slots slots;
+    slots.Set(3, 5);
+    slots.Set(4, 6);
+    slots.Set(10, 5);
+    flush(slots);
+
+    // the API unbound name 5 when it was deleted, the slots must not take it as bound
+    slots.Forget(5);
+    expectCalls("forgotten slots are not unbound again", flush(slots), {});
+
+    slots.Set(3, 5);
+    slots.Set(4, 6);
+    expectCalls("a reused name is bound again", flush(slots), { 3, 1, 5 });
+
+    slots.Set(20, 7);
+    slots.Forget(7);
+    expectCalls("forgetting a pending value drops the bind", flush(slots), {});
+
+    slots.ForgetIf([](uint32_t value) { return value >= 6; });
+    slots.Set(4, 6);
+    slots.Set(5, 9);
+    expectCalls("ForgetIf", flush(slots), { 4, 2, 6, 9 });
+
+    slots.Reset();
+    expectCalls("Reset only unbinds the slots still in use", flush(slots), { 3, 3, 0, 0, 0 });
+}
+
+static void testReset()
+{
+    Slots slots;
+
+    // first range
+    slots.Set(0, 1);
+    slots.Set(1, 2);
+    slots.Set(2, 3);
+    slots.Set(8, 4);
+    flush(slots);
+
+    // the next range is delta encoded from the empty state and sets slot 1 only
+    slots.Reset();
+    slots.Set(1, 5);
+    expectCalls("slots the next range doesn't set are unbound", flush(slots), { 0, 3, 0, 5, 0,  8, 1, 0 });
+
+    // a range sorted next to one with the same bindings costs nothing
+    slots.Reset();
+    slots.Set(1, 5);
+    slots.Set(2, 6);
+    flush(slots);
+    slots.Reset();
+    slots.Set(1, 5);
+    slots.Set(2, 6);
+    expectCalls("bindings shared with the previous range are not bound again", flush(slots), {});
+
+    slots.Reset();
+    slots.Set(2, 6);
+    expectCalls("only the slots that differ from the previous range are bound", flush(slots), { 1, 1, 0 });
+
+    slots.Reset();
+    expectCalls("a reset range unbinds the rest", flush(slots), { 2, 1, 0 });
+    expectCalls("nothing left to unbind", flush(slots), {});
+
+    slots.Set(0, 1);
+    slots.Set(4, 2);
+    slots.Set(6, 3);
+    flush(slots);
+
+    slots.Reset(4);
+    slots.Set(6, 7);
+    expectCalls("Reset(first) keeps the slots below first", flush(slots), { 4, 1, 0,  6, 1, 7 });
+    expect("slot 0 is still bound", slots.Get(0) == 1);
+}
+
+int main()
+{
+    testRanges();
+    testForget();
+    testReset();
+
+    printf("%d failures\n", g_numFailures);
+    return (g_numFailures == 0) ? 0 : 1;
+}
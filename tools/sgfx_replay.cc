@@ -0,0 +1,944 @@
+/// The MIT License (MIT)
+///
+/// Copyright (c) 2015 Kirill Bazhenov
+/// Copyright (c) 2015 BitBox, Ltd.
+///
+/// Permission is hereby granted, free of charge, to any person obtaining a copy
+/// of this software and associated documentation files (the "Software"), to deal
+/// in the Software without restriction, including without limitation the rights
+/// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+/// copies of the Software, and to permit persons to whom the Software is
+/// furnished to do so, subject to the following conditions:
+///
+/// The above copyright notice and this permission notice shall be included in
+/// all copies or substantial portions of the Software.
+///
+/// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+/// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+/// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+/// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+/// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+/// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+/// THE SOFTWARE.
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sigrlinn.hh"
+#include "sigrlinn_capture.hh"
+
+// sgfx-replay: plays back a capture written by the capture layer against the linked backend
+//
+// Everything before the last captured frame is executed once to create the resources, then the
+// last frame is replayed in a loop and the CPU time spent in every phase of it is reported.
+// Objects the frame creates and does not release are released before the next iteration.
+//
+// usage: sgfx-replay <capture file> [number of frames]
+
+using namespace sgfx;
+using namespace sgfx::capture;
+
+enum
+{
+    kDefaultNumFrames  = 100,
+    kBackBufferWidth   = 1280,
+    kBackBufferHeight  = 720,
+
+    kNumPhases         = static_cast<size_t>(Phase::Count)
+};
+
+static const char* g_phaseNames[] = { "objects", "updates", "recording", "submission" };
+static_assert(sizeof(g_phaseNames) / sizeof(g_phaseNames[0]) == kNumPhases, "Phase names mismatch");
+
+//=============================================================================
+
+class CaptureReader final
+{
+    const uint8_t* data   = nullptr;
+    size_t         size   = 0;
+    size_t         offset = 0;
+    bool           failed = false;
+
+    // captured handle values to live handles, interned state objects are returned by several creates
+    struct BoundHandle
+    {
+        void*    value;
+        uint32_t refCount;
+    };
+    std::unordered_map<uint64_t, BoundHandle> handles;
+
+public:
+
+    CaptureReader(const uint8_t* ndata, size_t nsize) : data(ndata), size(nsize) {}
+
+    inline size_t GetOffset() const          { return offset; }
+    inline void   SetOffset(size_t noffset)  { offset = noffset; }
+    inline bool   IsFailed() const           { return failed; }
+
+    const void* ReadBytes(size_t numBytes)
+    {
+        if (failed || numBytes > size - offset) {
+            failed = true;
+            return nullptr;
+        }
+        const void* ptr = data + offset;
+        offset += numBytes;
+        return ptr;
+    }
+
+    template <typename T>
+    T Read()
+    {
+        T value;
+        const void* ptr = ReadBytes(sizeof(T));
+        if (ptr != nullptr)
+            memcpy(&value, ptr, sizeof(T));
+        else
+            memset(&value, 0, sizeof(T));
+        return value;
+    }
+
+    const void* ReadBlob(size_t& blobSize)
+    {
+        blobSize = static_cast<size_t>(Read<uint64_t>());
+        return ReadBytes(blobSize);
+    }
+
+    // objects created before the capture started have no live handle and replay as invalid handles
+    void* Resolve(void* captured) const
+    {
+        auto it = handles.find(reinterpret_cast<uintptr_t>(captured));
+        return (it != handles.end()) ? it->second.value : nullptr;
+    }
+
+    template <typename H>
+    H ReadHandle()
+    {
+        return H(Resolve(reinterpret_cast<void*>(static_cast<uintptr_t>(Read<uint64_t>()))));
+    }
+
+    // reads the captured value of a returned handle and maps it to the live one
+    template <typename H>
+    uint64_t Bind(H live)
+    {
+        uint64_t captured = Read<uint64_t>();
+        if (captured != 0) {
+            BoundHandle& handle = handles[captured];
+            handle.value     = live.value;
+            handle.refCount += 1;
+        }
+        return captured;
+    }
+
+    // handles are forgotten with their last release, so releases replayed again by the frame loop are skipped
+    template <typename H>
+    H ReadReleasedHandle()
+    {
+        uint64_t captured = Read<uint64_t>();
+        H        handle   = H(Resolve(reinterpret_cast<void*>(static_cast<uintptr_t>(captured))));
+        Unbind(captured);
+        return handle;
+    }
+
+    inline void Unbind(uint64_t captured)
+    {
+        auto it = handles.find(captured);
+        if (it != handles.end() && --it->second.refCount == 0)
+            handles.erase(it);
+    }
+
+    template <typename H>
+    void Patch(H& handle) const
+    {
+        handle.value = Resolve(handle.value);
+    }
+};
+
+// an object created by the replayed frame, released before the frame is replayed again
+struct FrameObject
+{
+    uint8_t  command;
+    uint64_t captured;
+    void*    value;
+};
+
+struct Replay
+{
+    std::vector<FrameObject>           frameObjects;
+    bool                               trackObjects = false;
+    std::unordered_map<void*, void*>   mappedBuffers; // buffers mapped for writing
+
+    double phaseTime[kNumPhases];
+
+    void Created(uint8_t command, uint64_t captured, void* value)
+    {
+        if (trackObjects && value != nullptr)
+            frameObjects.push_back({ command, captured, value });
+    }
+
+    void Released(void* value)
+    {
+        for (size_t i = 0; i < frameObjects.size(); ++i) {
+            if (frameObjects[i].value == value) {
+                frameObjects.erase(frameObjects.begin() + i);
+                break;
+            }
+        }
+    }
+};
+
+static void releaseFrameObject(const FrameObject& object)
+{
+    switch (object.command) {
+    case CaptureCommand::CreateVertexShader:   releaseVertexShader(VertexShaderHandle(object.value));     break;
+    case CaptureCommand::CreateHullShader:     releaseHullShader(HullShaderHandle(object.value));         break;
+    case CaptureCommand::CreateDomainShader:   releaseDomainShader(DomainShaderHandle(object.value));     break;
+    case CaptureCommand::CreateGeometryShader: releaseGeometryShader(GeometryShaderHandle(object.value)); break;
+    case CaptureCommand::CreatePixelShader:    releasePixelShader(PixelShaderHandle(object.value));       break;
+    case CaptureCommand::CreateComputeShader:  releaseComputeShader(ComputeShaderHandle(object.value));   break;
+    case CaptureCommand::LinkSurfaceShader:    releaseSurfaceShader(SurfaceShaderHandle(object.value));   break;
+    case CaptureCommand::CreateComputeQueue:   releaseComputeQueue(ComputeQueueHandle(object.value));     break;
+    case CaptureCommand::CreateVertexFormat:   releaseVertexFormat(VertexFormatHandle(object.value));     break;
+    case CaptureCommand::CreatePipelineState:  releasePipelineState(PipelineStateHandle(object.value));   break;
+    case CaptureCommand::CreateBuffer:         releaseBuffer(BufferHandle(object.value));                 break;
+    case CaptureCommand::CreateConstantBuffer: releaseConstantBuffer(ConstantBufferHandle(object.value)); break;
+    case CaptureCommand::CreateSamplerState:   releaseSamplerState(SamplerStateHandle(object.value));     break;
+    case CaptureCommand::CreateTexture:        releaseTexture(TextureHandle(object.value));               break;
+    case CaptureCommand::CreateRenderTarget:   releaseRenderTarget(RenderTargetHandle(object.value));     break;
+    case CaptureCommand::CreateDrawQueue:
+    case CaptureCommand::CreateChildDrawQueue: releaseDrawQueue(DrawQueueHandle(object.value));           break;
+    case CaptureCommand::CreateBindGroup:      releaseBindGroup(BindGroupHandle(object.value));           break;
+    case CaptureCommand::CreateDrawBundle:     releaseDrawBundle(DrawBundleHandle(object.value));         break;
+    }
+}
+
+//=============================================================================
+
+template <typename H>
+static void replayShader(CaptureReader& reader, Replay& replay, uint8_t command, H (*create)(const void*, size_t))
+{
+    size_t      size = 0;
+    const void* data = reader.ReadBlob(size);
+
+    H handle = create(data, size);
+    replay.Created(command, reader.Bind(handle), handle.value);
+}
+
+template <typename H>
+static void replayRelease(CaptureReader& reader, Replay& replay, void (*release)(H))
+{
+    H handle = reader.ReadReleasedHandle<H>();
+    if (handle.value != nullptr) {
+        replay.Released(handle.value);
+        release(handle);
+    }
+}
+
+// executes one command, returns false at the end of the stream
+static bool replayCommand(CaptureReader& reader, Replay& replay, uint8_t command)
+{
+    switch (command) {
+    case CaptureCommand::End:
+        return false;
+
+    // objects
+    case CaptureCommand::CreateVertexShader:    replayShader(reader, replay, command, createVertexShader);   break;
+    case CaptureCommand::CreateHullShader:      replayShader(reader, replay, command, createHullShader);     break;
+    case CaptureCommand::CreateDomainShader:    replayShader(reader, replay, command, createDomainShader);   break;
+    case CaptureCommand::CreateGeometryShader:  replayShader(reader, replay, command, createGeometryShader); break;
+    case CaptureCommand::CreatePixelShader:     replayShader(reader, replay, command, createPixelShader);    break;
+    case CaptureCommand::CreateComputeShader:   replayShader(reader, replay, command, createComputeShader);  break;
+    case CaptureCommand::ReleaseVertexShader:   replayRelease(reader, replay, releaseVertexShader);          break;
+    case CaptureCommand::ReleaseHullShader:     replayRelease(reader, replay, releaseHullShader);            break;
+    case CaptureCommand::ReleaseDomainShader:   replayRelease(reader, replay, releaseDomainShader);          break;
+    case CaptureCommand::ReleaseGeometryShader: replayRelease(reader, replay, releaseGeometryShader);        break;
+    case CaptureCommand::ReleasePixelShader:    replayRelease(reader, replay, releasePixelShader);           break;
+    case CaptureCommand::ReleaseComputeShader:  replayRelease(reader, replay, releaseComputeShader);         break;
+    case CaptureCommand::ReleaseSurfaceShader:  replayRelease(reader, replay, releaseSurfaceShader);         break;
+    case CaptureCommand::ReleaseComputeQueue:   replayRelease(reader, replay, releaseComputeQueue);          break;
+    case CaptureCommand::ReleaseVertexFormat:   replayRelease(reader, replay, releaseVertexFormat);          break;
+    case CaptureCommand::ReleasePipelineState:  replayRelease(reader, replay, releasePipelineState);         break;
+    case CaptureCommand::ReleaseBuffer:         replayRelease(reader, replay, releaseBuffer);                break;
+    case CaptureCommand::ReleaseConstantBuffer: replayRelease(reader, replay, releaseConstantBuffer);        break;
+    case CaptureCommand::ReleaseSamplerState:   replayRelease(reader, replay, releaseSamplerState);          break;
+    case CaptureCommand::ReleaseTexture:        replayRelease(reader, replay, releaseTexture);               break;
+    case CaptureCommand::ReleaseRenderTarget:   replayRelease(reader, replay, releaseRenderTarget);          break;
+    case CaptureCommand::ReleaseDrawQueue:      replayRelease(reader, replay, releaseDrawQueue);             break;
+    case CaptureCommand::ReleaseBindGroup:      replayRelease(reader, replay, releaseBindGroup);             break;
+    case CaptureCommand::ReleaseDrawBundle:     replayRelease(reader, replay, releaseDrawBundle);            break;
+
+    case CaptureCommand::LinkSurfaceShader: {
+        VertexShaderHandle   vs = reader.ReadHandle<VertexShaderHandle>();
+        HullShaderHandle     hs = reader.ReadHandle<HullShaderHandle>();
+        DomainShaderHandle   ds = reader.ReadHandle<DomainShaderHandle>();
+        GeometryShaderHandle gs = reader.ReadHandle<GeometryShaderHandle>();
+        PixelShaderHandle    ps = reader.ReadHandle<PixelShaderHandle>();
+
+        SurfaceShaderHandle handle = linkSurfaceShader(vs, hs, ds, gs, ps);
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::CreateComputeQueue: {
+        ComputeQueueHandle handle = createComputeQueue(reader.ReadHandle<ComputeShaderHandle>());
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::CreateVertexFormat: {
+        size_t count = static_cast<size_t>(reader.Read<uint64_t>());
+
+        std::vector<std::string>             names(count);
+        std::vector<VertexElementDescriptor> elements(count);
+        for (size_t i = 0; i < count; ++i) {
+            size_t      size = 0;
+            const void* name = reader.ReadBlob(size);
+            if (name != nullptr)
+                names[i].assign(static_cast<const char*>(name), size);
+            elements[i] = reader.Read<VertexElementDescriptor>();
+        }
+        for (size_t i = 0; i < count; ++i)
+            elements[i].semanticName = names[i].empty() ? nullptr : names[i].c_str();
+
+        size_t      bytecodeSize = 0;
+        const void* bytecode     = reader.ReadBlob(bytecodeSize);
+
+        VertexFormatHandle handle = createVertexFormat(elements.data(), count, const_cast<void*>(bytecode), bytecodeSize, nullptr);
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::CreatePipelineState: {
+        PipelineStateDescriptor desc = reader.Read<PipelineStateDescriptor>();
+        reader.Patch(desc.shader);
+        reader.Patch(desc.vertexFormat);
+
+        PipelineStateHandle handle = createPipelineState(desc);
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::CreateBuffer: {
+        uint32_t    flags    = reader.Read<uint32_t>();
+        bool        hasData  = reader.Read<uint8_t>() != 0;
+        size_t      dataSize = 0;
+        const void* data     = reader.ReadBlob(dataSize);
+        size_t      size     = static_cast<size_t>(reader.Read<uint64_t>());
+        size_t      stride   = static_cast<size_t>(reader.Read<uint64_t>());
+
+        BufferHandle handle = createBuffer(flags, hasData ? data : nullptr, size, stride);
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::CreateConstantBuffer: {
+        bool        hasData  = reader.Read<uint8_t>() != 0;
+        size_t      dataSize = 0;
+        const void* data     = reader.ReadBlob(dataSize);
+        size_t      size     = static_cast<size_t>(reader.Read<uint64_t>());
+
+        ConstantBufferHandle handle = createConstantBuffer(hasData ? data : nullptr, size);
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::CreateSamplerState: {
+        SamplerStateHandle handle = createSamplerState(reader.Read<SamplerStateDescriptor>());
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::CreateTexture: {
+        uint8_t    dimensions = reader.Read<uint8_t>();
+        uint32_t   width      = reader.Read<uint32_t>();
+        uint32_t   height     = reader.Read<uint32_t>();
+        uint32_t   depth      = reader.Read<uint32_t>();
+        DataFormat format     = reader.Read<DataFormat>();
+        uint32_t   numMipmaps = reader.Read<uint32_t>();
+        uint32_t   flags      = reader.Read<uint32_t>();
+
+        TextureHandle handle;
+        switch (dimensions) {
+        case 1:  handle = createTexture1D(width, format, numMipmaps, flags);                break;
+        case 2:  handle = createTexture2D(width, height, format, numMipmaps, flags);        break;
+        default: handle = createTexture3D(width, height, depth, format, numMipmaps, flags); break;
+        }
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::GetBackBuffer:
+        reader.Bind(getBackBuffer());
+        break;
+
+    case CaptureCommand::CreateRenderTarget: {
+        RenderTargetDescriptor desc = reader.Read<RenderTargetDescriptor>();
+        for (uint32_t i = 0; i < RenderTargetSlot::Count; ++i)
+            reader.Patch(desc.colorTextures[i]);
+        reader.Patch(desc.depthStencilTexture);
+
+        RenderTargetHandle handle = createRenderTarget(desc);
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::CreateDrawQueue: {
+        DrawQueueHandle handle = createDrawQueue(reader.ReadHandle<PipelineStateHandle>());
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::CreateChildDrawQueue: {
+        DrawQueueHandle handle = createChildDrawQueue(reader.ReadHandle<DrawQueueHandle>());
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::CreateBindGroup: {
+        BindGroupDescriptor desc = reader.Read<BindGroupDescriptor>();
+        for (uint32_t i = 0; i < BindGroupDescriptor::kMaxConstantBuffers; ++i)
+            reader.Patch(desc.constantBuffers[i]);
+        for (uint32_t i = 0; i < BindGroupDescriptor::kMaxShaderResources; ++i) {
+            reader.Patch(desc.buffers[i]);
+            reader.Patch(desc.textures[i]);
+        }
+        for (uint32_t i = 0; i < BindGroupDescriptor::kMaxSamplerStates; ++i)
+            reader.Patch(desc.samplerStates[i]);
+
+        BindGroupHandle handle = createBindGroup(desc);
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    case CaptureCommand::CreateDrawBundle: {
+        DrawBundleHandle handle = createDrawBundle(reader.ReadHandle<DrawQueueHandle>());
+        replay.Created(command, reader.Bind(handle), handle.value);
+    } break;
+
+    // resource updates
+    case CaptureCommand::MapBuffer: {
+        BufferHandle handle = reader.ReadHandle<BufferHandle>();
+        MapType      type   = reader.Read<MapType>();
+        size_t       offset = static_cast<size_t>(reader.Read<uint64_t>());
+        size_t       size   = static_cast<size_t>(reader.Read<uint64_t>());
+
+        void* data = mapBuffer(handle, type, offset, size);
+        if (type != MapType::Read)
+            replay.mappedBuffers[handle.value] = data;
+    } break;
+
+    case CaptureCommand::UnmapBuffer: {
+        BufferHandle handle = reader.ReadHandle<BufferHandle>();
+        bool         write  = reader.Read<uint8_t>() != 0;
+        size_t       size   = 0;
+        const void*  data   = reader.ReadBlob(size);
+
+        auto it = replay.mappedBuffers.find(handle.value);
+        if (it != replay.mappedBuffers.end()) {
+            if (write && it->second != nullptr && data != nullptr)
+                memcpy(it->second, data, size);
+            replay.mappedBuffers.erase(it);
+        }
+        unmapBuffer(handle);
+    } break;
+
+    case CaptureCommand::CopyBufferData: {
+        BufferHandle handle = reader.ReadHandle<BufferHandle>();
+        size_t       offset = static_cast<size_t>(reader.Read<uint64_t>());
+        size_t       size   = 0;
+        const void*  data   = reader.ReadBlob(size);
+        copyBufferData(handle, offset, size, data);
+    } break;
+
+    case CaptureCommand::ClearBufferRWUint: {
+        BufferHandle handle = reader.ReadHandle<BufferHandle>();
+        clearBufferRW(handle, reader.Read<uint32_t>());
+    } break;
+
+    case CaptureCommand::ClearBufferRWFloat: {
+        BufferHandle handle = reader.ReadHandle<BufferHandle>();
+        clearBufferRW(handle, reader.Read<float>());
+    } break;
+
+    case CaptureCommand::UpdateConstantBuffer: {
+        ConstantBufferHandle handle = reader.ReadHandle<ConstantBufferHandle>();
+        size_t               size   = 0;
+        const void*          data   = reader.ReadBlob(size);
+        updateConstantBuffer(handle, data);
+    } break;
+
+    case CaptureCommand::MapTexture: {
+        TextureHandle handle = reader.ReadHandle<TextureHandle>();
+        mapTexture(handle, reader.Read<MapType>());
+    } break;
+
+    case CaptureCommand::UnmapTexture:
+        unmapTexture(reader.ReadHandle<TextureHandle>());
+        break;
+
+    case CaptureCommand::UpdateTexture: {
+        TextureHandle handle = reader.ReadHandle<TextureHandle>();
+        uint32_t      mip    = reader.Read<uint32_t>();
+
+        size_t args[8];
+        for (size_t& arg : args)
+            arg = static_cast<size_t>(reader.Read<uint64_t>());
+
+        size_t      size = 0;
+        const void* data = reader.ReadBlob(size);
+        updateTexture(handle, data, mip, args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7]);
+    } break;
+
+    case CaptureCommand::ClearTextureRWUint: {
+        TextureHandle handle = reader.ReadHandle<TextureHandle>();
+        clearTextureRW(handle, reader.Read<uint32_t>());
+    } break;
+
+    case CaptureCommand::ClearTextureRWFloat: {
+        TextureHandle handle = reader.ReadHandle<TextureHandle>();
+        clearTextureRW(handle, reader.Read<float>());
+    } break;
+
+    case CaptureCommand::CopyTexture: {
+        TextureHandle src = reader.ReadHandle<TextureHandle>();
+        copyResource(src, reader.ReadHandle<TextureHandle>());
+    } break;
+
+    case CaptureCommand::CopyBuffer: {
+        BufferHandle src = reader.ReadHandle<BufferHandle>();
+        copyResource(src, reader.ReadHandle<BufferHandle>());
+    } break;
+
+    case CaptureCommand::CopyConstantBuffer: {
+        ConstantBufferHandle src = reader.ReadHandle<ConstantBufferHandle>();
+        copyResource(src, reader.ReadHandle<ConstantBufferHandle>());
+    } break;
+
+    // recording
+    case CaptureCommand::ComputeSetConstantBuffer: {
+        ComputeQueueHandle handle = reader.ReadHandle<ComputeQueueHandle>();
+        uint32_t           idx    = reader.Read<uint32_t>();
+        setConstantBuffer(handle, idx, reader.ReadHandle<ConstantBufferHandle>());
+    } break;
+
+    case CaptureCommand::ComputeSetResourceBuffer: {
+        ComputeQueueHandle handle = reader.ReadHandle<ComputeQueueHandle>();
+        uint32_t           idx    = reader.Read<uint32_t>();
+        setResource(handle, idx, reader.ReadHandle<BufferHandle>());
+    } break;
+
+    case CaptureCommand::ComputeSetResourceTexture: {
+        ComputeQueueHandle handle = reader.ReadHandle<ComputeQueueHandle>();
+        uint32_t           idx    = reader.Read<uint32_t>();
+        setResource(handle, idx, reader.ReadHandle<TextureHandle>());
+    } break;
+
+    case CaptureCommand::ComputeSetResourceRWBuffer: {
+        ComputeQueueHandle handle = reader.ReadHandle<ComputeQueueHandle>();
+        uint32_t           idx    = reader.Read<uint32_t>();
+        setResourceRW(handle, idx, reader.ReadHandle<BufferHandle>());
+    } break;
+
+    case CaptureCommand::ComputeSetResourceRWTexture: {
+        ComputeQueueHandle handle = reader.ReadHandle<ComputeQueueHandle>();
+        uint32_t           idx    = reader.Read<uint32_t>();
+        setResourceRW(handle, idx, reader.ReadHandle<TextureHandle>());
+    } break;
+
+    case CaptureCommand::SetSamplerState: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        uint32_t        idx    = reader.Read<uint32_t>();
+        setSamplerState(handle, idx, reader.ReadHandle<SamplerStateHandle>());
+    } break;
+
+    case CaptureCommand::SetPrimitiveTopology: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        setPrimitiveTopology(handle, reader.Read<PrimitiveTopology>());
+    } break;
+
+    case CaptureCommand::SetVertexBuffer: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        BufferHandle    vb     = reader.ReadHandle<BufferHandle>();
+        setVertexBuffer(handle, vb, reader.Read<uint32_t>());
+    } break;
+
+    case CaptureCommand::SetIndexBuffer: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        setIndexBuffer(handle, reader.ReadHandle<BufferHandle>());
+    } break;
+
+    case CaptureCommand::SetConstantBuffer: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        uint32_t        idx    = reader.Read<uint32_t>();
+        setConstantBuffer(handle, idx, reader.ReadHandle<ConstantBufferHandle>());
+    } break;
+
+    case CaptureCommand::SetConstants: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        uint32_t        idx    = reader.Read<uint32_t>();
+        size_t          size   = 0;
+        const void*     data   = reader.ReadBlob(size);
+        setConstants(handle, idx, data, size);
+    } break;
+
+    case CaptureCommand::SetResourceBuffer: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        uint32_t        idx    = reader.Read<uint32_t>();
+        setResource(handle, idx, reader.ReadHandle<BufferHandle>());
+    } break;
+
+    case CaptureCommand::SetResourceTexture: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        uint32_t        idx    = reader.Read<uint32_t>();
+        setResource(handle, idx, reader.ReadHandle<TextureHandle>());
+    } break;
+
+    case CaptureCommand::SetBindGroup: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        uint32_t        idx    = reader.Read<uint32_t>();
+        setBindGroup(handle, idx, reader.ReadHandle<BindGroupHandle>());
+    } break;
+
+    case CaptureCommand::Draw: {
+        DrawQueueHandle handle      = reader.ReadHandle<DrawQueueHandle>();
+        uint32_t        count       = reader.Read<uint32_t>();
+        uint32_t        startVertex = reader.Read<uint32_t>();
+        draw(handle, count, startVertex);
+    } break;
+
+    case CaptureCommand::DrawIndexed: {
+        DrawQueueHandle handle      = reader.ReadHandle<DrawQueueHandle>();
+        uint32_t        count       = reader.Read<uint32_t>();
+        uint32_t        startIndex  = reader.Read<uint32_t>();
+        uint32_t        startVertex = reader.Read<uint32_t>();
+        drawIndexed(handle, count, startIndex, startVertex);
+    } break;
+
+    case CaptureCommand::DrawInstanced: {
+        DrawQueueHandle handle        = reader.ReadHandle<DrawQueueHandle>();
+        uint32_t        instanceCount = reader.Read<uint32_t>();
+        uint32_t        count         = reader.Read<uint32_t>();
+        uint32_t        startVertex   = reader.Read<uint32_t>();
+        uint32_t        startInstance = reader.Read<uint32_t>();
+        drawInstanced(handle, instanceCount, count, startVertex, startInstance);
+    } break;
+
+    case CaptureCommand::DrawIndexedInstanced: {
+        DrawQueueHandle handle        = reader.ReadHandle<DrawQueueHandle>();
+        uint32_t        instanceCount = reader.Read<uint32_t>();
+        uint32_t        count         = reader.Read<uint32_t>();
+        uint32_t        startIndex    = reader.Read<uint32_t>();
+        uint32_t        startVertex   = reader.Read<uint32_t>();
+        uint32_t        startInstance = reader.Read<uint32_t>();
+        drawIndexedInstanced(handle, instanceCount, count, startIndex, startVertex, startInstance);
+    } break;
+
+    case CaptureCommand::DrawInstancedIndirect: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        BufferHandle    args   = reader.ReadHandle<BufferHandle>();
+        drawInstancedIndirect(handle, args, static_cast<size_t>(reader.Read<uint64_t>()));
+    } break;
+
+    case CaptureCommand::DrawIndexedInstancedIndirect: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        BufferHandle    args   = reader.ReadHandle<BufferHandle>();
+        drawIndexedInstancedIndirect(handle, args, static_cast<size_t>(reader.Read<uint64_t>()));
+    } break;
+
+    case CaptureCommand::MultiDrawIndexedIndirect: {
+        DrawQueueHandle handle      = reader.ReadHandle<DrawQueueHandle>();
+        BufferHandle    args        = reader.ReadHandle<BufferHandle>();
+        size_t          argsOffset  = static_cast<size_t>(reader.Read<uint64_t>());
+        uint32_t        maxDraws    = reader.Read<uint32_t>();
+        BufferHandle    countBuffer = reader.ReadHandle<BufferHandle>();
+        size_t          countOffset = static_cast<size_t>(reader.Read<uint64_t>());
+        uint32_t        stride      = reader.Read<uint32_t>();
+        multiDrawIndexedIndirect(handle, args, argsOffset, maxDraws, countBuffer, countOffset, stride);
+    } break;
+
+    case CaptureCommand::SetSortKey: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        setSortKey(handle, reader.Read<uint64_t>());
+    } break;
+
+    case CaptureCommand::SetDrawMerging: {
+        DrawQueueHandle handle = reader.ReadHandle<DrawQueueHandle>();
+        setDrawMerging(handle, reader.Read<uint8_t>() != 0);
+    } break;
+
+    case CaptureCommand::BundleSetConstantBuffer: {
+        DrawBundleHandle handle = reader.ReadHandle<DrawBundleHandle>();
+        uint32_t         idx    = reader.Read<uint32_t>();
+        setConstantBuffer(handle, idx, reader.ReadHandle<ConstantBufferHandle>());
+    } break;
+
+    case CaptureCommand::BundleSetResourceBuffer: {
+        DrawBundleHandle handle = reader.ReadHandle<DrawBundleHandle>();
+        uint32_t         idx    = reader.Read<uint32_t>();
+        setResource(handle, idx, reader.ReadHandle<BufferHandle>());
+    } break;
+
+    case CaptureCommand::BundleSetResourceTexture: {
+        DrawBundleHandle handle = reader.ReadHandle<DrawBundleHandle>();
+        uint32_t         idx    = reader.Read<uint32_t>();
+        setResource(handle, idx, reader.ReadHandle<TextureHandle>());
+    } break;
+
+    // submission
+    case CaptureCommand::ComputeSubmit: {
+        ComputeQueueHandle handle = reader.ReadHandle<ComputeQueueHandle>();
+        uint32_t           x      = reader.Read<uint32_t>();
+        uint32_t           y      = reader.Read<uint32_t>();
+        uint32_t           z      = reader.Read<uint32_t>();
+        submit(handle, x, y, z);
+    } break;
+
+    case CaptureCommand::Submit:
+        submit(reader.ReadHandle<DrawQueueHandle>());
+        break;
+
+    case CaptureCommand::SubmitMultiple: {
+        size_t count = static_cast<size_t>(reader.Read<uint64_t>());
+
+        std::vector<DrawQueueHandle> queues(count);
+        for (DrawQueueHandle& queue : queues)
+            queue = reader.ReadHandle<DrawQueueHandle>();
+        submit(queues.data(), count);
+    } break;
+
+    case CaptureCommand::SubmitBundle:
+        submitBundle(reader.ReadHandle<DrawBundleHandle>());
+        break;
+
+    case CaptureCommand::SetViewport: {
+        uint32_t width    = reader.Read<uint32_t>();
+        uint32_t height   = reader.Read<uint32_t>();
+        float    minDepth = reader.Read<float>();
+        float    maxDepth = reader.Read<float>();
+        setViewport(width, height, minDepth, maxDepth);
+    } break;
+
+    case CaptureCommand::RenderTargetSetResourceRWBuffer: {
+        RenderTargetHandle handle = reader.ReadHandle<RenderTargetHandle>();
+        uint32_t           slot   = reader.Read<uint32_t>();
+        setResourceRW(handle, slot, reader.ReadHandle<BufferHandle>());
+    } break;
+
+    case CaptureCommand::RenderTargetSetResourceRWTexture: {
+        RenderTargetHandle handle = reader.ReadHandle<RenderTargetHandle>();
+        uint32_t           slot   = reader.Read<uint32_t>();
+        setResourceRW(handle, slot, reader.ReadHandle<TextureHandle>());
+    } break;
+
+    case CaptureCommand::SetRenderTarget:
+        setRenderTarget(reader.ReadHandle<RenderTargetHandle>());
+        break;
+
+    case CaptureCommand::ClearRenderTarget: {
+        RenderTargetHandle handle = reader.ReadHandle<RenderTargetHandle>();
+        clearRenderTarget(handle, reader.Read<uint32_t>());
+    } break;
+
+    case CaptureCommand::ClearRenderTargetSlot: {
+        RenderTargetHandle handle = reader.ReadHandle<RenderTargetHandle>();
+        uint32_t           slot   = reader.Read<uint32_t>();
+        clearRenderTarget(handle, slot, reader.Read<uint32_t>());
+    } break;
+
+    case CaptureCommand::ClearDepthStencil: {
+        RenderTargetHandle handle = reader.ReadHandle<RenderTargetHandle>();
+        float              depth  = reader.Read<float>();
+        clearDepthStencil(handle, depth, reader.Read<uint8_t>());
+    } break;
+
+    case CaptureCommand::Flush:
+        flush();
+        break;
+
+    case CaptureCommand::Present:
+        present(reader.Read<uint32_t>());
+        break;
+
+    case CaptureCommand::EndFrame:
+        endFrame();
+        break;
+
+    default:
+        fprintf(stderr, "unknown capture command %u at offset %zu\n", command, reader.GetOffset() - 1);
+        return false;
+    }
+
+    return !reader.IsFailed();
+}
+
+// executes [begin, end) of the stream and adds the time spent in every phase to the replay
+static bool replayRange(CaptureReader& reader, Replay& replay, size_t begin, size_t end)
+{
+    for (double& time : replay.phaseTime)
+        time = 0.0;
+
+    reader.SetOffset(begin);
+
+    auto  phaseStart = std::chrono::high_resolution_clock::now();
+    Phase phase      = Phase::Objects;
+
+    while (reader.GetOffset() < end) {
+        uint8_t command   = reader.Read<uint8_t>();
+        Phase   nextPhase = getPhase(command);
+
+        if (nextPhase != phase) {
+            auto now = std::chrono::high_resolution_clock::now();
+            replay.phaseTime[static_cast<size_t>(phase)] += std::chrono::duration<double>(now - phaseStart).count();
+
+            phase      = nextPhase;
+            phaseStart = now;
+        }
+
+        if (!replayCommand(reader, replay, command))
+            return !reader.IsFailed() && command == CaptureCommand::End;
+    }
+
+    auto now = std::chrono::high_resolution_clock::now();
+    replay.phaseTime[static_cast<size_t>(phase)] += std::chrono::duration<double>(now - phaseStart).count();
+    return true;
+}
+
+static bool loadFile(const char* path, std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    data.resize(size > 0 ? static_cast<size_t>(size) : 0);
+    bool result = size > 0 && fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("usage: %s <capture file> [number of frames]\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t numFrames = (argc > 2) ? static_cast<uint32_t>(atoi(argv[2])) : kDefaultNumFrames;
+    if (numFrames == 0)
+        numFrames = 1;
+
+    std::vector<uint8_t> data;
+    if (!loadFile(argv[1], data) || data.size() < sizeof(CaptureHeader) + sizeof(uint64_t)) {
+        fprintf(stderr, "can't read %s\n", argv[1]);
+        return 1;
+    }
+
+    CaptureReader reader(data.data(), data.size());
+
+    CaptureHeader header = reader.Read<CaptureHeader>();
+    if (header.magic != kMagic || header.version != kVersion) {
+        fprintf(stderr, "%s is not a sigrlinn capture\n", argv[1]);
+        return 1;
+    }
+    if (header.pointerSize != sizeof(void*)) {
+        fprintf(stderr, "%s was captured by a %u-bit build\n", argv[1], header.pointerSize * 8);
+        return 1;
+    }
+
+    // frame table
+    uint64_t tableOffset = 0;
+    memcpy(&tableOffset, data.data() + data.size() - sizeof(uint64_t), sizeof(uint64_t));
+
+    reader.SetOffset(static_cast<size_t>(tableOffset));
+    uint64_t numCapturedFrames = reader.Read<uint64_t>();
+
+    std::vector<uint64_t> frames(static_cast<size_t>(numCapturedFrames) * 2);
+    for (uint64_t& offset : frames)
+        offset = reader.Read<uint64_t>();
+
+    if (reader.IsFailed() || numCapturedFrames == 0) {
+        fprintf(stderr, "%s has no complete frames\n", argv[1]);
+        return 1;
+    }
+
+    size_t frameBegin = static_cast<size_t>(frames[frames.size() - 2]);
+    size_t frameEnd   = static_cast<size_t>(frames[frames.size() - 1]);
+
+    // TODO: other backends need a device and a window
+    if (!initNull(kBackBufferWidth, kBackBufferHeight)) {
+        fprintf(stderr, "failed to initialize the backend\n");
+        return 1;
+    }
+
+    Replay replay;
+    if (!replayRange(reader, replay, sizeof(CaptureHeader), frameBegin)) {
+        fprintf(stderr, "failed to replay the capture setup at offset %zu\n", reader.GetOffset());
+        return 1;
+    }
+
+    printf("%s: %llu captured frames, replaying the last one (%zu bytes) %u times\n\n",
+        argv[1], static_cast<unsigned long long>(numCapturedFrames), frameEnd - frameBegin, numFrames
+    );
+
+    double totalTime[kNumPhases] = {};
+    double minTime[kNumPhases];
+    double maxTime[kNumPhases]   = {};
+    double minFrameTime            = 1e30;
+    double maxFrameTime            = 0.0;
+    for (double& time : minTime)
+        time = 1e30;
+
+    null::resetStats();
+
+    for (uint32_t frame = 0; frame < numFrames; ++frame) {
+        // objects left by the previous iteration, the last one keeps them for the rest of the capture
+        // in reverse, child queues and bundles go before their parents
+        for (size_t i = replay.frameObjects.size(); i > 0; --i) {
+            reader.Unbind(replay.frameObjects[i - 1].captured);
+            releaseFrameObject(replay.frameObjects[i - 1]);
+        }
+        replay.frameObjects.clear();
+
+        replay.trackObjects = true;
+        bool result = replayRange(reader, replay, frameBegin, frameEnd);
+        replay.trackObjects = false;
+
+        if (!result) {
+            fprintf(stderr, "failed to replay the frame at offset %zu\n", reader.GetOffset());
+            return 1;
+        }
+
+        double frameTime = 0.0;
+        for (size_t i = 0; i < kNumPhases; ++i) {
+            totalTime[i] += replay.phaseTime[i];
+            minTime[i]    = std::min(minTime[i], replay.phaseTime[i]);
+            maxTime[i]    = std::max(maxTime[i], replay.phaseTime[i]);
+            frameTime    += replay.phaseTime[i];
+        }
+        minFrameTime = std::min(minFrameTime, frameTime);
+        maxFrameTime = std::max(maxFrameTime, frameTime);
+
+    }
+
+    printf("%-16s %12s %12s %12s\n", "phase", "avg ms", "min ms", "max ms");
+
+    double frameTotal = 0.0;
+    for (size_t i = 0; i < kNumPhases; ++i) {
+        printf("%-16s %12.4f %12.4f %12.4f\n",
+            g_phaseNames[i], totalTime[i] * 1000.0 / numFrames, minTime[i] * 1000.0, maxTime[i] * 1000.0
+        );
+        frameTotal += totalTime[i];
+    }
+    printf("%-16s %12.4f %12.4f %12.4f\n", "frame", frameTotal * 1000.0 / numFrames, minFrameTime * 1000.0, maxFrameTime * 1000.0);
+
+    const null::Stats& stats = null::getStats();
+    printf("\nper frame: %llu submits, %llu commands, %llu draw calls, %llu bind calls, %llu dispatches\n",
+        static_cast<unsigned long long>(stats.numSubmits / numFrames),
+        static_cast<unsigned long long>(stats.numCommands / numFrames),
+        static_cast<unsigned long long>(stats.numDrawCalls / numFrames),
+        static_cast<unsigned long long>(stats.numBindCalls / numFrames),
+        static_cast<unsigned long long>(stats.numDispatches / numFrames)
+    );
+
+    // whatever the capture released after its last frame
+    replayRange(reader, replay, frameEnd, static_cast<size_t>(tableOffset));
+
+    shutdown();
+    return 0;
+}